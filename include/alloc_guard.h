@@ -0,0 +1,35 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Debug build only (env:alloc_guard): malloc, calloc and realloc are
+// wrapped at link time and every call after allocGuardArm() is counted
+// against the task that made it
+#ifndef ALLOC_GUARD
+#define ALLOC_GUARD 0
+#endif
+
+// 1: abort on the first allocation a strict task makes after arming, the
+// panic backtrace shows the caller
+#ifndef ALLOC_GUARD_ASSERT
+#define ALLOC_GUARD_ASSERT 0
+#endif
+
+#define ALLOC_GUARD_TASKS 6 // tasks tracked by name, the rest are counted as "other"
+
+#if ALLOC_GUARD
+
+// Tasks are matched by their FreeRTOS name; call before arming. Strict
+// tasks must not allocate at all once armed.
+void     allocGuardWatch(const char *taskName, bool strict);
+
+// Boot complete: from here on allocations are counted
+void     allocGuardArm();
+
+// Allocations made by strict tasks since arming
+uint32_t allocGuardViolations();
+
+// "ui 0, network 12/3400B, ..." allocations/bytes per watched task
+int      allocGuardFormat(char *out, size_t size);
+
+#endif
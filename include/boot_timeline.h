@@ -0,0 +1,34 @@
+#pragma once
+
+#include <Arduino.h>
+
+enum BootPhase {
+    BOOT_STORAGE,     // settings and subscriptions loaded
+    BOOT_DISPLAY,     // panel initialized
+    BOOT_TASKS,       // sensor, motion and UI tasks running
+    BOOT_FIRST_FRAME, // first data frame handed to the panel
+    BOOT_RESTORED,    // last known values back from the history log
+    BOOT_WIFI,        // joined the AP
+    BOOT_MQTT,        // broker connected
+    BOOT_TIME,        // NTP synced
+    BOOT_PHASE_COUNT
+};
+
+// millis() at which each boot phase completed. Every phase is marked by
+// one task and only the first mark counts, so no locking is needed.
+class BootTimeline {
+    public:
+        void     mark(uint8_t phase) {
+            if(at[phase] == 0)
+                at[phase] = millis() > 0 ? millis() : 1;
+        }
+
+        bool     isMarked(uint8_t phase) const { return at[phase] != 0; }
+        uint32_t elapsed(uint8_t phase) const { return at[phase]; }
+
+        // "storage=12 display=80 ..." with "-" for phases not reached yet
+        int      format(char *out, size_t size) const;
+
+    private:
+        volatile uint32_t at[BOOT_PHASE_COUNT] = {};
+};
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Standard CRC-32 (IEEE 802.3, same as zlib.crc32), start with crc = 0
+// and feed chunks by passing the previous result back in
+uint32_t crc32Update(uint32_t crc, const void *data, size_t length);
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+
+#define SCHEDULER_MAX_JOBS 8 // job ids are 0 .. SCHEDULER_MAX_JOBS - 1
+
+// Pending jobs as a binary min-heap on their deadline (epoch seconds), so
+// the caller only ever looks at the earliest one and can sleep until it.
+// Every job id is in the heap at most once; scheduling it again moves it.
+// Times are passed in by the caller.
+class DeadlineScheduler {
+    public:
+        DeadlineScheduler();
+
+        void schedule(uint8_t job, uint32_t due);
+        void cancel(uint8_t job);
+        bool isScheduled(uint8_t job) const { return job < SCHEDULER_MAX_JOBS && position[job] >= 0; }
+        bool deadline(uint8_t job, uint32_t *due) const;
+
+        // Earliest deadline, false if nothing is scheduled
+        bool next(uint8_t *job, uint32_t *due) const;
+
+        // Remove the earliest job if it is due at `now`, -1 if none is
+        int  popDue(uint32_t now, uint32_t *due);
+
+    private:
+        struct Entry {
+                uint32_t due;
+                uint8_t  job;
+        };
+
+        void    place(uint8_t index, const Entry &entry);
+        void    siftUp(uint8_t index);
+        void    siftDown(uint8_t index);
+        void    removeAt(uint8_t index);
+
+        Entry   heap[SCHEDULER_MAX_JOBS];
+        uint8_t count = 0;
+        int8_t  position[SCHEDULER_MAX_JOBS]; // heap index per job, -1 if not scheduled
+};
+
+// Epoch of the next local time-of-day minuteOfDay strictly after `after`,
+// and of the latest one at or before `at`. Calendar math goes through the
+// C library's local time, so the TZ set by configTime() and DST apply.
+uint32_t nextDailyDeadline(uint32_t after, uint16_t minuteOfDay);
+uint32_t lastDailyDeadline(uint32_t at, uint16_t minuteOfDay);
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdint.h>
+
+#define DISPENSE_FAST_FRACTION  0.9f   // share of the target the first, full speed move aims for
+#define DISPENSE_TOLERANCE      1.0f   // g below target that counts as done; top-ups aim at half of it
+#define DISPENSE_MIN_STEPS      32     // smallest top-up move
+#define DISPENSE_MAX_MOVES      8
+#define DISPENSE_SETTLE_TIMEOUT 4000   // ms to wait for a settled reading before using what we have
+#define DISPENSE_TIMEOUT        300000 // ms for the whole feed
+#define DISPENSE_LEARN_ALPHA    0.5f   // weight of the latest feed in GramsPerRotation
+
+enum DispenseCommand {
+    DISPENSE_WAIT,  // nothing to do this round
+    DISPENSE_MOVE,  // start a move of `steps`, slowly if `slow`
+    DISPENSE_STOP,  // the target is reached, brake the running move
+    DISPENSE_DONE,  // finished, dispensed() holds the measured grams
+    DISPENSE_FAILED // gave up (timeout, empty hopper, jam); dispensed() is still valid
+};
+
+struct DispenseAction {
+        DispenseCommand command;
+        uint32_t        steps;
+        bool            slow;
+};
+
+// Closed-loop feeding by weight. Pure logic: it is fed the filtered scale
+// reading and the motor state every loop and answers with what the motor
+// should do. A full speed move covers most of the target, braking early
+// if the scale already shows enough; slow top-ups sized from the rate
+// measured so far close the rest. Each finished feed refines the
+// grams-per-rotation estimate used to size the next one.
+class DispenseController {
+    public:
+        void           start(float targetGrams, float gramsPerRotation, uint32_t stepsPerRev, uint32_t now);
+        void           cancel() { active = false; }
+
+        // weight: filtered grams; moving/stepped: motor running, pulses of its current/last move
+        DispenseAction update(uint32_t now, float weight, bool settled, bool moving, uint32_t stepped);
+
+        bool           isActive() const { return active; }
+        float          dispensed() const { return dispensedGrams; }
+        uint32_t       totalSteps() const { return stepsDone; }
+
+        // GramsPerRotation blended with what the last feed measured
+        float          learnedGramsPerRotation() const { return gramsPerRotation; }
+
+    private:
+        enum Phase {
+            PHASE_BASELINE,
+            PHASE_MOVING,
+            PHASE_SETTLING
+        };
+
+        DispenseAction move(uint32_t steps, bool slow, float stopAt);
+        DispenseAction finish(DispenseCommand result);
+        uint32_t       gramsToSteps(float grams, float gramsPerStep) const;
+
+        bool           active           = false;
+        Phase          phase            = PHASE_BASELINE;
+        float          target           = 0.0f;
+        float          gramsPerRotation = 0.0f;
+        uint32_t       stepsPerRev      = 1;
+        uint32_t       startedAt        = 0;
+        uint32_t       deadline         = 0;
+
+        float          baseline         = 0.0f;
+        float          stopAt           = 0.0f; // brake the running move at this many grams
+        bool           stopSent         = false;
+        uint8_t        moves            = 0;
+        uint32_t       stepsDone        = 0;
+        float          dispensedGrams   = 0.0f;
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <Arduino.h>
+#include <U8g2lib.h>
+
+#define FRAME_TILE_WIDTH  16 // 128 px / 8
+#define FRAME_TILE_HEIGHT 8  // 64 px / 8
+#define FRAME_BUFFER_SIZE (FRAME_TILE_WIDTH * FRAME_TILE_HEIGHT * 8)
+
+struct DisplayStats {
+        uint32_t framesRendered = 0; // frames that were re-rasterized and submitted
+        uint32_t framesSkipped  = 0; // loop passes where nothing on screen changed
+        uint32_t bytesSent      = 0; // display RAM bytes pushed over SPI
+};
+
+// Whatever moves finished tiles to the panel. The flush task is the only
+// caller, so implementations don't need to be thread safe.
+class DisplayTransport {
+    public:
+        virtual ~DisplayTransport() {}
+
+        // Write `count` 8x8 tiles starting at tile column `tx` of page `page`
+        virtual void writeTiles(uint8_t tx, uint8_t page, uint8_t count, uint8_t *tiles) = 0;
+        virtual void setContrast(uint8_t value)                                          = 0;
+};
+
+// Sends tiles through the u8x8 layer of a u8g2 display
+class U8g2Transport : public DisplayTransport {
+    public:
+        explicit U8g2Transport(U8G2 &display) :
+            display(display) {}
+
+        void writeTiles(uint8_t tx, uint8_t page, uint8_t count, uint8_t *tiles) override;
+        void setContrast(uint8_t value) override;
+
+    private:
+        U8G2 &display;
+};
+
+// Double buffered panel flush. The u8g2 buffer is the back buffer the
+// main loop draws into; submit() copies the tiles that changed into the
+// front buffer and wakes a FreeRTOS task that pushes them to the panel
+// while the loop carries on. Frames are numbered so producers can tell
+// when their frame reached the glass.
+class DisplayFlusher {
+    public:
+        DisplayFlusher(U8G2 &display, DisplayTransport &transport) :
+            display(display),
+            transport(transport) {}
+
+        void         begin(UBaseType_t priority = 2);
+
+        // Hand the back buffer over. Returns the frame's sequence number or 0
+        // when the previous frame is still being sent (try again later).
+        uint32_t     submit();
+
+        // Submit and block until the frame is on the panel (boot screens)
+        void         present();
+
+        bool         isPresented(uint32_t sequence) const;
+        uint32_t     presentedSequence() const { return presentedSeq; }
+        bool         isBusy() const { return submittedSeq != presentedSeq; }
+
+        // Contrast goes over the same bus, so it is applied by the flush task
+        void         setContrast(uint8_t value);
+
+        DisplayStats stats;
+
+    private:
+        static void       taskMain(void *arg);
+        void              service();
+
+        U8G2             &display;
+        DisplayTransport &transport;
+        TaskHandle_t      task = NULL;
+
+        uint8_t           front[FRAME_BUFFER_SIZE];
+        bool              frontValid = false;
+        uint8_t           spanFirst[FRAME_TILE_HEIGHT];
+        uint8_t           spanCount[FRAME_TILE_HEIGHT];
+
+        // Each counter has a single writer: submit() or the flush task
+        volatile uint32_t submittedSeq    = 0;
+        volatile uint32_t presentedSeq    = 0;
+        volatile int16_t  pendingContrast = -1;
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <Arduino.h>
+#include "fixed_point.h"
+
+#define FEED_LEDGER_FILE    "/feeds.bin"
+#define FEED_LEDGER_ENTRIES 64               // ring slots, on flash and in RAM
+#define FEED_WINDOW_S       (24 * 60 * 60UL) // the rolling quota window
+
+// One dispense, little endian. Slot on flash is seq % FEED_LEDGER_ENTRIES.
+struct __attribute__((packed)) FeedLedgerEntry {
+        uint32_t seq;   // 0: empty slot
+        uint32_t time;  // epoch seconds, 0 if fed before the clock was set
+        Fixed    grams;
+        uint32_t crc;   // CRC-32 over the fields above
+};
+
+struct FeedLedgerStats {
+        uint32_t recorded = 0;
+        uint32_t refused  = 0; // feeds turned down by the quota
+        uint32_t trimmed  = 0; // feeds cut down to what was left of it
+        uint32_t corrupt  = 0; // slots with a bad CRC seen while loading
+};
+
+// Every dispense as a timestamped entry in a fixed ring file on LittleFS,
+// so the totals survive reboots and flash use stays bounded. Totals are
+// running sums: record() adds, advance() subtracts entries as they leave
+// the 24 h window, oldest first, so both are O(1) per event. Only the
+// slot of the new entry is written.
+class FeedLedger {
+    public:
+        // Read the ring back. The clock may not be set yet: until the
+        // first advance() every loaded entry counts as recent.
+        void            begin();
+
+        bool            record(uint32_t now, Fixed grams);
+
+        // Drop entries older than the window. Entries made before the
+        // clock was set are stamped with the first valid `now`.
+        void            advance(uint32_t now);
+
+        // Local midnight starting the current day, recomputes the day total
+        void            startDay(uint32_t dayStart);
+
+        Fixed           rollingTotal() const { return rolling; }
+        Fixed           dayTotal() const { return today; }
+        uint8_t         size() const { return count; } // entries within the window
+        bool            isFull() const { return count == FEED_LEDGER_ENTRIES; }
+        // Time of the oldest entry in the window, false if there is none
+        bool            oldest(uint32_t *time) const;
+
+        FeedLedgerStats stats;
+
+    private:
+        FeedLedgerEntry &at(uint32_t seq) { return ring[seq % FEED_LEDGER_ENTRIES]; }
+        void             write(const FeedLedgerEntry &entry);
+
+        FeedLedgerEntry  ring[FEED_LEDGER_ENTRIES] = {}; // mirror of the file
+        uint32_t         nextSeq  = 1;
+        uint8_t          count    = 0; // the newest `count` seqs are in the window
+        uint8_t          untimed  = 0; // of those, stamped 0
+        Fixed            rolling  = 0;
+        Fixed            today    = 0;
+        uint32_t         dayStart = 0;
+};
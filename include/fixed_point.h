@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+
+// Values on the way from MQTT to the screen are fixed point: an int32 in
+// thousandths. The C3 has no FPU, so every float operation is a libgcc
+// call; floats only appear where a library wants one (HA, the history
+// file, the load cell filter) and are converted right there.
+//
+// That limits values to +-2147483.647. Anything beyond is clamped to
+// FIXED_MAX / FIXED_MIN, which callers can tell apart with
+// fixedIsSaturated(); neither conversion lands on them otherwise.
+#define FIXED_DECIMALS 3
+#define FIXED_ONE      1000
+#define FIXED_MAX      INT32_MAX
+#define FIXED_MIN      (-INT32_MAX) // symmetric, so negating never overflows
+
+typedef int32_t Fixed;
+
+static const int32_t fixedPowers[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000 };
+
+// Rounds to the nearest thousandth and saturates, NaN gives 0
+inline Fixed fixedFromFloat(float value) {
+    float scaled = value * FIXED_ONE;
+    if(!(scaled == scaled))
+        return 0;
+    if(scaled >= 2147483520.0f) // largest float below 2^31
+        return FIXED_MAX;
+    if(scaled <= -2147483520.0f)
+        return FIXED_MIN;
+    return (Fixed) (scaled < 0.0f ? scaled - 0.5f : scaled + 0.5f);
+}
+
+inline bool fixedIsSaturated(Fixed value) {
+    return value == FIXED_MAX || value == FIXED_MIN;
+}
+
+inline float fixedToFloat(Fixed value) {
+    return value / (float) FIXED_ONE;
+}
+
+// The value scaled by 10^decimals instead, rounded half away from zero.
+// decimals above FIXED_DECIMALS add no precision and are clamped.
+inline int32_t fixedRescale(Fixed value, uint8_t decimals) {
+    if(decimals >= FIXED_DECIMALS)
+        return value;
+    int32_t divisor = fixedPowers[FIXED_DECIMALS - decimals];
+    int32_t half    = divisor / 2;
+    return value < 0 ? -((-(int64_t) value + half) / divisor) : (value + (int64_t) half) / divisor;
+}
+
+// Integer times a fixed factor, truncated toward zero
+inline int32_t fixedScale(int32_t count, Fixed factor) {
+    return (int32_t) ((int64_t) count * factor / FIXED_ONE);
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stdint.h>
+
+#define GESTURE_MAX_BUTTONS   4
+#define GESTURE_DEBOUNCE_MS   50  // edges closer than this to the last accepted one are bounce
+#define GESTURE_LONG_MS       500 // held this long is a long press
+#define GESTURE_DOUBLE_GAP_MS 300 // second click within this after the first is a double
+#define GESTURE_REPEAT_MS     250 // repeat period while held past a long press
+
+enum GestureType {
+    GESTURE_PRESS,  // button went down, reported right away
+    GESTURE_SHORT,  // released before the long press time, no second click followed
+    GESTURE_LONG,   // still held at the long press time
+    GESTURE_DOUBLE, // two short clicks
+    GESTURE_REPEAT, // still held, once per repeat period after the long press
+    GESTURE_COUNT
+};
+
+// Raw edge as captured by the ISR
+struct ButtonEdge {
+        uint8_t  button;
+        uint8_t  pressed;
+        uint32_t at; // micros()
+};
+
+struct Gesture {
+        uint8_t  button;
+        uint8_t  type;    // GestureType
+        uint16_t repeats; // GESTURE_REPEAT: 1 for the first
+        uint32_t at;      // micros() of the edge or timeout that completed it
+};
+
+struct GestureTimings {
+        uint16_t debounceMs  = GESTURE_DEBOUNCE_MS;
+        uint16_t longMs      = GESTURE_LONG_MS;
+        uint16_t doubleGapMs = GESTURE_DOUBLE_GAP_MS; // 0 reports clicks as short right away
+        uint16_t repeatMs    = GESTURE_REPEAT_MS;     // 0 disables hold-repeat
+};
+
+struct GestureStats {
+        uint32_t edges        = 0;
+        uint32_t bounces      = 0; // edges swallowed by the debounce
+        uint32_t gestures     = 0;
+        uint32_t maxLatencyUs = 0; // worst edge age when it was handled
+};
+
+typedef void (*GestureHandler)(const Gesture &gesture, void *context);
+
+// Turns debounced button edges into gestures. Pure logic: feed() takes
+// the edges in order as the task drains them from the ISR, poll() runs
+// the timeouts (long press, repeat, double press gap, a bounce that
+// settled late). All times are micros() and wrap safely.
+class GestureRecognizer {
+    public:
+        void         configure(const GestureTimings &timings) { this->timings = timings; }
+
+        void         feed(const ButtonEdge &edge, uint32_t now, GestureHandler handler, void *context);
+        void         poll(uint32_t now, GestureHandler handler, void *context);
+
+        bool         isPressed(uint8_t button) const { return buttons[button].pressed; }
+
+        GestureStats stats;
+
+    private:
+        struct Button {
+                bool     pressed;    // debounced
+                bool     raw;        // level of the latest edge
+                bool     longSent;   // the current press already reported GESTURE_LONG
+                uint8_t  clicks;     // short click waiting for the double press gap
+                uint16_t repeats;
+                uint32_t rawAt;
+                uint32_t changedAt;  // last accepted edge
+                uint32_t releasedAt; // end of the waiting click
+                uint32_t nextRepeat;
+        };
+
+        void           accept(uint8_t button, uint32_t at, GestureHandler handler, void *context);
+        void           timeouts(uint8_t button, uint32_t now, GestureHandler handler, void *context);
+        void           emit(uint8_t button, GestureType type, uint32_t at, GestureHandler handler, void *context);
+
+        GestureTimings timings;
+        Button         buttons[GESTURE_MAX_BUTTONS] = {};
+};
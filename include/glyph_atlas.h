@@ -0,0 +1,38 @@
+#pragma once
+
+#include <Arduino.h>
+#include <U8g2lib.h>
+
+#define GLYPH_ATLAS_CHARS "0123456789-."
+#define GLYPH_ATLAS_COUNT (sizeof(GLYPH_ATLAS_CHARS) - 1)
+#define GLYPH_MAX_WIDTH   16 // columns kept per glyph
+#define GLYPH_MAX_HEIGHT  32 // rows, one bit each in a column word
+
+// One pre-rasterized glyph, stored column by column so it can be OR-ed
+// straight into the vertical bytes of the u8g2 page buffer
+struct PackedGlyph {
+        uint8_t  width;   // inked columns
+        uint8_t  advance; // cursor advance, same as u8g2 print()
+        int8_t   top;     // first row relative to the baseline
+        uint32_t columns[GLYPH_MAX_WIDTH];
+};
+
+// Digits, sign and decimal point of one u8g2 font, rasterized once at boot
+class GlyphFont {
+    public:
+        // Renders the glyphs through u8g2, clobbers the display buffer
+        void build(U8G2 &display, const uint8_t *font);
+
+        // Blit text with its baseline at y, returns x after the last glyph
+        // (including spacing) like drawTextWithSpacing() leaves the cursor
+        int  draw(U8G2 &display, int x, int y, const char *text, int spacing) const;
+
+    private:
+        const PackedGlyph *find(char c) const;
+
+        PackedGlyph        glyphs[GLYPH_ATLAS_COUNT];
+};
+
+// Integer-only fixed decimal formatting: value is scaled by 10^decimals.
+// Writes e.g. "-12" to intPart and "5" to fracPart for -125 / 1 decimal.
+void formatFixed(int32_t value, uint8_t decimals, char *intPart, char *fracPart);
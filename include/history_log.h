@@ -0,0 +1,98 @@
+#pragma once
+
+#include <Arduino.h>
+
+#define HISTORY_DIR             "/hist"
+#define HISTORY_TIERS           3    // raw, 1 min, 15 min
+#define HISTORY_SEGMENT_BYTES   4096 // segment files are closed at this size
+#define HISTORY_BATCH_RECORDS   64   // records per CRC-protected batch
+#define HISTORY_STAGING_RECORDS 128  // RAM queue between loop() and the writer task
+#define HISTORY_FLUSH_MS        (5 * 60 * 1000UL)
+
+// Series ids: value slots use their slot number, the rest follow
+#define HISTORY_SERIES_SCALE    32
+#define HISTORY_SERIES_FEED     33
+#define HISTORY_SERIES_COUNT    34
+
+// On-disk layout, little endian. A segment file is a sequence of batches:
+// a HistoryBatchHeader followed by `count` HistoryRecords. A batch whose
+// CRC doesn't match (e.g. torn by a power cut) is skipped on read.
+struct __attribute__((packed)) HistoryRecord {
+        uint32_t time;   // epoch seconds, start of the bucket for compacted tiers
+        uint8_t  series;
+        uint8_t  tier;
+        uint16_t count;  // raw samples folded into this record
+        float    mean;
+        float    min;
+        float    max;
+};
+
+struct __attribute__((packed)) HistoryBatchHeader {
+        uint32_t magic; // HISTORY_BATCH_MAGIC
+        uint16_t count;
+        uint8_t  tier;
+        uint8_t  version;
+        uint32_t crc;   // CRC-32 over the records
+};
+
+#define HISTORY_BATCH_MAGIC   0x31424C48 // "HLB1"
+#define HISTORY_BATCH_VERSION 1
+
+struct HistoryStats {
+        uint32_t recordsWritten = 0;
+        uint32_t recordsDropped = 0; // staging queue full or time not set
+        uint32_t batchesWritten = 0; // flash write operations
+        uint32_t compactions    = 0;
+        uint32_t corruptBatches = 0;
+};
+
+typedef void (*HistoryVisitor)(const HistoryRecord &record, void *context);
+
+// Append-only time series log on LittleFS. Samples are queued in RAM by
+// append() and written in batches by a low priority task, so loop() never
+// touches flash. When a tier holds too many segments the oldest one is
+// downsampled into the next tier (raw -> 1 min -> 15 min) and deleted.
+class HistoryLog {
+    public:
+        void         begin(UBaseType_t priority = 1);
+
+        // Queue one sample stamped with the current epoch time. Cheap and
+        // non-blocking; false if dropped (clock not synced, queue full).
+        bool         append(uint8_t series, float value);
+
+        // Write out whatever is queued without waiting for the timer
+        void         requestFlush();
+
+        // Visit records of one series within [from, to], oldest tier first.
+        // Reads flash, so call it from a task that may block.
+        uint32_t     query(uint8_t series, uint32_t from, uint32_t to, HistoryVisitor visitor, void *context);
+
+        // Last record written for each of `count` series (at most 64) into
+        // out[i], count 0 where there is none. One pass from the newest
+        // segment back that stops once every series has one; returns how
+        // many were found.
+        uint8_t      latest(const uint8_t *series, uint8_t count, HistoryRecord *out);
+
+        HistoryStats stats;
+
+    private:
+        static void  taskMain(void *arg);
+        void         drain();
+        void         writeBatch(uint8_t tier, const HistoryRecord *records, uint16_t count);
+        void         compact(uint8_t tier);
+        void         segmentPath(char *path, uint8_t tier, uint32_t seq) const;
+        uint32_t     readSegment(uint8_t tier, uint32_t seq, HistoryVisitor visitor, void *context);
+        void         scan();
+
+        TaskHandle_t      task = NULL;
+        SemaphoreHandle_t fileLock = NULL;
+        portMUX_TYPE      stagingMux = portMUX_INITIALIZER_UNLOCKED;
+
+        HistoryRecord     staging[HISTORY_STAGING_RECORDS];
+        uint16_t          stagingHead  = 0;
+        uint16_t          stagingCount = 0;
+
+        uint32_t          firstSeq[HISTORY_TIERS] = {};
+        uint32_t          nextSeq[HISTORY_TIERS]  = {};
+        uint32_t          openSize[HISTORY_TIERS] = {}; // bytes in the newest segment
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <stdint.h>
+
+#define LINK_WIFI_TIMEOUT_MS  10000 // full join with a scan
+#define LINK_FAST_TIMEOUT_MS  4000  // join to the cached BSSID/channel
+#define LINK_MQTT_TIMEOUT_MS  15000 // the HA client retries every 10 s on its own
+#define LINK_BACKOFF_MIN_MS   1000
+#define LINK_BACKOFF_MAX_MS   60000
+#define LINK_QUALITY_MS       5000  // RSSI sampling period while associated
+#define LINK_RSSI_ALPHA       0.2f
+
+// What the link manager drives. None of the calls may wait for the
+// network, except mqttPoll() which runs the client's own connect attempt.
+class LinkDriver {
+    public:
+        virtual ~LinkDriver() {}
+
+        virtual bool wifiConnected()                                              = 0;
+        // bssid NULL: scan for the configured network
+        virtual void wifiConnect(const uint8_t *bssid, int32_t channel)           = 0;
+        // Only valid while connected
+        virtual bool wifiLinkInfo(uint8_t *bssid, int32_t *channel, int8_t *rssi) = 0;
+
+        virtual bool mqttConnected()                                              = 0;
+        virtual void mqttPoll()                                                   = 0;
+};
+
+enum LinkState {
+    LINK_WIFI_DOWN, // waiting out the backoff
+    LINK_WIFI_CONNECTING,
+    LINK_MQTT_DOWN,
+    LINK_MQTT_CONNECTING,
+    LINK_UP
+};
+
+enum LinkEvent {
+    LINK_EVENT_NONE,
+    LINK_EVENT_UP,  // broker reachable again
+    LINK_EVENT_DOWN // lost WiFi or the broker
+};
+
+struct LinkStats {
+        uint32_t wifiConnects = 0;
+        uint32_t fastConnects = 0; // joined through the cached BSSID/channel
+        uint32_t wifiDrops    = 0;
+        uint32_t wifiFailures = 0; // join attempts that timed out
+        uint32_t mqttConnects = 0;
+        uint32_t mqttDrops    = 0;
+        uint32_t mqttFailures = 0;
+        uint32_t lastOutageMs = 0; // from losing the link to being up again
+        uint32_t maxOutageMs  = 0;
+        uint32_t downtimeMs   = 0; // sum of finished outages
+        int8_t   rssi         = 0; // dBm, latest sample
+        float    rssiAverage  = 0.0f;
+};
+
+// Keeps WiFi and the MQTT session up without ever blocking the caller.
+// Each loop() looks at the link and starts at most one attempt; failed
+// attempts back off exponentially with jitter so a dead AP or broker is
+// not hammered. Each round of WiFi joins goes straight to the last AP's
+// BSSID and channel first and only scans when that fails. While waiting
+// for the broker, mqttPoll() runs every loop; the HA client spaces its
+// own connect attempts.
+class LinkManager {
+    public:
+        explicit LinkManager(LinkDriver &driver) :
+            driver(driver) {}
+
+        // AP remembered from an earlier boot, so the first join skips the scan
+        void      seedAp(const uint8_t *bssid, int32_t channel);
+        bool      cachedAp(uint8_t *bssid, int32_t *channel) const;
+
+        void      begin(uint32_t now, uint32_t seed);
+        LinkEvent loop(uint32_t now);
+
+        LinkState state() const { return current; }
+        bool      isUp() const { return current == LINK_UP; }
+
+        LinkStats stats;
+
+    private:
+        void        backoff(uint8_t &failures, uint32_t now);
+        LinkEvent   lost(uint32_t now);
+        void        sampleQuality(uint32_t now);
+        uint32_t    nextRandom();
+
+        LinkDriver &driver;
+        LinkState   current        = LINK_WIFI_DOWN;
+        uint32_t    retryAt        = 0;
+        uint32_t    deadline       = 0;
+        uint32_t    downSince      = 0;
+        uint32_t    qualityAt      = 0;
+        uint32_t    rng            = 1;
+        uint8_t     wifiFailures   = 0; // consecutive, drive the backoff
+        uint8_t     mqttFailures   = 0;
+        bool        fastAttempt    = false;
+        bool        fastFailed     = false;
+        bool        cacheValid     = false;
+        bool        wasUp          = false;
+        uint8_t     cachedBssid[6] = {};
+        int32_t     cachedChannel  = 0;
+};
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <Arduino.h>
+#include <limits.h>
+#include "HX711.h"
+#include "series_stats.h"
+#include "spsc_ring.h"
+
+#define LOADCELL_POLL_MS          20   // data-ready poll period, the HX711 runs at 10 SPS
+#define LOADCELL_RING_SIZE        16   // raw samples buffered between the task and loop()
+#define LOADCELL_MEDIAN_MAX       9
+#define LOADCELL_SETTLE_MS        1500 // window the weight must stay within the settle band
+#define LOADCELL_SETTLE_SAMPLES   10
+#define LOADCELL_STEP_SIGMA       6.0f // innovations beyond this snap the filter to the new weight
+#define LOADCELL_OFFSET_UNSET     LONG_MIN
+
+// update() result bits
+#define LOADCELL_CHANGED          0x01 // settled weight moved beyond the deadband
+#define LOADCELL_TARED            0x02 // offset() holds a new tare
+#define LOADCELL_CALIBRATED       0x04 // factor() holds a new calibration
+#define LOADCELL_CALIBRATE_FAILED 0x08 // known mass too small to calibrate against
+
+struct LoadCellConfig {
+        uint8_t medianWindow     = 5;     // raw samples, odd, 1 disables the median
+        float   processNoise     = 0.01f; // g^2 per sample the true weight may drift
+        float   measurementNoise = 4.0f;  // g^2 of the median output
+        float   settleBand       = 0.5f;  // g of max-min within LOADCELL_SETTLE_MS
+        float   deadband         = 0.5f;  // g a settled weight must move to be reported
+};
+
+struct LoadCellStats {
+        uint32_t samples = 0;
+        uint32_t steps   = 0; // filter snapped to a new weight
+};
+
+// HX711 sampling and filtering. A low priority task polls data-ready and
+// pushes raw counts into a lock-free ring; update() drains it from loop()
+// through a median and a scalar Kalman filter, detects when the weight has
+// settled and reports it only when it moved by more than the deadband.
+// Tare and known-mass calibration run on the next settled reading.
+class LoadCell {
+    public:
+        explicit LoadCell(HX711 &hx711) :
+            hx711(hx711),
+            settleStats(LOADCELL_SETTLE_MS, 1.0f) {}
+
+        // offset may be LOADCELL_OFFSET_UNSET, a tare is then requested
+        void          begin(long offset, float factor, UBaseType_t priority = 2);
+        void          configure(const LoadCellConfig &config);
+
+        // Drain new samples; returns LOADCELL_* bits
+        uint8_t       update();
+
+        float         weight() const { return estimate; } // filtered grams
+        bool          isSettled() const { return settled; }
+        long          offset() const { return tareOffset; }
+        float         factor() const { return countsPerGram; }
+
+        void          setFactor(float factor);
+        // Both wait until the weight settled for a full window after the call
+        void          requestTare();
+        void          requestCalibration(float mass);
+
+        uint32_t      droppedSamples() const { return ring.dropped; }
+
+        LoadCellStats stats;
+
+    private:
+        struct RawSample {
+                int32_t  counts;
+                uint32_t timestamp;
+        };
+
+        static void                          taskMain(void *arg);
+        float                                median(int32_t counts);
+        void                                 filter(float grams);
+        void                                 resetFilter();
+
+        HX711                               &hx711;
+        TaskHandle_t                         task = NULL;
+        SpscRing<RawSample, LOADCELL_RING_SIZE> ring;
+        LoadCellConfig                       config;
+
+        int32_t                              window[LOADCELL_MEDIAN_MAX];
+        uint8_t                              windowCount = 0;
+        uint8_t                              windowNext  = 0;
+
+        float                                estimate    = 0.0f;
+        float                                variance    = 0.0f;
+        bool                                 filterValid = false;
+        SeriesStats<16>                      settleStats;
+        bool                                 settled     = false;
+        float                                reported    = 0.0f;
+        bool                                 reportValid = false;
+
+        long                                 tareOffset    = 0;
+        float                                countsPerGram = 1.0f;
+        bool                                 pendingTare   = false;
+        float                                pendingMass   = 0.0f;
+        uint32_t                             pendingSince  = 0;
+};
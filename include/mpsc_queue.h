@@ -0,0 +1,56 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Bounded queue for any number of producers (tasks or ISRs) and one
+// consumer. The core has no compare-and-swap, so a producer reserves its
+// slot inside a critical section of a few instructions; the copy and the
+// consumer side run without any lock. The consumer takes slots in order
+// and waits for a reserved one until its producer marked it ready.
+// N must be a power of two so the free-running indices wrap cleanly.
+template <typename T, uint16_t N>
+class MpscQueue {
+        static_assert(N > 0 && (N & (N - 1)) == 0, "MpscQueue size must be a power of two");
+
+    public:
+        bool IRAM_ATTR push(const T &item) {
+            portENTER_CRITICAL_SAFE(&reserveMux);
+            uint16_t slot = reserved;
+            bool     full = (uint16_t) (slot - tail) == N;
+            if(full)
+                dropped++;
+            else
+                reserved = slot + 1;
+            portEXIT_CRITICAL_SAFE(&reserveMux);
+            if(full)
+                return false;
+
+            items[slot % N] = item;
+            __sync_synchronize();
+            ready[slot % N] = true;
+            return true;
+        }
+
+        bool pop(T *item) {
+            uint16_t t = tail;
+            if(!ready[t % N])
+                return false;
+            __sync_synchronize();
+            *item        = items[t % N];
+            ready[t % N] = false;
+            __sync_synchronize();
+            tail = t + 1;
+            return true;
+        }
+
+        uint16_t          size() const { return (uint16_t) (reserved - tail); }
+
+        volatile uint32_t dropped = 0; // pushes refused because the queue was full
+
+    private:
+        T                 items[N];
+        volatile bool     ready[N]   = {};
+        volatile uint16_t reserved   = 0; // next slot handed to a producer
+        volatile uint16_t tail       = 0; // written by the consumer only
+        portMUX_TYPE      reserveMux = portMUX_INITIALIZER_UNLOCKED;
+};
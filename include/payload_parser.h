@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "fixed_point.h"
+
+// Decimal number as written in the payload: mantissa * 10^exponent
+struct DecimalNumber {
+        uint32_t mantissa;
+        int16_t  exponent;
+        bool     negative;
+};
+
+// Parse a plain number ("21.5", " -3e-1 ") straight from the payload span.
+// Never allocates or throws; anything else, including trailing garbage,
+// is rejected.
+bool scanDecimal(const char *text, uint16_t length, DecimalNumber *out);
+bool parseNumber(const char *text, uint16_t length, Fixed *out);
+
+// Pull a number out of a JSON object by a dotted key path ("state.temp")
+// with a streaming scan, without building a document. Numbers quoted as
+// strings are accepted. Only the part of the payload up to the value is
+// looked at.
+bool jsonExtractNumber(const char *json, uint16_t length, const char *path, Fixed *out);
+
+// Integer only, digits past the thousandths are rounded. A number beyond
+// the Fixed range is clamped rather than rejected, see fixedIsSaturated().
+bool decimalToFixed(const DecimalNumber &number, Fixed *out);
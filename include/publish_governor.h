@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+
+#define GOVERNOR_MAX_ENTRIES 24
+
+// Pushes one value to its entity, true if it went out. Adapters should
+// force the publish: the governor has already decided it is needed.
+typedef bool (*GovernedPublish)(void *entity, float value);
+
+struct PublishPolicy {
+        float    deadband;      // changes up to this much are not published
+        uint32_t minIntervalMs; // bursts within this are coalesced into the latest value
+        uint32_t maxStaleMs;    // heartbeat: republish at least this often, 0 = never
+};
+
+struct GovernorStats {
+        uint32_t sent       = 0;
+        uint32_t suppressed = 0; // within the deadband
+        uint32_t coalesced  = 0; // overwritten by a newer value before being sent
+        uint32_t heartbeats = 0;
+        uint32_t failed     = 0; // publish returned false, retried on the next loop()
+};
+
+// Sits between the firmware and the HA entities. update() records the
+// latest value of an entity; it is published immediately, later (once the
+// minimum interval passed, as the newest value of the burst) or not at all
+// (within the deadband). loop() flushes coalesced values and heartbeats.
+// Times are millis() passed in by the caller.
+class PublishGovernor {
+    public:
+        void          add(uint8_t handle, GovernedPublish publish, void *entity, const PublishPolicy &policy);
+        void          update(uint8_t handle, float value, uint32_t now);
+        void          loop(uint32_t now);
+
+        GovernorStats stats;
+
+    private:
+        struct Entry {
+                GovernedPublish publish;
+                void           *entity;
+                PublishPolicy   policy;
+                float           latest;
+                float           sentValue;
+                uint32_t        sentAt;
+                bool            pending;
+                bool            everSent;
+        };
+
+        void  send(Entry &entry, uint32_t now);
+
+        Entry entries[GOVERNOR_MAX_ENTRIES] = {};
+};
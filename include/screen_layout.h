@@ -0,0 +1,138 @@
+#pragma once
+
+#include <Arduino.h>
+#include <U8g2lib.h>
+#include "display_transport.h"
+#include "glyph_atlas.h"
+#include "spark_series.h"
+#include "value_table.h"
+
+#define LAYOUT_FILE         "/layout.txt"
+#define LAYOUT_MAX_WIDGETS  48 // all pages together
+#define LAYOUT_MAX_PAGES    4
+#define LAYOUT_PAGE_WIDGETS 32 // update() reports one bit per widget of the page
+#define LAYOUT_TEXT_POOL    256
+#define LAYOUT_LINE_LENGTH  96
+#define LAYOUT_SPARK_WIDTH  128 // widest sparkline, one history column per pixel
+
+enum LayoutWidgetType {
+    LAYOUT_FRAME, // static rectangle outline
+    LAYOUT_LABEL, // static text
+    LAYOUT_VALUE, // a value slot as a fixed decimal number
+    LAYOUT_TREND, // up/down arrow once the slot (a slope) passes the threshold
+    LAYOUT_SPARK  // min/max bar per column over the slot's recent history
+};
+
+enum LayoutFont {
+    LAYOUT_FONT_TINY,
+    LAYOUT_FONT_SMALL,
+    LAYOUT_FONT_BIG,
+    LAYOUT_FONT_COUNT
+};
+
+// Compiled widget, the draw list is a flat array of these in page order
+struct LayoutWidget {
+        uint8_t  type; // LayoutWidgetType
+        uint8_t  font; // LayoutFont
+        uint8_t  slot;
+        uint8_t  decimals;
+        int8_t   spacing;  // extra pixels between glyphs
+        uint8_t  x, y;     // text baseline start, frame and arrow corner
+        uint8_t  boxX, boxY;
+        uint8_t  w, h;     // frame and sparkline size, arrow size, or the box a value clears
+        uint16_t text;     // label offset in the text pool
+        Fixed    threshold;
+};
+
+struct LayoutFonts {
+        const uint8_t   *text[LAYOUT_FONT_COUNT];     // u8g2 fonts for labels
+        const GlyphFont *digits[LAYOUT_FONT_COUNT];   // integer part of values
+        const GlyphFont *fraction[LAYOUT_FONT_COUNT]; // decimal point and decimals
+};
+
+// Fills the newest `width` history columns of a value slot, oldest first,
+// and the range to scale them to. False if the slot has no history.
+typedef bool (*SparkSource)(uint8_t slot, SparkColumn *out, uint16_t width, Fixed *low, Fixed *high);
+
+// Screen pages described by text, one widget per line:
+//   page
+//   frame <x> <y> <w> <h>
+//   label <x> <y> <font> <spacing> <text>
+//   value <x> <y> <font> <spacing> <slot> <decimals> <boxX> <boxY> <boxW> <boxH>
+//   trend <x> <y> <size> <slot> <threshold>
+//   spark <x> <y> <w> <h> <slot>
+// Fonts are tiny, small or big; x/y of text is the baseline, '#' starts a
+// comment. Loading compiles the lines into the draw list, so a frame is
+// a walk over the current page's widgets without any parsing.
+//
+// Frames and labels never change, so they are rasterized once per page
+// into a separate chrome layer. A full redraw copies that layer into the
+// display buffer and draws the values and arrows on top; a partial one
+// restores just the box of each changed widget from it.
+class ScreenLayout {
+    public:
+        // Replace the layout with LAYOUT_FILE, false if missing or invalid
+        bool     load();
+        // Same from '\n' separated text in memory
+        bool     parse(const char *text);
+        // 1-based line of the last parse error, 0 if none
+        uint16_t errorLine() const { return badLine; }
+
+        uint8_t  pageCount() const { return pages; }
+        uint8_t  page() const { return current; }
+        void     showPage(uint8_t page);
+        void     invalidate() { valid = false; }
+        // Rasterize the frames and labels again on the next draw()
+        void     invalidateChrome() {
+            chromeValid = false;
+            valid       = false;
+        }
+
+        // Bit i set: widget i of the current page has to be drawn. All of
+        // them after a page change or invalidate(), else only the values
+        // and arrows whose drawn state changed. Frames and labels come
+        // from the chrome layer whatever their bit says.
+        uint32_t update(const ValueTable &values);
+        void     draw(U8G2 &display, const LayoutFonts &fonts, uint32_t changed);
+
+        // Where sparklines get their columns; they stay blank without one.
+        // columnMs is the time one column spans: sparklines are redrawn
+        // when it rolls over, so a quiet series still scrolls and expires.
+        void     setSparkSource(SparkSource source, uint32_t columnMs) {
+            sparkSource   = source;
+            sparkColumnMs = columnMs;
+        }
+
+    private:
+        struct Page {
+                uint8_t first;
+                uint8_t count;
+        };
+
+        void         reset();
+        bool         addLine(char *line);
+        int32_t      stateOf(const LayoutWidget &widget, const ValueTable &values) const;
+        void         drawWidget(U8G2 &display, const LayoutFonts &fonts, const LayoutWidget &widget, int32_t state);
+        void         drawSpark(U8G2 &display, const LayoutWidget &widget);
+        void         rasterizeChrome(U8G2 &display, const LayoutFonts &fonts);
+        void         restoreBox(uint8_t *buffer, int x, int y, int w, int h) const;
+
+        LayoutWidget widgets[LAYOUT_MAX_WIDGETS];
+        Page         pageList[LAYOUT_MAX_PAGES];
+        char         textPool[LAYOUT_TEXT_POOL];
+        uint8_t      widgetCount = 0;
+        uint8_t      pages       = 0;
+        uint16_t     textUsed    = 0;
+        uint16_t     badLine     = 0;
+
+        uint8_t      current     = 0;
+        bool         valid       = false;
+        bool         chromeValid = false;
+        uint32_t     chrome[FRAME_BUFFER_SIZE / 4]; // frames and labels of the current page, word aligned
+        int32_t      shown[LAYOUT_PAGE_WIDGETS]; // drawn state per widget of the current page
+        int32_t      next[LAYOUT_PAGE_WIDGETS];
+
+        SparkSource  sparkSource   = NULL;
+        uint32_t     sparkColumnMs = 0;
+        SparkColumn  sparkColumns[LAYOUT_SPARK_WIDTH]; // scratch for drawSpark()
+};
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming statistics over a time window of one value series, in fixed
+// memory. Samples older than the window (or beyond the capacity N) drop
+// out on the next add(). Everything is updated incrementally:
+//  - least-squares slope from running sums, O(1) per sample
+//  - EWMA of the raw samples
+//  - window min/max from monotonic deques, amortized O(1)
+template <uint16_t N>
+class SeriesStats {
+    public:
+        SeriesStats(uint32_t windowMs, float ewmaAlpha) :
+            windowMs(windowMs),
+            ewmaAlpha(ewmaAlpha) {}
+
+        void add(uint32_t timestamp, float value) {
+            while(count > 0 && (count == N || timestamp - at(oldestSeq()).timestamp > windowMs))
+                evictOldest();
+            if(count > 0 && timestamp - baseTime > windowMs)
+                rebase(); // keep the running sums well conditioned
+
+            if(count == 0) {
+                baseTime = timestamp;
+                clearSums();
+            }
+
+            uint32_t seq = nextSeq++;
+            Sample  &s   = at(seq);
+            s.timestamp  = timestamp;
+            s.value      = value;
+            count++;
+            accumulate(s, 1.0f);
+
+            // Monotonic deques: drop entries the new sample dominates
+            while(minCount > 0 && at(minQueue[(minHead + minCount - 1) % N]).value >= value) minCount--;
+            minQueue[(minHead + minCount++) % N] = seq;
+            while(maxCount > 0 && at(maxQueue[(maxHead + maxCount - 1) % N]).value <= value) maxCount--;
+            maxQueue[(maxHead + maxCount++) % N] = seq;
+
+            ewmaValue = ewmaValid ? ewmaValue + ewmaAlpha * (value - ewmaValue) : value;
+            ewmaValid = true;
+            updateSlope();
+        }
+
+        uint16_t size() const { return count; }
+        float    latest() const { return count ? at(nextSeq - 1).value : 0.0f; }
+        float    minimum() const { return count ? at(minQueue[minHead]).value : 0.0f; }
+        float    maximum() const { return count ? at(maxQueue[maxHead]).value : 0.0f; }
+        float    ewma() const { return ewmaValue; }
+
+        // Least-squares trend over the window, in value units per minute
+        float    slope() const { return slopeValue; }
+
+        // Bytes of RAM one series takes, for reporting
+        static constexpr size_t footprint() { return sizeof(SeriesStats<N>); }
+
+    private:
+        struct Sample {
+                uint32_t timestamp;
+                float    value;
+        };
+
+        Sample       &at(uint32_t seq) { return samples[seq % N]; }
+        const Sample &at(uint32_t seq) const { return samples[seq % N]; }
+        uint32_t      oldestSeq() const { return nextSeq - count; }
+
+        void          evictOldest() {
+            uint32_t seq = oldestSeq();
+            accumulate(at(seq), -1.0f);
+            count--;
+            if(minCount > 0 && minQueue[minHead] == seq) {
+                minHead = (minHead + 1) % N;
+                minCount--;
+            }
+            if(maxCount > 0 && maxQueue[maxHead] == seq) {
+                maxHead = (maxHead + 1) % N;
+                maxCount--;
+            }
+        }
+
+        void clearSums() {
+            sumT  = 0.0f;
+            sumV  = 0.0f;
+            sumTT = 0.0f;
+            sumTV = 0.0f;
+        }
+
+        void accumulate(const Sample &s, float sign) {
+            float t  = (s.timestamp - baseTime) / 60000.0f; // minutes since baseTime
+            sumT    += sign * t;
+            sumV    += sign * s.value;
+            sumTT   += sign * t * t;
+            sumTV   += sign * t * s.value;
+        }
+
+        // Move the time origin to the oldest sample and recompute the sums
+        void rebase() {
+            baseTime = at(oldestSeq()).timestamp;
+            clearSums();
+            for(uint32_t seq = oldestSeq(); seq != nextSeq; seq++)
+                accumulate(at(seq), 1.0f);
+        }
+
+        void updateSlope() {
+            float n           = count;
+            float denominator = n * sumTT - sumT * sumT;
+            if(count < 2 || denominator <= 1e-9f)
+                slopeValue = 0.0f;
+            else
+                slopeValue = (n * sumTV - sumT * sumV) / denominator;
+        }
+
+        uint32_t windowMs;
+        float    ewmaAlpha;
+
+        Sample   samples[N];
+        uint32_t nextSeq  = 0;
+        uint16_t count    = 0;
+
+        uint32_t minQueue[N];
+        uint16_t minHead  = 0;
+        uint16_t minCount = 0;
+        uint32_t maxQueue[N];
+        uint16_t maxHead  = 0;
+        uint16_t maxCount = 0;
+
+        uint32_t baseTime = 0;
+        float    sumT     = 0.0f;
+        float    sumV     = 0.0f;
+        float    sumTT    = 0.0f;
+        float    sumTV    = 0.0f;
+
+        float    ewmaValue  = 0.0f;
+        bool     ewmaValid  = false;
+        float    slopeValue = 0.0f;
+};
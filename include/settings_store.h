@@ -0,0 +1,91 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+
+#define SETTINGS_SNAPSHOT_FILE "/settings.kv"
+#define SETTINGS_JOURNAL_FILE  "/settings.jnl"
+#define SETTINGS_TEMP_FILE     "/settings.tmp"
+#define SETTINGS_LEGACY_FILE   "/settings.bin" // raw struct dump of older firmware
+#define SETTINGS_LEGACY_SIZE   228             // sizeof(settings) of the last raw layout
+#define SETTINGS_LEGACY_STABLE 196             // MQTT prefix shared by every raw layout
+
+#define SETTINGS_MAX_BYTES     512
+#define SETTINGS_FLUSH_DELAY   2000  // ms of quiet before pending changes are written
+#define SETTINGS_FLUSH_MAX     10000 // ms a change may stay pending while edits keep coming
+#define SETTINGS_JOURNAL_LIMIT 1024  // bytes, beyond this the journal is folded into the snapshot
+
+// Converts a stored value written by an older field version, false drops it
+typedef bool (*SettingsUpgrade)(uint8_t fromVersion, const uint8_t *data, uint8_t size, uint8_t *out);
+
+// One persisted member of the settings struct. The id is the key on flash
+// and must never be reused; bump version when the stored format changes.
+struct SettingsField {
+        uint8_t         id;
+        uint8_t         version;
+        uint8_t         size;
+        uint16_t        offset;       // offsetof() in the settings struct
+        int16_t         legacyOffset; // offset in SETTINGS_LEGACY_FILE, -1 if absent
+        SettingsUpgrade upgrade;      // NULL: other versions fall back to the default
+};
+
+struct SettingsStoreStats {
+        uint32_t saveRequests  = 0; // requestSave() calls
+        uint32_t flashWrites   = 0; // files opened for writing
+        uint32_t fieldsWritten = 0;
+        uint32_t bytesWritten  = 0;
+        uint32_t compactions   = 0;
+        uint32_t badRecords    = 0; // CRC or framing errors seen while loading
+};
+
+// Field-keyed settings persistence. Every record is id/version/size/data
+// plus a CRC-32. Changes are compared against a shadow of what is on
+// flash and only the changed fields are appended to a journal, after a
+// short quiet period so bursts (e.g. dragging an HA slider) collapse into
+// one write. The journal is folded into the snapshot once it grows.
+class SettingsStore {
+    public:
+        SettingsStore(void *data, size_t size, const SettingsField *fields, uint8_t fieldCount) :
+            data(static_cast<uint8_t *>(data)),
+            size(size),
+            fields(fields),
+            fieldCount(fieldCount) {}
+
+        // Snapshot + journal, or a field-by-field migration of the legacy dump
+        void               load();
+
+        // Something in the struct changed; it will be written after a delay
+        void               requestSave();
+
+        // Call from loop(), writes pending changes once the delay expired
+        void               loop();
+
+        // Write pending changes now
+        void               flush();
+
+        bool               isPending() const { return pending; }
+
+        SettingsStoreStats stats;
+
+    private:
+        bool                 readFile(const char *path);
+        bool                 migrateLegacy();
+        void                 applyRecord(const uint8_t *record, uint8_t id, uint8_t version, uint8_t length);
+        bool                 isChanged(const SettingsField &field) const;
+        void                 writeRecords(File &file, bool changedOnly);
+        void                 writeSnapshot();
+        const SettingsField *find(uint8_t id) const;
+
+        uint8_t             *data;
+        size_t               size;
+        const SettingsField *fields;
+        uint8_t              fieldCount;
+
+        uint8_t              shadow[SETTINGS_MAX_BYTES]; // contents as last persisted
+        bool                 pending      = false;
+        unsigned long        firstRequest = 0;
+        unsigned long        lastRequest  = 0;
+        size_t               journalSize  = 0;
+        bool                 upgraded     = false; // a record was converted while loading
+        bool                 damaged      = false; // a file had a bad record, rewrite it
+};
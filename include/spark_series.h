@@ -0,0 +1,136 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "fixed_point.h"
+
+// Value range of one pixel column; low > high marks a column without samples
+struct SparkColumn {
+        Fixed low;
+        Fixed high;
+};
+
+// Sparkline history of one value series, decimated as samples arrive into
+// N time columns of columnMs each (one per pixel). Only the min/max of a
+// column is kept, so memory is fixed whatever the sample rate, and drawing
+// walks the columns without touching raw samples. The range over all held
+// columns (the autoscale) comes from monotonic deques, amortized O(1).
+template <uint16_t N>
+class SparkSeries {
+    public:
+        explicit SparkSeries(uint32_t columnMs) :
+            columnMs(columnMs) {}
+
+        void add(uint32_t timestamp, Fixed value) {
+            uint32_t column = timestamp / columnMs;
+            if(count > 0 && column < at(newestSeq()).column)
+                clear(); // millis() wrapped
+            expireColumns(column);
+
+            uint32_t seq;
+            if(count > 0 && at(newestSeq()).column == column) {
+                seq       = newestSeq();
+                Column &c = at(seq);
+                if(value < c.low)
+                    c.low = value;
+                if(value > c.high)
+                    c.high = value;
+            } else {
+                seq       = nextSeq++;
+                Column &c = at(seq);
+                c.column  = column;
+                c.low     = value;
+                c.high    = value;
+                count++;
+            }
+
+            // The newest column only ever widens, so it is pushed again
+            // like a new entry, dropping whatever it now dominates
+            while(minCount > 0 && at(minQueue[(minHead + minCount - 1) % N]).low >= at(seq).low) minCount--;
+            minQueue[(minHead + minCount++) % N] = seq;
+            while(maxCount > 0 && at(maxQueue[(maxHead + maxCount - 1) % N]).high <= at(seq).high) maxCount--;
+            maxQueue[(maxHead + maxCount++) % N] = seq;
+            version++;
+        }
+
+        // Drop columns that scrolled out by `timestamp` without a new sample
+        void expire(uint32_t timestamp) { expireColumns(timestamp / columnMs); }
+
+        // The `width` columns ending at the one holding `timestamp`, oldest
+        // first. False if none of them has a sample.
+        bool columns(uint32_t timestamp, SparkColumn *out, uint16_t width) const {
+            uint32_t last = timestamp / columnMs;
+            uint32_t seq  = nextSeq - count;
+            bool     any  = false;
+            for(uint16_t i = 0; i < width; i++) {
+                uint32_t back   = width - 1 - i;
+                uint32_t column = last - back;
+                while(back <= last && seq != nextSeq && at(seq).column < column) seq++;
+                if(back <= last && seq != nextSeq && at(seq).column == column) {
+                    out[i].low  = at(seq).low;
+                    out[i].high = at(seq).high;
+                    any         = true;
+                } else {
+                    out[i].low  = 1;
+                    out[i].high = 0;
+                }
+            }
+            return any;
+        }
+
+        uint16_t size() const { return count; }
+        Fixed    minimum() const { return count ? at(minQueue[minHead]).low : 0; }
+        Fixed    maximum() const { return count ? at(maxQueue[maxHead]).high : 0; }
+        // Bumped by every add(), for change detection
+        uint32_t changes() const { return version; }
+
+        // Bytes of RAM one series takes, for reporting
+        static constexpr size_t footprint() { return sizeof(SparkSeries<N>); }
+
+    private:
+        struct Column {
+                uint32_t column; // timestamp / columnMs
+                Fixed    low;
+                Fixed    high;
+        };
+
+        Column       &at(uint32_t seq) { return columnList[seq % N]; }
+        const Column &at(uint32_t seq) const { return columnList[seq % N]; }
+        uint32_t      newestSeq() const { return nextSeq - 1; }
+
+        void          expireColumns(uint32_t column) {
+            while(count > 0 && column - at(nextSeq - count).column >= N) {
+                uint32_t seq = nextSeq - count;
+                count--;
+                if(minCount > 0 && minQueue[minHead] == seq) {
+                    minHead = (minHead + 1) % N;
+                    minCount--;
+                }
+                if(maxCount > 0 && maxQueue[maxHead] == seq) {
+                    maxHead = (maxHead + 1) % N;
+                    maxCount--;
+                }
+            }
+        }
+
+        void clear() {
+            count    = 0;
+            minCount = 0;
+            maxCount = 0;
+        }
+
+        uint32_t columnMs;
+
+        Column   columnList[N];
+        uint32_t nextSeq  = 0;
+        uint16_t count    = 0;
+
+        uint32_t minQueue[N];
+        uint16_t minHead  = 0;
+        uint16_t minCount = 0;
+        uint32_t maxQueue[N];
+        uint16_t maxHead  = 0;
+        uint16_t maxCount = 0;
+
+        uint32_t version  = 0;
+};
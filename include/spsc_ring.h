@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+#ifdef ARDUINO
+#include <esp_attr.h>
+#else
+#define IRAM_ATTR
+#endif
+
+// Lock-free ring for exactly one producer and one consumer (task/task or
+// ISR/task). Each index is written by one side only, so no critical
+// section is needed; the fence orders the payload before the index.
+// N must be a power of two so the free-running indices wrap cleanly.
+template <typename T, uint16_t N>
+class SpscRing {
+        static_assert(N > 0 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+    public:
+        bool IRAM_ATTR push(const T &item) {
+            uint16_t h = head;
+            if((uint16_t) (h - tail) == N) {
+                dropped++;
+                return false;
+            }
+            items[h % N] = item;
+            __sync_synchronize();
+            head = h + 1;
+            return true;
+        }
+
+        bool pop(T *item) {
+            uint16_t t = tail;
+            if(t == head)
+                return false;
+            *item = items[t % N];
+            __sync_synchronize();
+            tail = t + 1;
+            return true;
+        }
+
+        uint16_t          size() const { return (uint16_t) (head - tail); }
+
+        volatile uint32_t dropped = 0; // pushes refused because the ring was full
+
+    private:
+        T                 items[N];
+        volatile uint16_t head = 0; // written by the producer only
+        volatile uint16_t tail = 0; // written by the consumer only
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Build with -DPROFILE_STAGES=0 to compile every PROFILE_SCOPE out
+#ifndef PROFILE_STAGES
+#define PROFILE_STAGES 1
+#endif
+
+#define PROFILE_BUCKETS 33 // log2 of the cycle count: bucket b holds [2^(b-1), 2^b)
+
+enum ProfileStage {
+    STAGE_RENDER,       // drawing a frame into the back buffer
+    STAGE_FLUSH,        // sending the changed tiles to the panel
+    STAGE_MQTT_LOOP,    // one mqtt.loop(), message handling included
+    STAGE_MQTT_MESSAGE, // onMqttMessage()
+    STAGE_SCALE,        // scaleLoop()
+    STAGE_STEP_ISR,     // one step pulse
+    STAGE_COUNT
+};
+
+struct StageSummary {
+        uint32_t count = 0;
+        uint32_t p50Us = 0; // interpolated inside the bucket
+        uint32_t p99Us = 0;
+        uint32_t maxUs = 0;
+};
+
+// Duration histogram of one stage since boot. Every stage is timed from
+// one task or ISR only, so record() needs no lock; a reader racing it
+// may see one sample missing from a bucket, which the summary tolerates.
+class StageHistogram {
+    public:
+        void IRAM_ATTR record(uint32_t cycles);
+        void           summarize(StageSummary *out) const;
+
+    private:
+        volatile uint32_t buckets[PROFILE_BUCKETS] = {};
+        volatile uint32_t count                    = 0;
+        volatile uint32_t maxCycles                = 0;
+};
+
+extern StageHistogram stageHistograms[STAGE_COUNT];
+
+// "render 120/480/900us, ..." (p50/p99/max) for the stages that ran; short
+// enough for an HA state, which is capped at 255 characters
+int                   formatStages(char *out, size_t size);
+
+#if PROFILE_STAGES
+
+#include <esp_cpu.h>
+
+// Times the enclosing scope on the CPU cycle counter. Inlined so it is
+// safe in IRAM code; the counter wraps after ~26 s at 160 MHz, far
+// longer than anything timed with it.
+class ScopedStageTimer {
+    public:
+        inline __attribute__((always_inline)) explicit ScopedStageTimer(uint8_t stage) :
+            stage(stage), start(esp_cpu_get_ccount()) {}
+        inline __attribute__((always_inline)) ~ScopedStageTimer() { stageHistograms[stage].record(esp_cpu_get_ccount() - start); }
+
+    private:
+        uint8_t  stage;
+        uint32_t start;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b)  PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(stage)  ScopedStageTimer PROFILE_CONCAT(stageTimer, __LINE__)(stage)
+
+#else
+
+#define PROFILE_SCOPE(stage) \
+    do {                     \
+    } while(0)
+
+#endif
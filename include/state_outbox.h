@@ -0,0 +1,51 @@
+#pragma once
+
+#include "publish_governor.h"
+
+// One slot per entity that publishes through the outbox, so even an
+// outage that touches every one of them loses nothing
+#ifndef STATE_OUTBOX_SIZE
+#define STATE_OUTBOX_SIZE 24
+#endif
+
+struct StateOutboxStats {
+        uint32_t queued     = 0; // changes made while offline
+        uint32_t coalesced  = 0; // replaced by a newer value of the same entity
+        uint32_t overflowed = 0; // dropped, the outbox was full
+        uint32_t replayed   = 0;
+};
+
+// Last known state of the entities changed while the broker was out of
+// reach. Online, send() publishes straight through. Offline (or when the
+// publish fails) it keeps only the newest value per entity, so a long
+// outage costs one slot per entity; replay() sends them in the order they
+// first changed once the link is back, and again while online as long as
+// anything is left.
+class StateOutbox {
+    public:
+        // True once the value is either published or queued
+        bool             send(GovernedPublish publish, void *entity, float value);
+
+        void             setOnline(bool online) { this->online = online; }
+        bool             isOnline() const { return online; }
+
+        // Returns how many are still waiting, non zero if the link dropped again
+        uint8_t          replay();
+        uint8_t          pending() const { return count; }
+
+        StateOutboxStats stats;
+
+    private:
+        struct Entry {
+                GovernedPublish publish;
+                void           *entity;
+                float           value;
+        };
+
+        bool    queue(GovernedPublish publish, void *entity, float value);
+        void    forget(GovernedPublish publish, void *entity);
+
+        Entry   entries[STATE_OUTBOX_SIZE] = {};
+        uint8_t count                      = 0;
+        bool    online                     = false;
+};
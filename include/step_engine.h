@@ -0,0 +1,48 @@
+#pragma once
+
+#include <Arduino.h>
+#include <driver/timer.h>
+#include "step_ramp.h"
+
+#define STEP_ENGINE_START_DELAY_US 20 // first pulse after move(), lets the caller enable the driver first
+#define STEP_ENGINE_PULSE_US       2  // STEP high time, covers A4988/DRV8825/TMC22xx minimums
+
+// Step pulse generator. Instead of polling at a fixed rate, the timer
+// alarm is programmed for the exact time of the next step from a
+// StepRamp; the timer is stopped whenever no move is active. One
+// instance per hardware timer. The interrupt is IRAM resident and keeps
+// stepping while flash is busy (LittleFS writes), so everything the ISR
+// touches is IRAM code or inlined register access.
+class StepEngine {
+    public:
+        explicit StepEngine(uint8_t stepPin) :
+            stepPin(stepPin) {}
+
+        void     begin(uint8_t timerIndex = 0);
+
+        // steps/s and steps/s^2, applied to the next move
+        void     configure(uint32_t maxSpeed, uint32_t acceleration);
+
+        // Start a relative move, false while another one is running
+        bool     move(uint32_t steps);
+
+        // Decelerate to a stop as quickly as the ramp allows
+        void     stop();
+
+        bool     isRunning() const { return running; }
+        uint32_t stepped() const { return steps; }      // pulses of the current/last move
+        uint32_t remaining() const { return ramp.remaining(); }
+
+    private:
+        static bool IRAM_ATTR onTimer(void *arg);
+
+        uint8_t               stepPin;
+        timer_group_t         group        = TIMER_GROUP_0;
+        timer_idx_t           index        = TIMER_0;
+        portMUX_TYPE          mux          = portMUX_INITIALIZER_UNLOCKED;
+        StepRamp              ramp;
+        uint32_t              maxSpeed     = 1000;
+        uint32_t              acceleration = 1000;
+        volatile bool         running      = false;
+        volatile uint32_t     steps        = 0;
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#ifdef ARDUINO
+#include <esp_attr.h>
+#else
+#define IRAM_ATTR
+#endif
+
+#define STEP_RAMP_FRACTION_BITS 8     // step intervals are kept in 1/256 us
+#define STEP_RAMP_MAX_SPEED     20000 // steps/s
+
+// Trapezoidal step timing with integer math only, safe to run from an
+// ISR on a core without FPU. Same recurrence as AccelStepper (D. Austin,
+// "Generate stepper-motor speed profiles in real time"):
+//   c0 = 0.676 * sqrt(2 / a),  c(n) = c(n-1) - 2 c(n-1) / (4n + 1)
+// so moves keep the timing they had before, within rounding. No
+// hardware access; the caller emits the pulses.
+class StepRamp {
+    public:
+        // steps/s and steps/s^2, used from the next start() on
+        void     configure(uint32_t maxSpeed, uint32_t acceleration);
+
+        // Begin a move from standstill; the first step is due right away
+        void     start(uint32_t steps);
+
+        // Shorten the move to the quickest stop the deceleration allows
+        void     stop();
+
+        // Call right after each step pulse. Returns the us until the next
+        // one, or 0 when that pulse was the last of the move.
+        uint32_t next();
+
+        bool     isRunning() const { return stepsLeft > 0; }
+        uint32_t remaining() const { return stepsLeft; }
+
+        // Steps needed to stop from the current speed
+        uint32_t stoppingSteps() const { return rampSteps; }
+
+    private:
+        uint32_t c0        = 0; // first interval, fixed point us
+        uint32_t cMin      = 0; // interval at max speed
+        uint32_t cn        = 0;
+        int32_t  n         = 0; // > 0 accelerating/cruising, < 0 decelerating
+        uint32_t rampSteps = 0;
+        uint32_t stepsLeft = 0;
+        uint32_t fraction  = 0; // sub-us remainder carried to the next interval
+};
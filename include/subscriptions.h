@@ -0,0 +1,44 @@
+#pragma once
+
+#include <Arduino.h>
+#include "topic_router.h"
+#include "value_table.h"
+
+#define SUBSCRIPTION_COUNT   VALUE_SLOT_COUNT // one filter per value slot
+#define TOPIC_MAX_LENGTH     96
+#define JSON_PATH_MAX_LENGTH 32
+#define SUBSCRIPTIONS_FILE   "/topics.txt"
+
+static_assert(SUBSCRIPTION_COUNT <= TOPIC_SLOT_COUNT, "every slot needs a bit in the router mask");
+
+// Topic filters bound to value slots, persisted on LittleFS as one
+// "<slot> <filter> [json.path]" line per subscription and editable at
+// runtime. Without a JSON path the payload has to be a bare number.
+class SubscriptionRegistry {
+    public:
+        // Replace the table with the file contents, false if there is none
+        bool        load();
+        bool        save() const;
+
+        // Bind a filter to a slot; an empty filter removes the subscription.
+        // False leaves the slot as it was, also when the router is full.
+        bool        set(uint8_t slot, const char *filter, const char *jsonPath = "");
+        const char *filter(uint8_t slot) const { return filters[slot]; }
+        const char *jsonPath(uint8_t slot) const { return jsonPaths[slot]; }
+
+        // Apply a "<slot> <filter> [json.path]" command, "<slot> -" clears the slot.
+        // Returns the changed slot or -1 if the command was rejected.
+        int         applyCommand(const uint8_t *payload, uint16_t length);
+
+        uint8_t     dispatch(const char *topic, TopicMatchHandler handler, void *context) const {
+            return router.match(topic, handler, context);
+        }
+
+    private:
+        bool        parseLine(const char *line, uint16_t length, uint8_t *slot, char *filter, char *jsonPath) const;
+        bool        rebuild(); // false if a filter didn't fit in the router
+
+        char        filters[SUBSCRIPTION_COUNT][TOPIC_MAX_LENGTH]       = {};
+        char        jsonPaths[SUBSCRIPTION_COUNT][JSON_PATH_MAX_LENGTH] = {};
+        TopicRouter router;
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <Arduino.h>
+
+#define TASK_MONITOR_STACK_EVERY 64 // iterations between stack high-water scans
+
+struct TaskStats {
+        uint32_t iterations   = 0;
+        uint32_t maxLatencyUs = 0; // worst late wake-up or queued message age
+        uint32_t maxRunUs     = 0; // worst single iteration
+        uint32_t stackFree    = 0; // bytes never touched, lowest seen
+};
+
+// Paces a periodic task and keeps its worst case figures. The task calls
+// begin() once, then wait() at the end of every iteration instead of a
+// delay; wait() measures how long the iteration ran and how late the
+// scheduler woke the task for the next one.
+class TaskMonitor {
+    public:
+        explicit TaskMonitor(const char *name) :
+            name(name) {}
+
+        void        begin(uint32_t periodMs);
+        void        wait();
+
+        // Time a message spent queued before this task handled it
+        void        noteLatency(uint32_t us) {
+            if(us > stats.maxLatencyUs)
+                stats.maxLatencyUs = us;
+        }
+
+        // One line of "name it=... lat=...us run=...us stack=..."
+        int         format(char *out, size_t size) const;
+
+        const char *name;
+        TaskStats   stats;
+
+    private:
+        TickType_t lastWake   = 0;
+        TickType_t period     = 1;
+        uint32_t   periodUs   = 0;
+        uint32_t   expectedAt = 0; // micros() the next wake-up is due
+        uint32_t   runStart   = 0;
+};
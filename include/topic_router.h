@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TOPIC_MAX_LEVELS 16
+#define TOPIC_NODE_COUNT 160
+#define TOPIC_NAME_POOL  2048
+#define TOPIC_SLOT_COUNT 32 // slots a filter can be bound to, one mask bit each
+
+typedef void (*TopicMatchHandler)(uint8_t slot, void *context);
+
+// Trie over MQTT topic levels. Every filter (which may use the + and #
+// wildcards) ends in a node holding the mask of value slots bound to it,
+// so one filter can feed several slots. The incoming topic is split and
+// hashed once, so matching is linear in the topic length instead of one
+// strcmp per subscription.
+class TopicRouter {
+    public:
+        TopicRouter() { clear(); }
+
+        void        clear();
+        // Bind one more slot to the filter, the slots already bound stay
+        bool        add(const char *filter, uint8_t slot);
+
+        // Wildcards must fill a whole level and # has to be the last one
+        static bool isValidFilter(const char *filter);
+
+        // Calls handler for every slot of every filter matching the topic,
+        // returns the count
+        uint8_t     match(const char *topic, TopicMatchHandler handler, void *context) const;
+
+    private:
+        enum NodeKind {
+            NODE_LEVEL,
+            NODE_PLUS,
+            NODE_HASH
+        };
+
+        struct Node {
+                uint32_t hash;
+                uint16_t name; // offset into names
+                uint8_t  nameLength;
+                uint8_t  kind;
+                uint32_t slots;   // bit per bound slot, 0 when no filter ends here
+                uint16_t child;   // 0 = none, the root is never a child
+                uint16_t sibling; // 0 = none
+        };
+
+        struct Level {
+                const char *start;
+                uint8_t     length;
+                uint32_t    hash;
+        };
+
+        static uint8_t split(const char *topic, Level *levels);
+        static uint8_t notify(uint32_t slots, TopicMatchHandler handler, void *context);
+        int            findOrAddChild(uint16_t parent, const Level &level);
+        uint8_t        matchFrom(uint16_t node, const Level *levels, uint8_t count, uint8_t depth, TopicMatchHandler handler, void *context) const;
+
+        Node           nodes[TOPIC_NODE_COUNT];
+        uint16_t       nodeCount;
+        char           names[TOPIC_NAME_POOL];
+        uint16_t       namesUsed;
+};
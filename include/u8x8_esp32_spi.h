@@ -0,0 +1,22 @@
+#pragma once
+
+#include <Arduino.h>
+#include <U8g2lib.h>
+
+#define LCD_SPI_CLOCK_HZ (8 * 1000 * 1000) // ST7565 tolerates up to 20 MHz
+
+// u8x8 byte callback on the ESP-IDF SPI master driver. Bytes are batched
+// into one DMA transaction per command/data run; falls back to the 64 byte
+// FIFO when no DMA channel is available.
+uint8_t u8x8_byte_esp32_spi(u8x8_t *u8x8, uint8_t msg, uint8_t arg_int, void *arg_ptr);
+
+// Same panel as U8G2_ST7565_NHD_C12864_F_4W_SW_SPI, but on the SPI2
+// peripheral routed to the given pins through the GPIO matrix
+class U8G2_ST7565_NHD_C12864_F_4W_ESP32_SPI : public U8G2 {
+    public:
+        U8G2_ST7565_NHD_C12864_F_4W_ESP32_SPI(const u8g2_cb_t *rotation, uint8_t clock, uint8_t data, uint8_t cs, uint8_t dc, uint8_t reset = U8X8_PIN_NONE) :
+            U8G2() {
+            u8g2_Setup_st7565_nhd_c12864_f(&u8g2, rotation, u8x8_byte_esp32_spi, u8x8_gpio_and_delay_arduino);
+            u8x8_SetPin_4Wire_SW_SPI(getU8x8(), clock, data, cs, dc, reset);
+        }
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <Arduino.h>
+#include "fixed_point.h"
+
+#define VALUE_SLOT_COUNT  32 // slots fed by MQTT subscriptions
+
+// Well known slots the built-in screen and the delta logic read from
+#define SLOT_CO           0
+#define SLOT_CWU          1
+#define SLOT_DATA3        2
+#define SLOT_DATA4        3
+
+// Values derived on the device, published by the task that owns them
+#define SLOT_CO_SLOPE     (VALUE_SLOT_COUNT + 0) // trend, units per minute
+#define SLOT_CWU_SLOPE    (VALUE_SLOT_COUNT + 1)
+#define SLOT_SCALE        (VALUE_SLOT_COUNT + 2) // filtered grams
+#define SLOT_SCALE_STABLE (VALUE_SLOT_COUNT + 3) // 1 while the weight is settled
+#define VALUE_TABLE_SIZE  (VALUE_SLOT_COUNT + 4)
+
+// Latest value received for one subscription
+struct ValueSlot {
+        Fixed         value     = 0;
+        uint32_t      version   = 0; // bumped on every update
+        unsigned long updatedAt = 0; // millis() of the last update
+};
+
+// Values shared between tasks. Every slot has a single writing task; a
+// sequence lock lets any task read a consistent copy without blocking the
+// writer. The version is odd while a write is in progress and changes on
+// every update, so readers can also tell whether anything is new.
+class ValueTable {
+    public:
+        void write(uint8_t slot, Fixed value, unsigned long now) {
+            volatile ValueSlot &entry = slots[slot];
+            entry.version             = entry.version + 1;
+            __sync_synchronize();
+            entry.value     = value;
+            entry.updatedAt = now;
+            __sync_synchronize();
+            entry.version = entry.version + 1;
+        }
+
+        void read(uint8_t slot, ValueSlot *out) const {
+            const volatile ValueSlot &entry = slots[slot];
+            for(;;) {
+                uint32_t version = entry.version;
+                if(version & 1) {
+                    // The writer was preempted mid-update and, on a single
+                    // core, only gets to finish once we block
+                    vTaskDelay(1);
+                    continue;
+                }
+                __sync_synchronize();
+                out->value     = entry.value;
+                out->updatedAt = entry.updatedAt;
+                __sync_synchronize();
+                if(entry.version == version) {
+                    out->version = version;
+                    return;
+                }
+            }
+        }
+
+        Fixed value(uint8_t slot) const {
+            ValueSlot copy;
+            read(slot, &copy);
+            return copy.value;
+        }
+
+        uint32_t version(uint8_t slot) const { return slots[slot].version; }
+
+    private:
+        volatile ValueSlot slots[VALUE_TABLE_SIZE];
+};
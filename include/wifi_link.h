@@ -0,0 +1,33 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoHA.h>
+#include <WiFi.h>
+#include "link_manager.h"
+
+// LinkManager driver for the ESP32 WiFi station and the HA MQTT client
+class WifiMqttLink : public LinkDriver {
+    public:
+        explicit WifiMqttLink(HAMqtt &mqtt) :
+            mqtt(mqtt) {}
+
+        // Credentials the setup portal stored in NVS, false if there are none.
+        // Needs the station interface up (WiFi.mode(WIFI_STA)).
+        bool loadCredentials();
+
+        // Takes reconnecting over from the WiFi stack and keeps the
+        // credentials for joins to a known BSSID
+        void begin();
+
+        bool wifiConnected() override { return WiFi.status() == WL_CONNECTED; }
+        void wifiConnect(const uint8_t *bssid, int32_t channel) override;
+        bool wifiLinkInfo(uint8_t *bssid, int32_t *channel, int8_t *rssi) override;
+
+        bool mqttConnected() override { return mqtt.isConnected(); }
+        void mqttPoll() override { mqtt.loop(); }
+
+    private:
+        HAMqtt &mqtt;
+        char    ssid[33] = "";
+        char    psk[65]  = "";
+};
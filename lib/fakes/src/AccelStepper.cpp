@@ -0,0 +1,113 @@
+#include "AccelStepper.h"
+
+AccelStepper::AccelStepper(uint8_t interface, uint8_t stepPin, uint8_t dirPin) {
+    setAcceleration(1);
+    setMaxSpeed(1);
+}
+
+void AccelStepper::moveTo(long absolute) {
+    if(_targetPos != absolute) {
+        _targetPos = absolute;
+        computeNewSpeed();
+    }
+}
+
+void AccelStepper::move(long relative) {
+    moveTo(_currentPos + relative);
+}
+
+bool AccelStepper::runSpeed() {
+    if(!_stepInterval)
+        return false;
+
+    unsigned long time = micros();
+    if(time - _lastStepTime >= _stepInterval) {
+        _currentPos += _clockwise ? 1 : -1;
+        times.push_back(time);
+        _lastStepTime = time;
+        return true;
+    }
+    return false;
+}
+
+bool AccelStepper::run() {
+    if(runSpeed())
+        computeNewSpeed();
+    return _speed != 0.0f || distanceToGo() != 0;
+}
+
+void AccelStepper::computeNewSpeed() {
+    long distanceTo  = distanceToGo();
+    long stepsToStop = (long) ((_speed * _speed) / (2.0 * _acceleration));
+
+    if(distanceTo == 0 && stepsToStop <= 1) {
+        _stepInterval = 0;
+        _speed        = 0.0f;
+        _n            = 0;
+        return;
+    }
+
+    if(distanceTo > 0) {
+        if(_n > 0) {
+            if(stepsToStop >= distanceTo || !_clockwise)
+                _n = -stepsToStop; // start decelerating
+        } else if(_n < 0) {
+            if(stepsToStop < distanceTo && _clockwise)
+                _n = -_n; // start accelerating
+        }
+    } else if(distanceTo < 0) {
+        if(_n > 0) {
+            if(stepsToStop >= -distanceTo || _clockwise)
+                _n = -stepsToStop;
+        } else if(_n < 0) {
+            if(stepsToStop < -distanceTo && !_clockwise)
+                _n = -_n;
+        }
+    }
+
+    if(_n == 0) {
+        _cn        = _c0; // first step from stopped
+        _clockwise = distanceTo > 0;
+    } else {
+        _cn = _cn - ((2.0 * _cn) / ((4.0 * _n) + 1));
+        _cn = max(_cn, _cmin);
+    }
+    _n++;
+    _stepInterval = _cn;
+    _speed        = 1000000.0 / _cn;
+    if(!_clockwise)
+        _speed = -_speed;
+}
+
+void AccelStepper::setMaxSpeed(float speed) {
+    if(speed < 0.0f)
+        speed = -speed;
+    if(_maxSpeed != speed) {
+        _maxSpeed = speed;
+        _cmin     = 1000000.0 / speed;
+        if(_n > 0) {
+            _n = (long) ((_speed * _speed) / (2.0 * _acceleration)); // recompute from the current speed
+            computeNewSpeed();
+        }
+    }
+}
+
+void AccelStepper::setAcceleration(float acceleration) {
+    if(acceleration == 0.0f)
+        return;
+    if(acceleration < 0.0f)
+        acceleration = -acceleration;
+    if(_acceleration != acceleration) {
+        _n            = _n * (_acceleration / acceleration);
+        _c0           = 0.676 * sqrt(2.0 / acceleration) * 1000000.0;
+        _acceleration = acceleration;
+        computeNewSpeed();
+    }
+}
+
+void AccelStepper::stop() {
+    if(_speed != 0.0f) {
+        long stepsToStop = (long) ((_speed * _speed) / (2.0 * _acceleration)) + 1;
+        move(_speed > 0 ? stepsToStop : -stepsToStop);
+    }
+}
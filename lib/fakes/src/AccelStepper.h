@@ -0,0 +1,51 @@
+#pragma once
+
+#include <Arduino.h>
+#include <vector>
+
+// The step timing of AccelStepper 1.64 (run(), runSpeed() and
+// computeNewSpeed() follow the library line by line) driven by the fake
+// micros(). The firmware no longer links the library; this is the
+// reference StepRamp is compared against. Step times are recorded.
+class AccelStepper {
+    public:
+        enum MotorInterfaceType {
+            DRIVER = 1
+        };
+
+        AccelStepper(uint8_t interface = DRIVER, uint8_t stepPin = 2, uint8_t dirPin = 3);
+
+        void                              moveTo(long absolute);
+        void                              move(long relative);
+        bool                              run();
+        bool                              runSpeed();
+        void                              setMaxSpeed(float speed);
+        float                             maxSpeed() const { return _maxSpeed; }
+        void                              setAcceleration(float acceleration);
+        float                             speed() const { return _speed; }
+        long                              distanceToGo() const { return _targetPos - _currentPos; }
+        long                              targetPosition() const { return _targetPos; }
+        long                              currentPosition() const { return _currentPos; }
+        void                              stop();
+        bool                              isRunning() const { return !(_speed == 0.0f && _targetPos == _currentPos); }
+
+        // Fake only: micros() of every step since construction
+        const std::vector<unsigned long> &stepTimes() const { return times; }
+
+    private:
+        void                       computeNewSpeed();
+
+        long                       _currentPos   = 0;
+        long                       _targetPos    = 0;
+        float                      _speed        = 0.0f;
+        float                      _maxSpeed     = 1.0f;
+        float                      _acceleration = 0.0f;
+        unsigned long              _stepInterval = 0;
+        unsigned long              _lastStepTime = 0;
+        long                       _n            = 0;
+        float                      _c0           = 0.0f;
+        float                      _cn           = 0.0f;
+        float                      _cmin         = 1000000.0f;
+        bool                       _clockwise    = false;
+        std::vector<unsigned long> times;
+};
@@ -0,0 +1,180 @@
+#include "Arduino.h"
+
+#include <stdarg.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "esp_cpu.h"
+#include "fakes.h"
+
+HardwareSerial               Serial;
+EspClass                     ESP;
+
+static std::atomic<uint64_t> fakeMicros(0);
+
+void fakeSetMicros(uint64_t us) {
+    fakeMicros = us;
+}
+
+void fakeAdvanceMicros(uint64_t us) {
+    fakeMicros += us;
+}
+
+void fakeAdvanceMillis(uint32_t ms) {
+    fakeMicros += (uint64_t) ms * 1000;
+}
+
+unsigned long millis() {
+    return (unsigned long) (fakeMicros / 1000);
+}
+
+unsigned long micros() {
+    return (unsigned long) fakeMicros;
+}
+
+void delay(uint32_t ms) {
+    fakeAdvanceMillis(ms);
+    std::this_thread::yield();
+}
+
+uint32_t esp_cpu_get_ccount(void) {
+    auto elapsed = std::chrono::steady_clock::now().time_since_epoch();
+    return (uint32_t) (std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() * 160 / 1000);
+}
+
+size_t HardwareSerial::print(const char *text) {
+    return fputs(text, stdout) >= 0 ? strlen(text) : 0;
+}
+
+size_t HardwareSerial::println(const char *text) {
+    return print(text) + print("\n");
+}
+
+size_t HardwareSerial::printf(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int written = vprintf(format, args);
+    va_end(args);
+    return written > 0 ? written : 0;
+}
+
+// A task is a detached thread; its notification value is a counter
+struct FakeTask {
+        std::mutex              lock;
+        std::condition_variable wake;
+        uint32_t                notified = 0;
+        char                    name[16];
+        TaskFunction_t          code;
+        void                   *arg;
+};
+
+static thread_local FakeTask *currentTask = NULL;
+static FakeTask               mainTask;
+
+static FakeTask *self() {
+    return currentTask != NULL ? currentTask : &mainTask;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t code, const char *name, uint32_t stack, void *arg, UBaseType_t priority, TaskHandle_t *handle) {
+    FakeTask *task = new FakeTask;
+    snprintf(task->name, sizeof(task->name), "%s", name);
+    task->code = code;
+    task->arg  = arg;
+    if(handle != NULL)
+        *handle = task;
+    std::thread([task]() {
+        currentTask = task;
+        task->code(task->arg);
+    }).detach();
+    return pdPASS;
+}
+
+void vTaskDelay(TickType_t ticks) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks > 0 ? ticks : 0));
+    std::this_thread::yield();
+}
+
+void vTaskDelayUntil(TickType_t *previousWake, TickType_t period) {
+    *previousWake += period;
+    vTaskDelay(period);
+}
+
+TickType_t xTaskGetTickCount() {
+    return millis();
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+    return 1024;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    return self();
+}
+
+char *pcTaskGetName(TaskHandle_t task) {
+    FakeTask *fake = task != NULL ? static_cast<FakeTask *>(task) : self();
+    if(fake == &mainTask)
+        snprintf(fake->name, sizeof(fake->name), "main");
+    return fake->name;
+}
+
+BaseType_t xPortInIsrContext() {
+    return pdFALSE;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    if(task == NULL)
+        return pdFALSE;
+    FakeTask *fake = static_cast<FakeTask *>(task);
+    {
+        std::lock_guard<std::mutex> guard(fake->lock);
+        fake->notified++;
+    }
+    fake->wake.notify_all();
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t timeout) {
+    FakeTask                    *task = self();
+    std::unique_lock<std::mutex> guard(task->lock);
+    auto                         ready = [task]() { return task->notified > 0; };
+    if(timeout == portMAX_DELAY)
+        task->wake.wait(guard, ready);
+    else
+        task->wake.wait_for(guard, std::chrono::milliseconds(timeout), ready);
+
+    uint32_t value = task->notified;
+    if(value > 0)
+        task->notified = clear ? 0 : value - 1;
+    return value;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+    return new std::recursive_timed_mutex;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t timeout) {
+    std::recursive_timed_mutex *mutex = static_cast<std::recursive_timed_mutex *>(semaphore);
+    if(timeout == portMAX_DELAY) {
+        mutex->lock();
+        return pdTRUE;
+    }
+    return mutex->try_lock_for(std::chrono::milliseconds(timeout)) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    static_cast<std::recursive_timed_mutex *>(semaphore)->unlock();
+    return pdTRUE;
+}
+
+static std::recursive_mutex criticalLock;
+
+void portENTER_CRITICAL(portMUX_TYPE *mux) {
+    criticalLock.lock();
+}
+
+void portEXIT_CRITICAL(portMUX_TYPE *mux) {
+    criticalLock.unlock();
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+// Host stand-in for the part of arduino-esp32 and FreeRTOS the firmware
+// logic uses (env:native only). Time comes from a fake clock the tests
+// move, see fakes.h; tasks are threads and critical sections one lock.
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+#include "esp_attr.h"
+
+#define HIGH 1
+#define LOW  0
+
+using std::max;
+using std::min;
+
+typedef uint8_t byte;
+
+unsigned long millis();
+unsigned long micros();
+void          delay(uint32_t ms); // advances the fake clock and lets tasks run
+
+class HardwareSerial {
+    public:
+        size_t print(const char *text);
+        size_t println(const char *text = "");
+        size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+extern HardwareSerial Serial;
+
+class EspClass {
+    public:
+        uint32_t getCpuFreqMHz() { return 160; }
+        uint32_t getFreeHeap() { return 200000; }
+};
+
+extern EspClass ESP;
+
+// FreeRTOS, one tick per millisecond like the firmware's config
+typedef void    *TaskHandle_t;
+typedef void    *SemaphoreHandle_t;
+typedef uint32_t TickType_t;
+typedef int      BaseType_t;
+typedef unsigned UBaseType_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define pdTRUE               1
+#define pdFALSE              0
+#define pdPASS               1
+#define portMAX_DELAY        0xffffffffu
+#define portTICK_PERIOD_MS   1
+#define pdMS_TO_TICKS(ms)    ((TickType_t) (ms))
+
+BaseType_t        xTaskCreate(TaskFunction_t code, const char *name, uint32_t stack, void *arg, UBaseType_t priority, TaskHandle_t *handle);
+void              vTaskDelay(TickType_t ticks); // real sleep, the fake clock stays put
+void              vTaskDelayUntil(TickType_t *previousWake, TickType_t period);
+TickType_t        xTaskGetTickCount();
+UBaseType_t       uxTaskGetStackHighWaterMark(TaskHandle_t task);
+TaskHandle_t      xTaskGetCurrentTaskHandle();
+char             *pcTaskGetName(TaskHandle_t task);
+BaseType_t        xPortInIsrContext();
+BaseType_t        xTaskNotifyGive(TaskHandle_t task);
+uint32_t          ulTaskNotifyTake(BaseType_t clear, TickType_t timeout);
+
+SemaphoreHandle_t xSemaphoreCreateMutex();
+BaseType_t        xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t timeout);
+BaseType_t        xSemaphoreGive(SemaphoreHandle_t semaphore);
+
+// Every critical section shares one recursive lock
+typedef struct {
+        int unused;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {0}
+
+void portENTER_CRITICAL(portMUX_TYPE *mux);
+void portEXIT_CRITICAL(portMUX_TYPE *mux);
+
+#define portENTER_CRITICAL_ISR(mux)  portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux)   portEXIT_CRITICAL(mux)
+#define portENTER_CRITICAL_SAFE(mux) portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_SAFE(mux)  portEXIT_CRITICAL(mux)
@@ -0,0 +1,49 @@
+#include "ArduinoHA.h"
+
+HAMqtt *HAMqtt::current = NULL;
+
+HAMqtt::HAMqtt(void *client, HADevice &device, uint8_t maxEntities) {
+    current = this;
+}
+
+bool HAMqtt::subscribe(const char *topic) {
+    if(!connected)
+        return false;
+    subscriptions.push_back(topic);
+    return true;
+}
+
+bool HAMqtt::publish(const char *topic, const char *payload, bool retained) {
+    return publishState(topic, payload);
+}
+
+void HAMqtt::setConnected(bool up) {
+    connected = up;
+    if(!up)
+        subscriptions.clear(); // a new session subscribes again
+    else if(connectedCallback != NULL)
+        connectedCallback();
+}
+
+void HAMqtt::deliver(const char *topic, const char *payload) {
+    if(connected && messageCallback != NULL)
+        messageCallback(topic, (const uint8_t *) payload, strlen(payload));
+}
+
+bool HAMqtt::publishState(const char *uniqueId, const char *state) {
+    if(!connected)
+        return false;
+    states[uniqueId] = state;
+    published.push_back(std::string(uniqueId) + "=" + state);
+    return true;
+}
+
+bool HABaseDeviceType::publishText(const char *text) {
+    return HAMqtt::instance() != NULL && HAMqtt::instance()->publishState(id, text);
+}
+
+bool HABaseDeviceType::publishNumber(float value, uint8_t precision) {
+    char text[24];
+    snprintf(text, sizeof(text), "%.*f", precision, value);
+    return publishText(text);
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <Arduino.h>
+#include <map>
+#include <string>
+#include <vector>
+
+// Host stand-in for the part of arduino-home-assistant 2.x the firmware
+// uses. HAMqtt is a broker stand-in: while "connected" every state an
+// entity sets is recorded per unique id, the way a retained topic keeps
+// the last one; while not, setters fail like the real ones do.
+
+class HADevice {
+    public:
+        explicit HADevice(const char *id = "") {}
+        void setName(const char *name) {}
+        void setSoftwareVersion(const char *version) {}
+        void setManufacturer(const char *name) {}
+        void setModel(const char *name) {}
+        void enableSharedAvailability() {}
+        void enableLastWill() {}
+};
+
+class HAMqtt {
+    public:
+        HAMqtt(void *client, HADevice &device, uint8_t maxEntities = 6);
+
+        static HAMqtt                     *instance() { return current; }
+
+        bool                               begin(const char *host, uint16_t port = 1883, const char *user = NULL, const char *password = NULL) { return true; }
+        void                               loop() {}
+        bool                               isConnected() const { return connected; }
+        bool                               subscribe(const char *topic);
+        bool                               publish(const char *topic, const char *payload, bool retained = false);
+        void                               onMessage(void (*callback)(const char *, const uint8_t *, uint16_t)) { messageCallback = callback; }
+        void                               onConnected(void (*callback)()) { connectedCallback = callback; }
+
+        // Test side
+        void                               setConnected(bool up);
+        void                               deliver(const char *topic, const char *payload);
+        bool                               publishState(const char *uniqueId, const char *state);
+
+        std::map<std::string, std::string> states;    // last state per entity
+        std::vector<std::string>           published; // "id=state" in publish order
+        std::vector<std::string>           subscriptions;
+
+    private:
+        static HAMqtt *current;
+        bool           connected = false;
+        void (*messageCallback)(const char *, const uint8_t *, uint16_t) = NULL;
+        void (*connectedCallback)()                                      = NULL;
+};
+
+class HANumeric {
+    public:
+        HANumeric() {}
+        HANumeric(float value, uint8_t precision) :
+            value(value), precision(precision) {}
+
+        bool    isSet() const { return precision != 0xff; }
+        float   toFloat() const { return value; }
+        int16_t toInt16() const { return (int16_t) value; }
+        int32_t toInt32() const { return (int32_t) value; }
+        uint8_t toUInt8() const { return (uint8_t) value; }
+        uint8_t getPrecision() const { return precision; }
+
+    private:
+        float   value     = 0.0f;
+        uint8_t precision = 0xff;
+};
+
+class HABaseDeviceType {
+    public:
+        enum NumberPrecision {
+            PrecisionP0 = 0,
+            PrecisionP1,
+            PrecisionP2,
+            PrecisionP3
+        };
+
+        explicit HABaseDeviceType(const char *uniqueId) :
+            id(uniqueId) {}
+
+        const char *uniqueId() const { return id; }
+        void        setName(const char *name) {}
+        void        setIcon(const char *icon) {}
+
+    protected:
+        bool        publishText(const char *text);
+        bool        publishNumber(float value, uint8_t precision);
+
+        const char *id;
+};
+
+class HASensor : public HABaseDeviceType {
+    public:
+        explicit HASensor(const char *uniqueId, uint16_t features = 0) :
+            HABaseDeviceType(uniqueId) {}
+
+        bool setValue(const char *value) { return publishText(value); }
+        void setUnitOfMeasurement(const char *unit) {}
+        void setDeviceClass(const char *deviceClass) {}
+};
+
+class HASensorNumber : public HASensor {
+    public:
+        HASensorNumber(const char *uniqueId, NumberPrecision precision = PrecisionP0, uint16_t features = 0) :
+            HASensor(uniqueId), precision(precision) {}
+
+        bool setValue(float value, bool force = false) { return publishNumber(value, precision); }
+        bool setValue(int32_t value, bool force = false) { return publishNumber(value, precision); }
+        bool setValue(uint32_t value, bool force = false) { return publishNumber(value, precision); }
+
+    private:
+        uint8_t precision;
+};
+
+class HANumber : public HABaseDeviceType {
+    public:
+        enum Mode {
+            ModeAuto = 0,
+            ModeBox,
+            ModeSlider
+        };
+
+        HANumber(const char *uniqueId, NumberPrecision precision = PrecisionP0) :
+            HABaseDeviceType(uniqueId), precision(precision) {}
+
+        bool setState(float value, bool force = false) { return publishNumber(value, precision); }
+        bool setState(const HANumeric &value, bool force = false) { return publishNumber(value.toFloat(), precision); }
+        void setCurrentState(float value) {}
+        void setMode(Mode mode) {}
+        void setMin(float value) {}
+        void setMax(float value) {}
+        void setStep(float value) {}
+        void setOptimistic(bool optimistic) {}
+        void setUnitOfMeasurement(const char *unit) {}
+        void onCommand(void (*callback)(HANumeric, HANumber *)) {}
+
+    private:
+        uint8_t precision;
+};
+
+class HAButton : public HABaseDeviceType {
+    public:
+        explicit HAButton(const char *uniqueId) :
+            HABaseDeviceType(uniqueId) {}
+
+        void onCommand(void (*callback)(HAButton *)) {}
+};
+
+class HASwitch : public HABaseDeviceType {
+    public:
+        explicit HASwitch(const char *uniqueId) :
+            HABaseDeviceType(uniqueId) {}
+
+        bool setState(bool state, bool force = false) { return publishText(state ? "ON" : "OFF"); }
+        void setCurrentState(bool state) {}
+        void onCommand(void (*callback)(bool, HASwitch *)) {}
+};
+
+class HALight : public HABaseDeviceType {
+    public:
+        enum Features {
+            DefaultFeatures   = 0,
+            BrightnessFeature = 1
+        };
+
+        HALight(const char *uniqueId, uint8_t features = DefaultFeatures) :
+            HABaseDeviceType(uniqueId) {}
+
+        bool setState(bool state, bool force = false) { return publishText(state ? "ON" : "OFF"); }
+        bool setBrightness(uint8_t brightness, bool force = false) { return publishNumber(brightness, 0); }
+        void setCurrentState(bool state) {}
+        void setCurrentBrightness(uint8_t brightness) {}
+};
@@ -0,0 +1,199 @@
+#include "LittleFS.h"
+
+#include "fakes.h"
+
+fs::LittleFSFS  LittleFS;
+
+static size_t   tearBudget   = 0;
+static bool     tearing      = false;
+static uint32_t bytesWritten = 0;
+static uint32_t writeOpens   = 0;
+
+namespace fs {
+
+size_t File::write(const uint8_t *buffer, size_t size) {
+    if(!open || !writable || directory)
+        return 0;
+    if(tearing) {
+        if(size > tearBudget)
+            size = tearBudget;
+        tearBudget -= size;
+    }
+    if(append)
+        pos = node->data.size();
+    if(node->data.size() < pos + size)
+        node->data.resize(pos + size);
+    memcpy(node->data.data() + pos, buffer, size);
+    pos          += size;
+    bytesWritten += size;
+    return size;
+}
+
+size_t File::read(uint8_t *buffer, size_t size) {
+    if(!open || directory || pos >= node->data.size())
+        return 0;
+    size_t n = std::min(size, node->data.size() - pos);
+    memcpy(buffer, node->data.data() + pos, n);
+    pos += n;
+    return n;
+}
+
+int File::read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+}
+
+int File::available() {
+    return open && !directory && pos < node->data.size() ? (int) (node->data.size() - pos) : 0;
+}
+
+bool File::seek(uint32_t offset, SeekMode mode) {
+    if(!open || directory)
+        return false;
+    size_t base = mode == SeekSet ? 0 : mode == SeekCur ? pos : node->data.size();
+    if(base + offset > node->data.size())
+        return false;
+    pos = base + offset;
+    return true;
+}
+
+size_t File::size() const {
+    return open && !directory ? node->data.size() : 0;
+}
+
+void File::close() {
+    open = false;
+    node.reset();
+}
+
+const char *File::name() const {
+    size_t slash = fullPath.rfind('/');
+    return slash == std::string::npos ? fullPath.c_str() : fullPath.c_str() + slash + 1;
+}
+
+File File::openNextFile(const char *mode) {
+    if(!open || !directory || nextEntry >= entries.size())
+        return File();
+    return owner->open(entries[nextEntry++].c_str(), mode);
+}
+
+static std::string parentOf(const std::string &path) {
+    size_t slash = path.rfind('/');
+    return slash == 0 || slash == std::string::npos ? "/" : path.substr(0, slash);
+}
+
+File FS::open(const char *path, const char *mode, bool create) {
+    std::string key(path);
+    File        file;
+    file.fullPath = key;
+    file.owner    = this;
+
+    if(dirs.count(key) || key == "/") {
+        file.open      = true;
+        file.directory = true;
+        for(auto &entry : files)
+            if(parentOf(entry.first) == key)
+                file.entries.push_back(entry.first);
+        for(auto &entry : dirs)
+            if(entry.first != key && parentOf(entry.first) == key)
+                file.entries.push_back(entry.first);
+        return file;
+    }
+
+    auto found = files.find(key);
+    if(mode[0] == 'r') {
+        if(found == files.end())
+            return file;
+        file.node     = found->second;
+        file.writable = mode[1] == '+';
+    } else {
+        if(tearing && tearBudget == 0)
+            return file; // no power, nothing opens for writing
+        if(found == files.end() || mode[0] == 'w') {
+            auto node  = std::make_shared<FakeNode>();
+            files[key] = node;
+            found      = files.find(key);
+        }
+        file.node     = found->second;
+        file.writable = true;
+        file.append   = mode[0] == 'a';
+        writeOpens++;
+    }
+    file.open = true;
+    return file;
+}
+
+bool FS::exists(const char *path) {
+    return files.count(path) > 0 || dirs.count(path) > 0;
+}
+
+bool FS::remove(const char *path) {
+    if(tearing && tearBudget == 0)
+        return false;
+    return files.erase(path) > 0;
+}
+
+bool FS::rename(const char *from, const char *to) {
+    auto found = files.find(from);
+    if(found == files.end() || (tearing && tearBudget == 0))
+        return false;
+    files[to] = found->second;
+    files.erase(from);
+    return true;
+}
+
+bool FS::mkdir(const char *path) {
+    dirs[path] = true;
+    return true;
+}
+
+bool FS::rmdir(const char *path) {
+    return dirs.erase(path) > 0;
+}
+
+void FS::reset() {
+    files.clear();
+    dirs.clear();
+}
+
+size_t FS::usedBytes() {
+    size_t used = 0;
+    for(auto &entry : files)
+        used += entry.second->data.size();
+    return used;
+}
+
+} // namespace fs
+
+void fakeFsReset() {
+    LittleFS.reset();
+    fakeFsRestore();
+    bytesWritten = 0;
+    writeOpens   = 0;
+}
+
+void fakeFsTearAfter(size_t bytes) {
+    tearing    = true;
+    tearBudget = bytes;
+}
+
+void fakeFsRestore() {
+    tearing    = false;
+    tearBudget = 0;
+}
+
+uint32_t fakeFsBytesWritten() {
+    return bytesWritten;
+}
+
+uint32_t fakeFsWriteOpens() {
+    return writeOpens;
+}
+
+bool fakeFsCorrupt(const char *path, size_t offset, uint8_t mask) {
+    auto found = LittleFS.files.find(path);
+    if(found == LittleFS.files.end() || offset >= found->second->data.size())
+        return false;
+    found->second->data[offset] ^= mask;
+    return true;
+}
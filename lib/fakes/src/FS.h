@@ -0,0 +1,86 @@
+#pragma once
+
+#include <Arduino.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// In-memory stand-in for the arduino-esp32 FS API. A File shares its
+// data with the filesystem, so reads see earlier writes at once, like
+// LittleFS after close(). Faults are injected through fakes.h.
+namespace fs {
+
+enum SeekMode {
+    SeekSet = 0,
+    SeekCur = 1,
+    SeekEnd = 2
+};
+
+struct FakeNode {
+        std::vector<uint8_t> data;
+};
+
+class FS;
+
+class File {
+    public:
+        File() {}
+
+        size_t      write(const uint8_t *buffer, size_t size);
+        size_t      write(uint8_t c) { return write(&c, 1); }
+        size_t      read(uint8_t *buffer, size_t size);
+        int         read();
+        int         available();
+        bool        seek(uint32_t pos, SeekMode mode = SeekSet);
+        size_t      position() const { return pos; }
+        size_t      size() const;
+        void        flush() {}
+        void        close();
+        const char *name() const;
+        const char *path() const { return fullPath.c_str(); }
+        bool        isDirectory() const { return directory; }
+        File        openNextFile(const char *mode = "r");
+        operator bool() const { return open; }
+
+    private:
+        friend class FS;
+
+        std::shared_ptr<FakeNode> node;
+        std::string               fullPath;
+        size_t                    pos       = 0;
+        bool                      open      = false;
+        bool                      writable  = false;
+        bool                      append    = false;
+        bool                      directory = false;
+        std::vector<std::string>  entries; // directory listing taken at open
+        size_t                    nextEntry = 0;
+        FS                       *owner     = NULL;
+};
+
+class FS {
+    public:
+        File   open(const char *path, const char *mode = "r", bool create = false);
+        bool   exists(const char *path);
+        bool   remove(const char *path);
+        bool   rename(const char *from, const char *to);
+        bool   mkdir(const char *path);
+        bool   rmdir(const char *path);
+
+        // Test hooks, see fakes.h
+        void   reset();
+        size_t totalBytes() { return 1536 * 1024; }
+        size_t usedBytes();
+
+        std::map<std::string, std::shared_ptr<FakeNode>> files;
+        std::map<std::string, bool>                       dirs;
+};
+
+} // namespace fs
+
+using fs::File;
+using fs::FS;
+using fs::SeekCur;
+using fs::SeekEnd;
+using fs::SeekMode;
+using fs::SeekSet;
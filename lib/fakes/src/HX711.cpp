@@ -0,0 +1,25 @@
+#include "HX711.h"
+
+bool HX711::is_ready() {
+    std::lock_guard<std::mutex> guard(lock);
+    return !samples.empty();
+}
+
+long HX711::read() {
+    std::lock_guard<std::mutex> guard(lock);
+    if(!samples.empty()) {
+        last = samples.front();
+        samples.pop_front();
+    }
+    return last; // like the chip, an early read gets the previous conversion
+}
+
+void HX711::push(long counts) {
+    std::lock_guard<std::mutex> guard(lock);
+    samples.push_back(counts);
+}
+
+size_t HX711::pending() {
+    std::lock_guard<std::mutex> guard(lock);
+    return samples.size();
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <Arduino.h>
+#include <deque>
+#include <mutex>
+
+// Host stand-in for bogde/HX711: the test pushes raw counts, the
+// sampling task reads them back one conversion at a time
+class HX711 {
+    public:
+        void   begin(uint8_t dout, uint8_t sck, uint8_t gain = 128) {}
+        bool   is_ready();
+        long   read();
+        void   power_down() {}
+        void   power_up() {}
+
+        // Test side
+        void   push(long counts);
+        size_t pending();
+
+    private:
+        std::deque<long> samples;
+        std::mutex       lock;
+        long             last = 0;
+};
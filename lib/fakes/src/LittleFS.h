@@ -0,0 +1,19 @@
+#pragma once
+
+#include "FS.h"
+
+namespace fs {
+
+class LittleFSFS : public FS {
+    public:
+        bool begin(bool formatOnFail = false) { return true; }
+        bool format() {
+            reset();
+            return true;
+        }
+        void end() {}
+};
+
+} // namespace fs
+
+extern fs::LittleFSFS LittleFS;
@@ -0,0 +1,121 @@
+#include "U8g2lib.h"
+
+const u8g2_cb_t u8g2_cb_r0 = { 0 };
+
+const uint8_t   u8g2_font_t0_40_tf[]  = { 20, 23, 20 };
+const uint8_t   u8g2_font_t0_22_tf[]  = { 11, 13, 11 };
+const uint8_t   u8g2_font_t0_13_tf[]  = { 6, 9, 6 };
+const uint8_t   u8g2_font_tiny5_tf[]  = { 4, 5, 5 };
+const uint8_t   u8g2_font_luRS18_tn[] = { 13, 18, 14 };
+const uint8_t   u8g2_font_5x7_tf[]    = { 5, 7, 5 };
+
+uint8_t u8x8_DrawTile(u8x8_t *u8x8, uint8_t x, uint8_t y, uint8_t count, uint8_t *tiles) {
+    if(y >= U8G2_FAKE_HEIGHT / 8 || x + count > U8G2_FAKE_WIDTH / 8)
+        return 0;
+    memcpy(u8x8->panel + (y * U8G2_FAKE_WIDTH / 8 + x) * 8, tiles, count * 8);
+    u8x8->tilesWritten += count;
+    return 1;
+}
+
+U8G2::U8G2() {
+    memset(u8x8.panel, 0, sizeof(u8x8.panel));
+    clearBuffer();
+}
+
+void U8G2::clearBuffer() {
+    memset(buffer, 0, sizeof(buffer));
+}
+
+void U8G2::sendBuffer() {
+    memcpy(u8x8.panel, buffer, sizeof(buffer));
+    u8x8.tilesWritten += sizeof(buffer) / 8;
+}
+
+void U8G2::drawPixel(int x, int y) {
+    if(x < 0 || y < 0 || x >= U8G2_FAKE_WIDTH || y >= U8G2_FAKE_HEIGHT)
+        return;
+    uint8_t &cell = buffer[(y / 8) * U8G2_FAKE_WIDTH + x];
+    uint8_t  bit  = 1 << (y % 8);
+    if(drawColor == 0)
+        cell &= ~bit;
+    else if(drawColor == 2)
+        cell ^= bit;
+    else
+        cell |= bit;
+}
+
+void U8G2::drawHLine(int x, int y, int w) {
+    for(int i = 0; i < w; i++)
+        drawPixel(x + i, y);
+}
+
+void U8G2::drawVLine(int x, int y, int h) {
+    for(int i = 0; i < h; i++)
+        drawPixel(x, y + i);
+}
+
+void U8G2::drawLine(int x0, int y0, int x1, int y1) {
+    int dx  = abs(x1 - x0);
+    int dy  = -abs(y1 - y0);
+    int sx  = x0 < x1 ? 1 : -1;
+    int sy  = y0 < y1 ? 1 : -1;
+    int err = dx + dy;
+    for(;;) {
+        drawPixel(x0, y0);
+        if(x0 == x1 && y0 == y1)
+            break;
+        int e2 = 2 * err;
+        if(e2 >= dy) {
+            err += dy;
+            x0  += sx;
+        }
+        if(e2 <= dx) {
+            err += dx;
+            y0  += sy;
+        }
+    }
+}
+
+void U8G2::drawFrame(int x, int y, int w, int h) {
+    if(w <= 0 || h <= 0)
+        return;
+    drawHLine(x, y, w);
+    drawHLine(x, y + h - 1, w);
+    drawVLine(x, y, h);
+    drawVLine(x + w - 1, y, h);
+}
+
+void U8G2::drawBox(int x, int y, int w, int h) {
+    for(int i = 0; i < h; i++)
+        drawHLine(x, y + i, w);
+}
+
+uint16_t U8G2::drawGlyph(int x, int y, uint16_t encoding) {
+    if(font == NULL)
+        return 0;
+    uint8_t width  = font[0];
+    uint8_t height = font[1];
+    if(encoding == ' ')
+        return font[2];
+    // A border plus a few code dependent pixels inside
+    for(int column = 0; column < width; column++) {
+        for(int row = 0; row < height; row++) {
+            bool edge  = column == 0 || row == 0 || column == width - 1 || row == height - 1;
+            bool inner = ((encoding * 7 + column * 3 + row * 5) % 11) == 0;
+            if(edge || inner)
+                drawPixel(x + column, y - height + 1 + row);
+        }
+    }
+    return font[2];
+}
+
+uint16_t U8G2::drawStr(int x, int y, const char *text) {
+    int start = x;
+    for(const char *c = text; *c != '\0'; c++)
+        x += drawGlyph(x, y, (uint8_t) *c);
+    return x - start;
+}
+
+uint16_t U8G2::getStrWidth(const char *text) const {
+    return font != NULL ? strlen(text) * font[2] : 0;
+}
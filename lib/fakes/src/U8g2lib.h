@@ -0,0 +1,78 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Host stand-in for the u8g2 full buffer API on a 128x64 panel. Drawing
+// goes into the same page-major buffer layout as the real library, and
+// u8x8_DrawTile() copies tiles into a fake panel RAM tests can inspect.
+// Fonts are fake too: every glyph is a pattern derived from its code in
+// a box the size of the font, enough to tell glyphs and fonts apart.
+
+#define U8G2_FAKE_WIDTH  128
+#define U8G2_FAKE_HEIGHT 64
+
+struct u8x8_t {
+        uint8_t  panel[U8G2_FAKE_WIDTH * U8G2_FAKE_HEIGHT / 8]; // what the glass shows
+        uint32_t tilesWritten = 0;
+        uint8_t  contrast     = 0;
+};
+
+uint8_t u8x8_DrawTile(u8x8_t *u8x8, uint8_t x, uint8_t y, uint8_t count, uint8_t *tiles);
+
+struct u8g2_cb_t {
+        int unused;
+};
+
+extern const u8g2_cb_t u8g2_cb_r0;
+#define U8G2_R0 (&u8g2_cb_r0)
+
+// Fake font data: glyph width, height above the baseline, advance
+extern const uint8_t u8g2_font_t0_40_tf[];
+extern const uint8_t u8g2_font_t0_22_tf[];
+extern const uint8_t u8g2_font_t0_13_tf[];
+extern const uint8_t u8g2_font_tiny5_tf[];
+extern const uint8_t u8g2_font_luRS18_tn[];
+extern const uint8_t u8g2_font_5x7_tf[];
+
+class U8G2 {
+    public:
+        U8G2();
+
+        bool     begin() { return true; }
+        void     clearBuffer();
+        void     sendBuffer();
+        void     setContrast(uint8_t value) { u8x8.contrast = value; }
+        u8x8_t  *getU8x8() { return &u8x8; }
+
+        uint8_t *getBufferPtr() { return buffer; }
+        uint8_t  getBufferTileWidth() const { return U8G2_FAKE_WIDTH / 8; }
+        uint8_t  getBufferTileHeight() const { return U8G2_FAKE_HEIGHT / 8; }
+        uint8_t  getDisplayWidth() const { return U8G2_FAKE_WIDTH; }
+        uint8_t  getDisplayHeight() const { return U8G2_FAKE_HEIGHT; }
+
+        void     setDrawColor(uint8_t color) { drawColor = color; }
+        uint8_t  getDrawColor() const { return drawColor; }
+        void     drawPixel(int x, int y);
+        void     drawHLine(int x, int y, int w);
+        void     drawVLine(int x, int y, int h);
+        void     drawLine(int x0, int y0, int x1, int y1);
+        void     drawFrame(int x, int y, int w, int h);
+        void     drawBox(int x, int y, int w, int h);
+
+        void     setFont(const uint8_t *font) { this->font = font; }
+        uint16_t drawGlyph(int x, int y, uint16_t encoding);
+        uint16_t drawStr(int x, int y, const char *text);
+        uint16_t getStrWidth(const char *text) const;
+
+    private:
+        u8x8_t         u8x8;
+        uint8_t        buffer[U8G2_FAKE_WIDTH * U8G2_FAKE_HEIGHT / 8];
+        uint8_t        drawColor = 1;
+        const uint8_t *font      = NULL;
+};
+
+// The display types main.cpp declares, wired to nothing here
+class U8G2_ST7565_NHD_C12864_F_4W_HW_SPI : public U8G2 {
+    public:
+        U8G2_ST7565_NHD_C12864_F_4W_HW_SPI(const u8g2_cb_t *rotation, uint8_t cs, uint8_t dc, uint8_t reset = 255) {}
+};
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <stdint.h>
+
+// Cycles of a 160 MHz core derived from the host's monotonic clock, so
+// stage profiles read in the same units as on the device
+uint32_t esp_cpu_get_ccount(void);
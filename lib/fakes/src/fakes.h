@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Controls for the host fakes, used by tests and benchmarks only
+
+// millis()/micros() only move when told to (or through delay())
+void     fakeSetMicros(uint64_t us);
+void     fakeAdvanceMicros(uint64_t us);
+void     fakeAdvanceMillis(uint32_t ms);
+
+// Empties the in-memory LittleFS and clears any pending fault
+void     fakeFsReset();
+// Power cut: the next writes store `bytes` more bytes in total, then
+// every write fails until fakeFsReset() or fakeFsRestore()
+void     fakeFsTearAfter(size_t bytes);
+// Power back: writes work again, the torn data stays as it was
+void     fakeFsRestore();
+// Bytes written and files opened for writing since the last reset
+uint32_t fakeFsBytesWritten();
+uint32_t fakeFsWriteOpens();
+// Flip bits at `offset` of a file, false if it is shorter
+bool     fakeFsCorrupt(const char *path, size_t offset, uint8_t mask);
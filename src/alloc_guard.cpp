@@ -0,0 +1,100 @@
+#include "alloc_guard.h"
+
+#if ALLOC_GUARD
+
+extern "C" {
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *pointer, size_t size);
+}
+
+struct WatchedTask {
+        const char *name;
+        bool        strict;
+        uint32_t    allocations;
+        uint32_t    bytes;
+};
+
+static WatchedTask          watched[ALLOC_GUARD_TASKS + 1] = {}; // the last one is "other"
+static uint8_t              watchedCount                   = 0;
+static volatile bool        armed                          = false;
+static volatile uint32_t    violations                     = 0;
+static portMUX_TYPE         guardMux                       = portMUX_INITIALIZER_UNLOCKED;
+
+void allocGuardWatch(const char *taskName, bool strict) {
+    if(watchedCount >= ALLOC_GUARD_TASKS)
+        return;
+    watched[watchedCount].name   = taskName;
+    watched[watchedCount].strict = strict;
+    watchedCount++;
+}
+
+void allocGuardArm() {
+    watched[ALLOC_GUARD_TASKS].name = "other";
+    armed                           = true;
+}
+
+uint32_t allocGuardViolations() {
+    return violations;
+}
+
+// Nothing in here may allocate: no Serial, no String
+static WatchedTask *callerTask() {
+    if(xPortInIsrContext())
+        return &watched[ALLOC_GUARD_TASKS];
+    const char *name = pcTaskGetName(NULL);
+    for(uint8_t i = 0; i < watchedCount; i++)
+        if(strcmp(watched[i].name, name) == 0)
+            return &watched[i];
+    return &watched[ALLOC_GUARD_TASKS];
+}
+
+static void noteAllocation(size_t size) {
+    if(!armed)
+        return;
+    WatchedTask *task = callerTask();
+    portENTER_CRITICAL_SAFE(&guardMux);
+    task->allocations++;
+    task->bytes += size;
+    if(task->strict)
+        violations++;
+    portEXIT_CRITICAL_SAFE(&guardMux);
+#if ALLOC_GUARD_ASSERT
+    if(task->strict)
+        abort();
+#endif
+}
+
+extern "C" void *__wrap_malloc(size_t size) {
+    noteAllocation(size);
+    return __real_malloc(size);
+}
+
+extern "C" void *__wrap_calloc(size_t count, size_t size) {
+    noteAllocation(count * size);
+    return __real_calloc(count, size);
+}
+
+extern "C" void *__wrap_realloc(void *pointer, size_t size) {
+    if(size > 0)
+        noteAllocation(size);
+    return __real_realloc(pointer, size);
+}
+
+int allocGuardFormat(char *out, size_t size) {
+    size_t used = 0;
+    out[0]      = '\0';
+    for(uint8_t i = 0; i <= ALLOC_GUARD_TASKS && used < size; i++) {
+        const WatchedTask &task = watched[i];
+        if(task.name == NULL)
+            continue;
+        int written = snprintf(out + used, size - used, "%s%s %lu/%luB", used > 0 ? ", " : "", task.name,
+                               (unsigned long) task.allocations, (unsigned long) task.bytes);
+        if(written < 0)
+            break;
+        used += written;
+    }
+    return used < size ? used : size - 1;
+}
+
+#endif
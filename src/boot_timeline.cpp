@@ -0,0 +1,22 @@
+#include "boot_timeline.h"
+
+static const char *const phaseNames[BOOT_PHASE_COUNT] = {
+    "storage", "display", "tasks", "frame", "restored", "wifi", "mqtt", "time",
+};
+
+int BootTimeline::format(char *out, size_t size) const {
+    size_t used = 0;
+    out[0]      = '\0';
+    for(uint8_t phase = 0; phase < BOOT_PHASE_COUNT && used < size; phase++) {
+        const char *separator = phase > 0 ? " " : "";
+        int         written;
+        if(at[phase] != 0)
+            written = snprintf(out + used, size - used, "%s%s=%lu", separator, phaseNames[phase], (unsigned long) at[phase]);
+        else
+            written = snprintf(out + used, size - used, "%s%s=-", separator, phaseNames[phase]);
+        if(written < 0)
+            break;
+        used += written;
+    }
+    return used < size ? used : size - 1;
+}
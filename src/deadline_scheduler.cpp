@@ -0,0 +1,118 @@
+#include "deadline_scheduler.h"
+
+#include <time.h>
+
+DeadlineScheduler::DeadlineScheduler() {
+    for(uint8_t job = 0; job < SCHEDULER_MAX_JOBS; job++)
+        position[job] = -1;
+}
+
+void DeadlineScheduler::place(uint8_t index, const Entry &entry) {
+    heap[index]         = entry;
+    position[entry.job] = index;
+}
+
+void DeadlineScheduler::siftUp(uint8_t index) {
+    Entry entry = heap[index];
+    while(index > 0) {
+        uint8_t parent = (index - 1) / 2;
+        if(heap[parent].due <= entry.due)
+            break;
+        place(index, heap[parent]);
+        index = parent;
+    }
+    place(index, entry);
+}
+
+void DeadlineScheduler::siftDown(uint8_t index) {
+    Entry entry = heap[index];
+    for(;;) {
+        uint8_t child = 2 * index + 1;
+        if(child >= count)
+            break;
+        if(child + 1 < count && heap[child + 1].due < heap[child].due)
+            child++;
+        if(entry.due <= heap[child].due)
+            break;
+        place(index, heap[child]);
+        index = child;
+    }
+    place(index, entry);
+}
+
+void DeadlineScheduler::removeAt(uint8_t index) {
+    position[heap[index].job] = -1;
+    if(--count == index)
+        return;
+    Entry moved = heap[count]; // the last entry fills the hole, then settles
+    place(index, moved);
+    siftDown(index);
+    siftUp(position[moved.job]);
+}
+
+void DeadlineScheduler::schedule(uint8_t job, uint32_t due) {
+    if(job >= SCHEDULER_MAX_JOBS)
+        return;
+    Entry entry = { due, job };
+    if(position[job] >= 0) {
+        uint8_t index = position[job];
+        place(index, entry);
+        siftUp(index);
+        siftDown(position[job]);
+        return;
+    }
+    place(count, entry);
+    siftUp(count++);
+}
+
+void DeadlineScheduler::cancel(uint8_t job) {
+    if(isScheduled(job))
+        removeAt(position[job]);
+}
+
+bool DeadlineScheduler::deadline(uint8_t job, uint32_t *due) const {
+    if(!isScheduled(job))
+        return false;
+    *due = heap[position[job]].due;
+    return true;
+}
+
+bool DeadlineScheduler::next(uint8_t *job, uint32_t *due) const {
+    if(count == 0)
+        return false;
+    *job = heap[0].job;
+    *due = heap[0].due;
+    return true;
+}
+
+int DeadlineScheduler::popDue(uint32_t now, uint32_t *due) {
+    if(count == 0 || heap[0].due > now)
+        return -1;
+    uint8_t job = heap[0].job;
+    *due        = heap[0].due;
+    removeAt(0);
+    return job;
+}
+
+// Local midnight plus minuteOfDay on the day of `at`, shifted by `days`
+static uint32_t dailyAt(uint32_t at, uint16_t minuteOfDay, int days) {
+    time_t    seconds = at;
+    struct tm local;
+    localtime_r(&seconds, &local);
+    local.tm_mday  += days;
+    local.tm_hour   = minuteOfDay / 60;
+    local.tm_min    = minuteOfDay % 60;
+    local.tm_sec    = 0;
+    local.tm_isdst  = -1; // let mktime() work out DST for that day
+    return mktime(&local);
+}
+
+uint32_t nextDailyDeadline(uint32_t after, uint16_t minuteOfDay) {
+    uint32_t today = dailyAt(after, minuteOfDay, 0);
+    return today > after ? today : dailyAt(after, minuteOfDay, 1);
+}
+
+uint32_t lastDailyDeadline(uint32_t at, uint16_t minuteOfDay) {
+    uint32_t today = dailyAt(at, minuteOfDay, 0);
+    return today <= at ? today : dailyAt(at, minuteOfDay, -1);
+}
@@ -0,0 +1,101 @@
+#include "dispense_controller.h"
+
+void DispenseController::start(float targetGrams, float gramsPerRev, uint32_t stepsRev, uint32_t now) {
+    active           = true;
+    phase            = PHASE_BASELINE;
+    target           = targetGrams;
+    gramsPerRotation = gramsPerRev > 0.0f ? gramsPerRev : 1.0f;
+    stepsPerRev      = stepsRev > 0 ? stepsRev : 1;
+    startedAt        = now;
+    deadline         = now + DISPENSE_SETTLE_TIMEOUT;
+    moves            = 0;
+    stepsDone        = 0;
+    dispensedGrams   = 0.0f;
+}
+
+DispenseAction DispenseController::update(uint32_t now, float weight, bool settled, bool moving, uint32_t stepped) {
+    DispenseAction wait = { DISPENSE_WAIT, 0, false };
+    if(!active)
+        return wait;
+
+    switch(phase) {
+        case PHASE_BASELINE:
+            if(!settled && (int32_t) (now - deadline) < 0)
+                return wait;
+            baseline = weight;
+            return move(gramsToSteps(target * DISPENSE_FAST_FRACTION, gramsPerRotation / stepsPerRev), false,
+                        target * DISPENSE_FAST_FRACTION);
+
+        case PHASE_MOVING:
+            if(moving) {
+                // The reading lags the auger, so braking on it can only help
+                if(!stopSent && weight - baseline >= stopAt) {
+                    stopSent = true;
+                    return { DISPENSE_STOP, 0, false };
+                }
+                return wait;
+            }
+            stepsDone += stepped;
+            phase      = PHASE_SETTLING;
+            deadline   = now + DISPENSE_SETTLE_TIMEOUT;
+            return wait;
+
+        case PHASE_SETTLING: {
+            if(!settled && (int32_t) (now - deadline) < 0)
+                return wait;
+            dispensedGrams = weight - baseline;
+            if(dispensedGrams >= target - DISPENSE_TOLERANCE)
+                return finish(DISPENSE_DONE);
+
+            // Far more turned than should have been needed, yet next to
+            // nothing came out: the hopper is empty or the auger jammed
+            float expected = stepsDone * gramsPerRotation / stepsPerRev;
+            if(expected >= target * 0.5f && dispensedGrams < expected * 0.1f)
+                return finish(DISPENSE_FAILED);
+            if(moves >= DISPENSE_MAX_MOVES || now - startedAt >= DISPENSE_TIMEOUT)
+                return finish(DISPENSE_FAILED);
+
+            // Size the top-up from this feed's own rate once it is measurable
+            float gramsPerStep = gramsPerRotation / stepsPerRev;
+            if(dispensedGrams >= 1.0f && stepsDone > 0)
+                gramsPerStep = dispensedGrams / stepsDone;
+            float    aim   = target - DISPENSE_TOLERANCE * 0.5f;
+            uint32_t steps = gramsToSteps(aim - dispensedGrams, gramsPerStep);
+            return move(steps < DISPENSE_MIN_STEPS ? DISPENSE_MIN_STEPS : steps, true, aim);
+        }
+    }
+    return wait;
+}
+
+DispenseAction DispenseController::move(uint32_t steps, bool slow, float brakeAt) {
+    if(steps == 0)
+        return finish(DISPENSE_DONE); // nothing to dispense
+    phase    = PHASE_MOVING;
+    stopAt   = brakeAt;
+    stopSent = false;
+    moves++;
+    return { DISPENSE_MOVE, steps, slow };
+}
+
+DispenseAction DispenseController::finish(DispenseCommand result) {
+    active = false;
+
+    // Only learn from feeds that turned enough to average out the auger's
+    // pockets, and keep a single odd reading from dragging the estimate
+    if(result == DISPENSE_DONE && stepsDone >= stepsPerRev / 4 && dispensedGrams >= 1.0f) {
+        float measured = dispensedGrams * stepsPerRev / stepsDone;
+        if(measured > gramsPerRotation * 4.0f)
+            measured = gramsPerRotation * 4.0f;
+        if(measured < gramsPerRotation * 0.25f)
+            measured = gramsPerRotation * 0.25f;
+        gramsPerRotation += DISPENSE_LEARN_ALPHA * (measured - gramsPerRotation);
+    }
+    return { result, 0, false };
+}
+
+uint32_t DispenseController::gramsToSteps(float grams, float gramsPerStep) const {
+    if(grams <= 0.0f || gramsPerStep <= 0.0f)
+        return 0;
+    float steps = grams / gramsPerStep;
+    return steps < 4000000.0f ? (uint32_t) (steps + 0.5f) : 4000000;
+}
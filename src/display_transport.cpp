@@ -0,0 +1,104 @@
+#include "display_transport.h"
+#include "stage_profiler.h"
+
+void U8g2Transport::writeTiles(uint8_t tx, uint8_t page, uint8_t count, uint8_t *tiles) {
+    u8x8_DrawTile(display.getU8x8(), tx, page, count, tiles);
+}
+
+void U8g2Transport::setContrast(uint8_t value) {
+    display.setContrast(value);
+}
+
+void DisplayFlusher::begin(UBaseType_t priority) {
+    if(task == NULL)
+        xTaskCreate(taskMain, "display", 3072, this, priority, &task);
+}
+
+uint32_t DisplayFlusher::submit() {
+    if(isBusy())
+        return 0; // front buffer still in use by the flush task
+
+    const uint8_t *back  = display.getBufferPtr();
+    bool           dirty = false;
+
+    for(uint8_t page = 0; page < FRAME_TILE_HEIGHT; page++) {
+        const uint8_t *row      = back + page * FRAME_TILE_WIDTH * 8;
+        uint8_t       *frontRow = front + page * FRAME_TILE_WIDTH * 8;
+        int            first    = -1;
+        int            last     = -1;
+
+        for(uint8_t tile = 0; tile < FRAME_TILE_WIDTH; tile++) {
+            if(frontValid && memcmp(row + tile * 8, frontRow + tile * 8, 8) == 0)
+                continue;
+            if(first < 0)
+                first = tile;
+            last = tile;
+        }
+
+        if(first < 0) {
+            spanCount[page] = 0; // page unchanged
+            continue;
+        }
+
+        spanFirst[page]  = first;
+        spanCount[page]  = last - first + 1;
+        memcpy(frontRow + first * 8, row + first * 8, spanCount[page] * 8);
+        stats.bytesSent += spanCount[page] * 8;
+        dirty            = true;
+    }
+
+    frontValid = true;
+    if(!dirty)
+        return submittedSeq; // identical to what is already on the glass
+
+    submittedSeq = submittedSeq + 1;
+    xTaskNotifyGive(task);
+    return submittedSeq;
+}
+
+void DisplayFlusher::present() {
+    uint32_t sequence;
+    while((sequence = submit()) == 0)
+        delay(1);
+    while(!isPresented(sequence))
+        delay(1);
+}
+
+bool DisplayFlusher::isPresented(uint32_t sequence) const {
+    return (int32_t) (presentedSeq - sequence) >= 0;
+}
+
+void DisplayFlusher::setContrast(uint8_t value) {
+    pendingContrast = value;
+    xTaskNotifyGive(task);
+}
+
+void DisplayFlusher::taskMain(void *arg) {
+    DisplayFlusher *self = static_cast<DisplayFlusher *>(arg);
+    for(;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        self->service();
+    }
+}
+
+void DisplayFlusher::service() {
+    int16_t contrast = pendingContrast;
+    if(contrast >= 0) {
+        pendingContrast = -1;
+        transport.setContrast(contrast);
+    }
+
+    uint32_t sequence = submittedSeq;
+    if(sequence == presentedSeq)
+        return;
+
+    PROFILE_SCOPE(STAGE_FLUSH);
+    for(uint8_t page = 0; page < FRAME_TILE_HEIGHT; page++) {
+        if(spanCount[page] == 0)
+            continue;
+        uint8_t *tiles = front + page * FRAME_TILE_WIDTH * 8 + spanFirst[page] * 8;
+        transport.writeTiles(spanFirst[page], page, spanCount[page], tiles);
+    }
+
+    presentedSeq = sequence;
+}
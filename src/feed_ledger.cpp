@@ -0,0 +1,137 @@
+#include "feed_ledger.h"
+
+#include <LittleFS.h>
+#include "crc32.h"
+
+#define CLOCK_VALID 1000000000 // epoch seconds, same test as the history log
+
+static uint32_t entryCrc(const FeedLedgerEntry &entry) {
+    return crc32Update(0, &entry, offsetof(FeedLedgerEntry, crc));
+}
+
+void FeedLedger::begin() {
+    File file = LittleFS.open(FEED_LEDGER_FILE, "r");
+    if(!file) {
+        // A zeroed ring, so every later write is in place
+        file = LittleFS.open(FEED_LEDGER_FILE, "w");
+        if(file) {
+            file.write((const uint8_t *) ring, sizeof(ring));
+            file.close();
+        }
+        return;
+    }
+
+    FeedLedgerEntry loaded[FEED_LEDGER_ENTRIES] = {};
+    file.read((uint8_t *) loaded, sizeof(loaded));
+    file.close();
+
+    uint32_t newest = 0;
+    for(uint8_t slot = 0; slot < FEED_LEDGER_ENTRIES; slot++) {
+        const FeedLedgerEntry &entry = loaded[slot];
+        if(entry.seq == 0)
+            continue;
+        if(entry.crc != entryCrc(entry) || entry.seq % FEED_LEDGER_ENTRIES != slot) {
+            stats.corrupt++; // torn write, the slot reads as empty
+            continue;
+        }
+        ring[slot] = entry;
+        if(entry.seq > newest)
+            newest = entry.seq;
+    }
+    if(newest == 0)
+        return;
+
+    // The window is the unbroken run of seqs ending at the newest entry
+    nextSeq = newest + 1;
+    while(count < FEED_LEDGER_ENTRIES && newest - count > 0 && at(newest - count).seq == newest - count) {
+        const FeedLedgerEntry &entry = at(newest - count);
+        rolling += entry.grams;
+        if(entry.time == 0)
+            untimed++;
+        count++;
+    }
+    today = rolling;
+}
+
+bool FeedLedger::record(uint32_t now, Fixed grams) {
+    if(isFull()) {
+        // Callers refuse feeds while full, this only keeps the sums right
+        // when the oldest entry is overwritten anyway
+        FeedLedgerEntry &oldest = at(nextSeq - count);
+        rolling                -= oldest.grams;
+        if(oldest.time == 0)
+            untimed--;
+        if(oldest.time == 0 || oldest.time >= dayStart)
+            today -= oldest.grams;
+        count--;
+    }
+
+    FeedLedgerEntry &entry = at(nextSeq);
+    entry.seq              = nextSeq++;
+    entry.time             = now >= CLOCK_VALID ? now : 0;
+    entry.grams            = grams;
+    entry.crc              = entryCrc(entry);
+    write(entry);
+
+    count++;
+    rolling += grams;
+    if(entry.time == 0)
+        untimed++;
+    if(entry.time == 0 || entry.time >= dayStart)
+        today += grams;
+    stats.recorded++;
+    return true;
+}
+
+void FeedLedger::advance(uint32_t now) {
+    if(now < CLOCK_VALID)
+        return;
+
+    if(untimed > 0) {
+        for(uint32_t seq = nextSeq - count; seq != nextSeq; seq++) {
+            FeedLedgerEntry &entry = at(seq);
+            if(entry.time != 0)
+                continue;
+            entry.time = now;
+            entry.crc  = entryCrc(entry);
+            write(entry);
+        }
+        untimed = 0;
+    }
+
+    while(count > 0) {
+        const FeedLedgerEntry &entry = at(nextSeq - count);
+        if(now - entry.time < FEED_WINDOW_S || entry.time > now)
+            break;
+        rolling -= entry.grams;
+        if(entry.time >= dayStart)
+            today -= entry.grams; // a 25 h day or a late midnight job
+        count--;
+    }
+}
+
+void FeedLedger::startDay(uint32_t start) {
+    dayStart = start;
+    today    = 0;
+    for(uint32_t seq = nextSeq - count; seq != nextSeq; seq++) {
+        const FeedLedgerEntry &entry = at(seq);
+        if(entry.time == 0 || entry.time >= dayStart)
+            today += entry.grams;
+    }
+}
+
+bool FeedLedger::oldest(uint32_t *time) const {
+    if(count == 0)
+        return false;
+    *time = ring[(nextSeq - count) % FEED_LEDGER_ENTRIES].time;
+    return true;
+}
+
+void FeedLedger::write(const FeedLedgerEntry &entry) {
+    File file = LittleFS.open(FEED_LEDGER_FILE, "r+");
+    if(!file)
+        return;
+    file.seek((entry.seq % FEED_LEDGER_ENTRIES) * sizeof(FeedLedgerEntry));
+    file.write((const uint8_t *) &entry, sizeof(entry));
+    file.close();
+}
@@ -0,0 +1,91 @@
+#include "gesture_recognizer.h"
+
+#define MS_TO_US(ms) ((uint32_t) (ms) * 1000UL)
+
+void GestureRecognizer::feed(const ButtonEdge &edge, uint32_t now, GestureHandler handler, void *context) {
+    if(edge.button >= GESTURE_MAX_BUTTONS)
+        return;
+    stats.edges++;
+    if(now - edge.at > stats.maxLatencyUs)
+        stats.maxLatencyUs = now - edge.at;
+
+    // Whatever timed out before this edge happened comes first
+    timeouts(edge.button, edge.at, handler, context);
+
+    Button &b = buttons[edge.button];
+    b.raw     = edge.pressed != 0;
+    b.rawAt   = edge.at;
+    if(b.raw == b.pressed)
+        return;
+    if(edge.at - b.changedAt < MS_TO_US(timings.debounceMs)) {
+        stats.bounces++; // poll() accepts it if the level holds
+        return;
+    }
+    accept(edge.button, edge.at, handler, context);
+}
+
+void GestureRecognizer::poll(uint32_t now, GestureHandler handler, void *context) {
+    for(uint8_t button = 0; button < GESTURE_MAX_BUTTONS; button++)
+        timeouts(button, now, handler, context);
+}
+
+void GestureRecognizer::timeouts(uint8_t button, uint32_t now, GestureHandler handler, void *context) {
+    Button &b = buttons[button];
+
+    // A bounce that ended on the other level: the last edge was real
+    if(b.raw != b.pressed && now - b.rawAt >= MS_TO_US(timings.debounceMs))
+        accept(button, b.rawAt, handler, context);
+
+    if(b.pressed) {
+        if(!b.longSent && now - b.changedAt >= MS_TO_US(timings.longMs)) {
+            uint32_t at = b.changedAt + MS_TO_US(timings.longMs);
+            if(b.clicks > 0) {
+                b.clicks = 0;
+                emit(button, GESTURE_SHORT, b.releasedAt, handler, context); // click, then press and hold
+            }
+            b.longSent   = true;
+            b.repeats    = 0;
+            b.nextRepeat = at + MS_TO_US(timings.repeatMs);
+            emit(button, GESTURE_LONG, at, handler, context);
+        }
+        while(b.longSent && timings.repeatMs > 0 && (int32_t) (now - b.nextRepeat) >= 0) {
+            uint32_t at   = b.nextRepeat;
+            b.nextRepeat += MS_TO_US(timings.repeatMs);
+            b.repeats++;
+            emit(button, GESTURE_REPEAT, at, handler, context);
+        }
+    } else if(b.clicks > 0 && now - b.releasedAt >= MS_TO_US(timings.doubleGapMs)) {
+        b.clicks = 0;
+        emit(button, GESTURE_SHORT, b.releasedAt, handler, context);
+    }
+}
+
+void GestureRecognizer::accept(uint8_t button, uint32_t at, GestureHandler handler, void *context) {
+    Button &b   = buttons[button];
+    b.pressed   = b.raw;
+    b.changedAt = at;
+
+    if(b.pressed) {
+        b.longSent = false;
+        emit(button, GESTURE_PRESS, at, handler, context);
+        return;
+    }
+
+    if(b.longSent)
+        return; // end of a hold, already reported
+    if(timings.doubleGapMs == 0) {
+        emit(button, GESTURE_SHORT, at, handler, context);
+    } else if(b.clicks > 0) {
+        b.clicks = 0;
+        emit(button, GESTURE_DOUBLE, at, handler, context);
+    } else {
+        b.clicks     = 1;
+        b.releasedAt = at;
+    }
+}
+
+void GestureRecognizer::emit(uint8_t button, GestureType type, uint32_t at, GestureHandler handler, void *context) {
+    Gesture gesture = { button, (uint8_t) type, type == GESTURE_REPEAT ? buttons[button].repeats : (uint16_t) 0, at };
+    stats.gestures++;
+    handler(gesture, context);
+}
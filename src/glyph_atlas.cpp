@@ -0,0 +1,112 @@
+#include "glyph_atlas.h"
+
+#define GLYPH_BUILD_BASELINE 40 // leaves room above and below the baseline
+
+void GlyphFont::build(U8G2 &display, const uint8_t *font) {
+    const char    *chars  = GLYPH_ATLAS_CHARS;
+    const uint8_t *buffer = display.getBufferPtr();
+    uint8_t        width  = display.getBufferTileWidth() * 8;
+    uint8_t        height = display.getBufferTileHeight() * 8;
+
+    display.setFont(font);
+    for(uint8_t i = 0; i < GLYPH_ATLAS_COUNT; i++) {
+        PackedGlyph &glyph = glyphs[i];
+        memset(&glyph, 0, sizeof(glyph));
+
+        display.clearBuffer();
+        glyph.advance = display.drawGlyph(0, GLYPH_BUILD_BASELINE, chars[i]);
+
+        // Find the inked rows so the column words start at the glyph top
+        int firstRow = -1;
+        for(uint8_t y = 0; y < height && firstRow < 0; y++)
+            for(uint8_t x = 0; x < GLYPH_MAX_WIDTH; x++)
+                if(buffer[(y / 8) * width + x] & (1 << (y % 8))) {
+                    firstRow = y;
+                    break;
+                }
+        if(firstRow < 0)
+            continue; // blank glyph (or missing from the font)
+
+        glyph.top = firstRow - GLYPH_BUILD_BASELINE;
+        for(uint8_t x = 0; x < GLYPH_MAX_WIDTH; x++) {
+            uint32_t bits = 0;
+            for(uint8_t row = 0; row < GLYPH_MAX_HEIGHT && firstRow + row < height; row++) {
+                uint8_t y = firstRow + row;
+                if(buffer[(y / 8) * width + x] & (1 << (y % 8)))
+                    bits |= 1UL << row;
+            }
+            glyph.columns[x] = bits;
+            if(bits)
+                glyph.width = x + 1;
+        }
+    }
+    display.clearBuffer();
+}
+
+const PackedGlyph *GlyphFont::find(char c) const {
+    if(c >= '0' && c <= '9')
+        return &glyphs[c - '0'];
+    if(c == '-')
+        return &glyphs[10];
+    if(c == '.')
+        return &glyphs[11];
+    return NULL;
+}
+
+int GlyphFont::draw(U8G2 &display, int x, int y, const char *text, int spacing) const {
+    uint8_t *buffer = display.getBufferPtr();
+    int      width  = display.getBufferTileWidth() * 8;
+    int      pages  = display.getBufferTileHeight();
+
+    for(; *text; text++) {
+        const PackedGlyph *glyph = find(*text);
+        if(glyph == NULL)
+            continue;
+
+        int top = y + glyph->top;
+        for(uint8_t col = 0; col < glyph->width; col++) {
+            int      px   = x + col;
+            uint64_t bits = glyph->columns[col];
+            if(px < 0 || px >= width || bits == 0)
+                continue;
+
+            int row = top;
+            if(row < 0) {
+                if(row <= -GLYPH_MAX_HEIGHT)
+                    continue;
+                bits >>= -row;
+                row    = 0;
+            }
+
+            bits     <<= row % 8;
+            for(int page = row / 8; bits && page < pages; page++) {
+                buffer[page * width + px] |= bits & 0xFF;
+                bits                     >>= 8;
+            }
+        }
+        x += glyph->advance + spacing;
+    }
+    return x;
+}
+
+void formatFixed(int32_t value, uint8_t decimals, char *intPart, char *fracPart) {
+    char     digits[12];
+    uint8_t  count     = 0;
+    bool     negative  = value < 0;
+    uint32_t magnitude = negative ? 0u - (uint32_t) value : (uint32_t) value;
+
+    do {
+        digits[count++]   = '0' + magnitude % 10;
+        magnitude        /= 10;
+    } while(magnitude > 0 || count <= decimals);
+
+    for(uint8_t i = 0; i < decimals; i++)
+        fracPart[i] = digits[decimals - 1 - i];
+    fracPart[decimals] = '\0';
+
+    if(negative)
+        *intPart++ = '-';
+    while(count > decimals)
+        *intPart++ = digits[--count];
+    *intPart = '\0';
+}
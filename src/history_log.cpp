@@ -0,0 +1,339 @@
+#include "history_log.h"
+
+#include <LittleFS.h>
+#include "crc32.h"
+
+#define HISTORY_SEGMENT_RECORDS (HISTORY_SEGMENT_BYTES / sizeof(HistoryRecord))
+
+// Segments kept per tier before the oldest is folded into the next one
+static const uint8_t  maxSegments[HISTORY_TIERS]   = { 16, 16, 32 };
+static const uint32_t bucketSeconds[HISTORY_TIERS] = { 0, 60, 15 * 60 };
+
+void HistoryLog::begin(UBaseType_t priority) {
+    if(!LittleFS.exists(HISTORY_DIR))
+        LittleFS.mkdir(HISTORY_DIR);
+    scan();
+
+    fileLock = xSemaphoreCreateMutex();
+    xTaskCreate(taskMain, "history", 4096, this, priority, &task);
+}
+
+bool HistoryLog::append(uint8_t series, float value) {
+    time_t now = time(nullptr);
+    if(now < 1000000000 || series >= HISTORY_SERIES_COUNT) {
+        stats.recordsDropped++; // no wall clock yet, the sample can't be placed
+        return false;
+    }
+
+    portENTER_CRITICAL(&stagingMux);
+    if(stagingCount == HISTORY_STAGING_RECORDS) {
+        portEXIT_CRITICAL(&stagingMux);
+        stats.recordsDropped++;
+        return false;
+    }
+    HistoryRecord &record = staging[(stagingHead + stagingCount) % HISTORY_STAGING_RECORDS];
+    record.time           = now;
+    record.series         = series;
+    record.tier           = 0;
+    record.count          = 1;
+    record.mean           = value;
+    record.min            = value;
+    record.max            = value;
+    uint16_t queued       = ++stagingCount;
+    portEXIT_CRITICAL(&stagingMux);
+
+    if(queued >= HISTORY_BATCH_RECORDS)
+        requestFlush();
+    return true;
+}
+
+void HistoryLog::requestFlush() {
+    if(task != NULL)
+        xTaskNotifyGive(task);
+}
+
+void HistoryLog::taskMain(void *arg) {
+    HistoryLog *self = static_cast<HistoryLog *>(arg);
+    for(;;) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(HISTORY_FLUSH_MS));
+
+        xSemaphoreTake(self->fileLock, portMAX_DELAY);
+        self->drain();
+        for(uint8_t tier = 0; tier < HISTORY_TIERS; tier++)
+            while(self->nextSeq[tier] - self->firstSeq[tier] > maxSegments[tier])
+                self->compact(tier);
+        xSemaphoreGive(self->fileLock);
+    }
+}
+
+void HistoryLog::drain() {
+    static HistoryRecord batch[HISTORY_BATCH_RECORDS];
+
+    for(;;) {
+        uint16_t count = 0;
+        portENTER_CRITICAL(&stagingMux);
+        while(stagingCount > 0 && count < HISTORY_BATCH_RECORDS) {
+            batch[count++] = staging[stagingHead];
+            stagingHead    = (stagingHead + 1) % HISTORY_STAGING_RECORDS;
+            stagingCount--;
+        }
+        portEXIT_CRITICAL(&stagingMux);
+
+        if(count == 0)
+            return;
+        writeBatch(0, batch, count);
+    }
+}
+
+void HistoryLog::writeBatch(uint8_t tier, const HistoryRecord *records, uint16_t count) {
+    while(count > 0) {
+        uint16_t n     = count < HISTORY_BATCH_RECORDS ? count : HISTORY_BATCH_RECORDS;
+        uint32_t bytes = sizeof(HistoryBatchHeader) + n * sizeof(HistoryRecord);
+
+        if(nextSeq[tier] == firstSeq[tier] || openSize[tier] + bytes > HISTORY_SEGMENT_BYTES) {
+            nextSeq[tier]++; // start a new segment
+            openSize[tier] = 0;
+        }
+
+        HistoryBatchHeader header;
+        header.magic   = HISTORY_BATCH_MAGIC;
+        header.count   = n;
+        header.tier    = tier;
+        header.version = HISTORY_BATCH_VERSION;
+        header.crc     = crc32Update(0, records, n * sizeof(HistoryRecord));
+
+        char path[32];
+        segmentPath(path, tier, nextSeq[tier] - 1);
+        File file = LittleFS.open(path, "a");
+        if(file) {
+            file.write((const uint8_t *) &header, sizeof(header));
+            file.write((const uint8_t *) records, n * sizeof(HistoryRecord));
+            file.close();
+            stats.batchesWritten++;
+            stats.recordsWritten += n;
+        }
+
+        openSize[tier] += bytes;
+        records        += n;
+        count          -= n;
+    }
+}
+
+// Folds records into one bucket per series of the next tier
+struct HistoryCompactor {
+        uint32_t      bucketSeconds;
+        uint8_t       tier;
+        HistoryRecord open[HISTORY_SERIES_COUNT];
+        bool          isOpen[HISTORY_SERIES_COUNT];
+        HistoryRecord out[HISTORY_SEGMENT_RECORDS];
+        uint16_t      outCount;
+
+        void          emit(uint8_t series) {
+            if(isOpen[series] && outCount < HISTORY_SEGMENT_RECORDS)
+                out[outCount++] = open[series];
+            isOpen[series] = false;
+        }
+};
+
+static void compactVisitor(const HistoryRecord &record, void *context) {
+    HistoryCompactor *c = static_cast<HistoryCompactor *>(context);
+    if(record.series >= HISTORY_SERIES_COUNT)
+        return;
+
+    uint32_t       bucket = record.time - record.time % c->bucketSeconds;
+    HistoryRecord &acc    = c->open[record.series];
+    if(c->isOpen[record.series] && acc.time != bucket)
+        c->emit(record.series);
+
+    if(!c->isOpen[record.series]) {
+        acc                       = record;
+        acc.time                  = bucket;
+        acc.tier                  = c->tier;
+        c->isOpen[record.series]  = true;
+        return;
+    }
+
+    uint32_t total = acc.count + record.count;
+    acc.mean       = (acc.mean * acc.count + record.mean * record.count) / total;
+    acc.min        = record.min < acc.min ? record.min : acc.min;
+    acc.max        = record.max > acc.max ? record.max : acc.max;
+    acc.count      = total > 0xFFFF ? 0xFFFF : total;
+}
+
+void HistoryLog::compact(uint8_t tier) {
+    static HistoryCompactor compactor;
+
+    uint32_t seq = firstSeq[tier];
+    if(tier + 1 < HISTORY_TIERS) {
+        compactor.bucketSeconds = bucketSeconds[tier + 1];
+        compactor.tier          = tier + 1;
+        compactor.outCount      = 0;
+        memset(compactor.isOpen, 0, sizeof(compactor.isOpen));
+
+        readSegment(tier, seq, compactVisitor, &compactor);
+        for(uint8_t series = 0; series < HISTORY_SERIES_COUNT; series++)
+            compactor.emit(series);
+        writeBatch(tier + 1, compactor.out, compactor.outCount);
+    }
+
+    char path[32];
+    segmentPath(path, tier, seq);
+    LittleFS.remove(path);
+    firstSeq[tier]++;
+    stats.compactions++;
+}
+
+void HistoryLog::segmentPath(char *path, uint8_t tier, uint32_t seq) const {
+    snprintf(path, 32, HISTORY_DIR "/t%u-%08lu.seg", tier, (unsigned long) seq);
+}
+
+uint32_t HistoryLog::readSegment(uint8_t tier, uint32_t seq, HistoryVisitor visitor, void *context) {
+    static HistoryRecord records[HISTORY_BATCH_RECORDS];
+
+    char path[32];
+    segmentPath(path, tier, seq);
+    File file = LittleFS.open(path, "r");
+    if(!file)
+        return 0;
+
+    uint32_t visited = 0;
+    for(;;) {
+        HistoryBatchHeader header;
+        if(file.read((uint8_t *) &header, sizeof(header)) != sizeof(header))
+            break;
+        if(header.magic != HISTORY_BATCH_MAGIC || header.count > HISTORY_BATCH_RECORDS) {
+            stats.corruptBatches++; // lost framing, nothing after this is trustworthy
+            break;
+        }
+
+        size_t bytes = header.count * sizeof(HistoryRecord);
+        if(file.read((uint8_t *) records, bytes) != bytes)
+            break; // torn write at the end of the file
+        if(crc32Update(0, records, bytes) != header.crc) {
+            stats.corruptBatches++;
+            continue;
+        }
+
+        for(uint16_t i = 0; i < header.count; i++)
+            visitor(records[i], context);
+        visited += header.count;
+    }
+    file.close();
+    return visited;
+}
+
+void HistoryLog::scan() {
+    bool found[HISTORY_TIERS] = {};
+
+    File dir = LittleFS.open(HISTORY_DIR);
+    for(File file = dir.openNextFile(); file; file = dir.openNextFile()) {
+        const char   *name  = strrchr(file.name(), '/');
+        unsigned      tier  = 0;
+        unsigned long seq   = 0;
+        name                = name ? name + 1 : file.name();
+        if(sscanf(name, "t%u-%lu.seg", &tier, &seq) != 2 || tier >= HISTORY_TIERS)
+            continue;
+
+        if(!found[tier] || seq < firstSeq[tier])
+            firstSeq[tier] = seq;
+        if(!found[tier] || seq + 1 > nextSeq[tier]) {
+            nextSeq[tier]  = seq + 1;
+            openSize[tier] = file.size();
+        }
+        found[tier] = true;
+    }
+    dir.close();
+}
+
+struct HistoryQuery {
+        uint8_t        series;
+        uint32_t       from;
+        uint32_t       to;
+        HistoryVisitor visitor;
+        void          *context;
+        uint32_t       matched;
+};
+
+static void queryVisitor(const HistoryRecord &record, void *context) {
+    HistoryQuery *q = static_cast<HistoryQuery *>(context);
+    if(record.series != q->series || record.time < q->from || record.time > q->to)
+        return;
+    q->visitor(record, q->context);
+    q->matched++;
+}
+
+uint32_t HistoryLog::query(uint8_t series, uint32_t from, uint32_t to, HistoryVisitor visitor, void *context) {
+    static HistoryRecord pending[HISTORY_STAGING_RECORDS];
+    HistoryQuery         q = { series, from, to, visitor, context, 0 };
+
+    xSemaphoreTake(fileLock, portMAX_DELAY);
+    for(int tier = HISTORY_TIERS - 1; tier >= 0; tier--)
+        for(uint32_t seq = firstSeq[tier]; seq != nextSeq[tier]; seq++)
+            readSegment(tier, seq, queryVisitor, &q);
+
+    // Samples not yet written out are the newest ones
+    uint16_t count = 0;
+    portENTER_CRITICAL(&stagingMux);
+    for(; count < stagingCount; count++)
+        pending[count] = staging[(stagingHead + count) % HISTORY_STAGING_RECORDS];
+    portEXIT_CRITICAL(&stagingMux);
+    for(uint16_t i = 0; i < count; i++)
+        queryVisitor(pending[i], &q);
+    xSemaphoreGive(fileLock);
+
+    return q.matched;
+}
+
+struct HistoryLatest {
+        const uint8_t *series;
+        uint8_t        count;
+        HistoryRecord *out;
+        uint64_t       missing; // bit i: nothing found for series[i] in newer data yet
+        uint64_t       seen;    // found in the segment being read
+};
+
+static void latestVisitor(const HistoryRecord &record, void *context) {
+    HistoryLatest *l = static_cast<HistoryLatest *>(context);
+    for(uint8_t i = 0; i < l->count; i++) {
+        if(l->series[i] == record.series && (l->missing >> i & 1)) {
+            l->out[i]  = record; // later in a segment is newer
+            l->seen   |= 1ULL << i;
+        }
+    }
+}
+
+uint8_t HistoryLog::latest(const uint8_t *series, uint8_t count, HistoryRecord *out) {
+    static HistoryRecord pending[HISTORY_STAGING_RECORDS];
+    if(count > 64)
+        count = 64;
+    for(uint8_t i = 0; i < count; i++)
+        memset(&out[i], 0, sizeof(out[i]));
+    HistoryLatest l = { series, count, out, count < 64 ? (1ULL << count) - 1 : ~0ULL, 0 };
+
+    xSemaphoreTake(fileLock, portMAX_DELAY);
+    // Samples not yet written out are the newest ones
+    uint16_t queued = 0;
+    portENTER_CRITICAL(&stagingMux);
+    for(; queued < stagingCount; queued++)
+        pending[queued] = staging[(stagingHead + queued) % HISTORY_STAGING_RECORDS];
+    portEXIT_CRITICAL(&stagingMux);
+    for(uint16_t i = 0; i < queued; i++)
+        latestVisitor(pending[i], &l);
+    l.missing &= ~l.seen;
+
+    // Then the raw tier down to the coarsest, each newest segment first
+    for(uint8_t tier = 0; tier < HISTORY_TIERS && l.missing != 0; tier++) {
+        for(uint32_t seq = nextSeq[tier]; seq != firstSeq[tier] && l.missing != 0; seq--) {
+            l.seen = 0;
+            readSegment(tier, seq - 1, latestVisitor, &l);
+            l.missing &= ~l.seen;
+        }
+    }
+    xSemaphoreGive(fileLock);
+
+    uint8_t found = 0;
+    for(uint8_t i = 0; i < count; i++)
+        if(out[i].count > 0)
+            found++;
+    return found;
+}
@@ -0,0 +1,170 @@
+#include "link_manager.h"
+
+#include <string.h>
+
+void LinkManager::seedAp(const uint8_t *bssid, int32_t channel) {
+    if(channel <= 0)
+        return; // nothing stored yet
+    memcpy(cachedBssid, bssid, sizeof(cachedBssid));
+    cachedChannel = channel;
+    cacheValid    = true;
+}
+
+bool LinkManager::cachedAp(uint8_t *bssid, int32_t *channel) const {
+    if(!cacheValid)
+        return false;
+    memcpy(bssid, cachedBssid, sizeof(cachedBssid));
+    *channel = cachedChannel;
+    return true;
+}
+
+void LinkManager::begin(uint32_t now, uint32_t seed) {
+    rng       = seed != 0 ? seed : 1;
+    downSince = now;
+    if(driver.wifiConnected()) {
+        // Joined during setup; remember the AP and go on with the broker
+        stats.wifiConnects++;
+        int8_t rssi;
+        cacheValid = driver.wifiLinkInfo(cachedBssid, &cachedChannel, &rssi);
+        current    = LINK_MQTT_DOWN;
+    } else {
+        current = LINK_WIFI_DOWN;
+    }
+    retryAt = now;
+}
+
+LinkEvent LinkManager::loop(uint32_t now) {
+    switch(current) {
+        case LINK_WIFI_DOWN:
+            if((int32_t) (now - retryAt) < 0)
+                return LINK_EVENT_NONE;
+            fastAttempt = cacheValid && !fastFailed;
+            driver.wifiConnect(fastAttempt ? cachedBssid : NULL, fastAttempt ? cachedChannel : 0);
+            deadline = now + (fastAttempt ? LINK_FAST_TIMEOUT_MS : LINK_WIFI_TIMEOUT_MS);
+            current  = LINK_WIFI_CONNECTING;
+            return LINK_EVENT_NONE;
+
+        case LINK_WIFI_CONNECTING:
+            if(driver.wifiConnected()) {
+                stats.wifiConnects++;
+                if(fastAttempt)
+                    stats.fastConnects++;
+                int8_t rssi;
+                cacheValid   = driver.wifiLinkInfo(cachedBssid, &cachedChannel, &rssi);
+                fastFailed   = false;
+                wifiFailures = 0;
+                retryAt      = now;
+                current      = LINK_MQTT_DOWN;
+            } else if((int32_t) (now - deadline) >= 0) {
+                stats.wifiFailures++;
+                if(fastAttempt) {
+                    fastFailed = true; // AP may have moved channel, scan right away
+                    retryAt    = now;
+                } else {
+                    fastFailed = false; // next round tries the cached AP again
+                    backoff(wifiFailures, now);
+                }
+                current = LINK_WIFI_DOWN;
+            }
+            return LINK_EVENT_NONE;
+
+        case LINK_MQTT_DOWN:
+            if(!driver.wifiConnected())
+                return lost(now);
+            if((int32_t) (now - retryAt) < 0)
+                return LINK_EVENT_NONE;
+            deadline = now + LINK_MQTT_TIMEOUT_MS;
+            current  = LINK_MQTT_CONNECTING;
+            // fall through - the first attempt starts right away
+
+        case LINK_MQTT_CONNECTING:
+            if(!driver.wifiConnected())
+                return lost(now);
+            driver.mqttPoll();
+            if(driver.mqttConnected()) {
+                stats.mqttConnects++;
+                mqttFailures = 0;
+                uint32_t outage = now - downSince;
+                if(wasUp) {
+                    stats.lastOutageMs  = outage;
+                    stats.downtimeMs   += outage;
+                    if(outage > stats.maxOutageMs)
+                        stats.maxOutageMs = outage;
+                }
+                wasUp   = true;
+                current = LINK_UP;
+                return LINK_EVENT_UP;
+            }
+            if((int32_t) (now - deadline) >= 0) {
+                stats.mqttFailures++;
+                backoff(mqttFailures, now);
+                current = LINK_MQTT_DOWN;
+            }
+            return LINK_EVENT_NONE;
+
+        case LINK_UP:
+            if(!driver.wifiConnected() || !driver.mqttConnected())
+                return lost(now);
+            sampleQuality(now);
+            return LINK_EVENT_NONE;
+    }
+    return LINK_EVENT_NONE;
+}
+
+LinkEvent LinkManager::lost(uint32_t now) {
+    bool wasConnected = current == LINK_UP;
+    if(wasConnected)
+        downSince = now;
+
+    if(!driver.wifiConnected()) {
+        if(wasConnected || current == LINK_MQTT_DOWN || current == LINK_MQTT_CONNECTING)
+            stats.wifiDrops++;
+        retryAt = now; // the cached AP is worth a try right away
+        current = LINK_WIFI_DOWN;
+    } else {
+        stats.mqttDrops++;
+        retryAt = now;
+        current = LINK_MQTT_DOWN;
+    }
+    return wasConnected ? LINK_EVENT_DOWN : LINK_EVENT_NONE;
+}
+
+void LinkManager::backoff(uint8_t &failures, uint32_t now) {
+    uint32_t delay = LINK_BACKOFF_MAX_MS;
+    if(failures < 16 && ((uint32_t) LINK_BACKOFF_MIN_MS << failures) < LINK_BACKOFF_MAX_MS)
+        delay = (uint32_t) LINK_BACKOFF_MIN_MS << failures;
+    if(failures < 255)
+        failures++;
+
+    // Half fixed, half random, so devices that lost the same AP spread out
+    retryAt = now + delay / 2 + nextRandom() % (delay / 2 + 1);
+}
+
+void LinkManager::sampleQuality(uint32_t now) {
+    if(now - qualityAt < LINK_QUALITY_MS && stats.rssi != 0)
+        return;
+    qualityAt = now;
+
+    uint8_t bssid[6];
+    int32_t channel;
+    int8_t  rssi;
+    if(!driver.wifiLinkInfo(bssid, &channel, &rssi))
+        return;
+    if(stats.rssi == 0)
+        stats.rssiAverage = rssi;
+    stats.rssi         = rssi;
+    stats.rssiAverage += LINK_RSSI_ALPHA * (rssi - stats.rssiAverage);
+
+    // Roamed to another AP of the same network
+    memcpy(cachedBssid, bssid, sizeof(cachedBssid));
+    cachedChannel = channel;
+    cacheValid    = true;
+}
+
+uint32_t LinkManager::nextRandom() {
+    // xorshift32, plenty for jitter
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
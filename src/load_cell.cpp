@@ -0,0 +1,147 @@
+#include "load_cell.h"
+
+void LoadCell::begin(long offset, float factor, UBaseType_t priority) {
+    countsPerGram = factor != 0.0f ? factor : 1.0f;
+    if(offset == LOADCELL_OFFSET_UNSET)
+        requestTare(); // first boot, zero on whatever is on the scale now
+    else
+        tareOffset = offset;
+
+    xTaskCreate(taskMain, "scale", 2048, this, priority, &task);
+}
+
+void LoadCell::configure(const LoadCellConfig &next) {
+    config = next;
+    if(config.medianWindow < 1)
+        config.medianWindow = 1;
+    if(config.medianWindow > LOADCELL_MEDIAN_MAX)
+        config.medianWindow = LOADCELL_MEDIAN_MAX;
+    windowCount = 0;
+    windowNext  = 0;
+    resetFilter();
+}
+
+void LoadCell::setFactor(float factor) {
+    if(factor == 0.0f)
+        return;
+    countsPerGram = factor;
+    resetFilter(); // the estimate is in grams of the old scale
+}
+
+void LoadCell::requestTare() {
+    pendingTare  = true;
+    pendingSince = millis();
+}
+
+void LoadCell::requestCalibration(float mass) {
+    pendingMass  = mass;
+    pendingSince = millis();
+}
+
+void LoadCell::taskMain(void *arg) {
+    LoadCell *self = static_cast<LoadCell *>(arg);
+    for(;;) {
+        // read() clocks the 24 bits out right away once DOUT is low
+        if(self->hx711.is_ready()) {
+            RawSample sample = { (int32_t) self->hx711.read(), (uint32_t) millis() };
+            self->ring.push(sample);
+        }
+        vTaskDelay(pdMS_TO_TICKS(LOADCELL_POLL_MS));
+    }
+}
+
+uint8_t LoadCell::update() {
+    uint8_t   events = 0;
+    RawSample sample;
+
+    while(ring.pop(&sample)) {
+        stats.samples++;
+        float grams = (median(sample.counts) - tareOffset) / countsPerGram;
+        filter(grams);
+        settleStats.add(sample.timestamp, estimate);
+        settled = settleStats.size() >= LOADCELL_SETTLE_SAMPLES &&
+                  settleStats.maximum() - settleStats.minimum() <= config.settleBand;
+        if(!settled)
+            continue;
+        bool fresh = (int32_t) (sample.timestamp - pendingSince) >= LOADCELL_SETTLE_MS;
+
+        // Tare and calibration use the settled estimate mapped back to raw counts
+        float counts = estimate * countsPerGram + tareOffset;
+        if(pendingTare && fresh) {
+            pendingTare = false;
+            tareOffset  = lroundf(counts);
+            resetFilter();
+            events |= LOADCELL_TARED;
+            continue;
+        }
+        if(pendingMass > 0.0f && fresh) {
+            float load  = counts - tareOffset;
+            float mass  = pendingMass;
+            pendingMass = 0.0f;
+            if(fabsf(load) < 100.0f) {
+                events |= LOADCELL_CALIBRATE_FAILED; // nothing measurable on the scale
+            } else {
+                setFactor(load / mass);
+                events |= LOADCELL_CALIBRATED;
+            }
+            continue;
+        }
+
+        if(!reportValid || fabsf(estimate - reported) >= config.deadband) {
+            reported    = estimate;
+            reportValid = true;
+            events     |= LOADCELL_CHANGED;
+        }
+    }
+    return events;
+}
+
+float LoadCell::median(int32_t counts) {
+    window[windowNext] = counts;
+    windowNext         = (windowNext + 1) % config.medianWindow;
+    if(windowCount < config.medianWindow)
+        windowCount++;
+
+    int32_t sorted[LOADCELL_MEDIAN_MAX];
+    for(uint8_t i = 0; i < windowCount; i++) {
+        int32_t v = window[i];
+        uint8_t j = i;
+        for(; j > 0 && sorted[j - 1] > v; j--)
+            sorted[j] = sorted[j - 1];
+        sorted[j] = v;
+    }
+    if(windowCount % 2)
+        return sorted[windowCount / 2];
+    return (sorted[windowCount / 2 - 1] + (float) sorted[windowCount / 2]) * 0.5f;
+}
+
+// Scalar Kalman filter with a random-walk weight model. A jump far outside
+// the expected noise (bowl placed, food dispensed) restarts the estimate at
+// the new value instead of creeping towards it.
+void LoadCell::filter(float grams) {
+    if(!filterValid) {
+        estimate    = grams;
+        variance    = config.measurementNoise;
+        filterValid = true;
+        return;
+    }
+
+    variance         += config.processNoise;
+    float innovation  = grams - estimate;
+    float spread      = variance + config.measurementNoise;
+    if(innovation * innovation > LOADCELL_STEP_SIGMA * LOADCELL_STEP_SIGMA * spread) {
+        estimate = grams;
+        variance = config.measurementNoise;
+        stats.steps++;
+        return;
+    }
+
+    float gain  = variance / spread;
+    estimate   += gain * innovation;
+    variance   *= 1.0f - gain;
+}
+
+void LoadCell::resetFilter() {
+    filterValid = false;
+    settled     = false;
+}
@@ -5,11 +5,35 @@
 #include <WiFiManager.h>
 #include <LittleFS.h>
 #include <time.h>
-#include <sstream>
-#include <iomanip>
-#include <string>
-#include <AccelStepper.h>
+#include <stdarg.h>
+#include <esp_sntp.h>
 #include "HX711.h"
+#include "load_cell.h"
+#include "step_engine.h"
+#include "dispense_controller.h"
+#include "display_transport.h"
+#include "glyph_atlas.h"
+#include "screen_layout.h"
+#include "subscriptions.h"
+#include "payload_parser.h"
+#include "series_stats.h"
+#include "spark_series.h"
+#include "history_log.h"
+#include "feed_ledger.h"
+#include "deadline_scheduler.h"
+#include "settings_store.h"
+#include "publish_governor.h"
+#include "mpsc_queue.h"
+#include "spsc_ring.h"
+#include "task_monitor.h"
+#include "gesture_recognizer.h"
+#include "link_manager.h"
+#include "wifi_link.h"
+#include "state_outbox.h"
+#include "boot_timeline.h"
+#include "stage_profiler.h"
+#include "alloc_guard.h"
+#include "u8x8_esp32_spi.h"
 
 #define LCD_CLOCK            1
 #define LCD_DATA             0
@@ -32,19 +56,50 @@
 
 #define DEVICE_NAME          "HASS-Display"
 
+// Default subscriptions for the first slots, used until /topics.txt exists
 #define DATA_PRIMARY_TOPIC   "GreenThing/27B529/CO/temperature"
 #define DATA_SECONDARY_TOPIC "GreenThing/27B529/CWU/temperature"
 #define DATA3_TOPIC          "wled/62fad8/temperature"
 #define DATA4_TOPIC          "wled/b47157/temperature"
 
+// "<slot> <filter> [json.path]" published here rebinds a slot, "<slot> -" clears it
+#define TOPICS_COMMAND_TOPIC "aha/" DEVICE_NAME "/topics/set"
+#define TOPICS_STATE_PREFIX  "aha/" DEVICE_NAME "/topics/" // + slot, retained
+
 #define BACKLIGHT_TIME       15000 // ms
+#define HISTORY_SCALE_TIME   60000 // ms between scale samples in the history log
+#define DIAGNOSTICS_TIME     60000 // ms between diagnostic counter publishes
+
+#define HA_MAX_ENTITIES      64 // must cover every HA entity declared below
+
+// Each task owns the state it writes; everything else travels through
+// the queues or the value table declared below
+#define MOTION_TASK_PRIORITY  5 // step timing and braking on the scale reading
+#define SENSOR_TASK_PRIORITY  4
+#define UI_TASK_PRIORITY      3
+#define NETWORK_TASK_PRIORITY 2 // WiFi, MQTT/HA and flash writes, may block
+#define MOTION_PERIOD_MS      20
+#define SENSOR_PERIOD_MS      50 // the HX711 delivers a sample every 100 ms
+#define UI_PERIOD_MS          20
+#define NETWORK_PERIOD_MS     10
 
 // NTP Configuration
 #define NTP_SERVER           "pool.ntp.org"
 #define GMT_OFFSET_SEC       3600 // GMT+1 (adjust for your timezone)
 #define DAYLIGHT_OFFSET_SEC  3600 // Daylight saving time offset
+#define TIME_VALID_EPOCH     1577836800 // 2020-01-01, earlier means the clock was never set
+
+// Feed schedules and daily jobs
+#define FEED_SCHEDULES       4
+#define FEED_CATCHUP_S       (2 * 60 * 60)        // a feed missed by more than this is skipped, not made up
+#define PERSISTED_JOBS       (FEED_SCHEDULES + 1) // the feeds and the midnight reset remember their last run
+#define MAINTENANCE_MINUTE   (3 * 60 + 30)        // 03:30 local
+#define SCHEDULE_MAX_SLEEP   (60 * 60 * 1000UL)   // ms, the clock is looked at least this often
 
-#define DELTA_READINGS_COUNT 15 // Number of readings to use for delta calculation
+#define TREND_WINDOW_MS      (15 * 60 * 1000UL) // samples older than this leave the trend statistics
+#define TREND_SAMPLES        32                 // per series capacity within the window
+#define TREND_EWMA_ALPHA     0.2f
+#define SPARK_SPAN_MS        (3 * 60 * 60 * 1000UL) // history a full width sparkline shows
 
 #define EN_PIN               6
 #define STEP_PIN             7
@@ -55,61 +110,135 @@
 #define DOUT_PIN             9
 #define SCK_PIN              8
 
+// Entities whose state goes through the publish governor
+enum GovernedEntity {
+    PUB_BACKLIGHT,
+    PUB_SCALE,
+    PUB_GRAMS_FED,
+    PUB_CO_DELTA,
+    PUB_CO_AVERAGE,
+    PUB_CO_MIN,
+    PUB_CO_MAX,
+    PUB_CWU_DELTA,
+    PUB_CWU_AVERAGE,
+    PUB_CWU_MIN,
+    PUB_CWU_MAX,
+    PUB_COUNT
+};
+
+enum ButtonId {
+    BUTTON_WAKE, // display only, not exposed to HA
+    BUTTON_USAGE1,
+    BUTTON_USAGE2,
+    BUTTON_COUNT
+};
+
 enum ActivityState {
     ACTIVITY_LOW,
     ACTIVITY_HIGH,
     ACTIVITY_STEPPER
 };
 
-struct settings {
-        char    mqtt_server[64]     = "";
-        int     mqtt_port           = 1883;
-        char    mqtt_user[64]       = "";
-        char    mqtt_password[64]   = "";
-
-        uint8_t LCD_CONTRAST_VAL    = 128;
-        uint8_t LCD_BACKLIGHT_VAL   = 128;
-
-        int     StepperSpeed        = 10;
-        int     StepperAccel        = 20;
-        float   GramsFeededToday    = 0.0f;
-        float   RotationsPerFeeding = 1.0f;
-        float   GramsPerRotation    = 1.0f;
-        float   MaxGramsPerDay      = 100.0f;
-
-        long    calibrationFactor   = 1000; // HX711 calibration factor
-
-        void    saveToFS() {
-            File file = LittleFS.open("/settings.bin", "w");
-
-            if(file) {
-                file.write((uint8_t *) this, sizeof(settings));
-                file.close();
-                // Serial.println("Settings saved to filesystem.");
-            } else {
-                // Serial.println("Failed to open settings file for writing.");
-            }
-        }
+// Sensor, UI and motion tasks -> network task
+enum NetEventType {
+    NET_PUBLISH,            // GovernedEntity `id` has a new value
+    NET_TRIGGER,            // buttonTriggers[`id`] fired
+    NET_BRIGHTNESS,         // `value` set on the device
+    NET_TARED,              // `counts` is the new tare offset
+    NET_CALIBRATED,         // `counts` is the new calibration factor
+    NET_CALIBRATE_FAILED,
+    NET_FEED_DONE,          // `value` grams fed, `id` 1 if weighed rather than estimated, `counts` the quota reserved
+    NET_FEED_REJECTED,      // the feeder was busy, `counts` the quota reserved for the feed
+    NET_GRAMS_PER_ROTATION, // `value` learned by the last feed
+};
 
-        void loadFromFS() {
-            File file = LittleFS.open("/settings.bin", "r");
-
-            if(file) {
-                if(file.size() == sizeof(settings)) {
-                    file.read((uint8_t *) this, sizeof(settings));
-                    // Serial.println("Settings loaded from filesystem.");
-                } else {
-                    // read only mqtt settings if size mismatch
-                    file.read((uint8_t *) this, sizeof(char) * 64 * 3 + sizeof(int));
-
-                    // Serial.println("Settings file size mismatch. Using default settings.");
-                }
-                file.close();
-            } else {
-                // Serial.println("Settings file not found. Using default settings.");
-                this->saveToFS(); // Save default settings
-            }
-        }
+struct NetEvent {
+        uint8_t  type;
+        uint8_t  id;
+        float    value;
+        int32_t  counts;
+        uint32_t postedAt; // micros()
+};
+
+// Network and motion tasks -> UI task
+enum UiEventType {
+    UI_BACKLIGHT,  // HA switched the backlight `value` on or off
+    UI_BRIGHTNESS, // `value` is the new brightness
+    UI_CONTRAST,   // `value` is the new contrast
+    UI_FEEDING,    // `value` 1 while a feed runs, the backlight timeout waits for it
+    UI_PORTAL,     // `value` is a PortalState, the setup portal replaces the data screen
+};
+
+struct UiEvent {
+        uint8_t  type;
+        uint8_t  value;
+        uint32_t postedAt;
+};
+
+enum PortalState {
+    PORTAL_CLOSED,
+    PORTAL_OPEN,   // no stored credentials, waiting for the user
+    PORTAL_FAILED, // about to reboot
+};
+
+// Network task -> sensor task
+enum SensorCommandType {
+    SENSOR_TARE,
+    SENSOR_CALIBRATE,  // `value` is the known mass
+    SENSOR_SET_FACTOR, // `value` is the new calibration factor
+    SENSOR_CONFIGURE,  // config.ScaleFilter changed
+};
+
+struct SensorCommand {
+        uint8_t  type;
+        float    value;
+        uint32_t postedAt;
+};
+
+// Network task -> motion task. Every command carries the motion settings
+// so the motion task never reads config
+enum MotionCommandType {
+    MOTION_CONFIGURE,  // only speed and acceleration
+    MOTION_FEED_STEPS, // open loop, `grams` is the estimate
+    MOTION_FEED_GRAMS, // by weight, `grams` is the target
+};
+
+struct MotionCommand {
+        uint8_t  type;
+        uint32_t speed; // steps/s
+        uint32_t accel; // steps/s^2
+        uint32_t steps;
+        float    grams;
+        float    gramsPerRotation;
+        Fixed    reserved; // quota held for the feed until it is recorded
+        uint32_t postedAt;
+};
+
+struct settings {
+        char     mqtt_server[64]            = "";
+        int      mqtt_port                  = 1883;
+        char     mqtt_user[64]              = "";
+        char     mqtt_password[64]          = "";
+
+        uint8_t  LCD_CONTRAST_VAL           = 128;
+        uint8_t  LCD_BACKLIGHT_VAL          = 128;
+
+        int      StepperSpeed               = 10;
+        int      StepperAccel               = 20;
+        float    RotationsPerFeeding        = 1.0f;
+        float    GramsPerRotation           = 1.0f;
+        float    MaxGramsPerDay             = 100.0f;
+
+        long     calibrationFactor          = 1000;                  // HX711 counts per gram
+        long     tareOffset                 = LOADCELL_OFFSET_UNSET; // HX711 counts at zero load
+        float    CalibrationMass            = 100.0f;                // g, known mass for auto-calibration
+        float    FeedTargetGrams            = 20.0f;                 // g per feed when feeding by weight
+        uint8_t  FeedByWeight               = 0;                     // 1: dispense until the scale shows the target
+        uint8_t  WifiBssid[6]               = {};                    // AP of the last join, the next boot skips the scan
+        uint8_t  WifiChannel                = 0;                     // 0: no join yet
+        int16_t  FeedTimes[FEED_SCHEDULES]  = { -1, -1, -1, -1 };    // HHMM local time, -1: off
+        uint32_t JobLastRun[PERSISTED_JOBS] = {};                    // epoch of the last run per feed schedule, then the midnight reset
+        LoadCellConfig ScaleFilter;                                  // median, Kalman and settle tuning of the scale
 };
 
 WiFiManagerParameter  *mqtt_server_param;
@@ -120,15 +249,55 @@ WiFiManager            wifiManager;
 
 WiFiClient             client;
 HADevice               device(DEVICE_NAME);
-HAMqtt                 mqtt(client, device);
-AccelStepper           stepper(AccelStepper::DRIVER, STEP_PIN, 8);
+HAMqtt                 mqtt(client, device, HA_MAX_ENTITIES);
+WifiMqttLink           linkDriver(mqtt);
+LinkManager            connection(linkDriver);
+StateOutbox            stateOutbox; // state changed while the broker was unreachable
+StepEngine             stepEngine(STEP_PIN); // step only: feeding always turns one way
+DispenseController     dispenser;
 HX711                  scale;
-
-hw_timer_t            *stepperTimer = NULL;
-portMUX_TYPE           stepperMux   = portMUX_INITIALIZER_UNLOCKED;
+LoadCell               loadCell(scale);
 
 settings               config       = {};
 
+// Persisted fields. Ids are the keys on flash: append new ones, never
+// renumber. The last column is the field's place in the old raw dump.
+#define SETTINGS_FIELD(id, version, member, legacyOffset) \
+    { id, version, sizeof(settings::member), offsetof(settings, member), legacyOffset, NULL }
+
+const SettingsField settingsFields[] = {
+    SETTINGS_FIELD(1, 1, mqtt_server, 0),
+    SETTINGS_FIELD(2, 1, mqtt_port, 64),
+    SETTINGS_FIELD(3, 1, mqtt_user, 68),
+    SETTINGS_FIELD(4, 1, mqtt_password, 132),
+    SETTINGS_FIELD(5, 1, LCD_CONTRAST_VAL, 196),
+    SETTINGS_FIELD(6, 1, LCD_BACKLIGHT_VAL, 197),
+    SETTINGS_FIELD(7, 1, StepperSpeed, 200),
+    SETTINGS_FIELD(8, 1, StepperAccel, 204),
+    // 9: grams fed today, superseded by the feed ledger
+    SETTINGS_FIELD(10, 1, RotationsPerFeeding, 212),
+    SETTINGS_FIELD(11, 1, GramsPerRotation, 216),
+    SETTINGS_FIELD(12, 1, MaxGramsPerDay, 220),
+    SETTINGS_FIELD(13, 1, calibrationFactor, 224),
+    SETTINGS_FIELD(14, 1, tareOffset, -1),
+    SETTINGS_FIELD(15, 1, CalibrationMass, -1),
+    SETTINGS_FIELD(16, 1, FeedTargetGrams, -1),
+    SETTINGS_FIELD(17, 1, FeedByWeight, -1),
+    SETTINGS_FIELD(18, 1, WifiBssid, -1),
+    SETTINGS_FIELD(19, 1, WifiChannel, -1),
+    SETTINGS_FIELD(20, 1, FeedTimes, -1),
+    SETTINGS_FIELD(21, 1, JobLastRun, -1),
+    SETTINGS_FIELD(22, 1, ScaleFilter.medianWindow, -1),
+    SETTINGS_FIELD(23, 1, ScaleFilter.processNoise, -1),
+    SETTINGS_FIELD(24, 1, ScaleFilter.measurementNoise, -1),
+    SETTINGS_FIELD(25, 1, ScaleFilter.settleBand, -1),
+    SETTINGS_FIELD(26, 1, ScaleFilter.deadband, -1),
+};
+
+static_assert(sizeof(settings) <= SETTINGS_MAX_BYTES, "settings struct outgrew the store shadow");
+
+SettingsStore settingsStore(&config, sizeof(config), settingsFields, sizeof(settingsFields) / sizeof(settingsFields[0]));
+
 HALight                backlight("backlight", HALight::BrightnessFeature);
 HANumber               contrast("contrast", HABaseDeviceType::PrecisionP0);
 HANumber               stepperSpeed("stepper_speed", HABaseDeviceType::PrecisionP0);
@@ -136,70 +305,311 @@ HANumber               stepperAccel("stepper_accel", HABaseDeviceType::Precision
 HANumber               rotationsPerFeeding("rotations_per_feeding", HABaseDeviceType::PrecisionP2);
 HANumber               gramsPerFeeding("grams_per_feeding", HABaseDeviceType::PrecisionP2);
 HANumber               maxGramsPerDay("max_grams_per_day", HABaseDeviceType::PrecisionP2);
+HANumber               feedTarget("feed_target_grams", HABaseDeviceType::PrecisionP1);
+HASwitch               feedByWeight("feed_by_weight");
 
 HANumber               calibrationFactor("calibration_factor", HABaseDeviceType::PrecisionP0);
+HANumber               calibrationMass("calibration_mass", HABaseDeviceType::PrecisionP1);
+HAButton               tareButton("scale_tare");
+HANumber               scaleMedianWindow("scale_median_window", HABaseDeviceType::PrecisionP0);
+HANumber               scaleProcessNoise("scale_process_noise", HABaseDeviceType::PrecisionP3);
+HANumber               scaleMeasurementNoise("scale_measurement_noise", HABaseDeviceType::PrecisionP2);
+HANumber               scaleSettleBand("scale_settle_band", HABaseDeviceType::PrecisionP1);
+HANumber               scaleDeadband("scale_deadband", HABaseDeviceType::PrecisionP1);
+HAButton               calibrateButton("scale_calibrate");
 
 HASensorNumber         gramsFedTodaySensor("grams_fed_today", HABaseDeviceType::PrecisionP1);
 HASensorNumber         COdelta("co_delta", HABaseDeviceType::PrecisionP2);
 HASensorNumber         CWUdelta("cwu_delta", HABaseDeviceType::PrecisionP2);
+HASensorNumber         COaverage("co_average", HABaseDeviceType::PrecisionP1);
+HASensorNumber         COmin("co_min", HABaseDeviceType::PrecisionP1);
+HASensorNumber         COmax("co_max", HABaseDeviceType::PrecisionP1);
+HASensorNumber         CWUaverage("cwu_average", HABaseDeviceType::PrecisionP1);
+HASensorNumber         CWUmin("cwu_min", HABaseDeviceType::PrecisionP1);
+HASensorNumber         CWUmax("cwu_max", HABaseDeviceType::PrecisionP1);
 HASensorNumber         ScaleSensor("scale_weight", HABaseDeviceType::PrecisionP1);
+HASensorNumber         lastFeedSensor("last_feed_grams", HABaseDeviceType::PrecisionP1);
+HASensorNumber         gramsFed24hSensor("grams_fed_24h", HABaseDeviceType::PrecisionP1);
+HASensorNumber         quotaLeftSensor("feed_quota_left", HABaseDeviceType::PrecisionP1);
+HASensorNumber         feedsRefusedSensor("feeds_refused", HABaseDeviceType::PrecisionP0);
+HASensorNumber         framesRenderedSensor("display_frames_rendered", HABaseDeviceType::PrecisionP0);
+HASensorNumber         framesSkippedSensor("display_frames_skipped", HABaseDeviceType::PrecisionP0);
+HASensorNumber         bytesSentSensor("display_bytes_sent", HABaseDeviceType::PrecisionP0);
+HASensorNumber         settingsWritesSensor("settings_flash_writes", HABaseDeviceType::PrecisionP0);
+HASensorNumber         publishesSentSensor("ha_publishes_sent", HABaseDeviceType::PrecisionP0);
+HASensorNumber         publishesSavedSensor("ha_publishes_suppressed", HABaseDeviceType::PrecisionP0);
 
 HAButton               feedNowButton("feed_now");
+HANumber               feedTime1("feed_time_1", HABaseDeviceType::PrecisionP0);
+HANumber               feedTime2("feed_time_2", HABaseDeviceType::PrecisionP0);
+HANumber               feedTime3("feed_time_3", HABaseDeviceType::PrecisionP0);
+HANumber               feedTime4("feed_time_4", HABaseDeviceType::PrecisionP0);
+HASensor               nextFeedSensor("next_feed");
+
+HANumber *const        feedTimeNumbers[FEED_SCHEDULES] = { &feedTime1, &feedTime2, &feedTime3, &feedTime4 };
+
+HASensor               taskStatsSensor("task_stats");
+HASensorNumber         wifiRssiSensor("wifi_rssi", HABaseDeviceType::PrecisionP0);
+HASensorNumber         linkDropsSensor("link_drops", HABaseDeviceType::PrecisionP0);
+HASensorNumber         linkDowntimeSensor("link_downtime", HABaseDeviceType::PrecisionP0);
+HASensor               bootPhasesSensor("boot_phases");
+HASensorNumber         loopRateSensor("loop_rate", HABaseDeviceType::PrecisionP0);
+HASensorNumber         freeHeapSensor("free_heap", HABaseDeviceType::PrecisionP0);
+#if PROFILE_STAGES
+HASensor               stageTimingsSensor("stage_timings");
+#endif
+
+HASensorNumber         buttonDropsSensor("button_events_dropped", HABaseDeviceType::PrecisionP0);
+HASensorNumber         buttonLatencySensor("button_latency_max", HABaseDeviceType::PrecisionP0);
 
 HADeviceTrigger        trigger1short(HADeviceTrigger::ButtonShortPressType, "btn1");
 HADeviceTrigger        trigger1long(HADeviceTrigger::ButtonLongPressType, "btn1");
-bool                   triggered1long  = false;
-bool                   triggered1short = false;
-
+HADeviceTrigger        trigger1double(HADeviceTrigger::ButtonDoublePressType, "btn1");
+HADeviceTrigger        trigger1repeat("button_repeat", "btn1");
 HADeviceTrigger        trigger2short(HADeviceTrigger::ButtonShortPressType, "btn2");
 HADeviceTrigger        trigger2long(HADeviceTrigger::ButtonLongPressType, "btn2");
-bool                   triggered2long          = false;
-bool                   triggered2short         = false;
+HADeviceTrigger        trigger2double(HADeviceTrigger::ButtonDoublePressType, "btn2");
+HADeviceTrigger        trigger2repeat("button_repeat", "btn2");
+
+struct ButtonTriggerBinding {
+        uint8_t          button;
+        uint8_t          gesture;
+        HADeviceTrigger *trigger;
+        const char      *name;
+};
+
+const ButtonTriggerBinding buttonTriggers[] = {
+    { BUTTON_USAGE1,  GESTURE_SHORT,  &trigger1short,  "Short press 1" },
+    { BUTTON_USAGE1,   GESTURE_LONG,   &trigger1long,   "Long press 1" },
+    { BUTTON_USAGE1, GESTURE_DOUBLE, &trigger1double, "Double press 1" },
+    { BUTTON_USAGE1, GESTURE_REPEAT, &trigger1repeat,  "Hold repeat 1" },
+    { BUTTON_USAGE2,  GESTURE_SHORT,  &trigger2short,  "Short press 2" },
+    { BUTTON_USAGE2,   GESTURE_LONG,   &trigger2long,   "Long press 2" },
+    { BUTTON_USAGE2, GESTURE_DOUBLE, &trigger2double, "Double press 2" },
+    { BUTTON_USAGE2, GESTURE_REPEAT, &trigger2repeat,  "Hold repeat 2" },
+};
+
+struct ButtonPin {
+        uint8_t pin;
+        uint8_t mode;
+        uint8_t pressedLevel;
+};
 
-long                   button1PressinTime      = 0;
-long                   button2PressinTime      = 0;
-volatile unsigned long button1LastDebounce     = 0;
-volatile unsigned long button2LastDebounce     = 0;
-const unsigned long    BUTTON_DEBOUNCE_TIME    = 50; // ms
+const ButtonPin buttonPins[BUTTON_COUNT] = {
+    { BUTTON1_PIN,   INPUT_PULLUP,  LOW },
+    { BUTTON2_PIN, INPUT_PULLDOWN, HIGH },
+    { BUTTON3_PIN, INPUT_PULLDOWN, HIGH },
+};
+
+#define BRIGHTNESS_STEP 32 // per hold-repeat of the wake button
 
-const long             BUTTON_LONGPRESS_TIME   = 500; // ms
+// Written by the button ISR only, drained by the UI task
+SpscRing<ButtonEdge, 32> buttonEdges;
+volatile uint8_t         buttonLevels[BUTTON_COUNT] = {}; // last level pushed per button
+GestureRecognizer        gestures;                        // owned by the UI task
 
+// Owned by the UI task
 ActivityState          currentActivityState    = ACTIVITY_HIGH;
+unsigned long          lastActivity            = 0;
+uint8_t                uiBrightness            = 0;
+bool                   backlightShown          = true;
+uint8_t                portalShown             = PORTAL_CLOSED;
+
+typedef SeriesStats<TREND_SAMPLES> TrendSeries;
+
+TrendSeries                        primaryTrend(TREND_WINDOW_MS, TREND_EWMA_ALPHA);
+TrendSeries                        secondaryTrend(TREND_WINDOW_MS, TREND_EWMA_ALPHA);
+
+typedef SparkSeries<LAYOUT_SPARK_WIDTH> SparkHistory;
+
+// Written by the network task, drawn by the UI task under sparkLock
+SparkHistory                       primarySpark(SPARK_SPAN_MS / LAYOUT_SPARK_WIDTH);
+SparkHistory                       secondarySpark(SPARK_SPAN_MS / LAYOUT_SPARK_WIDTH);
+SemaphoreHandle_t                  sparkLock = NULL;
+
+// Value slot feeding a trend series and the HA sensors it publishes to
+struct TrendOutput {
+        uint8_t         slot;
+        uint8_t         slopeSlot; // the slope for the screen
+        const char     *name;
+        TrendSeries    *series;
+        SparkHistory   *spark;
+        uint8_t         slope; // GovernedEntity handles
+        uint8_t         average;
+        uint8_t         minimum;
+        uint8_t         maximum;
+};
+
+TrendOutput trendOutputs[] = {
+    {  SLOT_CO,  SLOT_CO_SLOPE,  "CO",   &primaryTrend,   &primarySpark,  PUB_CO_DELTA,  PUB_CO_AVERAGE,  PUB_CO_MIN,  PUB_CO_MAX },
+    { SLOT_CWU, SLOT_CWU_SLOPE, "CWU", &secondaryTrend, &secondarySpark, PUB_CWU_DELTA, PUB_CWU_AVERAGE, PUB_CWU_MIN, PUB_CWU_MAX },
+};
+
+static_assert(PUB_COUNT <= GOVERNOR_MAX_ENTRIES, "raise GOVERNOR_MAX_ENTRIES");
+
+// Sent through stateOutbox directly, next to the governed entities:
+// backlight brightness, calibration factor, grams per feeding, last feed
+// and the three feed ledger sensors. Keep in step with the send() calls.
+#define OUTBOX_DIRECT_ENTITIES 7
+
+static_assert(PUB_COUNT + OUTBOX_DIRECT_ENTITIES <= STATE_OUTBOX_SIZE, "raise STATE_OUTBOX_SIZE, an outage would drop retained states");
+
+PublishGovernor publishGovernor;
 
-const float            DELTA_TIME_DIVIDER      = 1000.0f * 60.0f; // to convert ms to seconds
+bool            sendSensor(void *entity, float value) {
+    return static_cast<HASensorNumber *>(entity)->setValue(value, true);
+}
+
+bool sendLightState(void *entity, float value) {
+    return static_cast<HALight *>(entity)->setState(value != 0.0f, true);
+}
 
-float                  PrimaryData             = 0.0f;
-float                  SecondaryData           = 0.0f;
-float                  PrimaryDelta            = 0.0f;
-float                  SecondaryDelta          = 0.0f;
-float                  PrimaryDeltaThreshold   = 0.15f;
-float                  SecondaryDeltaThreshold = 0.15f;
+bool sendLightBrightness(void *entity, float value) {
+    return static_cast<HALight *>(entity)->setBrightness((uint8_t) value, true);
+}
 
-// Ring buffers for delta calculation based on multiple readings
-struct DeltaReading {
-        float value;
-        long  timestamp;
+bool sendNumberState(void *entity, float value) {
+    return static_cast<HANumber *>(entity)->setState(value, true);
+}
+
+// Governed states are kept in the outbox while offline and replayed later
+bool publishSensor(void *entity, float value) {
+    return stateOutbox.send(sendSensor, entity, value);
+}
+
+bool publishLightState(void *entity, float value) {
+    return stateOutbox.send(sendLightState, entity, value);
+}
+
+struct GovernedBinding {
+        uint8_t         handle;
+        GovernedPublish publish;
+        void           *entity;
+        PublishPolicy   policy; // deadband, min interval ms, heartbeat ms
 };
 
-DeltaReading                       primaryReadings[DELTA_READINGS_COUNT];
-int                                primaryReadingsIndex = 0;
-int                                primaryReadingsCount = 0;
+const GovernedBinding governedBindings[] = {
+    {   PUB_BACKLIGHT, publishLightState,           &backlight, {  0.0f,  1000, 600000 } },
+    {       PUB_SCALE,     publishSensor,         &ScaleSensor, {  0.0f,  2000, 600000 } }, // LoadCell applies the deadband
+    {   PUB_GRAMS_FED,     publishSensor, &gramsFedTodaySensor, {  0.0f,     0, 600000 } },
+    {    PUB_CO_DELTA,     publishSensor,             &COdelta, { 0.01f, 10000, 300000 } },
+    {  PUB_CO_AVERAGE,     publishSensor,           &COaverage, { 0.05f, 10000, 300000 } },
+    {      PUB_CO_MIN,     publishSensor,               &COmin, { 0.05f, 10000, 300000 } },
+    {      PUB_CO_MAX,     publishSensor,               &COmax, { 0.05f, 10000, 300000 } },
+    {   PUB_CWU_DELTA,     publishSensor,            &CWUdelta, { 0.01f, 10000, 300000 } },
+    { PUB_CWU_AVERAGE,     publishSensor,          &CWUaverage, { 0.05f, 10000, 300000 } },
+    {     PUB_CWU_MIN,     publishSensor,              &CWUmin, { 0.05f, 10000, 300000 } },
+    {     PUB_CWU_MAX,     publishSensor,              &CWUmax, { 0.05f, 10000, 300000 } },
+};
+
+ValueTable                         values;
+MpscQueue<NetEvent, 32>            outbox;
+MpscQueue<UiEvent, 16>             uiEvents;
+SpscRing<SensorCommand, 8>         sensorCommands;
+SpscRing<MotionCommand, 8>         motionCommands;
+
+TaskMonitor                        motionMonitor("motion");
+TaskMonitor                        sensorMonitor("sensor");
+TaskMonitor                        uiMonitor("ui");
+TaskMonitor                        networkMonitor("network");
+TaskMonitor                       *const taskMonitors[] = { &motionMonitor, &sensorMonitor, &uiMonitor, &networkMonitor };
+BootTimeline                       bootTimeline;
+
+// Owned by the motion task
+uint32_t                           motionSpeed            = 0;
+uint32_t                           motionAccel            = 0;
+bool                               feeding                = false;
+Fixed                              feedReservation        = 0; // of the feed by weight in progress
+
+SubscriptionRegistry               subscriptions;
+uint32_t                           payloadErrors          = 0; // malformed payloads dropped
+uint32_t                           payloadClamped         = 0; // beyond the Fixed range, kept at its limit
+
+HistoryLog                         historyLog;
+unsigned long                      lastScaleHistory       = 0;
+
+// Owned by the network task
+FeedLedger                         feedLedger;
+Fixed                              feedReserved           = 0; // quota of feeds queued or running, not recorded yet
+
+// Jobs on the deadline scheduler
+enum ScheduledJob {
+    JOB_FEED,                      // + schedule index
+    JOB_MIDNIGHT = FEED_SCHEDULES, // daily counter reset
+    JOB_MAINTENANCE,
+    JOB_LEDGER,                    // the oldest feed leaves the 24 h window
+    JOB_COUNT
+};
 
-DeltaReading                       secondaryReadings[DELTA_READINGS_COUNT];
-int                                secondaryReadingsIndex = 0;
-int                                secondaryReadingsCount = 0;
+static_assert(JOB_COUNT <= SCHEDULER_MAX_JOBS, "raise SCHEDULER_MAX_JOBS");
 
-float                              Data3                  = 0.0f;
-float                              Data4                  = 0.0f;
+// Owned by the network task
+DeadlineScheduler                  scheduler;
+unsigned long                      scheduleWakeAt         = 0; // millis() to look at the clock again
+bool                               scheduleArmed          = false;
+volatile bool                      clockStepped           = false; // set by the SNTP callback
 
-int                                lastDay                = -1; // Track last known day for new day detection
+bool                                  portalDrawn             = false;
+bool                                  framePending            = false; // drawn but not yet accepted by the flush task
+unsigned long                         lastDiagnosticsPublish = 0;
+uint32_t                              lastLoopIterations     = 0;
 
-U8G2_ST7565_NHD_C12864_F_4W_SW_SPI u8g2(U8G2_R0,
+U8G2_ST7565_NHD_C12864_F_4W_ESP32_SPI u8g2(U8G2_R0,
 /* clock=*/LCD_CLOCK,
 /* data=*/LCD_DATA,
 /* cs=*/LCD_CS,
 /* dc=*/LCD_RS,
 /* reset=*/LCD_RSE);
+U8g2Transport                         displayTransport(u8g2);
+DisplayFlusher                        displayFlusher(u8g2, displayTransport);
+
+GlyphFont                             glyphsPrimary; // FONT_PRIMARY_DATA
+GlyphFont                             glyphsSmall;   // FONT_SMALL
+GlyphFont                             glyphsTiny;    // FONT_TINY
+
+const LayoutFonts                     layoutFonts = {
+    {           FONT_TINY,   FONT_SMALL, FONT_PRIMARY_DATA },
+    {         &glyphsTiny, &glyphsSmall,    &glyphsPrimary },
+    {         &glyphsTiny, &glyphsSmall,      &glyphsSmall },
+};
+
+// Built-in screen, used until /layout.txt exists. Slots: 0-3 subscriptions,
+// 32/33 the CO/CWU slopes, 34 the scale.
+static_assert(SLOT_CO_SLOPE == 32 && SLOT_CWU_SLOPE == 33 && SLOT_SCALE == 34, "update the default layout slots");
+
+const char defaultLayout[] = "page\n"
+                             "frame 0 0 45 64\n"
+                             "frame 44 0 84 64\n"
+                             "label 3 8 tiny 1 CO\n"
+                             "value 1 28 big -2 0 1 1 10 43 21\n"
+                             "trend 37 3 4 32 0.15\n"
+                             "label 3 61 tiny 1 CWU\n"
+                             "value 1 51 big -2 1 1 1 33 43 20\n"
+                             "trend 37 56 4 33 0.15\n"
+                             "frame 44 0 84 16\n"
+                             "label 46 12 small 0 Kamil\n"
+                             "value 98 12 small -1 2 1 98 2 29 12\n"
+                             "frame 44 15 84 16\n"
+                             "label 47 27 small 0 Magda\n"
+                             "value 98 27 small -1 3 1 98 17 29 12\n"
+                             "frame 44 30 84 16\n"
+                             "label 46 42 small 0 CO/m\n"
+                             "value 98 42 small -1 32 1 98 32 29 12\n"
+                             "frame 44 45 84 16\n"
+                             "label 46 57 small 0 CWU/m\n"
+                             "value 98 57 small -1 33 1 98 47 29 12\n"
+                             "page\n"
+                             "frame 0 0 128 64\n"
+                             "label 4 12 small 0 Scale\n"
+                             "value 4 44 big -2 34 1 2 20 100 28\n"
+                             "label 110 44 small 0 g\n"
+                             "page\n"
+                             "label 1 7 tiny 1 CO\n"
+                             "spark 0 9 128 22 0\n"
+                             "label 1 39 tiny 1 CWU\n"
+                             "spark 0 41 128 22 1\n";
+
+ScreenLayout                          screenLayout; // owned by the UI task
 
 
 // functions
@@ -216,83 +626,73 @@ void           onRotationsPerFeedingCommand(HANumeric value, HANumber *sender);
 void           onGramsPerFeedingCommand(HANumeric value, HANumber *sender);
 void           onMaxGramsPerDayCommand(HANumeric value, HANumber *sender);
 void           onFeedNowCommand(HAButton *sender);
+void           onFeedTargetCommand(HANumeric value, HANumber *sender);
+void           onFeedByWeightCommand(bool state, HASwitch *sender);
 void           onCalibrationFactorCommand(HANumeric value, HANumber *sender);
+void           onCalibrationMassCommand(HANumeric value, HANumber *sender);
+void           onScaleFilterCommand(HANumeric value, HANumber *sender);
+void           onTareCommand(HAButton *sender);
+void           onCalibrateCommand(HAButton *sender);
 void           onMqttMessage(const char *topic, const uint8_t *payload, uint16_t length);
+void           onMqttConnected();
+void           onSlotMessage(uint8_t slot, void *context);
+void           onTopicsCommand(const uint8_t *payload, uint16_t length);
+void           publishSubscription(uint8_t slot);
 void           render();
+void           publishDiagnostics();
 void           feedNow();
 void           stepperLoop();
-void IRAM_ATTR onStepperTimer();
-void           drawTextWithSpacing(int x, int y, const char *text, int spacing);
-void IRAM_ATTR buttonISR();
-void           setupNTP();
-void           checkNewDay();
+void           feedLoop();
+void           scaleLoop();
+void           activityLoop();
+void           recordFeed(float grams, Fixed reserved);
+void           postNet(uint8_t type, uint8_t id, float value, int32_t counts = 0);
+void           postUi(uint8_t type, uint8_t value);
+void           logPrintf(const char *format, ...) __attribute__((format(printf, 1, 2)));
+void           handleNetEvent(const NetEvent &event);
+void           handleUiEvent(const UiEvent &event);
+void           handleMotionCommand(const MotionCommand &command);
+MotionCommand  motionCommand(uint8_t type);
+void           showBacklight(bool on);
+void           networkTask(void *arg);
+void           uiTask(void *arg);
+void           sensorTask(void *arg);
+void           motionTask(void *arg);
+void           buildGlyphAtlas();
+#ifdef TEXT_BENCHMARK
+void benchmarkTextRendering();
+#endif
+void IRAM_ATTR buttonISR(void *arg);
+void           onGesture(const Gesture &gesture, void *context);
+void           wakeDisplay();
+void           startNetwork();
+void           runSetupPortal();
+void           restoreLastValues();
+void           rememberAp();
+void           publishBootTimeline();
+void           renderPortal();
+void           onTimeSynced(struct timeval *tv);
+void           runSchedule();
+void           rearmSchedule(uint32_t now);
+void           scheduleJob(uint8_t job, uint32_t now);
+void           runJob(uint8_t job, uint32_t due, uint32_t now);
+void           resetDailyCounters();
+void           publishNextFeed();
+void           publishLedger();
+void           onFeedTimeCommand(HANumeric value, HANumber *sender);
+bool           sparkColumns(uint8_t slot, SparkColumn *out, uint16_t width, Fixed *low, Fixed *high);
 //
-volatile unsigned long lastButtonInterruptTime = 0;
-const unsigned long    BUTTON_DEBOUNCE_MS      = 200;
-
-void IRAM_ATTR         buttonISR() {
-    unsigned long currentTime = millis();
-    if((currentTime - lastButtonInterruptTime) > BUTTON_DEBOUNCE_MS) {
-        currentActivityState    = ACTIVITY_HIGH;
-        lastButtonInterruptTime = currentTime;
-        setBacklight(config.LCD_BACKLIGHT_VAL);
-    }
-}
-
-void IRAM_ATTR usageButton1ISR() {
-    unsigned long currentTime = millis();
-    if((currentTime - button1LastDebounce) < BUTTON_DEBOUNCE_TIME) return;
-    button1LastDebounce = currentTime;
-
-    int state           = digitalRead(BUTTON2_PIN);
-    if(state == HIGH) {
-        // RISING - button pressed
-        button1PressinTime = currentTime;
-        buttonISR();
-    } else {
-        // FALLING - button released
-        if((currentTime - button1PressinTime) >= BUTTON_LONGPRESS_TIME)
-            triggered1long = true;
-        else
-            triggered1short = true;
-    }
-}
-
-void IRAM_ATTR usageButton2ISR() {
-    unsigned long currentTime = millis();
-    if((currentTime - button2LastDebounce) < BUTTON_DEBOUNCE_TIME) return;
-    button2LastDebounce = currentTime;
-
-    int state           = digitalRead(BUTTON3_PIN);
-    if(state == HIGH) {
-        // RISING - button pressed
-        button2PressinTime = currentTime;
-        buttonISR();
-    } else {
-        // FALLING - button released
-        if((currentTime - button2PressinTime) >= BUTTON_LONGPRESS_TIME)
-            triggered2long = true;
-        else
-            triggered2short = true;
-    }
-}
-
-void serviceCheck() {
-    // Check WiFi connection
-    if(WiFi.status() != WL_CONNECTED) {
-        Serial.println("WiFi disconnected. Attempting to reconnect...");
-        WiFi.reconnect();
-        delay(500);
-    }
-
-    // Check MQTT connection
-    if(!mqtt.isConnected()) {
-        Serial.println("MQTT disconnected. Attempting to reconnect...");
-        mqtt.begin(config.mqtt_server, config.mqtt_user, config.mqtt_password);
-        delay(500);
-    }
-
-    mqtt.loop();
+// Only captures the edge; debouncing and gestures are the UI task's job.
+// All GPIO interrupts share one handler, so this is a single producer.
+void IRAM_ATTR buttonISR(void *arg) {
+    uint8_t button  = (uint8_t) (uintptr_t) arg;
+    uint8_t pressed = digitalRead(buttonPins[button].pin) == buttonPins[button].pressedLevel;
+    if(pressed == buttonLevels[button])
+        return; // both edges of a bounce landed before we ran
+    buttonLevels[button] = pressed;
+
+    ButtonEdge edge       = { button, pressed, (uint32_t) micros() };
+    buttonEdges.push(edge);
 }
 
 void setup() {
@@ -302,14 +702,13 @@ void setup() {
     pinMode(LCD_BACKLIGHT, OUTPUT);
     pinMode(EN_PIN, OUTPUT);
 
-    pinMode(BUTTON1_PIN, INPUT_PULLUP);
-    pinMode(BUTTON2_PIN, INPUT_PULLDOWN);
-    pinMode(BUTTON3_PIN, INPUT_PULLDOWN);
-    attachInterrupt(digitalPinToInterrupt(BUTTON1_PIN), buttonISR, RISING);
-
-    attachInterrupt(digitalPinToInterrupt(BUTTON2_PIN), usageButton1ISR, CHANGE);
-    attachInterrupt(digitalPinToInterrupt(BUTTON3_PIN), usageButton2ISR, CHANGE);
+    for(uint8_t button = 0; button < BUTTON_COUNT; button++) {
+        pinMode(buttonPins[button].pin, buttonPins[button].mode);
+        attachInterruptArg(digitalPinToInterrupt(buttonPins[button].pin), buttonISR, (void *) (uintptr_t) button, CHANGE);
+    }
 
+    // Local hardware first: the screen is up before the network is even
+    // started, WiFi, NTP and MQTT come up in the network task
     // Try mounting
     if(!LittleFS.begin()) {
         Serial.println("LittleFS mount failed, formatting...");
@@ -318,80 +717,65 @@ void setup() {
     } else {
         Serial.println("LittleFS mounted successfully.");
     }
-    config.loadFromFS();
-
-    // Setup stepper motor
-    digitalWrite(EN_PIN, HIGH); // Disable the stepper driver
-    stepper.setMaxSpeed(config.StepperSpeed * STEPPER_MICROSTEPS);
-    stepper.setAcceleration(config.StepperAccel * STEPPER_MICROSTEPS);
-
-    // Setup scale
-    Serial.println("Initializing scale...");
-    scale.begin(DOUT_PIN, SCK_PIN);
-    scale.set_scale(config.calibrationFactor); // Assuming default scale factor, adjust as needed
-    scale.tare();                              // Reset the scale to 0
-    Serial.println("Scale initialized.");
+    settingsStore.load();
+    historyLog.begin();
+    feedLedger.begin();
+
+    subscriptions.set(SLOT_CO, DATA_PRIMARY_TOPIC);
+    subscriptions.set(SLOT_CWU, DATA_SECONDARY_TOPIC);
+    subscriptions.set(SLOT_DATA3, DATA3_TOPIC);
+    subscriptions.set(SLOT_DATA4, DATA4_TOPIC);
+    if(!subscriptions.load())
+        subscriptions.save(); // first boot, persist the defaults
+    if(!screenLayout.load()) {
+        if(screenLayout.errorLine() > 0)
+            logPrintf("%s: error in line %u, using the built-in layout\n", LAYOUT_FILE, screenLayout.errorLine());
+        screenLayout.parse(defaultLayout);
+    }
+    sparkLock = xSemaphoreCreateMutex();
+    screenLayout.setSparkSource(sparkColumns, SPARK_SPAN_MS / LAYOUT_SPARK_WIDTH);
+    bootTimeline.mark(BOOT_STORAGE);
 
     // Initialize the display
     u8g2.begin();
     u8g2.setContrast(config.LCD_CONTRAST_VAL);
     u8g2.clearDisplay();
+    displayFlusher.begin();
+    buildGlyphAtlas();
 
     // Set initial backlight brightness
+    uiBrightness = config.LCD_BACKLIGHT_VAL;
     setBacklight(config.LCD_BACKLIGHT_VAL);
     setContrast(config.LCD_CONTRAST_VAL);
+    bootTimeline.mark(BOOT_DISPLAY);
 
-    // Display a welcome message
-    u8g2.clearBuffer();
-    u8g2.setFont(FONT_SMALL);
-    u8g2.drawStr(0, 10, "Welcome");
-    u8g2.drawStr(0, 20, "Starting WiFi AP...");
-    u8g2.sendBuffer();
-
-    // WiFiManager setup
-    wifiManager.setHostname(DEVICE_NAME);
-
-    mqtt_server_param   = new WiFiManagerParameter("server", "MQTT Server", config.mqtt_server, 40);
-    mqtt_port_param     = new WiFiManagerParameter("port", "MQTT Port", std::to_string(config.mqtt_port).c_str(), 6);
-    mqtt_user_param     = new WiFiManagerParameter("user", "MQTT User", config.mqtt_user, 32);
-    mqtt_password_param = new WiFiManagerParameter("password", "MQTT Password", config.mqtt_password, 32);
-
-    wifiManager.addParameter(mqtt_server_param);
-    wifiManager.addParameter(mqtt_port_param);
-    wifiManager.addParameter(mqtt_user_param);
-    wifiManager.addParameter(mqtt_password_param);
-
-    // Setup WiFi Manager
-    if(!wifiManager.autoConnect(DEVICE_NAME "-AP", "qqqqqqqq")) {
-        // If connection fails, reset and try again
-        u8g2.drawStr(0, 30, "Failed to connect");
-        u8g2.drawStr(0, 40, "to WiFi");
-        u8g2.drawStr(0, 50, "Rebooting...");
-        u8g2.sendBuffer();
-
-        delay(3000);
-        ESP.restart();
-        delay(1000);
-    }
-    // Connected to WiFi
-    u8g2.clearBuffer();
-    u8g2.drawStr(0, 10, "WiFi Connected!");
-    u8g2.drawStr(0, 20, "IP Address:");
-    u8g2.drawStr(0, 30, WiFi.localIP().toString().c_str());
-    u8g2.sendBuffer();
-
-    // Initialize NTP time sync
-    setupNTP();
+    // Setup stepper motor
+    digitalWrite(EN_PIN, HIGH); // Disable the stepper driver
+    motionSpeed = config.StepperSpeed * STEPPER_MICROSTEPS;
+    motionAccel = config.StepperAccel * STEPPER_MICROSTEPS;
+    stepEngine.configure(motionSpeed, motionAccel);
+    stepEngine.begin(0); // timer 0, stays stopped until a move starts
 
-    strncpy(config.mqtt_server, mqtt_server_param->getValue(), sizeof(config.mqtt_server));
-    config.mqtt_server[sizeof(config.mqtt_server) - 1] = '\0';
-    config.mqtt_port                                   = atoi(mqtt_port_param->getValue());
-    strncpy(config.mqtt_user, mqtt_user_param->getValue(), sizeof(config.mqtt_user));
-    config.mqtt_user[sizeof(config.mqtt_user) - 1] = '\0';
-    strncpy(config.mqtt_password, mqtt_password_param->getValue(), sizeof(config.mqtt_password));
-    config.mqtt_password[sizeof(config.mqtt_password) - 1] = '\0';
+    // Setup scale
+    Serial.println("Initializing scale...");
+    scale.begin(DOUT_PIN, SCK_PIN);
+    loadCell.configure(config.ScaleFilter);
+    loadCell.begin(config.tareOffset, config.calibrationFactor); // tares only if no offset was stored
+    Serial.println("Scale initialized.");
 
-    config.saveToFS();
+#if ALLOC_GUARD
+    // Everything but the network stack and the flash writers runs without the heap
+    allocGuardWatch("motion", true);
+    allocGuardWatch("sensor", true);
+    allocGuardWatch("ui", true);
+    allocGuardWatch("display", true);
+    allocGuardWatch("scale", true);
+    allocGuardWatch("network", false);
+#endif
+    xTaskCreate(motionTask, "motion", 3072, NULL, MOTION_TASK_PRIORITY, NULL);
+    xTaskCreate(sensorTask, "sensor", 3072, NULL, SENSOR_TASK_PRIORITY, NULL);
+    xTaskCreate(uiTask, "ui", 4096, NULL, UI_TASK_PRIORITY, NULL);
+    bootTimeline.mark(BOOT_TASKS);
 
     // Setup HA Device
     device.setName(DEVICE_NAME);
@@ -469,11 +853,56 @@ void setup() {
     feedNowButton.setIcon("mdi:food");
     feedNowButton.onCommand(onFeedNowCommand);
 
+    // Daily feed times, HHMM local time; -1 turns a schedule off
+    for(uint8_t i = 0; i < FEED_SCHEDULES; i++) {
+        static char names[FEED_SCHEDULES][12];
+        snprintf(names[i], sizeof(names[i]), "Feed Time %u", i + 1);
+        feedTimeNumbers[i]->setName(names[i]);
+        feedTimeNumbers[i]->setIcon("mdi:clock-outline");
+        feedTimeNumbers[i]->setMode(HANumber::ModeBox);
+        feedTimeNumbers[i]->setMin(-1.0f);
+        feedTimeNumbers[i]->setMax(2359.0f);
+        feedTimeNumbers[i]->setStep(1.0f);
+        feedTimeNumbers[i]->onCommand(onFeedTimeCommand);
+        feedTimeNumbers[i]->setOptimistic(true);
+    }
+    nextFeedSensor.setName("Next Feed");
+    nextFeedSensor.setIcon("mdi:clock-start");
+
+    // Feeding by weight
+    feedTarget.setName("Feed Target");
+    feedTarget.setIcon("mdi:bowl");
+    feedTarget.setMode(HANumber::ModeBox);
+    feedTarget.setMin(1.0f);
+    feedTarget.setMax(500.0f);
+    feedTarget.setStep(0.5f);
+    feedTarget.setUnitOfMeasurement("g");
+    feedTarget.onCommand(onFeedTargetCommand);
+    feedTarget.setOptimistic(true);
+
+    feedByWeight.setName("Feed By Weight");
+    feedByWeight.setIcon("mdi:scale-balance");
+    feedByWeight.onCommand(onFeedByWeightCommand);
+
+    lastFeedSensor.setName("Last Feed");
+    lastFeedSensor.setIcon("mdi:bowl-outline");
+    lastFeedSensor.setUnitOfMeasurement("g");
+
     // Grams Fed Today Sensor
     gramsFedTodaySensor.setName("Grams Fed Today");
     gramsFedTodaySensor.setIcon("mdi:counter");
     gramsFedTodaySensor.setUnitOfMeasurement("g");
 
+    // Feed ledger, the daily quota applies to the last 24 hours
+    gramsFed24hSensor.setName("Grams Fed 24h");
+    gramsFed24hSensor.setIcon("mdi:history");
+    gramsFed24hSensor.setUnitOfMeasurement("g");
+    quotaLeftSensor.setName("Feed Quota Left");
+    quotaLeftSensor.setIcon("mdi:gauge");
+    quotaLeftSensor.setUnitOfMeasurement("g");
+    feedsRefusedSensor.setName("Feeds Refused");
+    feedsRefusedSensor.setIcon("mdi:food-off");
+
     // CO Delta Sensor
     COdelta.setName("CO Delta");
     COdelta.setIcon("mdi:chart-line");
@@ -484,11 +913,77 @@ void setup() {
     CWUdelta.setIcon("mdi:chart-line");
     CWUdelta.setUnitOfMeasurement("°C");
 
+    // Trend window statistics
+    COaverage.setName("CO Average");
+    COaverage.setIcon("mdi:thermometer");
+    COaverage.setUnitOfMeasurement("°C");
+    COmin.setName("CO Min");
+    COmin.setIcon("mdi:thermometer-chevron-down");
+    COmin.setUnitOfMeasurement("°C");
+    COmax.setName("CO Max");
+    COmax.setIcon("mdi:thermometer-chevron-up");
+    COmax.setUnitOfMeasurement("°C");
+
+    CWUaverage.setName("CWU Average");
+    CWUaverage.setIcon("mdi:thermometer");
+    CWUaverage.setUnitOfMeasurement("°C");
+    CWUmin.setName("CWU Min");
+    CWUmin.setIcon("mdi:thermometer-chevron-down");
+    CWUmin.setUnitOfMeasurement("°C");
+    CWUmax.setName("CWU Max");
+    CWUmax.setIcon("mdi:thermometer-chevron-up");
+    CWUmax.setUnitOfMeasurement("°C");
+
     // Scale Sensor
     ScaleSensor.setName("Scale Weight");
     ScaleSensor.setIcon("mdi:weight-kilogram");
     ScaleSensor.setUnitOfMeasurement("g");
 
+    // Display pipeline counters
+    framesRenderedSensor.setName("Display Frames Rendered");
+    framesRenderedSensor.setIcon("mdi:monitor-dashboard");
+    framesSkippedSensor.setName("Display Frames Skipped");
+    framesSkippedSensor.setIcon("mdi:monitor-off");
+    bytesSentSensor.setName("Display Bytes Sent");
+    bytesSentSensor.setIcon("mdi:swap-horizontal");
+    bytesSentSensor.setUnitOfMeasurement("B");
+    settingsWritesSensor.setName("Settings Flash Writes");
+    settingsWritesSensor.setIcon("mdi:content-save");
+    publishesSentSensor.setName("HA Publishes Sent");
+    publishesSentSensor.setIcon("mdi:upload-network");
+    publishesSavedSensor.setName("HA Publishes Suppressed");
+    publishesSavedSensor.setIcon("mdi:upload-off");
+    taskStatsSensor.setName("Task Stats");
+    taskStatsSensor.setIcon("mdi:timer-outline");
+    buttonDropsSensor.setName("Button Events Dropped");
+    buttonDropsSensor.setIcon("mdi:gesture-tap-button");
+    buttonLatencySensor.setName("Button Latency Max");
+    buttonLatencySensor.setIcon("mdi:timer-sand");
+    buttonLatencySensor.setUnitOfMeasurement("us");
+    wifiRssiSensor.setName("WiFi RSSI");
+    wifiRssiSensor.setIcon("mdi:wifi");
+    wifiRssiSensor.setUnitOfMeasurement("dBm");
+    linkDropsSensor.setName("Link Drops");
+    linkDropsSensor.setIcon("mdi:wifi-off");
+    linkDowntimeSensor.setName("Link Downtime");
+    linkDowntimeSensor.setIcon("mdi:timer-off-outline");
+    linkDowntimeSensor.setUnitOfMeasurement("s");
+    bootPhasesSensor.setName("Boot Phases");
+    bootPhasesSensor.setIcon("mdi:timer-play-outline");
+    loopRateSensor.setName("Loop Rate");
+    loopRateSensor.setIcon("mdi:sync");
+    loopRateSensor.setUnitOfMeasurement("Hz");
+    freeHeapSensor.setName("Free Heap");
+    freeHeapSensor.setIcon("mdi:memory");
+    freeHeapSensor.setUnitOfMeasurement("B");
+#if PROFILE_STAGES
+    stageTimingsSensor.setName("Stage Timings");
+    stageTimingsSensor.setIcon("mdi:chart-histogram");
+#endif
+
+    for(const GovernedBinding &binding : governedBindings)
+        publishGovernor.add(binding.handle, binding.publish, binding.entity, binding.policy);
+
     // Calibration Factor
     calibrationFactor.setName("Calibration Factor");
     calibrationFactor.setIcon("mdi:tune");
@@ -496,109 +991,495 @@ void setup() {
     calibrationFactor.setMin(100.0f);
     calibrationFactor.setMax(10000.0f);
     calibrationFactor.setStep(1.0f);
+    calibrationFactor.onCommand(onCalibrationFactorCommand);
+    calibrationFactor.setOptimistic(true);
+
+    // Known-mass calibration: put the mass on the scale, then press calibrate
+    calibrationMass.setName("Calibration Mass");
+    calibrationMass.setIcon("mdi:weight-gram");
+    calibrationMass.setMode(HANumber::ModeBox);
+    calibrationMass.setMin(1.0f);
+    calibrationMass.setMax(5000.0f);
+    calibrationMass.setStep(0.1f);
+    calibrationMass.onCommand(onCalibrationMassCommand);
+    calibrationMass.setOptimistic(true);
+
+    // Scale filter tuning, one handler for all of them
+    scaleMedianWindow.setName("Scale Median Window");
+    scaleMedianWindow.setIcon("mdi:filter-outline");
+    scaleMedianWindow.setMode(HANumber::ModeBox);
+    scaleMedianWindow.setMin(1.0f);
+    scaleMedianWindow.setMax(LOADCELL_MEDIAN_MAX);
+    scaleMedianWindow.setStep(2.0f);
+    scaleProcessNoise.setName("Scale Process Noise");
+    scaleProcessNoise.setIcon("mdi:chart-bell-curve");
+    scaleProcessNoise.setMode(HANumber::ModeBox);
+    scaleProcessNoise.setMin(0.001f);
+    scaleProcessNoise.setMax(10.0f);
+    scaleProcessNoise.setStep(0.001f);
+    scaleMeasurementNoise.setName("Scale Measurement Noise");
+    scaleMeasurementNoise.setIcon("mdi:chart-bell-curve-cumulative");
+    scaleMeasurementNoise.setMode(HANumber::ModeBox);
+    scaleMeasurementNoise.setMin(0.01f);
+    scaleMeasurementNoise.setMax(100.0f);
+    scaleMeasurementNoise.setStep(0.01f);
+    scaleSettleBand.setName("Scale Settle Band");
+    scaleSettleBand.setIcon("mdi:arrow-collapse-vertical");
+    scaleSettleBand.setUnitOfMeasurement("g");
+    scaleSettleBand.setMode(HANumber::ModeBox);
+    scaleSettleBand.setMin(0.1f);
+    scaleSettleBand.setMax(50.0f);
+    scaleSettleBand.setStep(0.1f);
+    scaleDeadband.setName("Scale Deadband");
+    scaleDeadband.setIcon("mdi:arrow-expand-vertical");
+    scaleDeadband.setUnitOfMeasurement("g");
+    scaleDeadband.setMode(HANumber::ModeBox);
+    scaleDeadband.setMin(0.0f);
+    scaleDeadband.setMax(50.0f);
+    scaleDeadband.setStep(0.1f);
+    for(HANumber *number : { &scaleMedianWindow, &scaleProcessNoise, &scaleMeasurementNoise, &scaleSettleBand, &scaleDeadband }) {
+        number->onCommand(onScaleFilterCommand);
+        number->setOptimistic(true);
+    }
+
+    tareButton.setName("Scale Tare");
+    tareButton.setIcon("mdi:scale-balance");
+    tareButton.onCommand(onTareCommand);
+
+    calibrateButton.setName("Scale Calibrate");
+    calibrateButton.setIcon("mdi:tune-vertical");
+    calibrateButton.onCommand(onCalibrateCommand);
 
     mqtt.onMessage(onMqttMessage);
+    mqtt.onConnected(onMqttConnected); // (re)subscribes after every connect
+
+    // Stored states go out with the discovery on the first connect
+    publishGovernor.update(PUB_BACKLIGHT, config.LCD_BACKLIGHT_VAL > 0, millis());
+    publishGovernor.update(PUB_GRAMS_FED, fixedToFloat(feedLedger.dayTotal()), millis());
+    backlight.setCurrentBrightness(config.LCD_BACKLIGHT_VAL);
+
+    contrast.setCurrentState(static_cast<float>(config.LCD_CONTRAST_VAL));
+
+    stepperSpeed.setCurrentState(static_cast<float>(config.StepperSpeed));
+    stepperAccel.setCurrentState(static_cast<float>(config.StepperAccel));
+    rotationsPerFeeding.setCurrentState(config.RotationsPerFeeding);
+    gramsPerFeeding.setCurrentState(config.GramsPerRotation);
+    maxGramsPerDay.setCurrentState(config.MaxGramsPerDay);
+    feedTarget.setCurrentState(config.FeedTargetGrams);
+    feedByWeight.setCurrentState(config.FeedByWeight != 0);
+    calibrationFactor.setCurrentState(static_cast<float>(config.calibrationFactor));
+    calibrationMass.setCurrentState(config.CalibrationMass);
+    scaleMedianWindow.setCurrentState(static_cast<float>(config.ScaleFilter.medianWindow));
+    scaleProcessNoise.setCurrentState(config.ScaleFilter.processNoise);
+    scaleMeasurementNoise.setCurrentState(config.ScaleFilter.measurementNoise);
+    scaleSettleBand.setCurrentState(config.ScaleFilter.settleBand);
+    scaleDeadband.setCurrentState(config.ScaleFilter.deadband);
+    for(uint8_t i = 0; i < FEED_SCHEDULES; i++)
+        feedTimeNumbers[i]->setCurrentState(static_cast<float>(config.FeedTimes[i]));
+
+    xTaskCreate(networkTask, "network", 8192, NULL, NETWORK_TASK_PRIORITY, NULL);
+}
+
+// Runs in the network task, so a slow join or an open portal never holds
+// up the screen or the sensors
+void startNetwork() {
+    WiFi.mode(WIFI_STA);
+    if(!linkDriver.loadCredentials())
+        runSetupPortal(); // first boot only
+
+    // enable light sleep
+    WiFi.setSleep(true);                // This is light sleep, not deep sleep
+    esp_wifi_set_ps(WIFI_PS_MIN_MODEM); // Minimal power saving
+
+    sntp_set_time_sync_notification_cb(onTimeSynced);
+    configTime(GMT_OFFSET_SEC, DAYLIGHT_OFFSET_SEC, NTP_SERVER); // syncs in the background
+
+    // From here on reconnecting never blocks anything but the network task
+    connection.seedAp(config.WifiBssid, config.WifiChannel);
+    linkDriver.begin();
+    connection.begin(millis(), esp_random());
     mqtt.begin(config.mqtt_server, config.mqtt_user, config.mqtt_password);
-    mqtt.loop();
+}
 
-    mqtt.subscribe(DATA_PRIMARY_TOPIC);
-    mqtt.subscribe(DATA_SECONDARY_TOPIC);
-    mqtt.subscribe(DATA3_TOPIC);
-    mqtt.subscribe(DATA4_TOPIC);
+// Blocks until the user has entered the WiFi and MQTT settings
+void runSetupPortal() {
+    postUi(UI_PORTAL, PORTAL_OPEN);
 
-    // send states
-    backlight.setState(config.LCD_BACKLIGHT_VAL > 0);
-    backlight.setBrightness(config.LCD_BACKLIGHT_VAL);
+    // WiFiManager setup
+    wifiManager.setHostname(DEVICE_NAME);
 
-    contrast.setState(static_cast<float>(config.LCD_CONTRAST_VAL));
+    mqtt_server_param   = new WiFiManagerParameter("server", "MQTT Server", config.mqtt_server, 40);
+    char port[8];
+    snprintf(port, sizeof(port), "%d", config.mqtt_port);
+    mqtt_port_param     = new WiFiManagerParameter("port", "MQTT Port", port, 6);
+    mqtt_user_param     = new WiFiManagerParameter("user", "MQTT User", config.mqtt_user, 32);
+    mqtt_password_param = new WiFiManagerParameter("password", "MQTT Password", config.mqtt_password, 32);
 
-    stepperSpeed.setState(static_cast<float>(config.StepperSpeed));
-    stepperAccel.setState(static_cast<float>(config.StepperAccel));
-    rotationsPerFeeding.setState(config.RotationsPerFeeding);
-    gramsPerFeeding.setState(config.GramsPerRotation);
-    maxGramsPerDay.setState(config.MaxGramsPerDay);
+    wifiManager.addParameter(mqtt_server_param);
+    wifiManager.addParameter(mqtt_port_param);
+    wifiManager.addParameter(mqtt_user_param);
+    wifiManager.addParameter(mqtt_password_param);
 
-    mqtt.loop();
+    if(!wifiManager.autoConnect(DEVICE_NAME "-AP", "qqqqqqqq")) {
+        // If connection fails, reset and try again
+        postUi(UI_PORTAL, PORTAL_FAILED);
+        delay(3000);
+        ESP.restart();
+        delay(1000);
+    }
+    postUi(UI_PORTAL, PORTAL_CLOSED);
 
-    // enable light sleep
-    WiFi.setSleep(true);                // This is light sleep, not deep sleep
-    esp_wifi_set_ps(WIFI_PS_MIN_MODEM); // Minimal power saving
+    strncpy(config.mqtt_server, mqtt_server_param->getValue(), sizeof(config.mqtt_server));
+    config.mqtt_server[sizeof(config.mqtt_server) - 1] = '\0';
+    config.mqtt_port                                   = atoi(mqtt_port_param->getValue());
+    strncpy(config.mqtt_user, mqtt_user_param->getValue(), sizeof(config.mqtt_user));
+    config.mqtt_user[sizeof(config.mqtt_user) - 1] = '\0';
+    strncpy(config.mqtt_password, mqtt_password_param->getValue(), sizeof(config.mqtt_password));
+    config.mqtt_password[sizeof(config.mqtt_password) - 1] = '\0';
+
+    settingsStore.requestSave();
+}
+
+// Shows the last logged value of every data slot until fresh MQTT data
+// arrives, instead of zeros for the first minutes after a reboot
+void restoreLastValues() {
+    static const uint8_t slots[] = { SLOT_CO, SLOT_CWU, SLOT_DATA3, SLOT_DATA4 };
+    HistoryRecord        newest[sizeof(slots)];
+
+    historyLog.latest(slots, sizeof(slots), newest); // one pass for all of them
+    for(uint8_t i = 0; i < sizeof(slots); i++)
+        if(newest[i].count > 0 && values.version(slots[i]) == 0)
+            values.write(slots[i], fixedFromFloat(newest[i].mean), 0); // updatedAt 0: not live data
+    bootTimeline.mark(BOOT_RESTORED);
+}
+
+// Keeps the AP of the latest join, the next boot goes straight to it
+void rememberAp() {
+    uint8_t bssid[6];
+    int32_t channel;
+    if(!connection.cachedAp(bssid, &channel))
+        return;
+    if(channel == config.WifiChannel && memcmp(bssid, config.WifiBssid, sizeof(bssid)) == 0)
+        return;
+    memcpy(config.WifiBssid, bssid, sizeof(bssid));
+    config.WifiChannel = (uint8_t) channel;
+    settingsStore.requestSave();
+}
+
+void postNet(uint8_t type, uint8_t id, float value, int32_t counts) {
+    NetEvent event = { type, id, value, counts, (uint32_t) micros() };
+    if(!outbox.push(event))
+        Serial.println("Network outbox full, event dropped.");
+}
+
+// Serial.printf() falls back to malloc() for lines longer than 64 bytes
+void logPrintf(const char *format, ...) {
+    char    line[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if(length > 0)
+        Serial.write((const uint8_t *) line, length < (int) sizeof(line) ? length : sizeof(line) - 1);
+}
 
-    // Setup hardware timer for stepper (timer 0, 80 divider = 1MHz, count up)
-    stepperTimer = timerBegin(0, 80, true);                    // Timer 0, prescaler 80 (1MHz), count up
-    timerAttachInterrupt(stepperTimer, &onStepperTimer, true); // Edge triggered
-    timerAlarmWrite(stepperTimer, 50, true);                   // 50us interval = 20kHz, auto-reload
-    timerAlarmEnable(stepperTimer);                            // Start the timer
+void postUi(uint8_t type, uint8_t value) {
+    UiEvent event = { type, value, (uint32_t) micros() };
+    uiEvents.push(event);
 }
 
-void IRAM_ATTR onStepperTimer() {
-    portENTER_CRITICAL_ISR(&stepperMux);
-    if(stepper.isRunning())
-        stepper.run();
-    portEXIT_CRITICAL_ISR(&stepperMux);
+void motionTask(void *arg) {
+    motionMonitor.begin(MOTION_PERIOD_MS);
+    for(;;) {
+        MotionCommand command;
+        while(motionCommands.pop(&command)) {
+            motionMonitor.noteLatency(micros() - command.postedAt);
+            handleMotionCommand(command);
+        }
+        feedLoop();    // Drive a feed by weight
+        stepperLoop(); // Check if stepper finished
+        motionMonitor.wait();
+    }
+}
+
+void sensorTask(void *arg) {
+    sensorMonitor.begin(SENSOR_PERIOD_MS);
+    for(;;) {
+        SensorCommand command;
+        while(sensorCommands.pop(&command)) {
+            sensorMonitor.noteLatency(micros() - command.postedAt);
+            if(command.type == SENSOR_TARE)
+                loadCell.requestTare(); // applied on the next settled reading
+            else if(command.type == SENSOR_CALIBRATE)
+                loadCell.requestCalibration(command.value);
+            else if(command.type == SENSOR_CONFIGURE)
+                loadCell.configure(config.ScaleFilter); // restarts the filter
+            else
+                loadCell.setFactor(command.value);
+        }
+        scaleLoop(); // Read weight from scale
+        sensorMonitor.wait();
+    }
+}
+
+void uiTask(void *arg) {
+    lastActivity = millis();
+    uiMonitor.begin(UI_PERIOD_MS);
+    for(;;) {
+        UiEvent event;
+        while(uiEvents.pop(&event)) {
+            uiMonitor.noteLatency(micros() - event.postedAt);
+            handleUiEvent(event);
+        }
+        ButtonEdge edge;
+        while(buttonEdges.pop(&edge))
+            gestures.feed(edge, micros(), onGesture, NULL);
+        gestures.poll(micros(), onGesture, NULL);
+        activityLoop();
+        render();
+        uiMonitor.wait();
+    }
+}
+
+void networkTask(void *arg) {
+    startNetwork();
+    connection.loop(millis()); // starts the join, the history is read meanwhile
+    restoreLastValues();
+
+    networkMonitor.begin(NETWORK_PERIOD_MS);
+    for(;;) {
+        NetEvent event;
+        while(outbox.pop(&event)) {
+            networkMonitor.noteLatency(micros() - event.postedAt);
+            handleNetEvent(event);
+        }
+        LinkEvent linkEvent = connection.loop(millis());
+        if(connection.stats.wifiConnects > 0)
+            bootTimeline.mark(BOOT_WIFI);
+        if(linkEvent == LINK_EVENT_UP) {
+            stateOutbox.setOnline(true);
+            stateOutbox.replay(); // what changed while offline
+            rememberAp();
+            Serial.println("MQTT connected.");
+            if(!bootTimeline.isMarked(BOOT_MQTT)) {
+                bootTimeline.mark(BOOT_MQTT);
+                publishBootTimeline();
+#if ALLOC_GUARD
+                allocGuardArm(); // discovery is out, the rest is steady state
+#endif
+            }
+        } else if(linkEvent == LINK_EVENT_DOWN) {
+            stateOutbox.setOnline(false);
+            Serial.println("Connection lost, retrying in the background.");
+        }
+        if(connection.isUp()) {
+            PROFILE_SCOPE(STAGE_MQTT_LOOP);
+            mqtt.loop();
+            if(stateOutbox.pending() > 0)
+                stateOutbox.replay(); // publishes that failed while online
+        }
+        publishDiagnostics();
+        publishGovernor.loop(millis()); // coalesced values and heartbeats
+        settingsStore.loop();   // write coalesced setting changes
+        runSchedule();          // feeds, midnight reset and maintenance when due
+        networkMonitor.wait();
+    }
+}
+
+void loop() {
+    vTaskDelete(NULL); // everything runs in the tasks setup() started
+}
+
+void handleNetEvent(const NetEvent &event) {
+    switch(event.type) {
+        case NET_PUBLISH:
+            publishGovernor.update(event.id, event.value, millis());
+            break;
+
+        case NET_TRIGGER:
+            buttonTriggers[event.id].trigger->trigger();
+            logPrintf("%s detected\n", buttonTriggers[event.id].name);
+            break;
+
+        case NET_BRIGHTNESS:
+            config.LCD_BACKLIGHT_VAL = event.value;
+            settingsStore.requestSave();
+            stateOutbox.send(sendLightBrightness, &backlight, config.LCD_BACKLIGHT_VAL);
+            break;
+
+        case NET_TARED:
+            config.tareOffset = event.counts;
+            settingsStore.requestSave();
+            Serial.println("Scale tared.");
+            break;
+
+        case NET_CALIBRATED:
+            config.calibrationFactor = event.counts;
+            settingsStore.requestSave();
+            stateOutbox.send(sendNumberState, &calibrationFactor, config.calibrationFactor);
+            Serial.println("Scale calibrated.");
+            break;
+
+        case NET_CALIBRATE_FAILED:
+            Serial.println("Scale calibration failed, no load detected.");
+            break;
+
+        case NET_FEED_DONE:
+            recordFeed(event.value, event.counts);
+            break;
+
+        case NET_FEED_REJECTED:
+            feedReserved -= event.counts;
+            publishLedger();
+            break;
+
+        case NET_GRAMS_PER_ROTATION:
+            config.GramsPerRotation = event.value;
+            settingsStore.requestSave();
+            stateOutbox.send(sendNumberState, &gramsPerFeeding, config.GramsPerRotation);
+            break;
+
+        default:
+            break;
+    }
+}
+
+void handleMotionCommand(const MotionCommand &command) {
+    motionSpeed = command.speed;
+    motionAccel = command.accel;
+    if(command.type == MOTION_CONFIGURE) {
+        if(!dispenser.isActive())
+            stepEngine.configure(motionSpeed, motionAccel); // a feed by weight sets its own speed per move
+        return;
+    }
+
+    if(stepEngine.isRunning() || dispenser.isActive()) {
+        Serial.println("Feeder still running, request ignored.");
+        postNet(NET_FEED_REJECTED, 0, 0.0f, command.reserved);
+        return;
+    }
+    feeding = true;
+    postUi(UI_FEEDING, 1);
+
+    if(command.type == MOTION_FEED_GRAMS) {
+        logPrintf("Feeding %.1f g by weight...\n", command.grams);
+        feedReservation = command.reserved;
+        dispenser.start(command.grams, command.gramsPerRotation, STEPS_PER_REV, millis());
+        return;
+    }
+
+    Serial.println("Feeding now...");
+    digitalWrite(EN_PIN, LOW); // Enable the stepper driver
+    stepEngine.move(command.steps);
+    postNet(NET_FEED_DONE, 0, command.grams, command.reserved); // open loop, all we have is the estimate
 }
 
 void stepperLoop() {
     // Check if stepper finished and disable driver
-    if(!stepper.isRunning())
+    if(!stepEngine.isRunning()) {
         digitalWrite(EN_PIN, HIGH); // Disable the stepper driver
+        if(feeding && !dispenser.isActive()) {
+            feeding = false;
+            postUi(UI_FEEDING, 0); // backlight timeout runs again
+        }
+    }
 }
 
 void scaleLoop() {
-    // Read weight from scale
-    if(scale.is_ready()) {
-        float weight = scale.get_units(10); // Average over 10 readings
-        ScaleSensor.setValue(weight);
+    PROFILE_SCOPE(STAGE_SCALE);
+    uint32_t samples = loadCell.stats.samples;
+    uint8_t  events  = loadCell.update();
+
+    if(events & LOADCELL_TARED)
+        postNet(NET_TARED, 0, 0.0f, loadCell.offset());
+    if(events & LOADCELL_CALIBRATED)
+        postNet(NET_CALIBRATED, 0, 0.0f, lroundf(loadCell.factor()));
+    if(events & LOADCELL_CALIBRATE_FAILED)
+        postNet(NET_CALIBRATE_FAILED, 0, 0.0f);
+
+    if(events & LOADCELL_CHANGED)
+        postNet(NET_PUBLISH, PUB_SCALE, loadCell.weight());
+
+    // The dispenser brakes on this, so it follows every sample
+    if(loadCell.stats.samples != samples) {
+        values.write(SLOT_SCALE, fixedFromFloat(loadCell.weight()), millis());
+        values.write(SLOT_SCALE_STABLE, loadCell.isSettled() ? FIXED_ONE : 0, millis());
+    }
+
+    if(loadCell.isSettled() && millis() - lastScaleHistory >= HISTORY_SCALE_TIME) {
+        lastScaleHistory = millis();
+        historyLog.append(HISTORY_SERIES_SCALE, loadCell.weight());
     }
 }
 
-void loop() {
-    if(triggered1long) {
-        trigger1long.trigger();
-        triggered1long = false;
-        Serial.println("Long press 1 detected");
-    }
-    if(triggered1short) {
-        trigger1short.trigger();
-        triggered1short = false;
-        Serial.println("Short press 1 detected");
-    }
-    if(triggered2long) {
-        trigger2long.trigger();
-        triggered2long = false;
-        Serial.println("Long press 2 detected");
-    }
-    if(triggered2short) {
-        trigger2short.trigger();
-        triggered2short = false;
-        Serial.println("Short press 2 detected");
-    }
-
-    render();
-    mqtt.loop();
-    serviceCheck();
-    stepperLoop(); // Check if stepper finished
-    checkNewDay(); // Check if a new day has started
-    scaleLoop();   // Read weight from scale
-
-    long currentTime = millis();
-
-    switch(currentActivityState) {
-        case ACTIVITY_HIGH:
-            if((currentTime - lastButtonInterruptTime) > BACKLIGHT_TIME && currentActivityState != ACTIVITY_STEPPER) {
+void onGesture(const Gesture &gesture, void *context) {
+    if(gesture.type == GESTURE_PRESS) {
+        wakeDisplay(); // any button
+        return;
+    }
+
+    if(gesture.button == BUTTON_WAKE) {
+        if(gesture.type == GESTURE_DOUBLE) {
+            if(currentActivityState != ACTIVITY_STEPPER)
                 currentActivityState = ACTIVITY_LOW;
-                // Turn off backlight
-                setBacklight(0);
-                backlight.setState(false);
-            } else {
-                backlight.setState(true);
-            }
+            showBacklight(false); // off until the next press
+        } else if(gesture.type == GESTURE_REPEAT) {
+            uiBrightness = uiBrightness > 255 - BRIGHTNESS_STEP ? BRIGHTNESS_STEP : uiBrightness + BRIGHTNESS_STEP;
+            showBacklight(true);
+            postNet(NET_BRIGHTNESS, 0, uiBrightness);
+        }
+        return;
+    }
+
+    // The usage buttons flip through the layout pages and still reach HA
+    uint8_t pages = screenLayout.pageCount();
+    if(gesture.type == GESTURE_SHORT && pages > 1) {
+        if(gesture.button == BUTTON_USAGE1)
+            screenLayout.showPage((screenLayout.page() + 1) % pages);
+        else if(gesture.button == BUTTON_USAGE2)
+            screenLayout.showPage((screenLayout.page() + pages - 1) % pages);
+    }
+
+    for(uint8_t i = 0; i < sizeof(buttonTriggers) / sizeof(buttonTriggers[0]); i++)
+        if(buttonTriggers[i].button == gesture.button && buttonTriggers[i].gesture == gesture.type)
+            postNet(NET_TRIGGER, i, 0.0f);
+}
+
+void wakeDisplay() {
+    if(currentActivityState != ACTIVITY_STEPPER)
+        currentActivityState = ACTIVITY_HIGH;
+    lastActivity = millis();
+    showBacklight(true);
+}
+
+void handleUiEvent(const UiEvent &event) {
+    switch(event.type) {
+        case UI_BRIGHTNESS:
+            uiBrightness = event.value;
+            wakeDisplay();
+            break;
+
+        case UI_BACKLIGHT:
             if(currentActivityState != ACTIVITY_STEPPER)
-                delay(10);
+                currentActivityState = event.value ? ACTIVITY_HIGH : ACTIVITY_LOW;
+            lastActivity = millis();
+            showBacklight(event.value != 0);
             break;
 
-        case ACTIVITY_LOW:
-            delay(10);
+        case UI_CONTRAST:
+            setContrast(event.value);
+            lastActivity = millis();
+            break;
+
+        case UI_FEEDING:
+            currentActivityState = event.value ? ACTIVITY_STEPPER : ACTIVITY_HIGH;
+            break;
+
+        case UI_PORTAL:
+            portalShown = event.value;
+            portalDrawn = false;
+            screenLayout.invalidate(); // redrawn from scratch after the portal
+            wakeDisplay();
             break;
 
         default:
@@ -606,134 +1487,322 @@ void loop() {
     }
 }
 
-int getTextWidth(const char *text, int charWidth, int spacing) {
-    int width = 0;
-    while(*text) {
-        width += charWidth + spacing;
-        text++;
+void activityLoop() {
+    if(currentActivityState == ACTIVITY_HIGH && millis() - lastActivity > BACKLIGHT_TIME) {
+        currentActivityState = ACTIVITY_LOW;
+        showBacklight(false); // Turn off backlight
     }
-    return width;
 }
-void drawTextWithSpacing(int x, int y, const char *text, int spacing) {
-    u8g2.setCursor(x, y);
 
-    while(*text) {
-        char c[2] = { *text++, '\0' };
-        u8g2.print(c);
-        u8g2.setCursor(u8g2.getCursorX() + spacing, y);
+void showBacklight(bool on) {
+    setBacklight(on ? uiBrightness : 0);
+    if(on != backlightShown) {
+        backlightShown = on;
+        postNet(NET_PUBLISH, PUB_BACKLIGHT, on ? 1.0f : 0.0f);
     }
 }
-void drawFloat(int x, int y, float value, int decimalPlaces, int spacing, const uint8_t *fontPrimary = FONT_PRIMARY_DATA, const uint8_t *fontSecondary = FONT_SMALL) {
-    char buf[16];
-    snprintf(buf, sizeof(buf), "%.*f", decimalPlaces, value);
-    char *dot = strchr(buf, '.');
-    if(dot) *dot = '\0'; // terminate integer part
-    // Draw integer part (big font)
-    u8g2.setFont(fontPrimary);
-    drawTextWithSpacing(x, y, buf, spacing);
 
-    x = u8g2.getCursorX();
-    if(dot) {
-        u8g2.setFont(fontSecondary);
-        drawTextWithSpacing(x, y, ".", 0);
-        x = u8g2.getCursorX();
-        drawTextWithSpacing(x, y, dot + 1, spacing); // decimal digits only
-    }
+void buildGlyphAtlas() {
+    glyphsPrimary.build(u8g2, FONT_PRIMARY_DATA);
+    glyphsSmall.build(u8g2, FONT_SMALL);
+    glyphsTiny.build(u8g2, FONT_TINY);
+#ifdef TEXT_BENCHMARK
+    benchmarkTextRendering();
+#endif
 }
-void drawArrow(int x, int y, int size, bool up) {
-    if(up) {
-        u8g2.drawLine(x, y + size, x + size / 2, y);
-        u8g2.drawLine(x + size / 2, y, x + size, y + size);
-    } else {
-        u8g2.drawLine(x, y, x + size / 2, y + size);
-        u8g2.drawLine(x + size / 2, y + size, x + size, y);
+#ifdef TEXT_BENCHMARK
+// Draws a value scaled by 10^decimals: integer part in the primary font,
+// point and decimals in the secondary one
+void drawFixed(int x, int y, int32_t value, uint8_t decimals, int spacing, const GlyphFont &primary = glyphsPrimary, const GlyphFont &secondary = glyphsSmall) {
+    char intPart[12];
+    char fracPart[8];
+    formatFixed(value, decimals, intPart, fracPart);
+
+    x = primary.draw(u8g2, x, y, intPart, spacing);
+    if(decimals > 0) {
+        x = secondary.draw(u8g2, x, y, ".", 0);
+        secondary.draw(u8g2, x, y, fracPart, spacing); // decimal digits only
     }
 }
-void drawETCTemp(int x, int y, int width, int height, std::string label, float temp, int labelXOffset = 0) {
-    u8g2.drawFrame(x, y, width, height);
 
-    u8g2.setFont(FONT_SMALL);
-    int xOff = 2 + labelXOffset;
-    int yOff = height - 4;
-    drawTextWithSpacing(x + xOff, y + yOff, label.c_str(), 0);
+// Per-frame cost of the six values render() draws: old snprintf + print()
+// path against the glyph atlas, then of a full layout redraw with and
+// without the chrome layer. Build with -DTEXT_BENCHMARK.
+void benchmarkTextRendering() {
+    const int   frames    = 200;
+    const float values[6] = { 45.3f, 52.1f, 21.4f, -3.7f, 0.2f, -0.1f };
+
+    unsigned long start   = micros();
+    for(int frame = 0; frame < frames; frame++) {
+        for(int i = 0; i < 6; i++) {
+            char buf[16];
+            snprintf(buf, sizeof(buf), "%.*f", 1, values[i]);
+            char *dot = strchr(buf, '.');
+            if(dot) *dot = '\0';
+            u8g2.setFont(FONT_PRIMARY_DATA);
+            u8g2.setCursor(0, 40);
+            for(const char *c = buf; *c; c++) {
+                char glyph[2] = { *c, '\0' };
+                u8g2.print(glyph);
+                u8g2.setCursor(u8g2.getCursorX() - 2, 40);
+            }
+            u8g2.setFont(FONT_SMALL);
+            u8g2.print(".");
+            u8g2.print(dot + 1);
+        }
+    }
+    unsigned long legacy = micros() - start;
+
+    start                = micros();
+    for(int frame = 0; frame < frames; frame++)
+        for(int i = 0; i < 6; i++)
+            drawFixed(0, 40, lroundf(values[i] * 10.0f), 1, -2);
+    unsigned long atlas = micros() - start;
+
+    logPrintf("Text benchmark: legacy %lu us/frame, atlas %lu us/frame\n", legacy / frames, atlas / frames);
+
+    // Full redraws of the layout: everything rasterized against the
+    // values drawn over the copied chrome layer
+    start = micros();
+    for(int frame = 0; frame < frames; frame++) {
+        screenLayout.invalidateChrome();
+        screenLayout.draw(u8g2, layoutFonts, screenLayout.update(::values));
+    }
+    unsigned long raster = micros() - start;
+
+    start                = micros();
+    for(int frame = 0; frame < frames; frame++) {
+        screenLayout.invalidate();
+        screenLayout.draw(u8g2, layoutFonts, screenLayout.update(::values));
+    }
+    unsigned long composed = micros() - start;
 
-    drawFloat(x + width - 30, y + yOff, temp, 1, -1, FONT_SMALL, FONT_SMALL);
+    logPrintf("Layout benchmark: rasterized %lu us/frame, composed %lu us/frame\n", raster / frames, composed / frames);
+    screenLayout.invalidate();
+    u8g2.clearBuffer();
 }
+#endif
 
 void render() {
-    u8g2.clearBuffer();
+    PROFILE_SCOPE(STAGE_RENDER);
+    if(portalShown != PORTAL_CLOSED) {
+        renderPortal();
+        return;
+    }
 
-    int x               = 0;
-    int coY             = 28;
-    int cwuY            = 61;
-    int spacing         = -2;
-    int labelSpacing    = 1;
-    int labelHeight     = 10;
-    int labelMarginLeft = 2;
-    int tempWidth       = 45;
-
-    // Draw Temps Border
-    u8g2.drawFrame(x, 0, tempWidth, 64);
-    x             += 1;
-
-    // Draw Temps
-    int coLabelY   = coY - labelHeight - 10;
-    int cwuLabelY  = cwuY;
-    u8g2.setFont(FONT_TINY);
-    drawTextWithSpacing(x + labelMarginLeft, coLabelY, "CO", labelSpacing);
-    drawTextWithSpacing(x + labelMarginLeft, cwuY, "CWU", labelSpacing);
-
-    drawFloat(x, coY, PrimaryData, 1, spacing);
-    drawFloat(x, cwuY - labelHeight, SecondaryData, 1, spacing);
-
-    // Draw Arrows
-    int size         = 4;
-    int arrowX       = tempWidth - size - 4;
-    int arrowOffsetY = -5;
-
-    if(PrimaryDelta > 0) {
-        if(PrimaryDelta >= PrimaryDeltaThreshold)
-            drawArrow(arrowX, coLabelY + arrowOffsetY, size, true);
-    } else {
-        if(-PrimaryDelta >= PrimaryDeltaThreshold)
-            drawArrow(arrowX, coLabelY + arrowOffsetY, size, false);
+    uint32_t changed = screenLayout.update(values);
+    if(changed == 0) {
+        if(framePending) {
+            framePending = displayFlusher.submit() == 0;
+            if(!framePending)
+                bootTimeline.mark(BOOT_FIRST_FRAME);
+        } else {
+            displayFlusher.stats.framesSkipped++;
+        }
+        return; // nothing new to draw
     }
 
-    if(SecondaryDelta > 0) {
-        if(SecondaryDelta >= SecondaryDeltaThreshold)
-            drawArrow(arrowX, cwuLabelY + arrowOffsetY, size, true);
+    screenLayout.draw(u8g2, layoutFonts, changed); // only the widgets that changed
+
+    displayFlusher.stats.framesRendered++;
+    framePending = displayFlusher.submit() == 0;
+    if(!framePending)
+        bootTimeline.mark(BOOT_FIRST_FRAME);
+}
+
+// Drawn once per portal state, the data screen waits until it closes
+void renderPortal() {
+    if(portalDrawn) {
+        if(framePending)
+            framePending = displayFlusher.submit() == 0;
+        return;
+    }
+    u8g2.clearBuffer();
+    u8g2.setFont(FONT_SMALL);
+    if(portalShown == PORTAL_OPEN) {
+        u8g2.drawStr(0, 10, "WiFi setup");
+        u8g2.drawStr(0, 20, "Join " DEVICE_NAME "-AP");
     } else {
-        if(-SecondaryDelta >= SecondaryDeltaThreshold)
-            drawArrow(arrowX, cwuLabelY + arrowOffsetY, size, false);
+        u8g2.drawStr(0, 30, "Failed to connect");
+        u8g2.drawStr(0, 40, "to WiFi");
+        u8g2.drawStr(0, 50, "Rebooting...");
     }
-    x                    += tempWidth;
+    portalDrawn  = true;
+    framePending = displayFlusher.submit() == 0;
+}
 
-    // Draw ETC Border
-    int etcOffsetX        = -2;
-    x                    += etcOffsetX;
-    int etcWidth          = 128 - x;
-    int etcSegmentHeight  = 16;
-    u8g2.drawFrame(x, 0, etcWidth, 64);
-    drawETCTemp(x, 0, etcWidth, etcSegmentHeight, "Kamil ", Data3);
-    drawETCTemp(x, etcSegmentHeight - 1, etcWidth, etcSegmentHeight, "Magda", Data4, 1);
-    drawETCTemp(x, 2 * etcSegmentHeight - 2, etcWidth, etcSegmentHeight, "CO/m", PrimaryDelta);
-    drawETCTemp(x, 3 * etcSegmentHeight - 3, etcWidth, etcSegmentHeight, "CWU/m", SecondaryDelta);
-    // drawETCTemp(x, 2 * etcSegmentHeight, etcWidth, etcSegmentHeight, "Kuchnia", 21.2f);
+void publishDiagnostics() {
+    unsigned long currentTime = millis();
+    if(currentTime - lastDiagnosticsPublish < DIAGNOSTICS_TIME)
+        return;
+    uint32_t elapsed       = currentTime - lastDiagnosticsPublish;
+    lastDiagnosticsPublish = currentTime;
+
+    framesRenderedSensor.setValue(displayFlusher.stats.framesRendered);
+    framesSkippedSensor.setValue(displayFlusher.stats.framesSkipped);
+    bytesSentSensor.setValue(displayFlusher.stats.bytesSent);
+    settingsWritesSensor.setValue(settingsStore.stats.flashWrites);
+    publishesSentSensor.setValue(publishGovernor.stats.sent);
+    publishesSavedSensor.setValue(publishGovernor.stats.suppressed + publishGovernor.stats.coalesced);
+
+    // Worst cases since boot, one task per line on serial
+    char   text[256];
+    size_t used = 0;
+    for(const TaskMonitor *monitor : taskMonitors) {
+        char line[80];
+        monitor->format(line, sizeof(line));
+        logPrintf("Task %s\n", line);
+        used += snprintf(text + used, sizeof(text) - used, "%s%s", used > 0 ? ", " : "", line);
+        if(used >= sizeof(text))
+            used = sizeof(text) - 1;
+    }
+    logPrintf("Queue drops: outbox %lu, ui %lu, sensor %lu, motion %lu\n", (unsigned long) outbox.dropped,
+               (unsigned long) uiEvents.dropped, (unsigned long) sensorCommands.dropped, (unsigned long) motionCommands.dropped);
+    taskStatsSensor.setValue(text);
+
+    // The network task took over from loop(); its rate drops when an
+    // iteration overruns the period
+    uint32_t iterations = networkMonitor.stats.iterations;
+    loopRateSensor.setValue((uint32_t) ((uint64_t) (iterations - lastLoopIterations) * 1000 / (elapsed > 0 ? elapsed : 1)));
+    lastLoopIterations = iterations;
+    freeHeapSensor.setValue(ESP.getFreeHeap());
+    logPrintf("Sparklines: %u series, %u bytes each\n", (unsigned) (sizeof(trendOutputs) / sizeof(trendOutputs[0])),
+               (unsigned) SparkHistory::footprint());
+    logPrintf("Heap: %lu free, %lu lowest, %lu largest block\n", (unsigned long) ESP.getFreeHeap(), (unsigned long) ESP.getMinFreeHeap(),
+               (unsigned long) ESP.getMaxAllocHeap());
+#if PROFILE_STAGES
+    char stages[192];
+    formatStages(stages, sizeof(stages));
+    logPrintf("Stages: %s\n", stages);
+    stageTimingsSensor.setValue(stages);
+#endif
+#if ALLOC_GUARD
+    char allocations[192];
+    allocGuardFormat(allocations, sizeof(allocations));
+    logPrintf("Allocations since boot: %s (%lu in strict tasks)\n", allocations, (unsigned long) allocGuardViolations());
+#endif
+
+    const LinkStats &linkStats = connection.stats;
+    wifiRssiSensor.setValue((int32_t) lroundf(linkStats.rssiAverage));
+    linkDropsSensor.setValue(linkStats.wifiDrops + linkStats.mqttDrops);
+    linkDowntimeSensor.setValue(linkStats.downtimeMs / 1000);
+    logPrintf("Link: rssi %d dBm (avg %.1f), wifi %lu joins (%lu fast, %lu failed, %lu drops), mqtt %lu connects (%lu failed, %lu drops), "
+               "outage last %lu ms max %lu ms\n",
+               linkStats.rssi, linkStats.rssiAverage, (unsigned long) linkStats.wifiConnects, (unsigned long) linkStats.fastConnects,
+               (unsigned long) linkStats.wifiFailures, (unsigned long) linkStats.wifiDrops, (unsigned long) linkStats.mqttConnects,
+               (unsigned long) linkStats.mqttFailures, (unsigned long) linkStats.mqttDrops, (unsigned long) linkStats.lastOutageMs,
+               (unsigned long) linkStats.maxOutageMs);
+    logPrintf("Feed ledger: %u in the window, %lu recorded, %lu refused, %lu trimmed, %lu corrupt\n", feedLedger.size(),
+               (unsigned long) feedLedger.stats.recorded, (unsigned long) feedLedger.stats.refused, (unsigned long) feedLedger.stats.trimmed,
+               (unsigned long) feedLedger.stats.corrupt);
+    logPrintf("Offline outbox: %lu queued, %lu coalesced, %lu overflowed, %lu replayed\n", (unsigned long) stateOutbox.stats.queued,
+               (unsigned long) stateOutbox.stats.coalesced, (unsigned long) stateOutbox.stats.overflowed, (unsigned long) stateOutbox.stats.replayed);
+
+    publishBootTimeline();
+
+    buttonDropsSensor.setValue(buttonEdges.dropped);
+    buttonLatencySensor.setValue(gestures.stats.maxLatencyUs);
+    logPrintf("Buttons: %lu edges, %lu bounces, %lu gestures, %lu dropped, worst latency %lu us\n",
+               (unsigned long) gestures.stats.edges, (unsigned long) gestures.stats.bounces, (unsigned long) gestures.stats.gestures,
+               (unsigned long) buttonEdges.dropped, (unsigned long) gestures.stats.maxLatencyUs);
+}
 
-    u8g2.sendBuffer();
+MotionCommand motionCommand(uint8_t type) {
+    MotionCommand command    = {};
+    command.type             = type;
+    command.speed            = config.StepperSpeed * STEPPER_MICROSTEPS;
+    command.accel            = config.StepperAccel * STEPPER_MICROSTEPS;
+    command.gramsPerRotation = config.GramsPerRotation;
+    command.postedAt         = micros();
+    return command;
 }
 
 void feedNow() {
-    Serial.println("Feeding now...");
-    long stepsToMove = static_cast<long>(((float) STEPS_PER_REV * config.RotationsPerFeeding) * 1000.0f) / 1000;
-    stepper.move(stepsToMove);
-    digitalWrite(EN_PIN, LOW); // Enable the stepper driver
-    currentActivityState     = ACTIVITY_STEPPER;
+    MotionCommand command = motionCommand(MOTION_FEED_STEPS);
+
+    // By weight needs a tared scale that is delivering readings
+    if(config.FeedByWeight && config.tareOffset != LOADCELL_OFFSET_UNSET && values.version(SLOT_SCALE) > 0) {
+        command.type  = MOTION_FEED_GRAMS;
+        command.grams = config.FeedTargetGrams;
+    } else {
+        command.steps = fixedScale(STEPS_PER_REV, fixedFromFloat(config.RotationsPerFeeding));
+        command.grams = config.GramsPerRotation * config.RotationsPerFeeding;
+    }
+
+    // The quota covers the last 24 hours; feeds still on their way count
+    feedLedger.advance(time(NULL));
+    Fixed planned = fixedFromFloat(command.grams);
+    Fixed left    = fixedFromFloat(config.MaxGramsPerDay) - feedLedger.rollingTotal() - feedReserved;
+    if(feedLedger.isFull() || left < FIXED_ONE) {
+        feedLedger.stats.refused++;
+        logPrintf("Feed refused, %.1f g of the daily quota left\n", fixedToFloat(left > 0 ? left : 0));
+        publishLedger();
+        return;
+    }
+    if(planned > left) {
+        if(command.type == MOTION_FEED_STEPS)
+            command.steps = (uint32_t) ((uint64_t) command.steps * left / planned);
+        command.grams = fixedToFloat(left);
+        planned       = left;
+        feedLedger.stats.trimmed++;
+        logPrintf("Feed trimmed to %.1f g by the daily quota\n", command.grams);
+    }
+    command.reserved = planned;
+    if(!motionCommands.push(command)) {
+        Serial.println("Feeder busy, request dropped.");
+        return;
+    }
+    feedReserved += planned;
+}
+
+void feedLoop() {
+    if(!dispenser.isActive())
+        return;
+
+    ValueSlot      weight;
+    values.read(SLOT_SCALE, &weight);
+    bool           settled = values.value(SLOT_SCALE_STABLE) != 0;
+    DispenseAction action  = dispenser.update(millis(), fixedToFloat(weight.value), settled, stepEngine.isRunning(), stepEngine.stepped());
 
-    // Update grams feeded today
-    config.GramsFeededToday += config.GramsPerRotation * config.RotationsPerFeeding;
-    gramsFedTodaySensor.setValue(config.GramsFeededToday);
-    config.saveToFS();
+    switch(action.command) {
+        case DISPENSE_MOVE:
+            stepEngine.configure(action.slow ? motionSpeed / 4 : motionSpeed, motionAccel); // top-ups creep up on the target
+            digitalWrite(EN_PIN, LOW);                                                      // Enable the stepper driver
+            stepEngine.move(action.steps);
+            break;
+
+        case DISPENSE_STOP:
+            stepEngine.stop();
+            break;
+
+        case DISPENSE_DONE:
+        case DISPENSE_FAILED:
+            stepEngine.configure(motionSpeed, motionAccel);
+            postNet(NET_FEED_DONE, 1, dispenser.dispensed(), feedReservation);
+            if(action.command == DISPENSE_DONE)
+                postNet(NET_GRAMS_PER_ROTATION, 0, dispenser.learnedGramsPerRotation());
+            logPrintf("Feed %s: %.1f g in %lu steps\n", action.command == DISPENSE_DONE ? "done" : "stopped",
+                       dispenser.dispensed(), (unsigned long) dispenser.totalSteps());
+            break;
+
+        default:
+            break;
+    }
+}
+
+void recordFeed(float grams, Fixed reserved) {
+    if(grams < 0.0f)
+        grams = 0.0f; // bowl moved during the feed
+    uint32_t now  = time(NULL);
+    feedReserved -= reserved;
+    feedLedger.record(now, fixedFromFloat(grams));
+    stateOutbox.send(sendSensor, &lastFeedSensor, grams);
+    historyLog.append(HISTORY_SERIES_FEED, grams);
+    publishLedger();
+    if(now >= TIME_VALID_EPOCH) {
+        scheduleJob(JOB_LEDGER, now); // this may be the first entry in the window
+        scheduleArmed = false;
+    }
 }
 
 void setBacklight(uint8_t brightness) {
@@ -741,193 +1810,422 @@ void setBacklight(uint8_t brightness) {
 }
 
 void setContrast(uint8_t contrast) {
-    u8g2.setContrast(contrast);
+    displayFlusher.setContrast(contrast);
 }
 
 void onLCDStateCommand(bool state, HALight *sender) {
-    if(state) {
-        // Turn on backlight to previous brightness
-        setBacklight(config.LCD_BACKLIGHT_VAL);
-    } else {
-        // Turn off backlight
-        setBacklight(0);
-    }
-    currentActivityState    = ACTIVITY_HIGH;
-    lastButtonInterruptTime = millis();
-    sender->setState(state); // Update state
+    postUi(UI_BACKLIGHT, state); // Turn the backlight on at the previous brightness or off
+    publishGovernor.update(PUB_BACKLIGHT, state, millis()); // Update state
 }
 void onLCDBrightnessCommand(uint8_t brightness, HALight *sender) {
     config.LCD_BACKLIGHT_VAL = brightness;
-    setBacklight(brightness);
-    config.saveToFS();
-    currentActivityState    = ACTIVITY_HIGH;
-    lastButtonInterruptTime = millis();
+    postUi(UI_BRIGHTNESS, brightness);
+    settingsStore.requestSave();
     sender->setBrightness(brightness); // Update brightness
 }
 
 void onContrastCommand(HANumeric value, HANumber *sender) {
     uint8_t contrastValue   = value.toUInt8();
     config.LCD_CONTRAST_VAL = contrastValue;
-    setContrast(contrastValue);
-    config.saveToFS();
-    currentActivityState    = ACTIVITY_HIGH;
-    lastButtonInterruptTime = millis();
+    postUi(UI_CONTRAST, contrastValue);
+    settingsStore.requestSave();
     sender->setState(value); // Update state
 }
 
 void onStepperSpeedCommand(HANumeric value, HANumber *sender) {
     config.StepperSpeed = value.toInt16();
-    config.saveToFS();
-    stepper.setMaxSpeed(config.StepperSpeed * STEPPER_MICROSTEPS);
+    settingsStore.requestSave();
+    motionCommands.push(motionCommand(MOTION_CONFIGURE));
     sender->setState(value);
 }
 
 void onStepperAccelCommand(HANumeric value, HANumber *sender) {
     config.StepperAccel = value.toInt16();
-    config.saveToFS();
-    stepper.setAcceleration(config.StepperAccel * STEPPER_MICROSTEPS);
+    settingsStore.requestSave();
+    motionCommands.push(motionCommand(MOTION_CONFIGURE));
     sender->setState(value);
 }
 
 void onRotationsPerFeedingCommand(HANumeric value, HANumber *sender) {
     config.RotationsPerFeeding = value.toFloat();
-    config.saveToFS();
+    settingsStore.requestSave();
     sender->setState(value);
 }
 
 void onGramsPerFeedingCommand(HANumeric value, HANumber *sender) {
     config.GramsPerRotation = value.toFloat();
-    config.saveToFS();
+    settingsStore.requestSave();
     sender->setState(value);
 }
 
 void onMaxGramsPerDayCommand(HANumeric value, HANumber *sender) {
     config.MaxGramsPerDay = value.toFloat();
-    config.saveToFS();
+    settingsStore.requestSave();
     sender->setState(value);
+    publishLedger();
 }
 
 void onFeedNowCommand(HAButton *sender) {
     feedNow();
 }
 
+void onFeedTimeCommand(HANumeric value, HANumber *sender) {
+    int32_t hhmm = static_cast<int32_t>(value.toFloat());
+    if(hhmm != -1 && (hhmm < 0 || hhmm / 100 > 23 || hhmm % 100 > 59)) {
+        logPrintf("Rejected feed time %ld, expected HHMM or -1\n", (long) hhmm);
+        return;
+    }
+    for(uint8_t i = 0; i < FEED_SCHEDULES; i++) {
+        if(feedTimeNumbers[i] != sender)
+            continue;
+        // Counts as done up to now: a time set to just passed is not a missed feed
+        uint32_t now         = time(NULL);
+        bool     synced      = now >= TIME_VALID_EPOCH;
+        config.FeedTimes[i]  = hhmm;
+        config.JobLastRun[i] = synced ? now : 0;
+        settingsStore.requestSave();
+        sender->setState(value);
+        if(synced) {
+            scheduleJob(JOB_FEED + i, now);
+            scheduleArmed = false; // the earliest deadline may have moved
+            publishNextFeed();
+        }
+    }
+}
+
+void onFeedTargetCommand(HANumeric value, HANumber *sender) {
+    config.FeedTargetGrams = value.toFloat();
+    settingsStore.requestSave();
+    sender->setState(value);
+}
+
+void onFeedByWeightCommand(bool state, HASwitch *sender) {
+    config.FeedByWeight = state;
+    settingsStore.requestSave();
+    sender->setState(state);
+}
+
 void onCalibrationFactorCommand(HANumeric value, HANumber *sender) {
     config.calibrationFactor = static_cast<long>(value.toFloat());
-    config.saveToFS();
-    scale.set_scale(config.calibrationFactor);
+    settingsStore.requestSave();
+    SensorCommand command = { SENSOR_SET_FACTOR, static_cast<float>(config.calibrationFactor), (uint32_t) micros() };
+    sensorCommands.push(command);
     sender->setState(value);
 }
 
+void onCalibrationMassCommand(HANumeric value, HANumber *sender) {
+    config.CalibrationMass = value.toFloat();
+    settingsStore.requestSave();
+    sender->setState(value);
+}
+
+void onScaleFilterCommand(HANumeric value, HANumber *sender) {
+    LoadCellConfig &filter = config.ScaleFilter;
+    if(sender == &scaleMedianWindow)
+        filter.medianWindow = static_cast<uint8_t>(value.toFloat()) | 1; // odd, so there is a middle sample
+    else if(sender == &scaleProcessNoise)
+        filter.processNoise = value.toFloat();
+    else if(sender == &scaleMeasurementNoise)
+        filter.measurementNoise = value.toFloat();
+    else if(sender == &scaleSettleBand)
+        filter.settleBand = value.toFloat();
+    else
+        filter.deadband = value.toFloat();
+    settingsStore.requestSave();
+    SensorCommand command = { SENSOR_CONFIGURE, 0.0f, (uint32_t) micros() };
+    sensorCommands.push(command);
+    if(sender == &scaleMedianWindow)
+        sender->setState(static_cast<float>(filter.medianWindow));
+    else
+        sender->setState(value);
+}
+
+void onTareCommand(HAButton *sender) {
+    SensorCommand command = { SENSOR_TARE, 0.0f, (uint32_t) micros() };
+    sensorCommands.push(command);
+}
+
+void onCalibrateCommand(HAButton *sender) {
+    SensorCommand command = { SENSOR_CALIBRATE, config.CalibrationMass, (uint32_t) micros() };
+    sensorCommands.push(command);
+}
+
+// Payload of the message being routed, handed to every matching slot
+struct SlotMessage {
+        const uint8_t *payload;
+        uint16_t       length;
+        long           timestamp;
+};
+
 void onMqttMessage(const char *topic, const uint8_t *payload, uint16_t length) {
-    Serial.print("MQTT Message received on topic: ");
-    Serial.print(topic);
-    Serial.print(" with payload: ");
-    Serial.write(payload, length);
-    Serial.println();
-    // Handle incoming MQTT messages if needed
-    long currentTime = millis();
-    if(strcmp(topic, DATA_PRIMARY_TOPIC) == 0) {
-        PrimaryData                                     = std::stof(std::string((const char *) payload, length));
-
-        // Store reading in ring buffer
-        primaryReadings[primaryReadingsIndex].value     = PrimaryData;
-        primaryReadings[primaryReadingsIndex].timestamp = currentTime;
-        primaryReadingsIndex                            = (primaryReadingsIndex + 1) % DELTA_READINGS_COUNT;
-        if(primaryReadingsCount < DELTA_READINGS_COUNT)
-            primaryReadingsCount++;
-
-        // Calculate delta based on oldest and newest readings in buffer
-        if(primaryReadingsCount >= 2) {
-            int   oldestIdx    = (primaryReadingsIndex - primaryReadingsCount + DELTA_READINGS_COUNT) % DELTA_READINGS_COUNT;
-            int   newestIdx    = (primaryReadingsIndex - 1 + DELTA_READINGS_COUNT) % DELTA_READINGS_COUNT;
-            float valueDiff    = primaryReadings[newestIdx].value - primaryReadings[oldestIdx].value;
-            float timeDeltaSec = (primaryReadings[newestIdx].timestamp - primaryReadings[oldestIdx].timestamp) / DELTA_TIME_DIVIDER;
-            if(timeDeltaSec > 0)
-                PrimaryDelta = valueDiff / timeDeltaSec;
-        }
+    PROFILE_SCOPE(STAGE_MQTT_MESSAGE);
 
-        COdelta.setValue(PrimaryDelta);
-
-        Serial.print("Primary Delta (based on ");
-        Serial.print(primaryReadingsCount);
-        Serial.print(" readings): ");
-        Serial.println(PrimaryDelta);
-    } else if(strcmp(topic, DATA_SECONDARY_TOPIC) == 0) {
-        SecondaryData                                       = std::stof(std::string((const char *) payload, length));
-
-        // Store reading in ring buffer
-        secondaryReadings[secondaryReadingsIndex].value     = SecondaryData;
-        secondaryReadings[secondaryReadingsIndex].timestamp = currentTime;
-        secondaryReadingsIndex                              = (secondaryReadingsIndex + 1) % DELTA_READINGS_COUNT;
-        if(secondaryReadingsCount < DELTA_READINGS_COUNT)
-            secondaryReadingsCount++;
-
-        // Calculate delta based on oldest and newest readings in buffer
-        if(secondaryReadingsCount >= 2) {
-            int   oldestIdx    = (secondaryReadingsIndex - secondaryReadingsCount + DELTA_READINGS_COUNT) % DELTA_READINGS_COUNT;
-            int   newestIdx    = (secondaryReadingsIndex - 1 + DELTA_READINGS_COUNT) % DELTA_READINGS_COUNT;
-            float valueDiff    = secondaryReadings[newestIdx].value - secondaryReadings[oldestIdx].value;
-            float timeDeltaSec = (secondaryReadings[newestIdx].timestamp - secondaryReadings[oldestIdx].timestamp) / DELTA_TIME_DIVIDER;
-            if(timeDeltaSec > 0)
-                SecondaryDelta = valueDiff / timeDeltaSec;
+    if(strcmp(topic, TOPICS_COMMAND_TOPIC) == 0) {
+        onTopicsCommand(payload, length);
+        return;
+    }
+
+    SlotMessage message = { payload, length, (long) millis() };
+    subscriptions.dispatch(topic, onSlotMessage, &message);
+}
+
+void onSlotMessage(uint8_t slot, void *context) {
+    const SlotMessage *message     = static_cast<const SlotMessage *>(context);
+    const char        *text        = (const char *) message->payload;
+    const char        *jsonPath    = subscriptions.jsonPath(slot);
+    long               currentTime = message->timestamp;
+    Fixed              value;
+
+    bool               parsed      = jsonPath[0] != '\0' ? jsonExtractNumber(text, message->length, jsonPath, &value) : parseNumber(text, message->length, &value);
+    if(!parsed) {
+        payloadErrors++;
+        logPrintf("Ignoring malformed payload for slot %u (%lu so far)\n", slot, (unsigned long) payloadErrors);
+        return;
+    }
+    if(fixedIsSaturated(value)) {
+        payloadClamped++;
+        logPrintf("Payload for slot %u is beyond +-2147483.647, clamped (%lu so far)\n", slot, (unsigned long) payloadClamped);
+    }
+
+    // Sparkline first: the screen redraws it when the slot's version moves
+    for(TrendOutput &trend : trendOutputs) {
+        if(trend.slot != slot)
+            continue;
+        xSemaphoreTake(sparkLock, portMAX_DELAY);
+        trend.spark->add(currentTime, value);
+        xSemaphoreGive(sparkLock);
+    }
+
+    values.write(slot, value, currentTime);
+    historyLog.append(slot, fixedToFloat(value));
+
+    for(TrendOutput &trend : trendOutputs) {
+        if(trend.slot != slot)
+            continue;
+
+        // Least squares needs the dynamic range; at one sample per message
+        // the float cost doesn't matter here
+        trend.series->add(currentTime, fixedToFloat(value));
+        values.write(trend.slopeSlot, fixedFromFloat(trend.series->slope()), currentTime);
+        publishGovernor.update(trend.slope, trend.series->slope(), millis());
+        publishGovernor.update(trend.average, trend.series->ewma(), millis());
+        publishGovernor.update(trend.minimum, trend.series->minimum(), millis());
+        publishGovernor.update(trend.maximum, trend.series->maximum(), millis());
+
+        logPrintf("%s trend (based on %u readings): %.2f/min\n", trend.name, trend.series->size(), trend.series->slope());
+    }
+}
+
+// SparkSource for the screen, runs on the UI task
+bool sparkColumns(uint8_t slot, SparkColumn *out, uint16_t width, Fixed *low, Fixed *high) {
+    for(TrendOutput &trend : trendOutputs) {
+        if(trend.slot != slot)
+            continue;
+        uint32_t now = millis();
+        xSemaphoreTake(sparkLock, portMAX_DELAY);
+        trend.spark->expire(now);
+        bool any = trend.spark->columns(now, out, width);
+        *low     = trend.spark->minimum();
+        *high    = trend.spark->maximum();
+        xSemaphoreGive(sparkLock);
+        return any;
+    }
+    return false;
+}
+
+void onMqttConnected() {
+    publishNextFeed();
+    publishLedger();
+    mqtt.subscribe(TOPICS_COMMAND_TOPIC);
+    for(uint8_t slot = 0; slot < SUBSCRIPTION_COUNT; slot++) {
+        if(subscriptions.filter(slot)[0] == '\0')
+            continue;
+        mqtt.subscribe(subscriptions.filter(slot));
+        publishSubscription(slot);
+    }
+}
+
+void onTopicsCommand(const uint8_t *payload, uint16_t length) {
+    int slot = subscriptions.applyCommand(payload, length);
+    if(slot < 0) {
+        Serial.println("Invalid topics command, expected \"<slot> <filter> [json.path]\"");
+        return;
+    }
+
+    subscriptions.save();
+    // The broker keeps a removed filter until the next reconnect, but the
+    // router no longer maps it to a slot
+    if(subscriptions.filter(slot)[0] != '\0')
+        mqtt.subscribe(subscriptions.filter(slot));
+    publishSubscription(slot);
+}
+
+void publishSubscription(uint8_t slot) {
+    char topic[sizeof(TOPICS_STATE_PREFIX) + 4];
+    char state[TOPIC_MAX_LENGTH + JSON_PATH_MAX_LENGTH + 2];
+    snprintf(topic, sizeof(topic), TOPICS_STATE_PREFIX "%u", slot);
+    if(subscriptions.jsonPath(slot)[0] != '\0')
+        snprintf(state, sizeof(state), "%s %s", subscriptions.filter(slot), subscriptions.jsonPath(slot));
+    else
+        snprintf(state, sizeof(state), "%s", subscriptions.filter(slot)); // empty clears the retained state
+    mqtt.publish(topic, state, true);
+}
+
+void publishBootTimeline() {
+    char text[128];
+    bootTimeline.format(text, sizeof(text));
+    logPrintf("Boot ms: %s\n", text);
+    bootPhasesSensor.setValue(text);
+}
+
+// Runs in the SNTP task on every sync, including the first
+void onTimeSynced(struct timeval *tv) {
+    clockStepped = true;
+}
+
+// Called every network loop. Between deadlines this is one millis()
+// compare: the wall clock is only read when the earliest job is due, the
+// SNTP client stepped the clock, or after SCHEDULE_MAX_SLEEP at the latest.
+void runSchedule() {
+    if(clockStepped) {
+        clockStepped = false;
+        bootTimeline.mark(BOOT_TIME);
+        rearmSchedule(time(NULL));
+    }
+    if(scheduleArmed && (long) (millis() - scheduleWakeAt) < 0)
+        return;
+
+    uint32_t now = time(NULL);
+    if(now < TIME_VALID_EPOCH) {
+        scheduleArmed = false;
+        return; // not synced yet, onTimeSynced() starts things
+    }
+    int      job;
+    uint32_t due;
+    while((job = scheduler.popDue(now, &due)) >= 0)
+        runJob(job, due, now);
+
+    uint8_t  next;
+    uint32_t sleep = SCHEDULE_MAX_SLEEP;
+    if(scheduler.next(&next, &due) && (due - now) * 1000ULL < sleep)
+        sleep = (due - now) * 1000;
+    scheduleWakeAt = millis() + sleep;
+    scheduleArmed  = true;
+}
+
+// After boot or a clock step: every deadline is computed again from the
+// persisted last runs, and whatever was missed meanwhile is caught up
+void rearmSchedule(uint32_t now) {
+    if(now < TIME_VALID_EPOCH)
+        return;
+    feedLedger.advance(now); // stamps the feeds made before the clock was set
+    feedLedger.startDay(lastDailyDeadline(now, 0));
+    for(uint8_t job = 0; job < JOB_COUNT; job++) {
+        bool     persisted = job < PERSISTED_JOBS;
+        uint32_t lastRun   = persisted ? config.JobLastRun[job] : now;
+        if(persisted && lastRun == 0) {
+            // First sync on this firmware: nothing is known to be missed
+            config.JobLastRun[job] = now;
+            settingsStore.requestSave();
+        } else if(job == JOB_MIDNIGHT && lastRun < lastDailyDeadline(now, 0)) {
+            runJob(job, lastDailyDeadline(now, 0), now); // rebooted across midnight
+            continue;
+        } else if(job < JOB_MIDNIGHT && config.FeedTimes[job] >= 0) {
+            uint16_t minute = config.FeedTimes[job] / 100 * 60 + config.FeedTimes[job] % 100;
+            uint32_t missed = lastDailyDeadline(now, minute);
+            if(lastRun < missed) {
+                runJob(job, missed, now);
+                continue;
+            }
         }
+        scheduleJob(job, now);
+    }
+    scheduleArmed = false; // look at the new earliest deadline
+    publishNextFeed();
+    publishLedger();
+}
 
-        CWUdelta.setValue(SecondaryDelta);
-
-        Serial.print("Secondary Delta (based on ");
-        Serial.print(secondaryReadingsCount);
-        Serial.print(" readings): ");
-        Serial.println(SecondaryDelta);
-    } else if(strcmp(topic, DATA3_TOPIC) == 0)
-        Data3 = std::stof(std::string((const char *) payload, length));
-    else if(strcmp(topic, DATA4_TOPIC) == 0)
-        Data4 = std::stof(std::string((const char *) payload, length));
-}
-
-// NTP Setup - Syncs time from the internet
-void setupNTP() {
-    configTime(GMT_OFFSET_SEC, DAYLIGHT_OFFSET_SEC, NTP_SERVER);
-    Serial.println("Waiting for NTP time sync...");
-
-    // Wait for time to be set (with timeout)
-    int retries = 0;
-    while(time(nullptr) < 1000000000 && retries < 20) {
-        delay(500);
-        Serial.print(".");
-        retries++;
-    }
-    Serial.println();
-
-    struct tm timeinfo;
-    if(getLocalTime(&timeinfo)) {
-        Serial.println("NTP time synchronized!");
-        Serial.printf("Current time: %02d:%02d:%02d, Day: %d\n",
-        timeinfo.tm_hour, timeinfo.tm_min, timeinfo.tm_sec, timeinfo.tm_mday);
-        lastDay = timeinfo.tm_mday; // Initialize lastDay
+// Puts the job's next occurrence on the scheduler. Never at or before its
+// last run, so a clock stepping back doesn't repeat a job.
+void scheduleJob(uint8_t job, uint32_t now) {
+    uint32_t after = now;
+    if(job < PERSISTED_JOBS && config.JobLastRun[job] > after)
+        after = config.JobLastRun[job];
+
+    if(job == JOB_MIDNIGHT) {
+        scheduler.schedule(job, nextDailyDeadline(after, 0));
+    } else if(job == JOB_MAINTENANCE) {
+        scheduler.schedule(job, nextDailyDeadline(after, MAINTENANCE_MINUTE));
+    } else if(job == JOB_LEDGER) {
+        uint32_t oldest;
+        feedLedger.advance(now);
+        if(feedLedger.oldest(&oldest))
+            scheduler.schedule(job, oldest + FEED_WINDOW_S);
+        else
+            scheduler.cancel(job);
+    } else if(config.FeedTimes[job] >= 0) {
+        uint16_t minute = config.FeedTimes[job] / 100 * 60 + config.FeedTimes[job] % 100;
+        scheduler.schedule(job, nextDailyDeadline(after, minute));
     } else {
-        Serial.println("Failed to get NTP time");
+        scheduler.cancel(job);
     }
 }
 
-// Check if a new day has started and reset daily counters
-void checkNewDay() {
-    struct tm timeinfo;
-    if(!getLocalTime(&timeinfo))
-        return; // Time not available yet
+void runJob(uint8_t job, uint32_t due, uint32_t now) {
+    if(job == JOB_MIDNIGHT) {
+        resetDailyCounters();
+    } else if(job == JOB_MAINTENANCE) {
+        historyLog.requestFlush(); // the day so far is on flash before the quiet hours
+        logPrintf("Maintenance: history flushed, %lu bytes heap free\n", (unsigned long) ESP.getFreeHeap());
+    } else if(job == JOB_LEDGER) {
+        feedLedger.advance(now);
+        publishLedger();
+    } else if(now - due > FEED_CATCHUP_S) {
+        logPrintf("Scheduled feed %u skipped, %lu min late\n", job + 1, (unsigned long) ((now - due) / 60));
+    } else {
+        logPrintf("Scheduled feed %u%s\n", job + 1, now - due > 60 ? " (catching up)" : "");
+        feedNow();
+    }
 
-    int currentDay = timeinfo.tm_mday;
+    if(job < PERSISTED_JOBS) {
+        config.JobLastRun[job] = now;
+        settingsStore.requestSave();
+    }
+    scheduleJob(job, now);
+    if(job < JOB_MIDNIGHT)
+        publishNextFeed();
+}
 
-    // Check if day has changed (and lastDay is valid)
-    if(lastDay != -1 && currentDay != lastDay) {
-        Serial.println("New day detected! Resetting daily counters...");
+void resetDailyCounters() {
+    Serial.println("New day, resetting daily counters.");
+    feedLedger.startDay(lastDailyDeadline(time(NULL), 0));
+    publishLedger();
+}
 
-        // Reset daily grams counter
-        config.GramsFeededToday = 0;
-        gramsFedTodaySensor.setValue(0.0f);
-        config.saveToFS();
+// Day total, 24 h total and the quota left. Refusals and quota changes
+// publish too, so automations always see the current quota.
+void publishLedger() {
+    Fixed left = fixedFromFloat(config.MaxGramsPerDay) - feedLedger.rollingTotal() - feedReserved;
+    publishGovernor.update(PUB_GRAMS_FED, fixedToFloat(feedLedger.dayTotal()), millis());
+    stateOutbox.send(sendSensor, &gramsFed24hSensor, fixedToFloat(feedLedger.rollingTotal()));
+    stateOutbox.send(sendSensor, &quotaLeftSensor, fixedToFloat(left > 0 ? left : 0));
+    stateOutbox.send(sendSensor, &feedsRefusedSensor, feedLedger.stats.refused);
+}
 
-        Serial.printf("Daily reset complete. New day: %d\n", currentDay);
+// "07:30", or "none" without an active schedule or a synced clock
+void publishNextFeed() {
+    uint32_t first = 0;
+    for(uint8_t job = JOB_FEED; job < JOB_FEED + FEED_SCHEDULES; job++) {
+        uint32_t due;
+        if(scheduler.deadline(job, &due) && (first == 0 || due < first))
+            first = due;
     }
-
-    lastDay = currentDay;
+    char text[8] = "none";
+    if(first != 0) {
+        time_t    seconds = first;
+        struct tm local;
+        localtime_r(&seconds, &local);
+        strftime(text, sizeof(text), "%H:%M", &local);
+    }
+    nextFeedSensor.setValue(text);
 }
\ No newline at end of file
@@ -0,0 +1,217 @@
+#include "payload_parser.h"
+
+#include <string.h>
+
+#define MANTISSA_LIMIT   100000000UL // keep 9 significant digits
+#define EXPONENT_LIMIT   1000        // beyond this the value is 0 or clamped anyway
+
+static bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+bool scanDecimal(const char *text, uint16_t length, DecimalNumber *out) {
+    const char *p        = text;
+    const char *end      = text + length;
+    uint32_t    mantissa = 0;
+    int32_t     exponent = 0;
+    uint8_t     digits   = 0;
+    bool        negative = false;
+
+    while(p < end && isSpace(*p)) p++;
+    while(end > p && isSpace(end[-1])) end--;
+
+    if(p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+
+    for(; p < end && isDigit(*p); p++, digits++) {
+        if(mantissa < MANTISSA_LIMIT)
+            mantissa = mantissa * 10 + (*p - '0');
+        else
+            exponent++; // digit dropped, keep the magnitude
+    }
+    if(p < end && *p == '.') {
+        for(p++; p < end && isDigit(*p); p++, digits++) {
+            if(mantissa < MANTISSA_LIMIT) {
+                mantissa = mantissa * 10 + (*p - '0');
+                exponent--;
+            }
+        }
+    }
+    if(digits == 0)
+        return false;
+
+    if(p < end && (*p == 'e' || *p == 'E')) {
+        bool    expNegative = false;
+        int32_t value       = 0;
+        uint8_t expDigits   = 0;
+        if(++p < end && (*p == '-' || *p == '+'))
+            expNegative = *p++ == '-';
+        for(; p < end && isDigit(*p); p++, expDigits++)
+            if(value < EXPONENT_LIMIT)
+                value = value * 10 + (*p - '0');
+        if(expDigits == 0)
+            return false;
+        exponent += expNegative ? -value : value;
+    }
+
+    if(p != end)
+        return false;
+    if(exponent > EXPONENT_LIMIT)
+        exponent = EXPONENT_LIMIT;
+    else if(exponent < -EXPONENT_LIMIT)
+        exponent = -EXPONENT_LIMIT;
+
+    out->mantissa = mantissa;
+    out->exponent = exponent;
+    out->negative = negative;
+    return true;
+}
+
+bool decimalToFixed(const DecimalNumber &number, Fixed *out) {
+    int32_t  shift     = number.exponent + FIXED_DECIMALS;
+    uint64_t magnitude = number.mantissa;
+    if(magnitude == 0) {
+        *out = 0;
+        return true;
+    }
+    if(shift > 0) {
+        if(shift > 9)
+            magnitude = FIXED_MAX + 1ULL; // past the range whatever the digits
+        else
+            magnitude *= fixedPowers[shift];
+    } else if(shift < 0) {
+        if(shift < -9) {
+            *out = 0; // below half a thousandth, the mantissa has 9 digits
+            return true;
+        }
+        uint32_t divisor = fixedPowers[-shift];
+        magnitude        = (magnitude + divisor / 2) / divisor;
+    }
+    if(magnitude > FIXED_MAX)
+        magnitude = FIXED_MAX;
+    *out = number.negative ? -(Fixed) magnitude : (Fixed) magnitude;
+    return true;
+}
+
+bool parseNumber(const char *text, uint16_t length, Fixed *out) {
+    DecimalNumber number;
+    return scanDecimal(text, length, &number) && decimalToFixed(number, out);
+}
+
+// Minimal JSON cursor, only as much as is needed to skip values
+struct JsonCursor {
+        const char *p;
+        const char *end;
+};
+
+static void skipSpace(JsonCursor &c) {
+    while(c.p < c.end && isSpace(*c.p)) c.p++;
+}
+
+// At an opening quote, moves past the closing one
+static bool skipString(JsonCursor &c) {
+    for(c.p++; c.p < c.end; c.p++) {
+        if(*c.p == '\\') {
+            c.p++; // escaped character
+        } else if(*c.p == '"') {
+            c.p++;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool skipValue(JsonCursor &c) {
+    skipSpace(c);
+    if(c.p == c.end)
+        return false;
+
+    if(*c.p == '"')
+        return skipString(c);
+
+    if(*c.p == '{' || *c.p == '[') {
+        int depth = 0;
+        while(c.p < c.end) {
+            char k = *c.p;
+            if(k == '"') {
+                if(!skipString(c))
+                    return false;
+                continue;
+            }
+            if(k == '{' || k == '[')
+                depth++;
+            else if((k == '}' || k == ']') && --depth == 0) {
+                c.p++;
+                return true;
+            }
+            c.p++;
+        }
+        return false; // unterminated
+    }
+
+    // Number or literal
+    const char *start = c.p;
+    while(c.p < c.end && *c.p != ',' && *c.p != '}' && *c.p != ']' && !isSpace(*c.p)) c.p++;
+    return c.p > start;
+}
+
+bool jsonExtractNumber(const char *json, uint16_t length, const char *path, Fixed *out) {
+    JsonCursor  c       = { json, json + length };
+    const char *segment = path;
+
+    // Descend one object level per path segment
+    for(;;) {
+        size_t segmentLength = strcspn(segment, ".");
+
+        skipSpace(c);
+        if(c.p == c.end || *c.p != '{')
+            return false;
+        c.p++;
+
+        for(;;) {
+            skipSpace(c);
+            if(c.p == c.end || *c.p != '"')
+                return false; // key missing or malformed object
+
+            const char *key = c.p + 1;
+            if(!skipString(c))
+                return false;
+            size_t keyLength = c.p - 1 - key;
+
+            skipSpace(c);
+            if(c.p == c.end || *c.p != ':')
+                return false;
+            c.p++;
+
+            if(keyLength == segmentLength && memcmp(key, segment, keyLength) == 0)
+                break;
+
+            if(!skipValue(c))
+                return false;
+            skipSpace(c);
+            if(c.p == c.end || *c.p != ',')
+                return false; // end of object without the key
+            c.p++;
+        }
+
+        if(segment[segmentLength] == '\0')
+            break;
+        segment += segmentLength + 1;
+    }
+
+    skipSpace(c);
+    if(c.p < c.end && *c.p == '"') {
+        const char *start = c.p + 1;
+        if(!skipString(c))
+            return false;
+        return parseNumber(start, c.p - 1 - start, out);
+    }
+
+    const char *start = c.p;
+    while(c.p < c.end && *c.p != ',' && *c.p != '}' && *c.p != ']') c.p++;
+    return parseNumber(start, c.p - start, out);
+}
@@ -0,0 +1,69 @@
+#include "publish_governor.h"
+
+#include <math.h>
+#include <stddef.h>
+
+void PublishGovernor::add(uint8_t handle, GovernedPublish publish, void *entity, const PublishPolicy &policy) {
+    if(handle >= GOVERNOR_MAX_ENTRIES)
+        return;
+    Entry &entry   = entries[handle];
+    entry.publish  = publish;
+    entry.entity   = entity;
+    entry.policy   = policy;
+    entry.pending  = false;
+    entry.everSent = false;
+}
+
+void PublishGovernor::update(uint8_t handle, float value, uint32_t now) {
+    if(handle >= GOVERNOR_MAX_ENTRIES || entries[handle].publish == NULL)
+        return;
+    Entry &entry = entries[handle];
+    entry.latest = value;
+
+    if(entry.everSent && fabsf(value - entry.sentValue) <= entry.policy.deadband) {
+        if(entry.pending)
+            stats.coalesced++; // moved back within the deadband before going out
+        else
+            stats.suppressed++;
+        entry.pending = false;
+        return;
+    }
+
+    if(entry.everSent && now - entry.sentAt < entry.policy.minIntervalMs) {
+        if(entry.pending)
+            stats.coalesced++;
+        entry.pending = true; // loop() sends the latest once the interval passed
+        return;
+    }
+    send(entry, now);
+}
+
+void PublishGovernor::loop(uint32_t now) {
+    for(uint8_t i = 0; i < GOVERNOR_MAX_ENTRIES; i++) {
+        Entry &entry = entries[i];
+        if(entry.publish == NULL)
+            continue;
+
+        if(entry.pending) {
+            if(!entry.everSent || now - entry.sentAt >= entry.policy.minIntervalMs)
+                send(entry, now);
+        } else if(entry.everSent && entry.policy.maxStaleMs > 0 && now - entry.sentAt >= entry.policy.maxStaleMs) {
+            stats.heartbeats++;
+            send(entry, now);
+        }
+    }
+}
+
+void PublishGovernor::send(Entry &entry, uint32_t now) {
+    if(!entry.publish(entry.entity, entry.latest)) {
+        stats.failed++;
+        entry.pending = true; // e.g. broker offline, keep the value for later
+        entry.sentAt  = now;  // and retry at the entity's own pace
+        return;
+    }
+    entry.sentValue = entry.latest;
+    entry.sentAt    = now;
+    entry.pending   = false;
+    entry.everSent  = true;
+    stats.sent++;
+}
@@ -0,0 +1,371 @@
+#include "screen_layout.h"
+
+#include <LittleFS.h>
+#include "payload_parser.h"
+
+static const char *const fontNames[LAYOUT_FONT_COUNT] = { "tiny", "small", "big" };
+
+// Next space separated word, NULL at the end of the line
+static char *nextWord(char **cursor) {
+    char *p = *cursor;
+    while(*p == ' ' || *p == '\t') p++;
+    if(*p == '\0')
+        return NULL;
+    char *word = p;
+    while(*p != '\0' && *p != ' ' && *p != '\t') p++;
+    if(*p != '\0')
+        *p++ = '\0';
+    *cursor = p;
+    return word;
+}
+
+static bool nextInt(char **cursor, long min, long max, long *out) {
+    char *word = nextWord(cursor);
+    if(word == NULL)
+        return false;
+    char *end;
+    *out = strtol(word, &end, 10);
+    return *end == '\0' && *out >= min && *out <= max;
+}
+
+static bool nextFont(char **cursor, uint8_t *out) {
+    char *word = nextWord(cursor);
+    if(word == NULL)
+        return false;
+    for(uint8_t font = 0; font < LAYOUT_FONT_COUNT; font++) {
+        if(strcmp(word, fontNames[font]) == 0) {
+            *out = font;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ScreenLayout::reset() {
+    widgetCount = 0;
+    pages       = 0;
+    textUsed    = 0;
+    badLine     = 0;
+    current     = 0;
+    valid       = false;
+    chromeValid = false;
+}
+
+bool ScreenLayout::load() {
+    File file = LittleFS.open(LAYOUT_FILE, "r");
+    if(!file)
+        return false;
+
+    reset();
+    char     line[LAYOUT_LINE_LENGTH + 1];
+    uint16_t length = 0;
+    uint16_t number = 1;
+    bool     ok     = true;
+    for(;;) {
+        int c = file.read();
+        if(c < 0 || c == '\n') {
+            line[length] = '\0';
+            if(ok && !addLine(line)) {
+                badLine = number;
+                ok      = false;
+            }
+            length = 0;
+            number++;
+            if(c < 0)
+                break;
+        } else if(c != '\r' && length < LAYOUT_LINE_LENGTH) {
+            line[length++] = c;
+        }
+    }
+    file.close();
+    return ok && pages > 0;
+}
+
+bool ScreenLayout::parse(const char *text) {
+    reset();
+    uint16_t number = 1;
+    while(*text != '\0') {
+        char     line[LAYOUT_LINE_LENGTH + 1];
+        uint16_t length = 0;
+        while(*text != '\0' && *text != '\n') {
+            if(length < LAYOUT_LINE_LENGTH)
+                line[length++] = *text;
+            text++;
+        }
+        if(*text == '\n')
+            text++;
+        line[length] = '\0';
+        if(!addLine(line)) {
+            badLine = number;
+            return false;
+        }
+        number++;
+    }
+    return pages > 0;
+}
+
+bool ScreenLayout::addLine(char *line) {
+    char *comment = strchr(line, '#');
+    if(comment != NULL)
+        *comment = '\0';
+    char *cursor  = line;
+    char *keyword = nextWord(&cursor);
+    if(keyword == NULL)
+        return true; // blank line or comment
+
+    if(strcmp(keyword, "page") == 0) {
+        if(pages >= LAYOUT_MAX_PAGES)
+            return false;
+        pageList[pages].first = widgetCount;
+        pageList[pages].count = 0;
+        pages++;
+        return true;
+    }
+
+    if(widgetCount >= LAYOUT_MAX_WIDGETS)
+        return false;
+    if(pages == 0) {
+        // Widgets before the first "page" line start the first page
+        pageList[0].first = 0;
+        pageList[0].count = 0;
+        pages             = 1;
+    }
+    if(pageList[pages - 1].count >= LAYOUT_PAGE_WIDGETS)
+        return false;
+
+    LayoutWidget widget = {};
+    long         x, y, w, h, spacing, slot, decimals, boxX, boxY;
+    if(strcmp(keyword, "frame") == 0) {
+        if(!nextInt(&cursor, 0, 127, &x) || !nextInt(&cursor, 0, 63, &y) || !nextInt(&cursor, 1, 128, &w) || !nextInt(&cursor, 1, 64, &h))
+            return false;
+        widget.type = LAYOUT_FRAME;
+        widget.w    = w;
+        widget.h    = h;
+    } else if(strcmp(keyword, "label") == 0) {
+        if(!nextInt(&cursor, 0, 127, &x) || !nextInt(&cursor, 0, 63, &y) || !nextFont(&cursor, &widget.font) ||
+           !nextInt(&cursor, -8, 8, &spacing))
+            return false;
+        while(*cursor == ' ' || *cursor == '\t') cursor++;
+        size_t length = strlen(cursor);
+        while(length > 0 && (cursor[length - 1] == ' ' || cursor[length - 1] == '\t')) length--;
+        if(length == 0 || textUsed + length + 1 > LAYOUT_TEXT_POOL)
+            return false;
+        memcpy(textPool + textUsed, cursor, length);
+        textPool[textUsed + length] = '\0';
+        widget.type                 = LAYOUT_LABEL;
+        widget.spacing              = spacing;
+        widget.text                 = textUsed;
+        textUsed                   += length + 1;
+    } else if(strcmp(keyword, "value") == 0) {
+        if(!nextInt(&cursor, 0, 127, &x) || !nextInt(&cursor, 0, 63, &y) || !nextFont(&cursor, &widget.font) ||
+           !nextInt(&cursor, -8, 8, &spacing) || !nextInt(&cursor, 0, VALUE_TABLE_SIZE - 1, &slot) || !nextInt(&cursor, 0, 3, &decimals) ||
+           !nextInt(&cursor, 0, 127, &boxX) || !nextInt(&cursor, 0, 63, &boxY) || !nextInt(&cursor, 1, 128, &w) || !nextInt(&cursor, 1, 64, &h))
+            return false;
+        widget.type     = LAYOUT_VALUE;
+        widget.spacing  = spacing;
+        widget.slot     = slot;
+        widget.decimals = decimals;
+        widget.boxX     = boxX;
+        widget.boxY     = boxY;
+        widget.w        = w;
+        widget.h        = h;
+    } else if(strcmp(keyword, "trend") == 0) {
+        char *threshold;
+        if(!nextInt(&cursor, 0, 127, &x) || !nextInt(&cursor, 0, 63, &y) || !nextInt(&cursor, 2, 32, &w) ||
+           !nextInt(&cursor, 0, VALUE_TABLE_SIZE - 1, &slot) || (threshold = nextWord(&cursor)) == NULL ||
+           !parseNumber(threshold, strlen(threshold), &widget.threshold))
+            return false;
+        widget.type = LAYOUT_TREND;
+        widget.slot = slot;
+        widget.w    = w;
+    } else if(strcmp(keyword, "spark") == 0) {
+        if(!nextInt(&cursor, 0, 127, &x) || !nextInt(&cursor, 0, 63, &y) || !nextInt(&cursor, 1, LAYOUT_SPARK_WIDTH, &w) ||
+           !nextInt(&cursor, 2, 64, &h) || !nextInt(&cursor, 0, VALUE_TABLE_SIZE - 1, &slot))
+            return false;
+        widget.type = LAYOUT_SPARK;
+        widget.slot = slot;
+        widget.w    = w;
+        widget.h    = h;
+    } else {
+        return false;
+    }
+    if(nextWord(&cursor) != NULL && widget.type != LAYOUT_LABEL)
+        return false; // trailing garbage
+
+    widget.x                 = x;
+    widget.y                 = y;
+    widgets[widgetCount++]   = widget;
+    pageList[pages - 1].count++;
+    return true;
+}
+
+void ScreenLayout::showPage(uint8_t page) {
+    if(page >= pages || page == current)
+        return;
+    current     = page;
+    valid       = false;
+    chromeValid = false;
+}
+
+int32_t ScreenLayout::stateOf(const LayoutWidget &widget, const ValueTable &values) const {
+    if(widget.type == LAYOUT_SPARK) {
+        // Both only grow, so the sum moves on a new sample or a new column
+        int32_t state = values.version(widget.slot);
+        if(sparkColumnMs > 0)
+            state += millis() / sparkColumnMs;
+        return state;
+    }
+    Fixed value = values.value(widget.slot);
+    if(widget.type == LAYOUT_VALUE)
+        return fixedRescale(value, widget.decimals);
+    if(value >= widget.threshold)
+        return 1;
+    if(-value >= widget.threshold)
+        return -1;
+    return 0;
+}
+
+uint32_t ScreenLayout::update(const ValueTable &values) {
+    if(pages == 0)
+        return 0;
+    const Page &page    = pageList[current];
+    uint32_t    changed = 0;
+    for(uint8_t i = 0; i < page.count; i++) {
+        const LayoutWidget &widget = widgets[page.first + i];
+        if(widget.type == LAYOUT_FRAME || widget.type == LAYOUT_LABEL) {
+            if(!valid)
+                changed |= 1UL << i;
+            continue;
+        }
+        next[i] = stateOf(widget, values);
+        if(!valid || next[i] != shown[i])
+            changed |= 1UL << i;
+    }
+    return changed;
+}
+
+void ScreenLayout::draw(U8G2 &display, const LayoutFonts &fonts, uint32_t changed) {
+    if(pages == 0)
+        return;
+    if(!chromeValid)
+        rasterizeChrome(display, fonts);
+
+    uint8_t *buffer = display.getBufferPtr();
+    if(!valid)
+        memcpy(buffer, chrome, FRAME_BUFFER_SIZE); // aligned, so newlib copies whole words
+
+    const Page &page = pageList[current];
+    for(uint8_t i = 0; i < page.count; i++) {
+        const LayoutWidget &widget = widgets[page.first + i];
+        if(widget.type == LAYOUT_FRAME || widget.type == LAYOUT_LABEL || !(changed & (1UL << i)))
+            continue;
+        if(valid) {
+            if(widget.type == LAYOUT_VALUE)
+                restoreBox(buffer, widget.boxX, widget.boxY, widget.w, widget.h);
+            else if(widget.type == LAYOUT_SPARK)
+                restoreBox(buffer, widget.x, widget.y, widget.w, widget.h);
+            else
+                restoreBox(buffer, widget.x, widget.y, widget.w + 1, widget.w + 1);
+        }
+        drawWidget(display, fonts, widget, next[i]);
+        shown[i] = next[i];
+    }
+    valid = true;
+}
+
+void ScreenLayout::rasterizeChrome(U8G2 &display, const LayoutFonts &fonts) {
+    display.clearBuffer();
+    const Page &page = pageList[current];
+    for(uint8_t i = 0; i < page.count; i++) {
+        const LayoutWidget &widget = widgets[page.first + i];
+        if(widget.type == LAYOUT_FRAME || widget.type == LAYOUT_LABEL)
+            drawWidget(display, fonts, widget, 0);
+    }
+    memcpy(chrome, display.getBufferPtr(), FRAME_BUFFER_SIZE);
+    chromeValid = true;
+    valid       = false;
+}
+
+// Copy a box back from the chrome layer. The buffer holds 8 rows per
+// byte (u8g2 tile order), so the top and bottom bytes are merged by mask.
+void ScreenLayout::restoreBox(uint8_t *buffer, int x, int y, int w, int h) const {
+    const uint8_t *layer = reinterpret_cast<const uint8_t *>(chrome);
+    int            right = x + w > FRAME_TILE_WIDTH * 8 ? FRAME_TILE_WIDTH * 8 : x + w;
+    int            last  = y + h > FRAME_TILE_HEIGHT * 8 ? FRAME_TILE_HEIGHT * 8 - 1 : y + h - 1;
+    for(int page = y / 8; page <= last / 8; page++) {
+        int     top    = page * 8 > y ? 0 : y - page * 8;
+        int     bottom = page * 8 + 7 < last ? 7 : last - page * 8;
+        uint8_t mask   = (uint8_t) ((0xFF << top) & (0xFF >> (7 - bottom)));
+        int     row    = page * FRAME_TILE_WIDTH * 8;
+        for(int column = x; column < right; column++)
+            buffer[row + column] = (buffer[row + column] & ~mask) | (layer[row + column] & mask);
+    }
+}
+
+void ScreenLayout::drawWidget(U8G2 &display, const LayoutFonts &fonts, const LayoutWidget &widget, int32_t state) {
+    switch(widget.type) {
+        case LAYOUT_FRAME:
+            display.drawFrame(widget.x, widget.y, widget.w, widget.h);
+            break;
+
+        case LAYOUT_LABEL: {
+            display.setFont(fonts.text[widget.font]);
+            int x = widget.x;
+            for(const char *c = textPool + widget.text; *c; c++)
+                x += display.drawGlyph(x, widget.y, *c) + widget.spacing;
+            break;
+        }
+
+        case LAYOUT_VALUE: {
+            char intPart[12];
+            char fracPart[8];
+            formatFixed(state, widget.decimals, intPart, fracPart);
+            int x = fonts.digits[widget.font]->draw(display, widget.x, widget.y, intPart, widget.spacing);
+            if(widget.decimals > 0) {
+                x = fonts.fraction[widget.font]->draw(display, x, widget.y, ".", 0);
+                fonts.fraction[widget.font]->draw(display, x, widget.y, fracPart, widget.spacing);
+            }
+            break;
+        }
+
+        case LAYOUT_TREND: {
+            uint8_t size = widget.w;
+            if(state > 0) {
+                display.drawLine(widget.x, widget.y + size, widget.x + size / 2, widget.y);
+                display.drawLine(widget.x + size / 2, widget.y, widget.x + size, widget.y + size);
+            } else if(state < 0) {
+                display.drawLine(widget.x, widget.y, widget.x + size / 2, widget.y + size);
+                display.drawLine(widget.x + size / 2, widget.y + size, widget.x + size, widget.y);
+            }
+            break;
+        }
+
+        case LAYOUT_SPARK:
+            drawSpark(display, widget);
+            break;
+    }
+}
+
+// One vertical bar per column from its minimum to its maximum, scaled to
+// the range of the whole history so the graph doesn't jump as it scrolls
+void ScreenLayout::drawSpark(U8G2 &display, const LayoutWidget &widget) {
+    Fixed low, high;
+    if(sparkSource == NULL || !sparkSource(widget.slot, sparkColumns, widget.w, &low, &high))
+        return;
+
+    int64_t range = (int64_t) high - low;
+    if(range == 0) {
+        low   -= 1; // flat series: a line through the middle
+        range  = 2;
+    }
+    int rows   = widget.h - 1;
+    int bottom = widget.y + rows;
+    for(uint8_t i = 0; i < widget.w; i++) {
+        const SparkColumn &column = sparkColumns[i];
+        if(column.low > column.high)
+            continue; // no samples
+        int top  = bottom - (int) ((((int64_t) column.high - low) * rows + range / 2) / range);
+        int foot = bottom - (int) ((((int64_t) column.low - low) * rows + range / 2) / range);
+        display.drawVLine(widget.x + i, top, foot - top + 1);
+    }
+}
@@ -0,0 +1,210 @@
+#include "settings_store.h"
+
+#include <LittleFS.h>
+#include "crc32.h"
+
+#define SETTINGS_MAGIC 0x31564B53 // "SKV1", first word of snapshot and journal
+
+// On flash a record is this header, `size` data bytes and a CRC-32 over both
+struct __attribute__((packed)) SettingsRecordHeader {
+        uint8_t id;
+        uint8_t version;
+        uint8_t size;
+        uint8_t reserved;
+};
+
+void SettingsStore::load() {
+    bool found = readFile(SETTINGS_SNAPSHOT_FILE);
+    if(readFile(SETTINGS_JOURNAL_FILE)) {
+        File journal = LittleFS.open(SETTINGS_JOURNAL_FILE, "r");
+        journalSize  = journal.size();
+        journal.close();
+        found = true;
+    }
+    if(!found)
+        migrateLegacy();
+
+    memcpy(shadow, data, size);
+    // Appending after a damaged record would hide everything written later
+    // from the next load, so fold what was readable into a fresh snapshot
+    if(!found || upgraded || damaged)
+        writeSnapshot(); // also stores the defaults on a fresh filesystem
+}
+
+bool SettingsStore::readFile(const char *path) {
+    File file = LittleFS.open(path, "r");
+    if(!file)
+        return false;
+
+    uint32_t magic = 0;
+    if(file.read((uint8_t *) &magic, sizeof(magic)) != sizeof(magic) || magic != SETTINGS_MAGIC) {
+        file.close();
+        stats.badRecords++;
+        damaged = true;
+        return false;
+    }
+
+    uint8_t record[sizeof(SettingsRecordHeader) + 255];
+    for(;;) {
+        SettingsRecordHeader &header = *(SettingsRecordHeader *) record;
+        if(file.read(record, sizeof(header)) != sizeof(header))
+            break;
+
+        uint32_t crc = 0;
+        if(file.read(record + sizeof(header), header.size) != header.size ||
+           file.read((uint8_t *) &crc, sizeof(crc)) != sizeof(crc)) {
+            stats.badRecords++; // torn append at the end of the journal
+            damaged = true;
+            break;
+        }
+        if(crc32Update(0, record, sizeof(header) + header.size) != crc) {
+            stats.badRecords++; // the size can't be trusted either, stop here
+            damaged = true;
+            break;
+        }
+        applyRecord(record + sizeof(header), header.id, header.version, header.size);
+    }
+    file.close();
+    return true;
+}
+
+void SettingsStore::applyRecord(const uint8_t *record, uint8_t id, uint8_t version, uint8_t length) {
+    const SettingsField *field = find(id);
+    if(field == NULL)
+        return; // field was retired, its id stays reserved
+
+    if(version == field->version && length == field->size) {
+        memcpy(data + field->offset, record, length);
+        return;
+    }
+
+    uint8_t converted[255];
+    if(field->upgrade == NULL || !field->upgrade(version, record, length, converted))
+        return; // keep the default
+    memcpy(data + field->offset, converted, field->size);
+    upgraded = true;
+}
+
+bool SettingsStore::migrateLegacy() {
+    File file = LittleFS.open(SETTINGS_LEGACY_FILE, "r");
+    if(!file)
+        return false;
+
+    // Raw dumps only match field offsets when the size matches the last
+    // layout; otherwise only the MQTT block at the front is trusted.
+    static uint8_t legacy[SETTINGS_LEGACY_SIZE];
+    size_t         length = file.read(legacy, sizeof(legacy));
+    size_t         limit  = file.size() == SETTINGS_LEGACY_SIZE ? SETTINGS_LEGACY_SIZE : SETTINGS_LEGACY_STABLE;
+    file.close();
+    if(length < limit)
+        limit = length;
+
+    for(uint8_t i = 0; i < fieldCount; i++) {
+        const SettingsField &field = fields[i];
+        if(field.legacyOffset >= 0 && (size_t) field.legacyOffset + field.size <= limit)
+            memcpy(data + field.offset, legacy + field.legacyOffset, field.size);
+    }
+
+    LittleFS.remove(SETTINGS_LEGACY_FILE);
+    return true;
+}
+
+void SettingsStore::requestSave() {
+    unsigned long now = millis();
+    stats.saveRequests++;
+    if(!pending)
+        firstRequest = now;
+    lastRequest = now;
+    pending     = true;
+}
+
+void SettingsStore::loop() {
+    if(!pending)
+        return;
+    unsigned long now = millis();
+    if(now - lastRequest >= SETTINGS_FLUSH_DELAY || now - firstRequest >= SETTINGS_FLUSH_MAX)
+        flush();
+}
+
+void SettingsStore::flush() {
+    pending = false;
+
+    size_t bytes = 0;
+    for(uint8_t i = 0; i < fieldCount; i++)
+        if(isChanged(fields[i]))
+            bytes += sizeof(SettingsRecordHeader) + fields[i].size + sizeof(uint32_t);
+    if(bytes == 0)
+        return; // changed back before the timer expired
+
+    if(journalSize + bytes > SETTINGS_JOURNAL_LIMIT) {
+        writeSnapshot();
+        return;
+    }
+
+    // An empty count means the journal is missing or unreadable: start over
+    File file = LittleFS.open(SETTINGS_JOURNAL_FILE, journalSize == 0 ? "w" : "a");
+    if(!file)
+        return;
+    if(journalSize == 0) {
+        uint32_t magic  = SETTINGS_MAGIC;
+        journalSize    += file.write((const uint8_t *) &magic, sizeof(magic));
+    }
+    writeRecords(file, true);
+    file.close();
+    journalSize += bytes;
+    stats.flashWrites++;
+}
+
+void SettingsStore::writeSnapshot() {
+    File file = LittleFS.open(SETTINGS_TEMP_FILE, "w");
+    if(!file)
+        return;
+    uint32_t magic = SETTINGS_MAGIC;
+    file.write((const uint8_t *) &magic, sizeof(magic));
+    writeRecords(file, false);
+    file.close();
+    stats.flashWrites++;
+
+    // A power cut before the journal is removed only replays values the
+    // snapshot already holds
+    LittleFS.rename(SETTINGS_TEMP_FILE, SETTINGS_SNAPSHOT_FILE);
+    LittleFS.remove(SETTINGS_JOURNAL_FILE);
+    journalSize = 0;
+    stats.compactions++;
+}
+
+void SettingsStore::writeRecords(File &file, bool changedOnly) {
+    uint8_t record[sizeof(SettingsRecordHeader) + 255];
+
+    for(uint8_t i = 0; i < fieldCount; i++) {
+        const SettingsField &field = fields[i];
+        if(changedOnly && !isChanged(field))
+            continue;
+
+        SettingsRecordHeader &header = *(SettingsRecordHeader *) record;
+        header.id                    = field.id;
+        header.version               = field.version;
+        header.size                  = field.size;
+        header.reserved              = 0;
+        memcpy(record + sizeof(header), data + field.offset, field.size);
+        uint32_t crc = crc32Update(0, record, sizeof(header) + field.size);
+
+        file.write(record, sizeof(header) + field.size);
+        file.write((const uint8_t *) &crc, sizeof(crc));
+        memcpy(shadow + field.offset, data + field.offset, field.size);
+
+        stats.fieldsWritten++;
+        stats.bytesWritten += sizeof(header) + field.size + sizeof(crc);
+    }
+}
+
+bool SettingsStore::isChanged(const SettingsField &field) const {
+    return memcmp(data + field.offset, shadow + field.offset, field.size) != 0;
+}
+
+const SettingsField *SettingsStore::find(uint8_t id) const {
+    for(uint8_t i = 0; i < fieldCount; i++)
+        if(fields[i].id == id)
+            return &fields[i];
+    return NULL;
+}
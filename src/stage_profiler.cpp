@@ -0,0 +1,94 @@
+#include "stage_profiler.h"
+
+#if PROFILE_STAGES
+
+StageHistogram            stageHistograms[STAGE_COUNT];
+
+static const char *const stageNames[STAGE_COUNT] = {
+    "render", "flush", "mqtt", "message", "scale", "step",
+};
+
+void IRAM_ATTR StageHistogram::record(uint32_t cycles) {
+    // Bit length without __builtin_clz, which is a libgcc call from flash here
+    uint8_t  bucket = 0;
+    uint32_t rest   = cycles;
+    if(rest >= 1UL << 16) {
+        bucket += 16;
+        rest  >>= 16;
+    }
+    if(rest >= 1UL << 8) {
+        bucket += 8;
+        rest  >>= 8;
+    }
+    if(rest >= 1UL << 4) {
+        bucket += 4;
+        rest  >>= 4;
+    }
+    if(rest >= 1UL << 2) {
+        bucket += 2;
+        rest  >>= 2;
+    }
+    bucket += rest >= 2 ? 2 : rest;
+
+    buckets[bucket] = buckets[bucket] + 1;
+    count           = count + 1;
+    if(cycles > maxCycles)
+        maxCycles = cycles;
+}
+
+// Cycles below which `rank` of the samples fall, linear inside the bucket
+static uint32_t percentile(const uint32_t *buckets, uint32_t rank) {
+    uint32_t below = 0;
+    for(uint8_t bucket = 0; bucket < PROFILE_BUCKETS; bucket++) {
+        if(below + buckets[bucket] < rank) {
+            below += buckets[bucket];
+            continue;
+        }
+        uint32_t low  = bucket == 0 ? 0 : 1UL << (bucket - 1);
+        uint32_t high = bucket == 0 ? 1 : (bucket == 32 ? UINT32_MAX : (1UL << bucket) - 1);
+        return low + (uint32_t) ((uint64_t) (high - low) * (rank - below) / buckets[bucket]);
+    }
+    return UINT32_MAX;
+}
+
+void StageHistogram::summarize(StageSummary *out) const {
+    uint32_t snapshot[PROFILE_BUCKETS];
+    uint32_t total = 0;
+    for(uint8_t bucket = 0; bucket < PROFILE_BUCKETS; bucket++) {
+        snapshot[bucket]  = buckets[bucket];
+        total            += snapshot[bucket];
+    }
+
+    uint32_t mhz = ESP.getCpuFreqMHz() > 0 ? ESP.getCpuFreqMHz() : 1;
+    uint32_t max = maxCycles;
+    out->count   = total;
+    out->maxUs   = max / mhz;
+    if(total == 0) {
+        out->p50Us = 0;
+        out->p99Us = 0;
+        return;
+    }
+    uint32_t p50 = percentile(snapshot, (total + 1) / 2);
+    uint32_t p99 = percentile(snapshot, total - total / 100);
+    out->p50Us   = (p50 < max ? p50 : max) / mhz;
+    out->p99Us   = (p99 < max ? p99 : max) / mhz;
+}
+
+int formatStages(char *out, size_t size) {
+    size_t used = 0;
+    out[0]      = '\0';
+    for(uint8_t stage = 0; stage < STAGE_COUNT && used < size; stage++) {
+        StageSummary summary;
+        stageHistograms[stage].summarize(&summary);
+        if(summary.count == 0)
+            continue;
+        int written = snprintf(out + used, size - used, "%s%s %lu/%lu/%luus", used > 0 ? ", " : "", stageNames[stage],
+                               (unsigned long) summary.p50Us, (unsigned long) summary.p99Us, (unsigned long) summary.maxUs);
+        if(written < 0)
+            break;
+        used += written;
+    }
+    return used < size ? used : size - 1;
+}
+
+#endif
@@ -0,0 +1,50 @@
+#include "state_outbox.h"
+
+bool StateOutbox::send(GovernedPublish publish, void *entity, float value) {
+    if(online && publish(entity, value)) {
+        forget(publish, entity); // an older value must not be replayed over it
+        return true;
+    }
+    return queue(publish, entity, value);
+}
+
+void StateOutbox::forget(GovernedPublish publish, void *entity) {
+    for(uint8_t i = 0; i < count; i++) {
+        if(entries[i].entity == entity && entries[i].publish == publish) {
+            for(uint8_t j = i + 1; j < count; j++)
+                entries[j - 1] = entries[j];
+            count--;
+            return;
+        }
+    }
+}
+
+bool StateOutbox::queue(GovernedPublish publish, void *entity, float value) {
+    for(uint8_t i = 0; i < count; i++) {
+        if(entries[i].entity == entity && entries[i].publish == publish) {
+            entries[i].value = value;
+            stats.coalesced++;
+            return true;
+        }
+    }
+    if(count == STATE_OUTBOX_SIZE) {
+        stats.overflowed++;
+        return false;
+    }
+    entries[count++] = { publish, entity, value };
+    stats.queued++;
+    return true;
+}
+
+uint8_t StateOutbox::replay() {
+    uint8_t sent = 0;
+    while(online && sent < count && entries[sent].publish(entries[sent].entity, entries[sent].value))
+        sent++;
+    stats.replayed += sent;
+
+    // Keep whatever did not go out, still in order
+    for(uint8_t i = sent; i < count; i++)
+        entries[i - sent] = entries[i];
+    count -= sent;
+    return count;
+}
@@ -0,0 +1,82 @@
+#include "step_engine.h"
+#include "stage_profiler.h"
+
+#include <esp_rom_sys.h>
+#include <hal/gpio_ll.h>
+#include <soc/soc_caps.h>
+
+void StepEngine::begin(uint8_t timerIndex) {
+    pinMode(stepPin, OUTPUT);
+    digitalWrite(stepPin, LOW);
+
+    // Numbered like timerBegin() does, but through the IDF driver: the
+    // Arduino timer HAL registers a flash-resident interrupt
+    group = (timer_group_t) (timerIndex / SOC_TIMER_GROUP_TIMERS_PER_GROUP);
+    index = (timer_idx_t) (timerIndex % SOC_TIMER_GROUP_TIMERS_PER_GROUP);
+
+    timer_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.divider     = 80; // 1 MHz, 1 tick = 1 us
+    config.counter_dir = TIMER_COUNT_UP;
+    config.counter_en  = TIMER_PAUSE; // idle until the first move
+    config.alarm_en    = TIMER_ALARM_EN;
+    config.auto_reload = TIMER_AUTORELOAD_EN;
+    timer_init(group, index, &config);
+    timer_isr_callback_add(group, index, &onTimer, this, ESP_INTR_FLAG_IRAM);
+}
+
+void StepEngine::configure(uint32_t speed, uint32_t accel) {
+    maxSpeed     = speed;
+    acceleration = accel;
+}
+
+bool StepEngine::move(uint32_t count) {
+    if(running || count == 0)
+        return false;
+
+    ramp.configure(maxSpeed, acceleration); // sqrt, keep it out of the ISR
+    portENTER_CRITICAL(&mux);
+    ramp.start(count);
+    steps   = 0;
+    running = true;
+    portEXIT_CRITICAL(&mux);
+
+    // Auto-reload: the counter restarts at every alarm, so each new alarm
+    // value is the exact interval to the next step regardless of ISR latency
+    timer_set_counter_value(group, index, 0);
+    timer_set_alarm_value(group, index, STEP_ENGINE_START_DELAY_US);
+    timer_set_alarm(group, index, TIMER_ALARM_EN);
+    timer_start(group, index);
+    return true;
+}
+
+void StepEngine::stop() {
+    portENTER_CRITICAL(&mux);
+    ramp.stop();
+    portEXIT_CRITICAL(&mux);
+}
+
+// Runs with the flash cache disabled during LittleFS writes: only IRAM
+// functions (the *_in_isr timer calls, StepRamp::next()), inlined
+// register access and ROM code in here
+bool IRAM_ATTR StepEngine::onTimer(void *arg) {
+    PROFILE_SCOPE(STAGE_STEP_ISR);
+    StepEngine *self = static_cast<StepEngine *>(arg);
+
+    portENTER_CRITICAL_ISR(&self->mux);
+    gpio_ll_set_level(&GPIO, (gpio_num_t) self->stepPin, 1);
+    uint32_t interval = self->ramp.next();
+    self->steps++;
+    esp_rom_delay_us(STEP_ENGINE_PULSE_US);
+    gpio_ll_set_level(&GPIO, (gpio_num_t) self->stepPin, 0);
+
+    if(interval == 0) {
+        // The driver re-arms an auto-reload alarm, a paused counter never reaches it
+        timer_group_set_counter_enable_in_isr(self->group, self->index, TIMER_PAUSE);
+        self->running = false;
+    } else {
+        timer_group_set_alarm_value_in_isr(self->group, self->index, interval);
+    }
+    portEXIT_CRITICAL_ISR(&self->mux);
+    return false; // no task to wake
+}
@@ -0,0 +1,63 @@
+#include "step_ramp.h"
+
+#include <math.h>
+
+#define STEP_RAMP_ONE     (1UL << STEP_RAMP_FRACTION_BITS)
+#define STEP_RAMP_MAX_CN  0x3FFFFFFFUL // keeps 2 * cn within 32 bits
+
+void StepRamp::configure(uint32_t maxSpeed, uint32_t acceleration) {
+    if(maxSpeed < 1)
+        maxSpeed = 1;
+    if(maxSpeed > STEP_RAMP_MAX_SPEED)
+        maxSpeed = STEP_RAMP_MAX_SPEED;
+    if(acceleration < 1)
+        acceleration = 1;
+
+    // Float only here, outside of the step interrupt
+    float first = 0.676f * sqrtf(2.0f / acceleration) * 1000000.0f * STEP_RAMP_ONE;
+    c0          = first < STEP_RAMP_MAX_CN ? (uint32_t) first : STEP_RAMP_MAX_CN;
+    cMin        = 1000000UL * STEP_RAMP_ONE / maxSpeed;
+}
+
+void StepRamp::start(uint32_t steps) {
+    stepsLeft = steps;
+    cn        = c0 > cMin ? c0 : cMin;
+    n         = 1;
+    rampSteps = 0;
+    fraction  = 0;
+}
+
+void StepRamp::stop() {
+    if(stepsLeft > rampSteps + 1)
+        stepsLeft = rampSteps + 1;
+}
+
+uint32_t IRAM_ATTR StepRamp::next() {
+    if(stepsLeft == 0 || --stepsLeft == 0)
+        return 0;
+
+    if(n > 0 && rampSteps >= stepsLeft)
+        n = -(int32_t) rampSteps; // start braking
+
+    if(n == 0) {
+        cn = c0;
+    } else if(n > 0) {
+        uint32_t divisor  = 4 * (uint32_t) n + 1;
+        cn               -= (2 * cn + divisor / 2) / divisor; // rounded, truncation would drift
+        if(cn <= cMin)
+            cn = cMin; // cruising, the ramp length stays what it took to get here
+        else
+            rampSteps = n;
+    } else {
+        uint32_t divisor = 4 * (uint32_t) -n - 1;
+        uint32_t delta   = (2 * cn + divisor / 2) / divisor;
+        cn               = cn + delta < STEP_RAMP_MAX_CN ? cn + delta : STEP_RAMP_MAX_CN;
+        rampSteps        = -n - 1;
+    }
+    n++;
+
+    uint32_t interval = cn + fraction;
+    fraction          = interval & (STEP_RAMP_ONE - 1);
+    interval        >>= STEP_RAMP_FRACTION_BITS;
+    return interval > 0 ? interval : 1;
+}
@@ -0,0 +1,132 @@
+#include "subscriptions.h"
+
+#include <LittleFS.h>
+
+bool SubscriptionRegistry::load() {
+    File file = LittleFS.open(SUBSCRIPTIONS_FILE, "r");
+    if(!file)
+        return false;
+
+    memset(filters, 0, sizeof(filters));
+    memset(jsonPaths, 0, sizeof(jsonPaths));
+
+    char     line[TOPIC_MAX_LENGTH + JSON_PATH_MAX_LENGTH + 8];
+    uint16_t length = 0;
+    for(;;) {
+        int c = file.read();
+        if(c < 0 || c == '\n') {
+            uint8_t slot;
+            char    filter[TOPIC_MAX_LENGTH];
+            char    jsonPath[JSON_PATH_MAX_LENGTH];
+            // A line the router has no room left for is skipped
+            if(parseLine(line, length, &slot, filter, jsonPath))
+                set(slot, filter, jsonPath);
+            length = 0;
+            if(c < 0)
+                break;
+        } else if(length < sizeof(line)) {
+            line[length++] = c;
+        }
+    }
+    file.close();
+
+    rebuild();
+    return true;
+}
+
+bool SubscriptionRegistry::save() const {
+    File file = LittleFS.open(SUBSCRIPTIONS_FILE, "w");
+    if(!file)
+        return false;
+
+    for(uint8_t slot = 0; slot < SUBSCRIPTION_COUNT; slot++) {
+        if(filters[slot][0] == '\0')
+            continue;
+        char line[TOPIC_MAX_LENGTH + JSON_PATH_MAX_LENGTH + 8];
+        int  length;
+        if(jsonPaths[slot][0] != '\0')
+            length = snprintf(line, sizeof(line), "%u %s %s\n", slot, filters[slot], jsonPaths[slot]);
+        else
+            length = snprintf(line, sizeof(line), "%u %s\n", slot, filters[slot]);
+        file.write((const uint8_t *) line, length);
+    }
+    file.close();
+    return true;
+}
+
+bool SubscriptionRegistry::set(uint8_t slot, const char *filter, const char *jsonPath) {
+    if(slot >= SUBSCRIPTION_COUNT || strlen(filter) >= TOPIC_MAX_LENGTH || strlen(jsonPath) >= JSON_PATH_MAX_LENGTH)
+        return false;
+
+    if(filter[0] != '\0' && !TopicRouter::isValidFilter(filter))
+        return false;
+
+    char previousFilter[TOPIC_MAX_LENGTH];
+    char previousPath[JSON_PATH_MAX_LENGTH];
+    strcpy(previousFilter, filters[slot]);
+    strcpy(previousPath, jsonPaths[slot]);
+
+    strcpy(filters[slot], filter);
+    strcpy(jsonPaths[slot], filter[0] != '\0' ? jsonPath : "");
+    if(rebuild())
+        return true;
+
+    // Out of trie nodes or name space, keep the table the router can hold
+    strcpy(filters[slot], previousFilter);
+    strcpy(jsonPaths[slot], previousPath);
+    rebuild();
+    return false;
+}
+
+int SubscriptionRegistry::applyCommand(const uint8_t *payload, uint16_t length) {
+    uint8_t slot;
+    char    filter[TOPIC_MAX_LENGTH];
+    char    jsonPath[JSON_PATH_MAX_LENGTH];
+    if(!parseLine((const char *) payload, length, &slot, filter, jsonPath))
+        return -1;
+    if(strcmp(filter, "-") == 0)
+        filter[0] = '\0';
+    return set(slot, filter, jsonPath) ? slot : -1;
+}
+
+// Copies the next space separated token, false if it doesn't fit
+static bool nextToken(const char *line, uint16_t length, uint16_t *i, char *out, uint16_t size) {
+    while(*i < length && line[*i] == ' ') (*i)++;
+    uint16_t start = *i;
+    while(*i < length && line[*i] != ' ' && line[*i] != '\r' && line[*i] != '\n') (*i)++;
+    if(*i - start >= size)
+        return false;
+
+    memcpy(out, line + start, *i - start);
+    out[*i - start] = '\0';
+    return true;
+}
+
+bool SubscriptionRegistry::parseLine(const char *line, uint16_t length, uint8_t *slot, char *filter, char *jsonPath) const {
+    uint16_t i     = 0;
+    unsigned value = 0;
+    while(i < length && line[i] == ' ') i++;
+    if(i == length || line[i] < '0' || line[i] > '9')
+        return false; // blank line or comment
+
+    uint16_t start = i;
+    while(i < length && line[i] >= '0' && line[i] <= '9' && i - start < 3)
+        value = value * 10 + (line[i++] - '0');
+    if(value >= SUBSCRIPTION_COUNT || i == length || line[i] != ' ')
+        return false; // "12abc/x" or a number that goes on
+
+    if(!nextToken(line, length, &i, filter, TOPIC_MAX_LENGTH) || !nextToken(line, length, &i, jsonPath, JSON_PATH_MAX_LENGTH))
+        return false;
+
+    *slot = value;
+    return true;
+}
+
+bool SubscriptionRegistry::rebuild() {
+    bool complete = true;
+    router.clear();
+    for(uint8_t slot = 0; slot < SUBSCRIPTION_COUNT; slot++)
+        if(filters[slot][0] != '\0' && !router.add(filters[slot], slot))
+            complete = false;
+    return complete;
+}
@@ -0,0 +1,37 @@
+#include "task_monitor.h"
+
+void TaskMonitor::begin(uint32_t periodMs) {
+    period          = pdMS_TO_TICKS(periodMs) > 0 ? pdMS_TO_TICKS(periodMs) : 1;
+    periodUs        = period * portTICK_PERIOD_MS * 1000UL;
+    lastWake        = xTaskGetTickCount();
+    runStart        = micros();
+    expectedAt      = runStart;
+    stats.stackFree = uxTaskGetStackHighWaterMark(NULL);
+}
+
+void TaskMonitor::wait() {
+    uint32_t ran = micros() - runStart;
+    if(ran > stats.maxRunUs)
+        stats.maxRunUs = ran;
+    if(stats.iterations++ % TASK_MONITOR_STACK_EVERY == 0)
+        stats.stackFree = uxTaskGetStackHighWaterMark(NULL); // scans the stack, not every round
+
+    vTaskDelayUntil(&lastWake, period);
+
+    runStart     = micros();
+    expectedAt  += periodUs;
+    int32_t late = (int32_t) (runStart - expectedAt);
+    if(late > (int32_t) periodUs) {
+        // Overran a whole period; vTaskDelayUntil() did not wait, so start
+        // counting from here instead of piling up the backlog
+        expectedAt = runStart;
+        lastWake   = xTaskGetTickCount();
+    }
+    if(late > 0)
+        noteLatency(late);
+}
+
+int TaskMonitor::format(char *out, size_t size) const {
+    return snprintf(out, size, "%s it=%lu lat=%luus run=%luus stack=%lu", name, (unsigned long) stats.iterations,
+                    (unsigned long) stats.maxLatencyUs, (unsigned long) stats.maxRunUs, (unsigned long) stats.stackFree);
+}
@@ -0,0 +1,153 @@
+#include "topic_router.h"
+
+#include <string.h>
+
+void TopicRouter::clear() {
+    nodeCount     = 1;
+    namesUsed     = 0;
+    nodes[0]      = {};
+    nodes[0].kind = NODE_LEVEL;
+}
+
+uint8_t TopicRouter::split(const char *topic, Level *levels) {
+    uint8_t count = 0;
+    for(;;) {
+        if(count == TOPIC_MAX_LEVELS)
+            return 0; // too deep to route
+
+        Level &level = levels[count++];
+        level.start  = topic;
+        level.hash   = 2166136261u; // FNV-1a
+        while(*topic && *topic != '/') {
+            level.hash ^= (uint8_t) *topic++;
+            level.hash *= 16777619u;
+        }
+        level.length = topic - level.start;
+
+        if(*topic == '\0')
+            return count;
+        topic++; // skip the separator
+    }
+}
+
+int TopicRouter::findOrAddChild(uint16_t parent, const Level &level) {
+    uint8_t kind = NODE_LEVEL;
+    if(level.length == 1 && level.start[0] == '+')
+        kind = NODE_PLUS;
+    else if(level.length == 1 && level.start[0] == '#')
+        kind = NODE_HASH;
+
+    for(uint16_t i = nodes[parent].child; i != 0; i = nodes[i].sibling) {
+        const Node &node = nodes[i];
+        if(node.kind == kind && node.hash == level.hash && node.nameLength == level.length && memcmp(names + node.name, level.start, level.length) == 0)
+            return i;
+    }
+
+    if(nodeCount == TOPIC_NODE_COUNT || namesUsed + level.length > TOPIC_NAME_POOL)
+        return -1;
+
+    memcpy(names + namesUsed, level.start, level.length);
+    Node &node          = nodes[nodeCount];
+    node.hash           = level.hash;
+    node.name           = namesUsed;
+    node.nameLength     = level.length;
+    node.kind           = kind;
+    node.slots          = 0;
+    node.child          = 0;
+    node.sibling        = nodes[parent].child;
+    nodes[parent].child = nodeCount;
+    namesUsed          += level.length;
+    return nodeCount++;
+}
+
+bool TopicRouter::isValidFilter(const char *filter) {
+    if(filter[0] == '\0')
+        return false;
+
+    for(const char *c = filter; *c; c++) {
+        if(*c != '+' && *c != '#')
+            continue;
+        bool levelStart = c == filter || c[-1] == '/';
+        bool levelEnd   = c[1] == '\0' || c[1] == '/';
+        if(!levelStart || !levelEnd || (*c == '#' && c[1] != '\0'))
+            return false;
+    }
+    return true;
+}
+
+bool TopicRouter::add(const char *filter, uint8_t slot) {
+    if(slot >= TOPIC_SLOT_COUNT || !isValidFilter(filter))
+        return false;
+
+    Level   levels[TOPIC_MAX_LEVELS];
+    uint8_t count = split(filter, levels);
+    if(count == 0)
+        return false;
+
+    uint16_t node = 0;
+    for(uint8_t i = 0; i < count; i++) {
+        int child = findOrAddChild(node, levels[i]);
+        if(child < 0)
+            return false; // pool exhausted
+        node = child;
+    }
+
+    nodes[node].slots |= 1UL << slot;
+    return true;
+}
+
+uint8_t TopicRouter::match(const char *topic, TopicMatchHandler handler, void *context) const {
+    Level   levels[TOPIC_MAX_LEVELS];
+    uint8_t count = split(topic, levels);
+    if(count == 0)
+        return 0;
+    return matchFrom(0, levels, count, 0, handler, context);
+}
+
+uint8_t TopicRouter::notify(uint32_t slots, TopicMatchHandler handler, void *context) {
+    uint8_t count = 0;
+    for(uint8_t slot = 0; slots != 0; slot++, slots >>= 1) {
+        if(slots & 1) {
+            handler(slot, context);
+            count++;
+        }
+    }
+    return count;
+}
+
+uint8_t TopicRouter::matchFrom(uint16_t node, const Level *levels, uint8_t count, uint8_t depth, TopicMatchHandler handler, void *context) const {
+    uint8_t matches = 0;
+
+    if(depth == count) {
+        matches += notify(nodes[node].slots, handler, context);
+        // "a/#" also matches "a" itself
+        for(uint16_t i = nodes[node].child; i != 0; i = nodes[i].sibling)
+            if(nodes[i].kind == NODE_HASH)
+                matches += notify(nodes[i].slots, handler, context);
+        return matches;
+    }
+
+    const Level &level    = levels[depth];
+    bool         reserved = depth == 0 && level.length > 0 && level.start[0] == '$'; // $SYS etc. never match wildcards
+
+    for(uint16_t i = nodes[node].child; i != 0; i = nodes[i].sibling) {
+        const Node &child = nodes[i];
+        switch(child.kind) {
+            case NODE_HASH:
+                if(!reserved)
+                    matches += notify(child.slots, handler, context);
+                break;
+
+            case NODE_PLUS:
+                if(!reserved)
+                    matches += matchFrom(i, levels, count, depth + 1, handler, context);
+                break;
+
+            default:
+                if(child.hash == level.hash && child.nameLength == level.length && memcmp(names + child.name, level.start, level.length) == 0)
+                    matches += matchFrom(i, levels, count, depth + 1, handler, context);
+                break;
+        }
+    }
+    return matches;
+}
@@ -0,0 +1,95 @@
+#include "u8x8_esp32_spi.h"
+
+#include <driver/spi_master.h>
+#include <esp_attr.h>
+
+#define LCD_SPI_HOST       SPI2_HOST
+#define LCD_SPI_CHUNK_DMA  128 // one full display page per transaction
+#define LCD_SPI_CHUNK_FIFO 64  // SPI FIFO size when running without DMA
+
+static spi_device_handle_t lcdSpi     = NULL;
+static uint16_t            lcdChunk   = LCD_SPI_CHUNK_FIFO;
+static uint16_t            lcdPending = 0;
+DMA_ATTR static uint8_t    lcdBuffer[LCD_SPI_CHUNK_DMA];
+
+static void lcdSpiFlush() {
+    if(lcdPending == 0)
+        return;
+
+    spi_transaction_t transaction = {};
+    transaction.length            = lcdPending * 8; // in bits
+    transaction.tx_buffer         = lcdBuffer;
+    spi_device_transmit(lcdSpi, &transaction); // sleeps while the DMA runs
+    lcdPending = 0;
+}
+
+static bool lcdSpiInit(u8x8_t *u8x8) {
+    spi_bus_config_t bus = {};
+    bus.mosi_io_num      = u8x8->pins[U8X8_PIN_SPI_DATA];
+    bus.sclk_io_num      = u8x8->pins[U8X8_PIN_SPI_CLOCK];
+    bus.miso_io_num      = -1;
+    bus.quadwp_io_num    = -1;
+    bus.quadhd_io_num    = -1;
+    bus.max_transfer_sz  = LCD_SPI_CHUNK_DMA;
+
+    if(spi_bus_initialize(LCD_SPI_HOST, &bus, SPI_DMA_CH_AUTO) == ESP_OK) {
+        lcdChunk = LCD_SPI_CHUNK_DMA;
+    } else {
+        bus.max_transfer_sz = LCD_SPI_CHUNK_FIFO;
+        if(spi_bus_initialize(LCD_SPI_HOST, &bus, SPI_DMA_DISABLED) != ESP_OK)
+            return false;
+        lcdChunk = LCD_SPI_CHUNK_FIFO;
+    }
+
+    spi_device_interface_config_t dev = {};
+    dev.clock_speed_hz                = LCD_SPI_CLOCK_HZ;
+    dev.mode                          = u8x8->display_info->spi_mode;
+    dev.spics_io_num                  = -1; // CS is driven by u8x8 around each transfer
+    dev.queue_size                    = 1;
+    return spi_bus_add_device(LCD_SPI_HOST, &dev, &lcdSpi) == ESP_OK;
+}
+
+uint8_t u8x8_byte_esp32_spi(u8x8_t *u8x8, uint8_t msg, uint8_t arg_int, void *arg_ptr) {
+    switch(msg) {
+        case U8X8_MSG_BYTE_INIT:
+            if(lcdSpi == NULL && !lcdSpiInit(u8x8))
+                return 0;
+            u8x8_gpio_SetCS(u8x8, u8x8->display_info->chip_disable_level);
+            break;
+
+        case U8X8_MSG_BYTE_SET_DC:
+            lcdSpiFlush(); // DC applies to everything queued so far
+            u8x8_gpio_SetDC(u8x8, arg_int);
+            break;
+
+        case U8X8_MSG_BYTE_START_TRANSFER:
+            u8x8_gpio_SetCS(u8x8, u8x8->display_info->chip_enable_level);
+            u8x8->gpio_and_delay_cb(u8x8, U8X8_MSG_DELAY_NANO, u8x8->display_info->post_chip_enable_wait_ns, NULL);
+            break;
+
+        case U8X8_MSG_BYTE_SEND: {
+            const uint8_t *data = static_cast<const uint8_t *>(arg_ptr);
+            while(arg_int > 0) {
+                uint16_t room = lcdChunk - lcdPending;
+                uint16_t n    = arg_int < room ? arg_int : room;
+                memcpy(lcdBuffer + lcdPending, data, n);
+                lcdPending += n;
+                data       += n;
+                arg_int    -= n;
+                if(lcdPending == lcdChunk)
+                    lcdSpiFlush();
+            }
+            break;
+        }
+
+        case U8X8_MSG_BYTE_END_TRANSFER:
+            lcdSpiFlush();
+            u8x8->gpio_and_delay_cb(u8x8, U8X8_MSG_DELAY_NANO, u8x8->display_info->pre_chip_disable_wait_ns, NULL);
+            u8x8_gpio_SetCS(u8x8, u8x8->display_info->chip_disable_level);
+            break;
+
+        default:
+            return 0;
+    }
+    return 1;
+}
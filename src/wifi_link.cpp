@@ -0,0 +1,40 @@
+#include "wifi_link.h"
+
+#include <esp_wifi.h>
+
+bool WifiMqttLink::loadCredentials() {
+    wifi_config_t conf;
+    if(esp_wifi_get_config(WIFI_IF_STA, &conf) != ESP_OK || conf.sta.ssid[0] == '\0')
+        return false;
+    strncpy(ssid, (const char *) conf.sta.ssid, sizeof(ssid) - 1);
+    strncpy(psk, (const char *) conf.sta.password, sizeof(psk) - 1);
+    return true;
+}
+
+void WifiMqttLink::begin() {
+    WiFi.setAutoReconnect(false); // LinkManager decides when to retry
+    if(WiFi.status() != WL_CONNECTED || ssid[0] != '\0')
+        return;
+    strncpy(ssid, WiFi.SSID().c_str(), sizeof(ssid) - 1);
+    strncpy(psk, WiFi.psk().c_str(), sizeof(psk) - 1);
+}
+
+void WifiMqttLink::wifiConnect(const uint8_t *bssid, int32_t channel) {
+    WiFi.disconnect(); // abandon an attempt that is still pending
+    if(ssid[0] == '\0')
+        WiFi.begin(); // whatever the portal stored
+    else if(bssid != NULL)
+        WiFi.begin(ssid, psk, channel, bssid); // no scan
+    else
+        WiFi.begin(ssid, psk);
+}
+
+bool WifiMqttLink::wifiLinkInfo(uint8_t *bssid, int32_t *channel, int8_t *rssi) {
+    const uint8_t *current = WiFi.BSSID();
+    if(WiFi.status() != WL_CONNECTED || current == NULL)
+        return false;
+    memcpy(bssid, current, 6);
+    *channel = WiFi.channel();
+    *rssi    = WiFi.RSSI();
+    return true;
+}
@@ -0,0 +1,484 @@
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <AccelStepper.h>
+#include <U8g2lib.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unity.h>
+
+#include "display_transport.h"
+#include "fakes.h"
+#include "glyph_atlas.h"
+#include "payload_parser.h"
+#include "publish_governor.h"
+#include "screen_layout.h"
+#include "series_stats.h"
+#include "settings_store.h"
+#include "spark_series.h"
+#include "step_ramp.h"
+#include "subscriptions.h"
+#include "value_table.h"
+
+// Host benchmarks of the firmware's hot paths. render() and
+// onMqttMessage() live in main.cpp, which needs the real board, so these
+// make the same module calls in the same order. Every result is printed
+// as a "BENCH {...}" line and the whole run is written as a JSON array to
+// $BENCH_RESULTS (bench_results.json by default) for comparing runs.
+
+#define BENCH_RESULTS_FILE "bench_results.json"
+
+struct BenchResult {
+        std::string name;
+        uint32_t    iterations;
+        double      nsPerOp;
+        std::string extra; // more "key":value pairs, already JSON
+};
+
+static std::vector<BenchResult> results;
+
+typedef std::chrono::steady_clock BenchClock;
+
+static double elapsedNs(BenchClock::time_point start) {
+    return std::chrono::duration<double, std::nano>(BenchClock::now() - start).count();
+}
+
+static void record(const char *name, uint32_t iterations, double totalNs, const std::string &extra = "") {
+    BenchResult result = { name, iterations, totalNs / iterations, extra };
+    results.push_back(result);
+    printf("BENCH {\"name\":\"%s\",\"iterations\":%lu,\"ns_per_op\":%.1f%s%s}\n", name, (unsigned long) iterations, result.nsPerOp,
+           extra.empty() ? "" : ",", extra.c_str());
+}
+
+static std::string field(const char *key, double value) {
+    char text[64];
+    snprintf(text, sizeof(text), "\"%s\":%.3f", key, value);
+    return text;
+}
+
+static void writeResults() {
+    const char *path = getenv("BENCH_RESULTS");
+    FILE       *file = fopen(path != NULL ? path : BENCH_RESULTS_FILE, "w");
+    if(file == NULL)
+        return;
+    fprintf(file, "[\n");
+    for(size_t i = 0; i < results.size(); i++) {
+        const BenchResult &result = results[i];
+        fprintf(file, "  {\"name\":\"%s\",\"iterations\":%lu,\"ns_per_op\":%.1f%s%s}%s\n", result.name.c_str(), (unsigned long) result.iterations,
+                result.nsPerOp, result.extra.empty() ? "" : ",", result.extra.c_str(), i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "]\n");
+    fclose(file);
+}
+
+// Screen: the built-in layout of main.cpp
+
+const char defaultLayout[] = "page\n"
+                             "frame 0 0 45 64\n"
+                             "frame 44 0 84 64\n"
+                             "label 3 8 tiny 1 CO\n"
+                             "value 1 28 big -2 0 1 1 10 43 21\n"
+                             "trend 37 3 4 32 0.15\n"
+                             "label 3 61 tiny 1 CWU\n"
+                             "value 1 51 big -2 1 1 1 33 43 20\n"
+                             "trend 37 56 4 33 0.15\n"
+                             "frame 44 0 84 16\n"
+                             "label 46 12 small 0 Kamil\n"
+                             "value 98 12 small -1 2 1 98 2 29 12\n"
+                             "frame 44 15 84 16\n"
+                             "label 47 27 small 0 Magda\n"
+                             "value 98 27 small -1 3 1 98 17 29 12\n"
+                             "frame 44 30 84 16\n"
+                             "label 46 42 small 0 CO/m\n"
+                             "value 98 42 small -1 32 1 98 32 29 12\n"
+                             "frame 44 45 84 16\n"
+                             "label 46 57 small 0 CWU/m\n"
+                             "value 98 57 small -1 33 1 98 47 29 12\n"
+                             "page\n"
+                             "frame 0 0 128 64\n"
+                             "label 4 12 small 0 Scale\n"
+                             "value 4 44 big -2 34 1 2 20 100 28\n"
+                             "label 110 44 small 0 g\n"
+                             "page\n"
+                             "label 1 7 tiny 1 CO\n"
+                             "spark 0 9 128 22 0\n"
+                             "label 1 39 tiny 1 CWU\n"
+                             "spark 0 41 128 22 1\n";
+
+#define SPARK_SPAN_MS (3 * 60 * 60 * 1000UL)
+
+class CountingTransport : public DisplayTransport {
+    public:
+        void writeTiles(uint8_t tx, uint8_t page, uint8_t count, uint8_t *tiles) override { tilesWritten += count; }
+        void setContrast(uint8_t value) override {}
+
+        volatile uint32_t tilesWritten = 0;
+};
+
+U8G2_ST7565_NHD_C12864_F_4W_HW_SPI u8g2(U8G2_R0, 0, 0, 0);
+CountingTransport                  transport;
+DisplayFlusher                     flusher(u8g2, transport);
+GlyphFont                          glyphsPrimary;
+GlyphFont                          glyphsSmall;
+GlyphFont                          glyphsTiny;
+const LayoutFonts                  layoutFonts = {
+    {  u8g2_font_tiny5_tf, u8g2_font_t0_13_tf, u8g2_font_luRS18_tn },
+    {         &glyphsTiny,       &glyphsSmall,      &glyphsPrimary },
+    {         &glyphsTiny,       &glyphsSmall,        &glyphsSmall },
+};
+ScreenLayout                       screenLayout;
+ValueTable                         values;
+SparkSeries<LAYOUT_SPARK_WIDTH>    sparks[2] = { SparkSeries<LAYOUT_SPARK_WIDTH>(SPARK_SPAN_MS / LAYOUT_SPARK_WIDTH),
+                                                 SparkSeries<LAYOUT_SPARK_WIDTH>(SPARK_SPAN_MS / LAYOUT_SPARK_WIDTH) };
+
+static bool sparkColumns(uint8_t slot, SparkColumn *out, uint16_t width, Fixed *low, Fixed *high) {
+    if(slot > 1 || !sparks[slot].columns(millis(), out, width))
+        return false;
+    *low  = sparks[slot].minimum();
+    *high = sparks[slot].maximum();
+    return true;
+}
+
+static void waitPresented() {
+    while(flusher.isBusy())
+        std::this_thread::yield();
+}
+
+// render(): update() -> draw() of the changed widgets -> submit()
+static uint32_t renderFrame() {
+    uint32_t changed = screenLayout.update(values);
+    if(changed == 0)
+        return 0;
+    screenLayout.draw(u8g2, layoutFonts, changed);
+    uint32_t sequence = flusher.submit();
+    return sequence;
+}
+
+static void test_render() {
+    u8g2.begin();
+    glyphsPrimary.build(u8g2, u8g2_font_luRS18_tn);
+    glyphsSmall.build(u8g2, u8g2_font_t0_13_tf);
+    glyphsTiny.build(u8g2, u8g2_font_tiny5_tf);
+    TEST_ASSERT_TRUE(screenLayout.parse(defaultLayout));
+    screenLayout.setSparkSource(sparkColumns, SPARK_SPAN_MS / LAYOUT_SPARK_WIDTH);
+    flusher.begin();
+
+    for(uint32_t t = 0; t < SPARK_SPAN_MS; t += 60000) {
+        sparks[0].add(t, 50000 + (int32_t) (t / 1000 % 7000));
+        sparks[1].add(t, 42000 - (int32_t) (t / 1000 % 5000));
+    }
+    fakeSetMicros((uint64_t) SPARK_SPAN_MS * 1000);
+
+    const uint32_t frames = 2000;
+    for(uint8_t page = 0; page < screenLayout.pageCount(); page++) {
+        screenLayout.showPage(page);
+
+        // Full frames: page change, every widget from the chrome layer up
+        double total = 0;
+        for(uint32_t i = 0; i < frames; i++) {
+            screenLayout.invalidate();
+            BenchClock::time_point start = BenchClock::now();
+            renderFrame();
+            total += elapsedNs(start);
+            waitPresented();
+        }
+        char name[32];
+        snprintf(name, sizeof(name), "render_full_page%u", page);
+        record(name, frames, total);
+
+        // One value changes per frame, the common case
+        uint32_t tilesBefore = transport.tilesWritten;
+        uint32_t drawn       = 0;
+        total                = 0;
+        for(uint32_t i = 0; i < frames; i++) {
+            values.write(i % 2 == 0 ? 0 : 34, (Fixed) (45000 + i * 100), millis());
+            values.write(32, (Fixed) ((int32_t) (i % 5) * 100 - 200), millis());
+            BenchClock::time_point start = BenchClock::now();
+            if(renderFrame() != 0)
+                drawn++;
+            total += elapsedNs(start);
+            waitPresented();
+        }
+        snprintf(name, sizeof(name), "render_partial_page%u", page);
+        record(name, frames, total, field("tiles_per_frame", (double) (transport.tilesWritten - tilesBefore) / frames));
+        TEST_ASSERT_GREATER_THAN(0, drawn);
+    }
+    screenLayout.showPage(0);
+}
+
+// MQTT: onMqttMessage() -> dispatch -> onSlotMessage() per matching slot
+
+typedef SeriesStats<32> TrendSeries;
+
+SubscriptionRegistry subscriptions;
+TrendSeries          trends[2] = { TrendSeries(15 * 60 * 1000UL, 0.2f), TrendSeries(15 * 60 * 1000UL, 0.2f) };
+PublishGovernor      governor;
+uint32_t             publishes = 0;
+uint32_t             rejected  = 0;
+
+static bool countPublish(void *entity, float value) {
+    publishes++;
+    return true;
+}
+
+struct BenchMessage {
+        const char *payload;
+        uint16_t    length;
+        uint32_t    timestamp;
+};
+
+static void onSlot(uint8_t slot, void *context) {
+    const BenchMessage *message  = static_cast<const BenchMessage *>(context);
+    const char         *jsonPath = subscriptions.jsonPath(slot);
+    Fixed               value;
+
+    bool                parsed   = jsonPath[0] != '\0' ? jsonExtractNumber(message->payload, message->length, jsonPath, &value)
+                                                       : parseNumber(message->payload, message->length, &value);
+    if(!parsed) {
+        rejected++;
+        return;
+    }
+    if(slot < 2)
+        sparks[slot].add(message->timestamp, value);
+    values.write(slot, value, message->timestamp);
+    if(slot >= 2)
+        return;
+
+    TrendSeries &trend = trends[slot];
+    trend.add(message->timestamp, fixedToFloat(value));
+    values.write(VALUE_SLOT_COUNT + slot, fixedFromFloat(trend.slope()), message->timestamp);
+    governor.update(slot * 4 + 0, trend.slope(), message->timestamp);
+    governor.update(slot * 4 + 1, trend.ewma(), message->timestamp);
+    governor.update(slot * 4 + 2, trend.minimum(), message->timestamp);
+    governor.update(slot * 4 + 3, trend.maximum(), message->timestamp);
+}
+
+static void benchMessages(const char *name, const char *topic, const char *const *payloads, uint8_t payloadCount) {
+    const uint32_t messages = 200000;
+    uint32_t       now      = 0;
+    uint32_t       sent     = publishes;
+    double         total    = 0;
+
+    for(uint32_t i = 0; i < messages; i++) {
+        const char            *payload = payloads[i % payloadCount];
+        BenchMessage           message = { payload, (uint16_t) strlen(payload), now };
+        BenchClock::time_point start   = BenchClock::now();
+        subscriptions.dispatch(topic, onSlot, &message);
+        total += elapsedNs(start);
+        now   += 10000; // a reading every 10 s
+    }
+    record(name, messages, total, field("publishes_per_message", (double) (publishes - sent) / messages));
+}
+
+static void test_mqtt_message() {
+    TEST_ASSERT_TRUE(subscriptions.set(0, "boiler/co/temperature"));
+    TEST_ASSERT_TRUE(subscriptions.set(1, "zigbee2mqtt/+/cwu", "state.temperature"));
+    TEST_ASSERT_TRUE(subscriptions.set(2, "home/room/kamil/temperature"));
+    TEST_ASSERT_TRUE(subscriptions.set(3, "home/room/magda/temperature"));
+    TEST_ASSERT_TRUE(subscriptions.set(4, "home/+/humidity"));
+    TEST_ASSERT_TRUE(subscriptions.set(5, "weather/#"));
+
+    const PublishPolicy policy = { 0.01f, 10000, 300000 };
+    for(uint8_t handle = 0; handle < 8; handle++)
+        governor.add(handle, countPublish, NULL, policy);
+
+    static const char *const numbers[] = { "52.4", "52.5", " 52.5 ", "53", "5.25e1", "52.6" };
+    static const char *const json[]    = { "{\"battery\":97,\"state\":{\"temperature\":44.1,\"humidity\":40}}",
+                                           "{\"state\":{\"temperature\":\"44.3\"},\"linkquality\":120}",
+                                           "{\"battery\":97,\"state\":{\"temperature\":44.2,\"humidity\":41}}" };
+
+    benchMessages("mqtt_number", "boiler/co/temperature", numbers, 6);
+    benchMessages("mqtt_json", "zigbee2mqtt/boiler/cwu", json, 3);
+    benchMessages("mqtt_unmatched", "home/room/office/temperature", numbers, 6);
+    TEST_ASSERT_EQUAL_UINT32(0, rejected);
+    BenchMessage last = { "52.6", 4, 0 };
+    subscriptions.dispatch("boiler/co/temperature", onSlot, &last);
+    TEST_ASSERT_EQUAL_INT32(52600, values.value(0));
+
+    // The parsers alone
+    const uint32_t         rounds = 1000000;
+    Fixed                  value  = 0;
+    BenchClock::time_point start  = BenchClock::now();
+    for(uint32_t i = 0; i < rounds; i++) {
+        const char *text = numbers[i % 6];
+        parseNumber(text, strlen(text), &value);
+    }
+    record("parse_number", rounds, elapsedNs(start));
+    start = BenchClock::now();
+    for(uint32_t i = 0; i < rounds; i++) {
+        const char *text = json[i % 3];
+        jsonExtractNumber(text, strlen(text), "state.temperature", &value);
+    }
+    record("parse_json_path", rounds, elapsedNs(start));
+    TEST_ASSERT_TRUE(jsonExtractNumber(json[1], strlen(json[1]), "state.temperature", &value));
+    TEST_ASSERT_EQUAL_INT32(44300, value);
+}
+
+// A value from the table to the text drawWidget() puts on screen, and the
+// float path it replaced. On the FPU-less C3 every float operation is a
+// libgcc call, so the host ratio understates the gap.
+
+static void test_value_formatting() {
+    const uint32_t rounds = 1000000;
+    char           intPart[12], fracPart[8], text[24];
+    uint32_t       length = 0;
+
+    BenchClock::time_point start = BenchClock::now();
+    for(uint32_t i = 0; i < rounds; i++) {
+        Fixed value = (Fixed) (i * 7919u % 200000u) - 100000;
+        formatFixed(fixedRescale(value, 1), 1, intPart, fracPart);
+        length += strlen(intPart) + strlen(fracPart);
+    }
+    record("format_fixed", rounds, elapsedNs(start));
+
+    start = BenchClock::now();
+    for(uint32_t i = 0; i < rounds; i++) {
+        float value = ((int32_t) (i * 7919u % 200000u) - 100000) / 1000.0f;
+        length     += snprintf(text, sizeof(text), "%.1f", value);
+    }
+    record("format_float", rounds, elapsedNs(start));
+
+    start       = BenchClock::now();
+    Fixed fixed = 0;
+    for(uint32_t i = 0; i < rounds; i++)
+        fixed += fixedFromFloat(i * 0.001f) & 1;
+    record("fixed_from_float", rounds, elapsedNs(start));
+    TEST_ASSERT_GREATER_THAN(0, length + fixed);
+}
+
+// Settings: the persisted part of main.cpp's config struct
+
+struct BenchSettings {
+        char     server[64];
+        uint32_t port;
+        char     user[64];
+        char     password[64];
+        uint8_t  contrast;
+        uint8_t  backlight;
+        float    stepperSpeed;
+        float    stepperAccel;
+        float    rotations;
+        float    gramsPerRotation;
+        float    maxGrams;
+        float    calibration;
+        int32_t  tare;
+};
+
+#define BENCH_FIELD(id, member) { id, 1, sizeof(((BenchSettings *) 0)->member), offsetof(BenchSettings, member), -1, NULL }
+
+const SettingsField benchFields[] = {
+    BENCH_FIELD(1, server),
+    BENCH_FIELD(2, port),
+    BENCH_FIELD(3, user),
+    BENCH_FIELD(4, password),
+    BENCH_FIELD(5, contrast),
+    BENCH_FIELD(6, backlight),
+    BENCH_FIELD(7, stepperSpeed),
+    BENCH_FIELD(8, stepperAccel),
+    BENCH_FIELD(10, rotations),
+    BENCH_FIELD(11, gramsPerRotation),
+    BENCH_FIELD(12, maxGrams),
+    BENCH_FIELD(13, calibration),
+    BENCH_FIELD(14, tare),
+};
+
+static void test_settings() {
+    fakeFsReset();
+    BenchSettings settings = {};
+    strcpy(settings.server, "192.168.1.10");
+    settings.port = 1883;
+    SettingsStore store(&settings, sizeof(settings), benchFields, sizeof(benchFields) / sizeof(benchFields[0]));
+    store.load();
+
+    // One slider drag: a single field changes per save
+    const uint32_t         saves = 5000;
+    BenchClock::time_point start = BenchClock::now();
+    for(uint32_t i = 0; i < saves; i++) {
+        settings.stepperSpeed = 100.0f + i;
+        store.requestSave();
+        store.flush();
+    }
+    std::string extra = field("bytes_per_save", (double) store.stats.bytesWritten / saves) + "," +
+                        field("compactions", store.stats.compactions);
+    record("settings_save", saves, elapsedNs(start), extra);
+
+    const uint32_t loads = 5000;
+    start                = BenchClock::now();
+    for(uint32_t i = 0; i < loads; i++) {
+        SettingsStore reader(&settings, sizeof(settings), benchFields, sizeof(benchFields) / sizeof(benchFields[0]));
+        reader.load();
+    }
+    record("settings_load", loads, elapsedNs(start));
+
+    BenchSettings loaded = {};
+    SettingsStore reader(&loaded, sizeof(loaded), benchFields, sizeof(benchFields) / sizeof(benchFields[0]));
+    reader.load();
+    TEST_ASSERT_EQUAL_MEMORY(&settings, &loaded, sizeof(settings));
+}
+
+// Steps: StepRamp against the AccelStepper timing it replaced
+
+static void test_step_generation() {
+    const uint32_t speed = 2000, accel = 4000, steps = 3200;
+
+    StepRamp       ramp;
+    ramp.configure(speed, accel);
+    std::vector<uint32_t>  intervals;
+    BenchClock::time_point start = BenchClock::now();
+    const uint32_t         moves = 200;
+    for(uint32_t move = 0; move < moves; move++) {
+        intervals.clear();
+        ramp.start(steps);
+        uint32_t interval;
+        while((interval = ramp.next()) != 0)
+            intervals.push_back(interval);
+    }
+    record("step_ramp_next", moves * steps, elapsedNs(start));
+
+    // AccelStepper steps when polled; poll it every microsecond
+    fakeSetMicros(0);
+    AccelStepper reference;
+    reference.setMaxSpeed(speed);
+    reference.setAcceleration(accel);
+    reference.move(steps);
+    start = BenchClock::now();
+    while(reference.run())
+        fakeAdvanceMicros(1);
+    const std::vector<unsigned long> &times = reference.stepTimes();
+    record("accelstepper_run_poll", times.size(), elapsedNs(start));
+
+    TEST_ASSERT_EQUAL_UINT32(steps - 1, intervals.size());
+    TEST_ASSERT_EQUAL_UINT32(steps, times.size());
+
+    uint64_t rampTotal = 0;
+    uint32_t worst     = 0;
+    for(uint32_t i = 0; i < intervals.size(); i++) {
+        uint32_t expected = times[i + 1] - times[i];
+        uint32_t error    = intervals[i] > expected ? intervals[i] - expected : expected - intervals[i];
+        if(error > worst)
+            worst = error;
+        rampTotal += intervals[i];
+    }
+    uint64_t    referenceTotal = times.back() - times.front();
+    double      deviation      = 100.0 * ((double) rampTotal - (double) referenceTotal) / referenceTotal;
+    std::string extra          = field("move_us", (double) rampTotal) + "," + field("reference_move_us", (double) referenceTotal) + "," +
+                        field("duration_delta_pct", deviation) + "," + field("worst_interval_error_us", worst);
+    record("step_ramp_vs_accelstepper", steps, 0, extra);
+    TEST_ASSERT_FLOAT_WITHIN(1.0, 0.0, deviation);
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_render);
+    RUN_TEST(test_mqtt_message);
+    RUN_TEST(test_value_formatting);
+    RUN_TEST(test_settings);
+    RUN_TEST(test_step_generation);
+    writeResults();
+    return UNITY_END();
+}
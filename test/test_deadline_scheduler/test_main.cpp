@@ -0,0 +1,174 @@
+#include <Arduino.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unity.h>
+
+#include "deadline_scheduler.h"
+
+// Heap order against a plain array under random schedule/cancel, and the
+// daily deadlines in a European time zone across both DST changes
+
+#define SPRING_DAY 1774742400UL // 2026-03-29 00:00 UTC, CET -> CEST at 01:00 UTC
+#define AUTUMN_DAY 1792886400UL // 2026-10-25 00:00 UTC, CEST -> CET at 01:00 UTC
+
+void setUp() {
+    setenv("TZ", "CET-1CEST,M3.5.0,M10.5.0/3", 1);
+    tzset();
+}
+
+void tearDown() {}
+
+static void test_next_is_the_earliest_deadline() {
+    DeadlineScheduler scheduler;
+    uint8_t           job;
+    uint32_t          due;
+    TEST_ASSERT_FALSE(scheduler.next(&job, &due));
+
+    scheduler.schedule(3, 300);
+    scheduler.schedule(1, 100);
+    scheduler.schedule(2, 200);
+    TEST_ASSERT_TRUE(scheduler.next(&job, &due));
+    TEST_ASSERT_EQUAL_UINT8(1, job);
+    TEST_ASSERT_EQUAL_UINT32(100, due);
+
+    TEST_ASSERT_EQUAL_INT(-1, scheduler.popDue(99, &due));
+    TEST_ASSERT_EQUAL_INT(1, scheduler.popDue(250, &due));
+    TEST_ASSERT_EQUAL_INT(2, scheduler.popDue(250, &due));
+    TEST_ASSERT_EQUAL_UINT32(200, due);
+    TEST_ASSERT_EQUAL_INT(-1, scheduler.popDue(250, &due));
+    TEST_ASSERT_TRUE(scheduler.isScheduled(3));
+    TEST_ASSERT_FALSE(scheduler.isScheduled(1));
+}
+
+static void test_rescheduling_moves_the_job() {
+    DeadlineScheduler scheduler;
+    scheduler.schedule(0, 100);
+    scheduler.schedule(1, 200);
+    scheduler.schedule(2, 300);
+
+    scheduler.schedule(0, 400); // later: sinks
+    scheduler.schedule(2, 50);  // earlier: rises
+
+    uint32_t due;
+    TEST_ASSERT_EQUAL_INT(2, scheduler.popDue(1000, &due));
+    TEST_ASSERT_EQUAL_INT(1, scheduler.popDue(1000, &due));
+    TEST_ASSERT_EQUAL_INT(0, scheduler.popDue(1000, &due));
+    TEST_ASSERT_EQUAL_UINT32(400, due);
+    TEST_ASSERT_EQUAL_INT(-1, scheduler.popDue(1000, &due)); // each job once
+}
+
+static void test_cancel_and_bad_ids() {
+    DeadlineScheduler scheduler;
+    scheduler.schedule(4, 10);
+    scheduler.schedule(5, 20);
+    scheduler.cancel(4);
+    scheduler.cancel(4);  // not scheduled any more
+    scheduler.cancel(200);
+    scheduler.schedule(SCHEDULER_MAX_JOBS, 1);
+    TEST_ASSERT_FALSE(scheduler.isScheduled(SCHEDULER_MAX_JOBS));
+
+    uint32_t due;
+    TEST_ASSERT_FALSE(scheduler.deadline(4, &due));
+    TEST_ASSERT_TRUE(scheduler.deadline(5, &due));
+    TEST_ASSERT_EQUAL_UINT32(20, due);
+    TEST_ASSERT_EQUAL_INT(5, scheduler.popDue(100, &due));
+    TEST_ASSERT_EQUAL_INT(-1, scheduler.popDue(100, &due));
+}
+
+static void test_random_operations_match_reference() {
+    DeadlineScheduler scheduler;
+    uint32_t          reference[SCHEDULER_MAX_JOBS];
+    bool              scheduled[SCHEDULER_MAX_JOBS] = {};
+    srand(7);
+
+    for(uint32_t round = 0; round < 20000; round++) {
+        uint8_t job = rand() % SCHEDULER_MAX_JOBS;
+        switch(rand() % 4) {
+        case 0:
+        case 1:
+            reference[job] = rand() % 1000; // ties too
+            scheduled[job] = true;
+            scheduler.schedule(job, reference[job]);
+            break;
+        case 2:
+            scheduled[job] = false;
+            scheduler.cancel(job);
+            break;
+        default: {
+            uint32_t now = rand() % 1000, due;
+            int      popped = scheduler.popDue(now, &due);
+            if(popped >= 0) {
+                TEST_ASSERT_TRUE(scheduled[popped]);
+                TEST_ASSERT_EQUAL_UINT32(reference[popped], due);
+                scheduled[popped] = false;
+            }
+            for(uint8_t other = 0; other < SCHEDULER_MAX_JOBS; other++)
+                if(scheduled[other])
+                    TEST_ASSERT_TRUE(popped >= 0 ? reference[other] >= due : reference[other] > now);
+        }
+        }
+
+        // The earliest and every deadline agree with the reference
+        uint8_t  first;
+        uint32_t earliest, due;
+        bool     any = scheduler.next(&first, &earliest);
+        bool     expected = false;
+        for(uint8_t other = 0; other < SCHEDULER_MAX_JOBS; other++) {
+            TEST_ASSERT_EQUAL(scheduled[other], scheduler.isScheduled(other));
+            if(!scheduled[other])
+                continue;
+            expected = true;
+            TEST_ASSERT_TRUE(scheduler.deadline(other, &due));
+            TEST_ASSERT_EQUAL_UINT32(reference[other], due);
+            TEST_ASSERT_TRUE(any && earliest <= reference[other]);
+        }
+        TEST_ASSERT_EQUAL(expected, any);
+        if(any)
+            TEST_ASSERT_EQUAL_UINT32(reference[first], earliest);
+    }
+}
+
+static void test_daily_deadline_on_ordinary_days() {
+    uint32_t morning = SPRING_DAY - 7 * 86400 + 6 * 3600; // 07:00 CET a week before
+    TEST_ASSERT_EQUAL_UINT32(morning + 3600, nextDailyDeadline(morning, 8 * 60));
+    TEST_ASSERT_EQUAL_UINT32(morning + 3600 - 86400, lastDailyDeadline(morning, 8 * 60));
+    // Exactly at the deadline: it is the last one, the next is tomorrow
+    TEST_ASSERT_EQUAL_UINT32(morning, lastDailyDeadline(morning, 7 * 60));
+    TEST_ASSERT_EQUAL_UINT32(morning + 86400, nextDailyDeadline(morning, 7 * 60));
+}
+
+static void test_daily_deadline_across_spring_forward() {
+    // 08:00 falls 23 h after the one the day before
+    uint32_t before = SPRING_DAY - 86400 + 7 * 3600; // 08:00 CET on the 28th
+    uint32_t next   = nextDailyDeadline(before, 8 * 60);
+    TEST_ASSERT_EQUAL_UINT32(before + 23 * 3600, next);
+    TEST_ASSERT_EQUAL_UINT32(before, lastDailyDeadline(next - 1, 8 * 60));
+
+    // 02:30 doesn't exist that day, it fires at 03:30 CEST instead
+    uint32_t midnight = SPRING_DAY - 3600;
+    TEST_ASSERT_EQUAL_UINT32(SPRING_DAY + 3600 + 1800, nextDailyDeadline(midnight, 2 * 60 + 30));
+}
+
+static void test_daily_deadline_across_fall_back() {
+    uint32_t before = AUTUMN_DAY - 2 * 3600 + 8 * 3600 - 86400; // 08:00 CEST on the 24th
+    uint32_t next   = nextDailyDeadline(before, 8 * 60);
+    TEST_ASSERT_EQUAL_UINT32(before + 25 * 3600, next);
+    TEST_ASSERT_EQUAL_UINT32(before, lastDailyDeadline(next - 1, 8 * 60));
+    TEST_ASSERT_EQUAL_UINT32(next, lastDailyDeadline(next, 8 * 60));
+
+    // Midnight to midnight is 25 h
+    uint32_t midnight = AUTUMN_DAY - 2 * 3600;
+    TEST_ASSERT_EQUAL_UINT32(midnight + 25 * 3600, nextDailyDeadline(midnight, 0));
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_next_is_the_earliest_deadline);
+    RUN_TEST(test_rescheduling_moves_the_job);
+    RUN_TEST(test_cancel_and_bad_ids);
+    RUN_TEST(test_random_operations_match_reference);
+    RUN_TEST(test_daily_deadline_on_ordinary_days);
+    RUN_TEST(test_daily_deadline_across_spring_forward);
+    RUN_TEST(test_daily_deadline_across_fall_back);
+    return UNITY_END();
+}
@@ -0,0 +1,187 @@
+#include <Arduino.h>
+#include <math.h>
+#include <unity.h>
+
+#include "dispense_controller.h"
+
+// The controller driving a simulated auger into a simulated scale. Food
+// leaves the auger in proportion to the steps turned, lands after a short
+// fall and shows up through the filter's lag; the motor brakes a few
+// steps after a stop. Loops every 10 ms like feedLoop().
+
+#define STEPS_PER_REV 3200
+#define TICK_MS       10
+
+struct Rig {
+        float    gramsPerStep     = 5.0f / STEPS_PER_REV; // what the auger really delivers
+        uint32_t stepsPerTick     = 16;                   // full speed, 1600 steps/s
+        uint32_t slowStepsPerTick = 4;
+        uint32_t brakeSteps       = 40;                   // steps after a stop
+        uint32_t fallTicks        = 30;                   // 300 ms from the auger to the bowl
+        float    filterAlpha      = 0.15f;                // scale filter lag per tick
+        float    noise            = 0.0f;                 // g, alternating
+        bool     neverSettles     = false;
+
+        // State
+        uint32_t now          = 0;
+        float    inFlight[64] = {};
+        float    bowl         = 12.0f; // whatever was left in the bowl
+        float    reading      = 12.0f;
+        float    recent[20]   = {};
+        uint32_t left         = 0; // steps of the running move
+        uint32_t stepped      = 0;
+        bool     slow         = false;
+        uint32_t moves        = 0;
+        uint32_t stops        = 0;
+
+        void tick() {
+            uint32_t steps = 0;
+            if(left > 0) {
+                steps    = min(left, slow ? slowStepsPerTick : stepsPerTick);
+                left    -= steps;
+                stepped += steps;
+            }
+            uint32_t index = now / TICK_MS;
+            bowl          += inFlight[index % fallTicks];
+            inFlight[index % fallTicks] = steps * gramsPerStep;
+            float measured = bowl + (index % 2 ? noise : -noise);
+            reading       += filterAlpha * (measured - reading);
+            recent[index % 20] = reading;
+            now           += TICK_MS;
+        }
+
+        bool settled() const {
+            if(neverSettles || left > 0)
+                return false;
+            float low = recent[0], high = recent[0];
+            for(float value : recent) {
+                low  = min(low, value);
+                high = max(high, value);
+            }
+            return high - low < 0.2f;
+        }
+
+        // Runs a feed to its end, returns the last command
+        DispenseCommand feed(DispenseController &controller, float target, float estimate) {
+            controller.start(target, estimate, STEPS_PER_REV, now);
+            for(uint32_t end = now + 2 * DISPENSE_TIMEOUT; now < end;) {
+                tick();
+                DispenseAction action = controller.update(now, reading, settled(), left > 0, stepped);
+                if(action.command == DISPENSE_MOVE) {
+                    left    = action.steps;
+                    stepped = 0;
+                    slow    = action.slow;
+                    moves++;
+                } else if(action.command == DISPENSE_STOP) {
+                    left = min(left, brakeSteps);
+                    stops++;
+                } else if(action.command == DISPENSE_DONE || action.command == DISPENSE_FAILED) {
+                    return action.command;
+                }
+            }
+            return DISPENSE_WAIT;
+        }
+
+        // Settled weight once everything has landed
+        float finalBowl() {
+            for(uint32_t i = 0; i < fallTicks * 2; i++)
+                tick();
+            return bowl;
+        }
+};
+
+void setUp() {}
+
+void tearDown() {}
+
+static void test_good_estimate_lands_within_tolerance() {
+    Rig                rig;
+    DispenseController controller;
+    float              before = rig.bowl;
+    TEST_ASSERT_EQUAL_INT(DISPENSE_DONE, rig.feed(controller, 20.0f, 5.0f));
+    float fed = rig.finalBowl() - before;
+    TEST_ASSERT_FLOAT_WITHIN(DISPENSE_TOLERANCE, 20.0f, fed);
+    TEST_ASSERT_FLOAT_WITHIN(0.3f, fed, controller.dispensed());
+    TEST_ASSERT_LESS_OR_EQUAL(3, rig.moves);
+}
+
+static void test_underestimated_rate_brakes_on_the_scale() {
+    Rig rig;
+    rig.gramsPerStep = 10.0f / STEPS_PER_REV; // twice what the firmware thinks
+    DispenseController controller;
+    float              before = rig.bowl;
+    TEST_ASSERT_EQUAL_INT(DISPENSE_DONE, rig.feed(controller, 20.0f, 5.0f));
+    TEST_ASSERT_EQUAL_UINT32(1, rig.stops);
+    // Lag and braking overshoot, but far less than the 36 g a blind move would give
+    TEST_ASSERT_LESS_THAN(26.0f, rig.finalBowl() - before);
+    TEST_ASSERT_GREATER_THAN(5.0f, controller.learnedGramsPerRotation());
+}
+
+static void test_overestimated_rate_tops_up_slowly() {
+    Rig rig;
+    rig.gramsPerStep = 2.5f / STEPS_PER_REV; // half
+    DispenseController controller;
+    float              before = rig.bowl;
+    TEST_ASSERT_EQUAL_INT(DISPENSE_DONE, rig.feed(controller, 20.0f, 5.0f));
+    TEST_ASSERT_FLOAT_WITHIN(DISPENSE_TOLERANCE, 20.0f, rig.finalBowl() - before);
+    TEST_ASSERT_GREATER_THAN(1, rig.moves);
+    TEST_ASSERT_TRUE(rig.slow); // the last move was a top-up
+    TEST_ASSERT_LESS_THAN(5.0f, controller.learnedGramsPerRotation());
+}
+
+static void test_estimate_converges_over_feeds() {
+    Rig rig;
+    rig.gramsPerStep = 7.0f / STEPS_PER_REV;
+    float estimate   = 4.0f;
+    for(uint8_t i = 0; i < 6; i++) {
+        DispenseController controller;
+        TEST_ASSERT_EQUAL_INT(DISPENSE_DONE, rig.feed(controller, 25.0f, estimate));
+        rig.finalBowl();
+        estimate = controller.learnedGramsPerRotation();
+    }
+    TEST_ASSERT_FLOAT_WITHIN(0.7f, 7.0f, estimate);
+}
+
+static void test_empty_hopper_fails_fast() {
+    Rig rig;
+    rig.gramsPerStep = 0.0f;
+    DispenseController controller;
+    TEST_ASSERT_EQUAL_INT(DISPENSE_FAILED, rig.feed(controller, 20.0f, 5.0f));
+    TEST_ASSERT_LESS_OR_EQUAL(2, rig.moves);
+    TEST_ASSERT_FLOAT_WITHIN(0.2f, 0.0f, controller.dispensed());
+    TEST_ASSERT_EQUAL_FLOAT(5.0f, controller.learnedGramsPerRotation()); // nothing learned
+}
+
+static void test_noisy_scale_still_finishes() {
+    Rig rig;
+    rig.noise        = 0.4f;
+    rig.neverSettles = true; // every wait ends on the settle timeout
+    DispenseController controller;
+    float              before = rig.bowl;
+    TEST_ASSERT_EQUAL_INT(DISPENSE_DONE, rig.feed(controller, 20.0f, 5.0f));
+    TEST_ASSERT_FLOAT_WITHIN(1.5f, 20.0f, rig.finalBowl() - before);
+    TEST_ASSERT_LESS_THAN(DISPENSE_TIMEOUT, rig.now);
+}
+
+static void test_cancel_stops_answering() {
+    Rig                rig;
+    DispenseController controller;
+    controller.start(20.0f, 5.0f, STEPS_PER_REV, 0);
+    TEST_ASSERT_TRUE(controller.isActive());
+    controller.cancel();
+    TEST_ASSERT_FALSE(controller.isActive());
+    DispenseAction action = controller.update(100, 0.0f, true, false, 0);
+    TEST_ASSERT_EQUAL_INT(DISPENSE_WAIT, action.command);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_good_estimate_lands_within_tolerance);
+    RUN_TEST(test_underestimated_rate_brakes_on_the_scale);
+    RUN_TEST(test_overestimated_rate_tops_up_slowly);
+    RUN_TEST(test_estimate_converges_over_feeds);
+    RUN_TEST(test_empty_hopper_fails_fast);
+    RUN_TEST(test_noisy_scale_still_finishes);
+    RUN_TEST(test_cancel_stops_answering);
+    return UNITY_END();
+}
@@ -0,0 +1,128 @@
+#include <Arduino.h>
+#include <U8g2lib.h>
+#include <atomic>
+#include <thread>
+#include <unity.h>
+
+#include "display_transport.h"
+
+// The flush task against a transport that records what reaches the
+// panel. It can be held mid-frame to check that the loop keeps drawing
+// into the back buffer without tearing the frame being sent.
+
+class PanelTransport : public DisplayTransport {
+    public:
+        void writeTiles(uint8_t tx, uint8_t page, uint8_t count, uint8_t *tiles) override {
+            while(hold.load())
+                std::this_thread::yield();
+            memcpy(panel + (page * FRAME_TILE_WIDTH + tx) * 8, tiles, count * 8);
+            tilesWritten += count;
+            writes++;
+        }
+        void setContrast(uint8_t value) override { contrast = value; }
+
+        uint8_t               panel[FRAME_BUFFER_SIZE] = {};
+        std::atomic<bool>     hold{ false };
+        std::atomic<uint32_t> tilesWritten{ 0 };
+        std::atomic<uint32_t> writes{ 0 };
+        std::atomic<int>      contrast{ -1 };
+};
+
+U8G2_ST7565_NHD_C12864_F_4W_HW_SPI u8g2(U8G2_R0, 0, 0, 0);
+
+static void waitPresented(DisplayFlusher &flusher, uint32_t sequence) {
+    for(uint32_t i = 0; i < 100000 && !flusher.isPresented(sequence); i++)
+        std::this_thread::yield();
+    TEST_ASSERT_TRUE(flusher.isPresented(sequence));
+}
+
+void setUp() {
+    u8g2.begin();
+    u8g2.clearBuffer();
+}
+
+void tearDown() {}
+
+static void test_first_frame_sends_everything() {
+    PanelTransport panel;
+    DisplayFlusher flusher(u8g2, panel);
+    flusher.begin();
+
+    u8g2.drawBox(10, 10, 30, 20);
+    flusher.present();
+    TEST_ASSERT_EQUAL_UINT32(FRAME_TILE_WIDTH * FRAME_TILE_HEIGHT, panel.tilesWritten.load());
+    TEST_ASSERT_EQUAL_MEMORY(u8g2.getBufferPtr(), panel.panel, FRAME_BUFFER_SIZE);
+    TEST_ASSERT_EQUAL_UINT32(FRAME_BUFFER_SIZE, flusher.stats.bytesSent);
+}
+
+static void test_only_changed_span_is_sent() {
+    PanelTransport panel;
+    DisplayFlusher flusher(u8g2, panel);
+    flusher.begin();
+    flusher.present();
+    uint32_t tiles = panel.tilesWritten.load();
+
+    // Two pixels on page 2, tiles 3 and 6: one write of tiles 3..6
+    u8g2.drawPixel(3 * 8, 2 * 8 + 1);
+    u8g2.drawPixel(6 * 8 + 7, 2 * 8 + 5);
+    uint32_t sequence = flusher.submit();
+    TEST_ASSERT_NOT_EQUAL(0, sequence);
+    waitPresented(flusher, sequence);
+    TEST_ASSERT_EQUAL_UINT32(4, panel.tilesWritten.load() - tiles);
+    TEST_ASSERT_EQUAL_MEMORY(u8g2.getBufferPtr(), panel.panel, FRAME_BUFFER_SIZE);
+
+    // Nothing changed: no new frame, the same sequence comes back
+    uint32_t writes = panel.writes.load();
+    TEST_ASSERT_EQUAL_UINT32(sequence, flusher.submit());
+    TEST_ASSERT_FALSE(flusher.isBusy());
+    TEST_ASSERT_EQUAL_UINT32(writes, panel.writes.load());
+}
+
+static void test_busy_flush_refuses_and_does_not_tear() {
+    PanelTransport panel;
+    DisplayFlusher flusher(u8g2, panel);
+    flusher.begin();
+    flusher.present();
+
+    panel.hold = true;
+    u8g2.drawBox(0, 0, 128, 8); // page 0 only
+    uint32_t first = flusher.submit();
+    TEST_ASSERT_NOT_EQUAL(0, first);
+    TEST_ASSERT_TRUE(flusher.isBusy());
+
+    // The loop draws the next frame meanwhile
+    uint8_t sent[FRAME_BUFFER_SIZE];
+    memcpy(sent, u8g2.getBufferPtr(), sizeof(sent));
+    u8g2.clearBuffer();
+    u8g2.drawBox(0, 56, 128, 8);
+    TEST_ASSERT_EQUAL_UINT32(0, flusher.submit());
+
+    panel.hold = false;
+    waitPresented(flusher, first);
+    TEST_ASSERT_EQUAL_MEMORY(sent, panel.panel, FRAME_BUFFER_SIZE); // the frame as submitted
+
+    uint32_t second = flusher.submit();
+    TEST_ASSERT_EQUAL_UINT32(first + 1, second);
+    waitPresented(flusher, second);
+    TEST_ASSERT_EQUAL_MEMORY(u8g2.getBufferPtr(), panel.panel, FRAME_BUFFER_SIZE);
+}
+
+static void test_contrast_goes_through_the_flush_task() {
+    PanelTransport panel;
+    DisplayFlusher flusher(u8g2, panel);
+    flusher.begin();
+    flusher.setContrast(42);
+    for(uint32_t i = 0; i < 100000 && panel.contrast.load() < 0; i++)
+        std::this_thread::yield();
+    TEST_ASSERT_EQUAL_INT(42, panel.contrast.load());
+    TEST_ASSERT_EQUAL_UINT32(0, panel.writes.load());
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_first_frame_sends_everything);
+    RUN_TEST(test_only_changed_span_is_sent);
+    RUN_TEST(test_busy_flush_refuses_and_does_not_tear);
+    RUN_TEST(test_contrast_goes_through_the_flush_task);
+    return UNITY_END();
+}
@@ -0,0 +1,198 @@
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unity.h>
+
+#include "deadline_scheduler.h"
+#include "fakes.h"
+#include "feed_ledger.h"
+
+// Feed ledger totals, what survives a reboot, and the day boundary
+// around DST changes in a European time zone
+
+#define T0         1767225600UL // 2026-01-01 00:00 UTC
+#define SPRING_DAY 1774742400UL // 2026-03-29 00:00 UTC, CET -> CEST at 01:00 UTC
+#define AUTUMN_DAY 1792886400UL // 2026-10-25 00:00 UTC, CEST -> CET at 01:00 UTC
+
+static Fixed grams(float value) {
+    return fixedFromFloat(value);
+}
+
+// What the next boot sees
+static void reboot(FeedLedger &ledger) {
+    ledger = FeedLedger();
+    ledger.begin();
+}
+
+void setUp() {
+    fakeFsReset();
+    setenv("TZ", "CET-1CEST,M3.5.0,M10.5.0/3", 1);
+    tzset();
+}
+
+void tearDown() {}
+
+static void test_totals_follow_the_rolling_window() {
+    FeedLedger ledger;
+    ledger.begin();
+    ledger.startDay(T0);
+
+    ledger.record(T0 + 3600, grams(10.0f));
+    ledger.record(T0 + 7200, grams(5.0f));
+    TEST_ASSERT_EQUAL_INT32(grams(15.0f), ledger.rollingTotal());
+    TEST_ASSERT_EQUAL_INT32(grams(15.0f), ledger.dayTotal());
+
+    ledger.advance(T0 + 3600 + FEED_WINDOW_S - 1);
+    TEST_ASSERT_EQUAL_UINT8(2, ledger.size());
+    ledger.advance(T0 + 3600 + FEED_WINDOW_S);
+    TEST_ASSERT_EQUAL_UINT8(1, ledger.size());
+    TEST_ASSERT_EQUAL_INT32(grams(5.0f), ledger.rollingTotal());
+
+    uint32_t oldest;
+    TEST_ASSERT_TRUE(ledger.oldest(&oldest));
+    TEST_ASSERT_EQUAL_UINT32(T0 + 7200, oldest);
+}
+
+static void test_ring_wraps_at_its_size() {
+    FeedLedger ledger;
+    ledger.begin();
+    ledger.startDay(T0);
+
+    // More feeds than slots within one window: the oldest are overwritten
+    for(uint32_t i = 0; i < FEED_LEDGER_ENTRIES + 6; i++) {
+        ledger.record(T0 + i * 60, grams(1.0f + i));
+        if(i + 1 >= FEED_LEDGER_ENTRIES)
+            TEST_ASSERT_TRUE(ledger.isFull());
+    }
+    float expected = 0;
+    for(uint32_t i = 6; i < FEED_LEDGER_ENTRIES + 6; i++)
+        expected += 1.0f + i;
+    TEST_ASSERT_EQUAL_UINT8(FEED_LEDGER_ENTRIES, ledger.size());
+    TEST_ASSERT_EQUAL_INT32(grams(expected), ledger.rollingTotal());
+    TEST_ASSERT_EQUAL_INT32(grams(expected), ledger.dayTotal());
+
+    uint32_t oldest;
+    TEST_ASSERT_TRUE(ledger.oldest(&oldest));
+    TEST_ASSERT_EQUAL_UINT32(T0 + 6 * 60, oldest);
+
+    // The file holds the same window
+    File file = LittleFS.open(FEED_LEDGER_FILE, "r");
+    TEST_ASSERT_EQUAL_UINT32(FEED_LEDGER_ENTRIES * sizeof(FeedLedgerEntry), file.size());
+    file.close();
+    reboot(ledger);
+    TEST_ASSERT_EQUAL_UINT8(FEED_LEDGER_ENTRIES, ledger.size());
+    TEST_ASSERT_EQUAL_INT32(grams(expected), ledger.rollingTotal());
+    TEST_ASSERT_TRUE(ledger.oldest(&oldest));
+    TEST_ASSERT_EQUAL_UINT32(T0 + 6 * 60, oldest);
+}
+
+static void test_untimed_feeds_are_stamped_on_first_valid_clock() {
+    FeedLedger ledger;
+    ledger.begin();
+
+    // Fed right after boot, before SNTP answered
+    ledger.record(5, grams(7.0f));
+    ledger.record(9, grams(3.0f));
+    ledger.advance(12); // still no clock: nothing moves
+    TEST_ASSERT_EQUAL_UINT8(2, ledger.size());
+
+    uint32_t oldest;
+    TEST_ASSERT_TRUE(ledger.oldest(&oldest));
+    TEST_ASSERT_EQUAL_UINT32(0, oldest);
+
+    ledger.advance(T0);
+    TEST_ASSERT_TRUE(ledger.oldest(&oldest));
+    TEST_ASSERT_EQUAL_UINT32(T0, oldest);
+    TEST_ASSERT_EQUAL_INT32(grams(10.0f), ledger.rollingTotal());
+
+    // The stamp is on flash too, and they leave a window after it
+    reboot(ledger);
+    TEST_ASSERT_TRUE(ledger.oldest(&oldest));
+    TEST_ASSERT_EQUAL_UINT32(T0, oldest);
+    ledger.advance(T0 + FEED_WINDOW_S - 1);
+    TEST_ASSERT_EQUAL_UINT8(2, ledger.size());
+    ledger.advance(T0 + FEED_WINDOW_S);
+    TEST_ASSERT_EQUAL_UINT8(0, ledger.size());
+    TEST_ASSERT_EQUAL_INT32(0, ledger.rollingTotal());
+}
+
+static void test_clock_stepping_back_keeps_entries() {
+    FeedLedger ledger;
+    ledger.begin();
+    ledger.startDay(T0);
+    ledger.record(T0 + 7200, grams(4.0f));
+    ledger.record(T0 + 7300, grams(6.0f));
+
+    // SNTP corrects the clock an hour back: the feeds are now in the
+    // future and must neither be evicted nor wrap to "very old"
+    ledger.advance(T0 + 3600);
+    TEST_ASSERT_EQUAL_UINT8(2, ledger.size());
+    TEST_ASSERT_EQUAL_INT32(grams(10.0f), ledger.rollingTotal());
+
+    // Once time catches up they leave at their own window end
+    ledger.advance(T0 + 7200 + FEED_WINDOW_S);
+    TEST_ASSERT_EQUAL_UINT8(1, ledger.size());
+    TEST_ASSERT_EQUAL_INT32(grams(6.0f), ledger.rollingTotal());
+    ledger.advance(T0 + 7300 + FEED_WINDOW_S);
+    TEST_ASSERT_EQUAL_UINT8(0, ledger.size());
+}
+
+static void test_corrupt_slot_ends_the_window_on_reload() {
+    FeedLedger ledger;
+    ledger.begin();
+    ledger.record(T0 + 60, grams(1.0f));
+    ledger.record(T0 + 120, grams(2.0f));
+    ledger.record(T0 + 180, grams(3.0f));
+
+    // seq 2 is torn: only the unbroken run ending at the newest counts
+    TEST_ASSERT_TRUE(fakeFsCorrupt(FEED_LEDGER_FILE, 2 * sizeof(FeedLedgerEntry) + 8, 0x01));
+    reboot(ledger);
+    TEST_ASSERT_EQUAL_UINT32(1, ledger.stats.corrupt);
+    TEST_ASSERT_EQUAL_UINT8(1, ledger.size());
+    TEST_ASSERT_EQUAL_INT32(grams(3.0f), ledger.rollingTotal());
+}
+
+static void test_day_starts_at_local_midnight_across_dst() {
+    // Spring: the day is 23 h long, midnight is still 23:00 UTC before
+    uint32_t noon  = SPRING_DAY + 10 * 3600; // 12:00 CEST
+    uint32_t start = lastDailyDeadline(noon, 0);
+    TEST_ASSERT_EQUAL_UINT32(SPRING_DAY - 3600, start);
+    TEST_ASSERT_EQUAL_UINT32(start + 23 * 3600, nextDailyDeadline(noon, 0));
+
+    FeedLedger ledger;
+    ledger.begin();
+    ledger.record(start - 60, grams(2.0f)); // 23:59 the evening before
+    ledger.record(start + 60, grams(5.0f)); // 00:01
+    ledger.record(noon, grams(8.0f));
+    ledger.startDay(start);
+    TEST_ASSERT_EQUAL_INT32(grams(13.0f), ledger.dayTotal());
+    TEST_ASSERT_EQUAL_INT32(grams(15.0f), ledger.rollingTotal());
+
+    // Autumn: the day is 25 h long and 23:30 local is 22:30 UTC
+    fakeFsReset();
+    noon  = AUTUMN_DAY + 11 * 3600; // 12:00 CET
+    start = lastDailyDeadline(noon, 0);
+    TEST_ASSERT_EQUAL_UINT32(AUTUMN_DAY - 2 * 3600, start);
+    TEST_ASSERT_EQUAL_UINT32(start + 25 * 3600, nextDailyDeadline(noon, 0));
+
+    ledger = FeedLedger();
+    ledger.begin();
+    ledger.record(start - 60, grams(2.0f));
+    ledger.record(AUTUMN_DAY + 22 * 3600 + 1800, grams(4.0f)); // 23:30 CET
+    ledger.startDay(start);
+    TEST_ASSERT_EQUAL_INT32(grams(4.0f), ledger.dayTotal());
+    ledger.startDay(nextDailyDeadline(noon, 0));
+    TEST_ASSERT_EQUAL_INT32(0, ledger.dayTotal());
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_totals_follow_the_rolling_window);
+    RUN_TEST(test_ring_wraps_at_its_size);
+    RUN_TEST(test_untimed_feeds_are_stamped_on_first_valid_clock);
+    RUN_TEST(test_clock_stepping_back_keeps_entries);
+    RUN_TEST(test_corrupt_slot_ends_the_window_on_reload);
+    RUN_TEST(test_day_starts_at_local_midnight_across_dst);
+    return UNITY_END();
+}
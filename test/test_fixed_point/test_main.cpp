@@ -0,0 +1,110 @@
+#include <Arduino.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unity.h>
+
+#include "fixed_point.h"
+#include "glyph_atlas.h"
+#include "payload_parser.h"
+
+// The fixed point helpers against double arithmetic, and the whole path a
+// value takes to the screen (parse, rescale, format) against printf()
+
+// Half away from zero, like fixedRescale()
+static int64_t roundedDivide(int64_t value, int64_t divisor) {
+    return value < 0 ? -((-value + divisor / 2) / divisor) : (value + divisor / 2) / divisor;
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+static void test_from_float_rounds_to_nearest() {
+    srand(4);
+    for(uint32_t i = 0; i < 1000000; i++) {
+        float  value    = (rand() - RAND_MAX / 2) / 1000.0f * (i % 2 ? 1.0f : 0.001f);
+        double expected = (double) value * FIXED_ONE;
+        Fixed  fixed    = fixedFromFloat(value);
+        // value * 1000 is rounded to a float first: off by one at the edges
+        TEST_ASSERT_TRUE(fabs(fixed - expected) <= 0.5 + fabs(expected) * 1.2e-7);
+    }
+    TEST_ASSERT_EQUAL_INT32(21500, fixedFromFloat(21.5f));
+    TEST_ASSERT_EQUAL_INT32(-1, fixedFromFloat(-0.0005f));
+    TEST_ASSERT_EQUAL_INT32(0, fixedFromFloat(0.0004f));
+}
+
+static void test_from_float_saturates() {
+    TEST_ASSERT_EQUAL_INT32(INT32_MAX, fixedFromFloat(1e9f));
+    TEST_ASSERT_EQUAL_INT32(-INT32_MAX, fixedFromFloat(-1e9f));
+    TEST_ASSERT_EQUAL_INT32(INT32_MAX, fixedFromFloat(INFINITY));
+    TEST_ASSERT_EQUAL_INT32(-INT32_MAX, fixedFromFloat(-INFINITY));
+    TEST_ASSERT_EQUAL_INT32(0, fixedFromFloat(NAN));
+    TEST_ASSERT_GREATER_THAN(2147483000, fixedFromFloat(2147483.5f));
+    TEST_ASSERT_TRUE(fixedIsSaturated(fixedFromFloat(1e9f)));
+    TEST_ASSERT_TRUE(fixedIsSaturated(fixedFromFloat(-1e9f)));
+    TEST_ASSERT_FALSE(fixedIsSaturated(fixedFromFloat(2147483.0f)));
+    TEST_ASSERT_FLOAT_WITHIN(0.0005f, 21.5f, fixedToFloat(fixedFromFloat(21.5f)));
+}
+
+static void test_rescale_matches_integer_reference() {
+    srand(5);
+    for(uint32_t i = 0; i < 1000000; i++) {
+        Fixed value = (Fixed) ((uint32_t) rand() << 1 ^ rand());
+        if(i < 4)
+            value = i < 2 ? INT32_MAX - i : -INT32_MAX + i;
+        for(uint8_t decimals = 0; decimals <= FIXED_DECIMALS + 1; decimals++) {
+            int64_t expected = decimals >= FIXED_DECIMALS ? value : roundedDivide(value, fixedPowers[FIXED_DECIMALS - decimals]);
+            TEST_ASSERT_EQUAL_INT32(expected, fixedRescale(value, decimals));
+        }
+    }
+    TEST_ASSERT_EQUAL_INT32(22, fixedRescale(21500, 0));
+    TEST_ASSERT_EQUAL_INT32(-22, fixedRescale(-21500, 0));
+    TEST_ASSERT_EQUAL_INT32(215, fixedRescale(21549, 1));
+}
+
+static void test_scale_truncates_toward_zero() {
+    srand(6);
+    for(uint32_t i = 0; i < 1000000; i++) {
+        int32_t count  = rand() % 16777216 - 8388608; // HX711 range
+        Fixed   factor = rand() % 200000 - 100000;
+        int64_t exact  = (int64_t) count * factor;
+        TEST_ASSERT_EQUAL_INT32(exact / FIXED_ONE, fixedScale(count, factor));
+    }
+}
+
+static void test_screen_text_matches_printf() {
+    // Values as a broker sends them, drawn with 0..3 decimals. Exact
+    // decimal ties are skipped: printf rounds the binary double there.
+    srand(7);
+    char payload[24], expected[24], intPart[12], fracPart[8], shown[24];
+    for(uint32_t i = 0; i < 300000; i++) {
+        int32_t thousandths = rand() % 20000001 - 10000000;
+        snprintf(payload, sizeof(payload), "%s%ld.%03ld", thousandths < 0 ? "-" : "", labs(thousandths) / 1000L, labs(thousandths) % 1000L);
+        Fixed value;
+        TEST_ASSERT_TRUE(parseNumber(payload, strlen(payload), &value));
+        TEST_ASSERT_EQUAL_INT32(thousandths, value);
+
+        for(uint8_t decimals = 0; decimals <= FIXED_DECIMALS; decimals++) {
+            int32_t divisor = fixedPowers[FIXED_DECIMALS - decimals];
+            if(divisor > 1 && labs(thousandths) % divisor == divisor / 2)
+                continue;
+            formatFixed(fixedRescale(value, decimals), decimals, intPart, fracPart);
+            snprintf(shown, sizeof(shown), decimals > 0 ? "%s.%s" : "%s", intPart, fracPart);
+            snprintf(expected, sizeof(expected), "%.*f", decimals, strtod(payload, NULL));
+            if(expected[0] == '-' && strspn(expected + 1, "0.") == strlen(expected + 1))
+                memmove(expected, expected + 1, strlen(expected)); // printf keeps the sign of a value rounded to 0
+            TEST_ASSERT_EQUAL_STRING_MESSAGE(expected, shown, payload);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_from_float_rounds_to_nearest);
+    RUN_TEST(test_from_float_saturates);
+    RUN_TEST(test_rescale_matches_integer_reference);
+    RUN_TEST(test_scale_truncates_toward_zero);
+    RUN_TEST(test_screen_text_matches_printf);
+    return UNITY_END();
+}
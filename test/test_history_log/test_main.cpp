@@ -0,0 +1,130 @@
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <unity.h>
+
+#include "fakes.h"
+#include "history_log.h"
+
+// One log for the whole run, like the firmware: the writer task lives on
+static HistoryLog history;
+
+// Queue `count` samples of a series and wait for the writer task
+static void appendWritten(uint8_t series, uint16_t count, float first) {
+    history.requestFlush();
+    for(uint32_t wait = 0; wait < 200; wait++)
+        vTaskDelay(1); // anything queued before goes first
+    uint32_t target = history.stats.recordsWritten + count;
+    for(uint16_t i = 0; i < count; i++) {
+        TEST_ASSERT_TRUE(history.append(series, first + i));
+        if(i % HISTORY_BATCH_RECORDS == HISTORY_BATCH_RECORDS - 1) {
+            for(uint32_t wait = 0; wait < 2000 && history.stats.recordsWritten < target - count + i + 1; wait++)
+                vTaskDelay(1);
+        }
+    }
+    history.requestFlush();
+    for(uint32_t wait = 0; wait < 2000 && history.stats.recordsWritten < target; wait++)
+        vTaskDelay(1);
+    TEST_ASSERT_EQUAL_UINT32(target, history.stats.recordsWritten);
+}
+
+struct Newest {
+        HistoryRecord record;
+        uint32_t      seen;
+};
+
+static void newestVisitor(const HistoryRecord &record, void *context) {
+    Newest *newest = static_cast<Newest *>(context);
+    newest->record = record; // query() visits in write order within a tier
+    newest->seen++;
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+static void test_latest_reads_pending_samples() {
+    fakeFsReset();
+    history.begin();
+
+    TEST_ASSERT_TRUE(history.append(2, 21.5f));
+    TEST_ASSERT_TRUE(history.append(2, 22.5f));
+
+    const uint8_t series[] = { 2, 3 };
+    HistoryRecord out[2];
+    TEST_ASSERT_EQUAL_UINT8(1, history.latest(series, 2, out));
+    TEST_ASSERT_EQUAL_FLOAT(22.5f, out[0].mean);
+    TEST_ASSERT_EQUAL_UINT16(0, out[1].count);
+
+    appendWritten(2, 0, 0.0f); // write them out for the next tests
+}
+
+static void test_latest_finds_each_series_across_segments() {
+    appendWritten(1, 64, 100.0f);  // only in an old segment
+    appendWritten(0, 600, 0.0f);   // several segments after it
+    appendWritten(3, 64, 300.0f);
+
+    const uint8_t series[] = { 0, 1, 3, 7, 2 };
+    HistoryRecord out[5];
+    TEST_ASSERT_EQUAL_UINT8(4, history.latest(series, 5, out));
+    TEST_ASSERT_EQUAL_FLOAT(599.0f, out[0].mean);
+    TEST_ASSERT_EQUAL_FLOAT(163.0f, out[1].mean);
+    TEST_ASSERT_EQUAL_FLOAT(363.0f, out[2].mean);
+    TEST_ASSERT_EQUAL_UINT16(0, out[3].count);
+    TEST_ASSERT_EQUAL_FLOAT(22.5f, out[4].mean);
+
+    // Same answer as walking everything with query()
+    for(uint8_t i = 0; i < 5; i++) {
+        Newest newest = {};
+        history.query(series[i], 0, UINT32_MAX, newestVisitor, &newest);
+        TEST_ASSERT_EQUAL_UINT16(newest.record.count, out[i].count);
+        if(newest.seen > 0)
+            TEST_ASSERT_EQUAL_FLOAT(newest.record.mean, out[i].mean);
+    }
+}
+
+static void test_latest_prefers_newer_segment_over_same_series_older() {
+    appendWritten(1, 64, 1000.0f);
+
+    const uint8_t series[] = { 1 };
+    HistoryRecord out[1];
+    TEST_ASSERT_EQUAL_UINT8(1, history.latest(series, 1, out));
+    TEST_ASSERT_EQUAL_FLOAT(1063.0f, out[0].mean);
+}
+
+static void test_latest_skips_corrupt_batches() {
+    // Flip a byte in the last batch of the newest raw segment: it fails
+    // the CRC, so series 6 has nothing left while series 5 is untouched
+    appendWritten(5, 10, 50.0f);
+    appendWritten(6, 10, 60.0f);
+
+    char     path[32];
+    uint32_t seq = 0;
+    for(;; seq++) {
+        snprintf(path, sizeof(path), HISTORY_DIR "/t0-%08lu.seg", (unsigned long) (seq + 1));
+        if(!LittleFS.exists(path))
+            break;
+    }
+    snprintf(path, sizeof(path), HISTORY_DIR "/t0-%08lu.seg", (unsigned long) seq);
+    File     file = LittleFS.open(path, "r");
+    uint32_t size = file.size();
+    file.close();
+    // The last batch is the 10 records of series 6
+    TEST_ASSERT_TRUE(fakeFsCorrupt(path, size - 5, 0xFF));
+
+    uint32_t      corrupt  = history.stats.corruptBatches;
+    const uint8_t series[] = { 5, 6 };
+    HistoryRecord out[2];
+    TEST_ASSERT_EQUAL_UINT8(1, history.latest(series, 2, out));
+    TEST_ASSERT_EQUAL_FLOAT(59.0f, out[0].mean);
+    TEST_ASSERT_EQUAL_UINT16(0, out[1].count);
+    TEST_ASSERT_GREATER_THAN(corrupt, history.stats.corruptBatches);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_latest_reads_pending_samples);
+    RUN_TEST(test_latest_finds_each_series_across_segments);
+    RUN_TEST(test_latest_prefers_newer_segment_over_same_series_older);
+    RUN_TEST(test_latest_skips_corrupt_batches);
+    return UNITY_END();
+}
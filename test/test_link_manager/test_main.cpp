@@ -0,0 +1,306 @@
+#include <Arduino.h>
+#include <ArduinoHA.h>
+#include <string>
+#include <unity.h>
+
+#include "link_manager.h"
+#include "state_outbox.h"
+
+// Link manager driven through a scripted WiFi/broker, and the state
+// outbox against the broker stand-in from the ArduinoHA fake
+
+class FakeLink : public LinkDriver {
+    public:
+        bool wifiConnected() override { return wifiUp; }
+        void wifiConnect(const uint8_t *bssid, int32_t channel) override {
+            joins++;
+            lastJoinFast = bssid != NULL;
+            lastChannel  = channel;
+            if(joinSucceeds && (bssid == NULL || channel == apChannel))
+                wifiUp = true;
+        }
+        bool wifiLinkInfo(uint8_t *bssid, int32_t *channel, int8_t *rssi) override {
+            if(!wifiUp)
+                return false;
+            memcpy(bssid, apBssid, 6);
+            *channel = apChannel;
+            *rssi    = -60;
+            return true;
+        }
+        bool mqttConnected() override { return wifiUp && brokerUp; }
+        void mqttPoll() override { polls++; }
+
+        bool    wifiUp       = false;
+        bool    brokerUp     = true;
+        bool    joinSucceeds = true;
+        bool    lastJoinFast = false;
+        int32_t lastChannel  = 0;
+        int32_t apChannel    = 6;
+        uint8_t apBssid[6]   = { 1, 2, 3, 4, 5, 6 };
+        int     joins        = 0;
+        int     polls        = 0;
+};
+
+// Runs loop() every 100 ms until `until`, returns the last event that was not NONE
+static LinkEvent runUntil(LinkManager &manager, uint32_t &now, uint32_t until) {
+    LinkEvent last = LINK_EVENT_NONE;
+    for(; now < until; now += 100) {
+        LinkEvent event = manager.loop(now);
+        if(event != LINK_EVENT_NONE)
+            last = event;
+    }
+    return last;
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+static void test_first_join_scans_then_connects() {
+    FakeLink    link;
+    LinkManager manager(link);
+    uint32_t    now = 0;
+    manager.begin(now, 1);
+
+    TEST_ASSERT_EQUAL_INT(LINK_EVENT_UP, runUntil(manager, now, 1000));
+    TEST_ASSERT_TRUE(manager.isUp());
+    TEST_ASSERT_FALSE(link.lastJoinFast); // nothing cached yet
+    TEST_ASSERT_EQUAL_UINT32(1, manager.stats.wifiConnects);
+    TEST_ASSERT_EQUAL_UINT32(1, manager.stats.mqttConnects);
+
+    uint8_t bssid[6];
+    int32_t channel;
+    TEST_ASSERT_TRUE(manager.cachedAp(bssid, &channel));
+    TEST_ASSERT_EQUAL_INT32(6, channel);
+}
+
+static void test_seeded_ap_joins_without_scan() {
+    FakeLink    link;
+    LinkManager manager(link);
+    manager.seedAp(link.apBssid, 6);
+    uint32_t now = 0;
+    manager.begin(now, 1);
+    runUntil(manager, now, 1000);
+
+    TEST_ASSERT_TRUE(manager.isUp());
+    TEST_ASSERT_TRUE(link.lastJoinFast);
+    TEST_ASSERT_EQUAL_UINT32(1, manager.stats.fastConnects);
+}
+
+static void test_moved_ap_falls_back_to_scan_at_once() {
+    FakeLink    link;
+    LinkManager manager(link);
+    manager.seedAp(link.apBssid, 11); // the AP moved to channel 6 since
+    uint32_t now = 0;
+    manager.begin(now, 1);
+    runUntil(manager, now, LINK_FAST_TIMEOUT_MS + 1000);
+
+    TEST_ASSERT_TRUE(manager.isUp());
+    TEST_ASSERT_EQUAL_INT(2, link.joins);
+    TEST_ASSERT_FALSE(link.lastJoinFast);
+    TEST_ASSERT_EQUAL_UINT32(1, manager.stats.wifiFailures);
+    TEST_ASSERT_EQUAL_UINT32(0, manager.stats.fastConnects);
+}
+
+static void test_failed_joins_back_off_with_jitter() {
+    FakeLink link;
+    link.joinSucceeds = false;
+    LinkManager manager(link);
+    uint32_t    now = 0;
+    manager.begin(now, 12345);
+
+    // Join attempts start at the timeout plus a backoff that doubles
+    // from LINK_BACKOFF_MIN_MS and stays within [delay / 2, delay]
+    uint32_t previousJoin = 0;
+    int      joins        = link.joins;
+    uint32_t delay        = LINK_BACKOFF_MIN_MS;
+    for(; now < 30 * 60 * 1000UL; now += 10) {
+        manager.loop(now);
+        if(link.joins == joins)
+            continue;
+        joins = link.joins;
+        if(joins > 1) {
+            uint32_t gap = now - previousJoin - LINK_WIFI_TIMEOUT_MS;
+            TEST_ASSERT_GREATER_OR_EQUAL(delay / 2, gap + 10);
+            TEST_ASSERT_LESS_OR_EQUAL(delay + 10, gap);
+            delay = min(delay * 2, (uint32_t) LINK_BACKOFF_MAX_MS);
+        }
+        previousJoin = now;
+    }
+    TEST_ASSERT_GREATER_THAN(20, joins);
+    TEST_ASSERT_INT_WITHIN(1, joins, manager.stats.wifiFailures); // the last one may still be running
+    TEST_ASSERT_FALSE(manager.isUp());
+}
+
+static void test_broker_outage_is_measured() {
+    FakeLink    link;
+    LinkManager manager(link);
+    uint32_t    now = 0;
+    manager.begin(now, 1);
+    runUntil(manager, now, 1000);
+
+    link.brokerUp = false;
+    TEST_ASSERT_EQUAL_INT(LINK_EVENT_DOWN, runUntil(manager, now, 2000));
+    TEST_ASSERT_EQUAL_UINT32(1, manager.stats.mqttDrops);
+    TEST_ASSERT_EQUAL_UINT32(0, manager.stats.wifiDrops);
+    TEST_ASSERT_GREATER_THAN(0, link.polls);
+
+    runUntil(manager, now, 9000);
+    link.brokerUp = true;
+    TEST_ASSERT_EQUAL_INT(LINK_EVENT_UP, runUntil(manager, now, 70000));
+    TEST_ASSERT_UINT32_WITHIN(200, 8000, manager.stats.lastOutageMs);
+    TEST_ASSERT_EQUAL_UINT32(manager.stats.lastOutageMs, manager.stats.downtimeMs);
+}
+
+static void test_wifi_drop_rejoins_cached_ap() {
+    FakeLink    link;
+    LinkManager manager(link);
+    uint32_t    now = 0;
+    manager.begin(now, 1);
+    runUntil(manager, now, 1000);
+
+    link.wifiUp = false;
+    TEST_ASSERT_EQUAL_INT(LINK_EVENT_UP, runUntil(manager, now, 3000));
+    TEST_ASSERT_EQUAL_UINT32(1, manager.stats.wifiDrops);
+    TEST_ASSERT_TRUE(link.lastJoinFast);
+}
+
+// Outbox
+
+static bool sendSensor(void *entity, float value) {
+    return static_cast<HASensorNumber *>(entity)->setValue(value, true);
+}
+
+#define TEST_ENTITIES 18 // what main.cpp sends through the outbox
+
+static const char *const entityIds[TEST_ENTITIES] = {
+    "e0", "e1", "e2", "e3", "e4", "e5", "e6", "e7", "e8", "e9", "e10", "e11", "e12", "e13", "e14", "e15", "e16", "e17",
+};
+
+static void test_outage_keeps_newest_state_of_every_entity() {
+    TEST_ASSERT_GREATER_OR_EQUAL(TEST_ENTITIES, STATE_OUTBOX_SIZE);
+
+    HADevice        device;
+    HAMqtt          broker(NULL, device);
+    HASensorNumber *sensors[TEST_ENTITIES];
+    for(uint8_t i = 0; i < TEST_ENTITIES; i++)
+        sensors[i] = new HASensorNumber(entityIds[i], HABaseDeviceType::PrecisionP1);
+
+    StateOutbox outbox;
+    broker.setConnected(true);
+    outbox.setOnline(true);
+    for(uint8_t i = 0; i < TEST_ENTITIES; i++)
+        TEST_ASSERT_TRUE(outbox.send(sendSensor, sensors[i], 1.0f));
+    TEST_ASSERT_EQUAL_UINT32(0, outbox.stats.queued);
+
+    // A long outage: every entity changes many times
+    broker.setConnected(false);
+    outbox.setOnline(false);
+    for(uint32_t round = 0; round < 50; round++)
+        for(uint8_t i = 0; i < TEST_ENTITIES; i++)
+            TEST_ASSERT_TRUE(outbox.send(sendSensor, sensors[i], round + i / 10.0f));
+    TEST_ASSERT_EQUAL_UINT32(TEST_ENTITIES, outbox.stats.queued);
+    TEST_ASSERT_EQUAL_UINT32(0, outbox.stats.overflowed);
+
+    size_t publishedBefore = broker.published.size();
+    broker.setConnected(true);
+    outbox.setOnline(true);
+    TEST_ASSERT_EQUAL_UINT8(0, outbox.replay());
+    TEST_ASSERT_EQUAL_UINT32(TEST_ENTITIES, broker.published.size() - publishedBefore);
+
+    for(uint8_t i = 0; i < TEST_ENTITIES; i++) {
+        char expected[16];
+        snprintf(expected, sizeof(expected), "%.1f", 49 + i / 10.0f);
+        TEST_ASSERT_EQUAL_STRING(expected, broker.states[entityIds[i]].c_str());
+    }
+    // In the order they first changed
+    TEST_ASSERT_EQUAL_STRING("e0=49.0", broker.published[publishedBefore].c_str());
+    TEST_ASSERT_EQUAL_STRING("e17=50.7", broker.published.back().c_str());
+
+    for(uint8_t i = 0; i < TEST_ENTITIES; i++)
+        delete sensors[i];
+}
+
+static void test_link_dropping_mid_replay_keeps_the_rest() {
+    HADevice       device;
+    HAMqtt         broker(NULL, device);
+    HASensorNumber first("first"), second("second");
+    StateOutbox    outbox;
+
+    TEST_ASSERT_TRUE(outbox.send(sendSensor, &first, 1.0f));
+    TEST_ASSERT_TRUE(outbox.send(sendSensor, &second, 2.0f));
+
+    // Online again as far as the firmware knows, but the broker is gone
+    outbox.setOnline(true);
+    TEST_ASSERT_EQUAL_UINT8(2, outbox.replay());
+    TEST_ASSERT_EQUAL_UINT32(0, outbox.stats.replayed);
+
+    // A failed direct publish lands in the outbox too
+    TEST_ASSERT_TRUE(outbox.send(sendSensor, &first, 3.0f));
+    TEST_ASSERT_EQUAL_UINT32(1, outbox.stats.coalesced);
+
+    broker.setConnected(true);
+    TEST_ASSERT_EQUAL_UINT8(0, outbox.replay());
+    TEST_ASSERT_EQUAL_STRING("3", broker.states["first"].c_str());
+    TEST_ASSERT_EQUAL_STRING("2", broker.states["second"].c_str());
+}
+
+static void test_direct_send_replaces_the_queued_value() {
+    HADevice       device;
+    HAMqtt         broker(NULL, device);
+    HASensorNumber first("first"), second("second");
+    StateOutbox    outbox;
+
+    // The publish fails while the link still counts as up
+    outbox.setOnline(true);
+    TEST_ASSERT_TRUE(outbox.send(sendSensor, &first, 1.0f));
+    TEST_ASSERT_TRUE(outbox.send(sendSensor, &second, 2.0f));
+    TEST_ASSERT_EQUAL_UINT8(2, outbox.pending());
+
+    // A newer value goes straight through and takes the old one with it
+    broker.setConnected(true);
+    TEST_ASSERT_TRUE(outbox.send(sendSensor, &first, 5.0f));
+    TEST_ASSERT_EQUAL_UINT8(1, outbox.pending());
+    TEST_ASSERT_EQUAL_UINT8(0, outbox.replay());
+    TEST_ASSERT_EQUAL_STRING("5", broker.states["first"].c_str());
+    TEST_ASSERT_EQUAL_STRING("2", broker.states["second"].c_str());
+    TEST_ASSERT_EQUAL_UINT32(2, broker.published.size());
+    TEST_ASSERT_EQUAL_UINT32(1, outbox.stats.replayed);
+}
+
+static void test_failed_publish_retries_while_online() {
+    HADevice       device;
+    HAMqtt         broker(NULL, device);
+    HASensorNumber first("first");
+    StateOutbox    outbox;
+
+    outbox.setOnline(true);
+    TEST_ASSERT_TRUE(outbox.send(sendSensor, &first, 7.0f));
+
+    // Passes of the network task with no link event in between, as when
+    // the client buffer was full for a moment
+    for(uint8_t pass = 0; pass < 3; pass++) {
+        if(pass == 2)
+            broker.setConnected(true);
+        if(outbox.pending() > 0)
+            outbox.replay();
+    }
+    TEST_ASSERT_EQUAL_UINT8(0, outbox.pending());
+    TEST_ASSERT_EQUAL_STRING("7", broker.states["first"].c_str());
+    TEST_ASSERT_EQUAL_UINT32(1, outbox.stats.replayed);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_first_join_scans_then_connects);
+    RUN_TEST(test_seeded_ap_joins_without_scan);
+    RUN_TEST(test_moved_ap_falls_back_to_scan_at_once);
+    RUN_TEST(test_failed_joins_back_off_with_jitter);
+    RUN_TEST(test_broker_outage_is_measured);
+    RUN_TEST(test_wifi_drop_rejoins_cached_ap);
+    RUN_TEST(test_outage_keeps_newest_state_of_every_entity);
+    RUN_TEST(test_link_dropping_mid_replay_keeps_the_rest);
+    RUN_TEST(test_direct_send_replaces_the_queued_value);
+    RUN_TEST(test_failed_publish_retries_while_online);
+    return UNITY_END();
+}
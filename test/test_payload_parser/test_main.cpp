@@ -0,0 +1,171 @@
+#include <Arduino.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unity.h>
+
+#include "payload_parser.h"
+
+// Plain and JSON payloads as brokers send them, random numbers against
+// strtod(), and random bytes that must be rejected without reading past
+// the payload. The payload is copied into a buffer of exactly its length
+// so a sanitizer build catches any overrun. Timings are in test_bench.
+
+static bool parse(const char *text, Fixed *out) {
+    size_t length = strlen(text);
+    char  *exact  = (char *) malloc(length > 0 ? length : 1);
+    memcpy(exact, text, length);
+    bool parsed = parseNumber(exact, length, out);
+    free(exact);
+    return parsed;
+}
+
+static bool extract(const char *json, const char *path, Fixed *out) {
+    size_t length = strlen(json);
+    char  *exact  = (char *) malloc(length > 0 ? length : 1);
+    memcpy(exact, json, length);
+    bool found = jsonExtractNumber(exact, length, path, out);
+    free(exact);
+    return found;
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+static void test_plain_numbers() {
+    Fixed value;
+    TEST_ASSERT_TRUE(parse("21.5", &value));
+    TEST_ASSERT_EQUAL_INT32(21500, value);
+    TEST_ASSERT_TRUE(parse(" -3e-1 \r\n", &value));
+    TEST_ASSERT_EQUAL_INT32(-300, value);
+    TEST_ASSERT_TRUE(parse("+7", &value));
+    TEST_ASSERT_EQUAL_INT32(7000, value);
+    TEST_ASSERT_TRUE(parse(".5", &value));
+    TEST_ASSERT_EQUAL_INT32(500, value);
+    TEST_ASSERT_TRUE(parse("5.", &value));
+    TEST_ASSERT_EQUAL_INT32(5000, value);
+    TEST_ASSERT_TRUE(parse("0.0004", &value)); // below half a thousandth
+    TEST_ASSERT_EQUAL_INT32(0, value);
+    TEST_ASSERT_TRUE(parse("0.0005", &value));
+    TEST_ASSERT_EQUAL_INT32(1, value);
+    TEST_ASSERT_TRUE(parse("-0.0005", &value)); // half away from zero
+    TEST_ASSERT_EQUAL_INT32(-1, value);
+    TEST_ASSERT_TRUE(parse("123456.789", &value));
+    TEST_ASSERT_EQUAL_INT32(123456789, value);
+    TEST_ASSERT_TRUE(parse("1234567.891", &value)); // 9 significant digits are kept
+    TEST_ASSERT_EQUAL_INT32(1234567890, value);
+    TEST_ASSERT_TRUE(parse("0.000000000000000000001e21", &value));
+    TEST_ASSERT_EQUAL_INT32(1000, value);
+}
+
+static void test_rejects_garbage_and_clamps_overflow() {
+    const char *bad[] = { "", " ", "-", ".", "e5", "1e", "1e+", "21.5C", "0x10", "1 2", "--1", "nan", "inf", "unavailable", "1.2.3" };
+    for(const char *text : bad) {
+        Fixed value = 12345;
+        TEST_ASSERT_FALSE_MESSAGE(parse(text, &value), text);
+    }
+    Fixed value;
+    TEST_ASSERT_TRUE(parse("-2147483.64", &value));
+    TEST_ASSERT_EQUAL_INT32(-2147483640, value);
+    TEST_ASSERT_FALSE(fixedIsSaturated(value));
+
+    // Beyond the range is a valid number, just clamped
+    const char *large[] = { "2147484", "3000000", "1e12", "999999999e300", "1e99999" };
+    for(const char *text : large) {
+        TEST_ASSERT_TRUE_MESSAGE(parse(text, &value), text);
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(FIXED_MAX, value, text);
+    }
+    TEST_ASSERT_TRUE(parse("1e-99999", &value));
+    TEST_ASSERT_EQUAL_INT32(0, value);
+    TEST_ASSERT_TRUE(parse("-3000000", &value));
+    TEST_ASSERT_EQUAL_INT32(FIXED_MIN, value);
+    TEST_ASSERT_TRUE(fixedIsSaturated(value));
+    TEST_ASSERT_TRUE(extract("{\"energy\":{\"total\":4520113.2}}", "energy.total", &value));
+    TEST_ASSERT_EQUAL_INT32(FIXED_MAX, value);
+}
+
+static void test_json_paths() {
+    Fixed value;
+    TEST_ASSERT_TRUE(extract("{\"temp\":21.5}", "temp", &value));
+    TEST_ASSERT_EQUAL_INT32(21500, value);
+    TEST_ASSERT_TRUE(extract(" { \"a\" : [1, {\"temp\": 9}], \"s\": \"x}\\\"y\", \"state\" : { \"temp\" : \"-4.25\" } } ", "state.temp", &value));
+    TEST_ASSERT_EQUAL_INT32(-4250, value);
+    TEST_ASSERT_TRUE(extract("{\"Time\":\"2026-01-01T00:00:00\",\"DS18B20\":{\"Id\":\"0316\",\"Temperature\":54.3},\"TempUnit\":\"C\"}",
+                             "DS18B20.Temperature", &value));
+    TEST_ASSERT_EQUAL_INT32(54300, value);
+    // The key is matched whole, not as a prefix
+    TEST_ASSERT_TRUE(extract("{\"tempX\":1,\"temp\":2}", "temp", &value));
+    TEST_ASSERT_EQUAL_INT32(2000, value);
+
+    TEST_ASSERT_FALSE(extract("{\"temp\":21.5}", "humidity", &value));
+    TEST_ASSERT_FALSE(extract("{\"temp\":\"warm\"}", "temp", &value));
+    TEST_ASSERT_FALSE(extract("{\"temp\":{\"v\":1}}", "temp", &value));
+    TEST_ASSERT_FALSE(extract("{\"state\":1}", "state.temp", &value));
+    TEST_ASSERT_FALSE(extract("[1,2]", "temp", &value));
+    TEST_ASSERT_FALSE(extract("{\"a\":\"unterminated", "temp", &value));
+    TEST_ASSERT_FALSE(extract("{\"a\":[1,2", "temp", &value));
+    TEST_ASSERT_FALSE(extract("21.5", "temp", &value));
+}
+
+static void test_random_numbers_match_strtod() {
+    srand(1);
+    char text[40];
+    for(uint32_t i = 0; i < 200000; i++) {
+        double expected = (rand() % 4000001 - 2000000) / 1000.0 * (rand() % 2 ? 1 : 1e-3);
+        switch(i % 3) {
+        case 0: snprintf(text, sizeof(text), "%.6f", expected); break;
+        case 1: snprintf(text, sizeof(text), "%g", expected); break;
+        default: snprintf(text, sizeof(text), "%.4e", expected); break;
+        }
+        double parsedBack = strtod(text, NULL) * FIXED_ONE;
+        Fixed  reference  = (Fixed) (parsedBack < 0 ? parsedBack - 0.5 : parsedBack + 0.5);
+        Fixed  value;
+        TEST_ASSERT_TRUE_MESSAGE(parse(text, &value), text);
+        TEST_ASSERT_INT32_WITHIN_MESSAGE(1, reference, value, text); // the reference rounds a binary double
+    }
+}
+
+static void test_random_bytes_never_overrun() {
+    static const char alphabet[] = "{}[]\":,.\\ -+eE0123456789abtx";
+    srand(2);
+    char json[64];
+    for(uint32_t i = 0; i < 300000; i++) {
+        uint8_t length = rand() % sizeof(json);
+        for(uint8_t k = 0; k < length; k++)
+            json[k] = i % 2 ? alphabet[rand() % (sizeof(alphabet) - 1)] : (char) rand();
+        char *exact = (char *) malloc(length > 0 ? length : 1);
+        memcpy(exact, json, length);
+        Fixed value;
+        parseNumber(exact, length, &value);
+        jsonExtractNumber(exact, length, "a.b", &value);
+        jsonExtractNumber(exact, length, "t", &value);
+        free(exact);
+    }
+    // Mutations of a valid payload: truncated anywhere, any byte flipped
+    const char *valid  = "{\"a\":{\"x\":[1,\"]\"],\"b\":\"12.5\"},\"t\":3}";
+    size_t      length = strlen(valid);
+    for(size_t cut = 0; cut <= length; cut++) {
+        for(uint32_t flip = 0; flip < 256; flip++) {
+            char *exact = (char *) malloc(cut > 0 ? cut : 1);
+            memcpy(exact, valid, cut);
+            if(cut > 0)
+                exact[flip % cut] ^= flip;
+            Fixed value;
+            jsonExtractNumber(exact, cut, "a.b", &value);
+            free(exact);
+        }
+    }
+    Fixed value;
+    TEST_ASSERT_TRUE(extract(valid, "a.b", &value));
+    TEST_ASSERT_EQUAL_INT32(12500, value);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_plain_numbers);
+    RUN_TEST(test_rejects_garbage_and_clamps_overflow);
+    RUN_TEST(test_json_paths);
+    RUN_TEST(test_random_numbers_match_strtod);
+    RUN_TEST(test_random_bytes_never_overrun);
+    return UNITY_END();
+}
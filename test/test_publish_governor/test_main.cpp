@@ -0,0 +1,157 @@
+#include <Arduino.h>
+#include <vector>
+#include <unity.h>
+
+#include "publish_governor.h"
+
+// What reaches an entity for a stream of updates under each policy knob
+
+struct Entity {
+        std::vector<float> sent;
+        bool               online = true;
+};
+
+static bool record(void *entity, float value) {
+    Entity *target = static_cast<Entity *>(entity);
+    if(!target->online)
+        return false;
+    target->sent.push_back(value);
+    return true;
+}
+
+static const PublishPolicy deadbandOnly  = { 0.5f, 0, 0 };
+static const PublishPolicy rateLimited   = { 0.0f, 1000, 0 };
+static const PublishPolicy withHeartbeat = { 1.0f, 0, 60000 };
+
+void setUp() {}
+
+void tearDown() {}
+
+static void test_first_value_goes_out_at_once() {
+    PublishGovernor governor;
+    Entity          entity;
+    governor.add(0, record, &entity, rateLimited);
+    governor.update(0, 21.0f, 5);
+    TEST_ASSERT_EQUAL_UINT32(1, entity.sent.size());
+    TEST_ASSERT_EQUAL_FLOAT(21.0f, entity.sent[0]);
+}
+
+static void test_deadband_suppresses_small_changes() {
+    PublishGovernor governor;
+    Entity          entity;
+    governor.add(0, record, &entity, deadbandOnly);
+    governor.update(0, 20.0f, 0);
+    governor.update(0, 20.4f, 10);
+    governor.update(0, 19.6f, 20);
+    governor.update(0, 20.5f, 30); // at the band edge: still suppressed
+    TEST_ASSERT_EQUAL_UINT32(1, entity.sent.size());
+    TEST_ASSERT_EQUAL_UINT32(3, governor.stats.suppressed);
+
+    // Measured from the last value sent, so a slow drift does go out
+    governor.update(0, 20.6f, 40);
+    TEST_ASSERT_EQUAL_UINT32(2, entity.sent.size());
+    TEST_ASSERT_EQUAL_FLOAT(20.6f, entity.sent[1]);
+}
+
+static void test_bursts_coalesce_to_the_newest_value() {
+    PublishGovernor governor;
+    Entity          entity;
+    governor.add(0, record, &entity, rateLimited);
+    governor.update(0, 1.0f, 0);
+    for(uint32_t t = 100; t < 1000; t += 100) {
+        governor.update(0, t / 100.0f + 1.0f, t);
+        governor.loop(t);
+    }
+    TEST_ASSERT_EQUAL_UINT32(1, entity.sent.size());
+
+    governor.loop(1000);
+    TEST_ASSERT_EQUAL_UINT32(2, entity.sent.size());
+    TEST_ASSERT_EQUAL_FLOAT(10.0f, entity.sent[1]);
+    TEST_ASSERT_EQUAL_UINT32(8, governor.stats.coalesced);
+
+    governor.loop(5000); // nothing pending, no heartbeat configured
+    TEST_ASSERT_EQUAL_UINT32(2, entity.sent.size());
+}
+
+static void test_value_back_within_deadband_cancels_pending() {
+    PublishPolicy   policy = { 0.5f, 1000, 0 };
+    PublishGovernor governor;
+    Entity          entity;
+    governor.add(0, record, &entity, policy);
+    governor.update(0, 10.0f, 0);
+    governor.update(0, 12.0f, 100); // pending
+    governor.update(0, 10.2f, 200); // a spike that went away
+    governor.loop(2000);
+    TEST_ASSERT_EQUAL_UINT32(1, entity.sent.size());
+}
+
+static void test_heartbeat_republishes_unchanged_value() {
+    PublishGovernor governor;
+    Entity          entity;
+    governor.add(0, record, &entity, withHeartbeat);
+    governor.update(0, 5.0f, 0);
+    governor.update(0, 5.5f, 30000);
+    governor.loop(59999);
+    TEST_ASSERT_EQUAL_UINT32(1, entity.sent.size());
+    governor.loop(60000);
+    TEST_ASSERT_EQUAL_UINT32(2, entity.sent.size());
+    TEST_ASSERT_EQUAL_FLOAT(5.5f, entity.sent[1]); // the latest, not the last sent
+    TEST_ASSERT_EQUAL_UINT32(1, governor.stats.heartbeats);
+    governor.loop(119999);
+    TEST_ASSERT_EQUAL_UINT32(2, entity.sent.size());
+}
+
+static void test_failed_publish_is_retried() {
+    PublishGovernor governor;
+    Entity          entity;
+    governor.add(0, record, &entity, rateLimited);
+    entity.online = false;
+    governor.update(0, 3.0f, 0);
+    TEST_ASSERT_EQUAL_UINT32(1, governor.stats.failed);
+
+    governor.update(0, 4.0f, 10);
+    entity.online = true;
+    governor.loop(20); // never sent, so there is no interval to wait for
+    TEST_ASSERT_EQUAL_UINT32(1, entity.sent.size());
+    TEST_ASSERT_EQUAL_FLOAT(4.0f, entity.sent[0]);
+
+    // Once sent, a failure waits out the entity's interval before retrying
+    entity.online = false;
+    governor.update(0, 9.0f, 2000);
+    entity.online = true;
+    governor.loop(2500);
+    TEST_ASSERT_EQUAL_UINT32(1, entity.sent.size());
+    governor.loop(3000);
+    TEST_ASSERT_EQUAL_UINT32(2, entity.sent.size());
+    TEST_ASSERT_EQUAL_FLOAT(9.0f, entity.sent[1]);
+}
+
+static void test_entries_are_independent_and_bounds_checked() {
+    PublishGovernor governor;
+    Entity          first, second;
+    governor.add(0, record, &first, rateLimited);
+    governor.add(GOVERNOR_MAX_ENTRIES - 1, record, &second, deadbandOnly);
+    governor.add(GOVERNOR_MAX_ENTRIES, record, &second, deadbandOnly);
+    governor.update(GOVERNOR_MAX_ENTRIES, 1.0f, 0);
+    governor.update(5, 1.0f, 0); // never added
+    TEST_ASSERT_EQUAL_UINT32(0, second.sent.size());
+
+    governor.update(0, 1.0f, 0);
+    governor.update(GOVERNOR_MAX_ENTRIES - 1, 1.0f, 0);
+    governor.update(0, 2.0f, 10); // held back by its own interval only
+    governor.update(GOVERNOR_MAX_ENTRIES - 1, 2.0f, 10);
+    TEST_ASSERT_EQUAL_UINT32(1, first.sent.size());
+    TEST_ASSERT_EQUAL_UINT32(2, second.sent.size());
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_first_value_goes_out_at_once);
+    RUN_TEST(test_deadband_suppresses_small_changes);
+    RUN_TEST(test_bursts_coalesce_to_the_newest_value);
+    RUN_TEST(test_value_back_within_deadband_cancels_pending);
+    RUN_TEST(test_heartbeat_republishes_unchanged_value);
+    RUN_TEST(test_failed_publish_is_retried);
+    RUN_TEST(test_entries_are_independent_and_bounds_checked);
+    return UNITY_END();
+}
@@ -0,0 +1,165 @@
+#include <Arduino.h>
+#include <U8g2lib.h>
+#include <unity.h>
+
+#include "fakes.h"
+#include "screen_layout.h"
+
+// Which widgets update() marks for drawing as values and time move on,
+// and that partial frames composed over the chrome layer leave the same
+// pixels as drawing the page from scratch
+
+#define COLUMN_MS 60000UL
+
+static const char *layout = "page\n"
+                            "value 0 20 small 0 0 1 0 8 64 14\n"
+                            "spark 0 30 128 30 1\n";
+
+U8G2_ST7565_NHD_C12864_F_4W_HW_SPI u8g2(U8G2_R0, 0, 0, 0);
+GlyphFont                          glyphs;
+const LayoutFonts                  fonts = {
+    { u8g2_font_t0_13_tf, u8g2_font_t0_13_tf, u8g2_font_t0_13_tf },
+    {            &glyphs,            &glyphs,            &glyphs },
+    {            &glyphs,            &glyphs,            &glyphs },
+};
+SparkSeries<LAYOUT_SPARK_WIDTH>    spark(COLUMN_MS);
+
+static bool sparkColumns(uint8_t slot, SparkColumn *out, uint16_t width, Fixed *low, Fixed *high) {
+    spark.expire(millis());
+    if(slot != 1 || !spark.columns(millis(), out, width))
+        return false;
+    *low  = spark.minimum();
+    *high = spark.maximum();
+    return true;
+}
+
+// update() and draw() like render() does, returns what was drawn
+static uint32_t frame(ScreenLayout &screen, const ValueTable &values) {
+    uint32_t changed = screen.update(values);
+    if(changed != 0)
+        screen.draw(u8g2, fonts, changed);
+    return changed;
+}
+
+void setUp() {
+    fakeSetMicros(0);
+}
+
+void tearDown() {}
+
+static const char *chromeLayout = "page\n"
+                                  "frame 0 0 64 64\n"
+                                  "label 3 8 tiny 1 CO\n"
+                                  "value 1 28 big -2 0 1 1 10 43 21\n"
+                                  "trend 37 3 4 32 0.15\n"
+                                  "frame 63 0 65 32\n"
+                                  "label 66 12 small 0 CWU\n"
+                                  "value 66 28 small -1 1 2 66 17 60 12\n"
+                                  "spark 64 33 64 31 1\n"
+                                  "page\n"
+                                  "label 0 10 small 0 Other\n";
+
+static void test_partial_frames_match_full_redraw() {
+    ScreenLayout screen, reference;
+    ValueTable   values;
+    TEST_ASSERT_TRUE(screen.parse(chromeLayout));
+    TEST_ASSERT_TRUE(reference.parse(chromeLayout));
+    screen.setSparkSource(sparkColumns, COLUMN_MS);
+    reference.setSparkSource(sparkColumns, COLUMN_MS);
+    frame(screen, values);
+
+    static uint8_t composed[FRAME_BUFFER_SIZE];
+    srand(8);
+    for(uint32_t i = 0; i < 500; i++) {
+        uint8_t slot = rand() % 3;
+        Fixed   value = rand() % 200000 - 100000;
+        values.write(slot == 2 ? SLOT_CO_SLOPE : slot, value, millis());
+        if(slot == 1)
+            spark.add(millis(), value);
+        fakeAdvanceMillis(rand() % 20000);
+        if(i % 100 == 50) {
+            screen.showPage(1); // away and back rebuilds the chrome layer
+            frame(screen, values);
+            screen.showPage(0);
+        }
+        frame(screen, values);
+        memcpy(composed, u8g2.getBufferPtr(), FRAME_BUFFER_SIZE);
+
+        u8g2.clearBuffer();
+        reference.invalidate();
+        frame(reference, values);
+        TEST_ASSERT_EQUAL_MEMORY(u8g2.getBufferPtr(), composed, FRAME_BUFFER_SIZE);
+        memcpy(u8g2.getBufferPtr(), composed, FRAME_BUFFER_SIZE); // the next partial frame starts from it
+    }
+    uint32_t lit = 0;
+    for(uint16_t i = 0; i < FRAME_BUFFER_SIZE; i++)
+        lit += __builtin_popcount(composed[i]);
+    TEST_ASSERT_GREATER_THAN(300, lit); // frames, text and bars all drew something
+}
+
+static void test_first_frame_draws_everything() {
+    ScreenLayout screen;
+    ValueTable   values;
+    TEST_ASSERT_TRUE(screen.parse(layout));
+    TEST_ASSERT_EQUAL_HEX32(0x3, frame(screen, values));
+    TEST_ASSERT_EQUAL_HEX32(0, frame(screen, values));
+}
+
+static void test_value_redraws_only_when_shown_digits_change() {
+    ScreenLayout screen;
+    ValueTable   values;
+    TEST_ASSERT_TRUE(screen.parse(layout));
+    frame(screen, values);
+
+    values.write(0, fixedFromFloat(21.5f), millis());
+    TEST_ASSERT_EQUAL_HEX32(0x1, frame(screen, values));
+    values.write(0, fixedFromFloat(21.51f), millis()); // same with one decimal
+    TEST_ASSERT_EQUAL_HEX32(0, frame(screen, values));
+}
+
+static void test_quiet_sparkline_scrolls_with_time() {
+    ScreenLayout screen;
+    ValueTable   values;
+    TEST_ASSERT_TRUE(screen.parse(layout));
+    screen.setSparkSource(sparkColumns, COLUMN_MS);
+    spark.add(millis(), fixedFromFloat(1.0f));
+    values.write(1, fixedFromFloat(1.0f), millis());
+    frame(screen, values);
+
+    // No sample for a whole column: the line still moves one pixel left
+    fakeAdvanceMillis(COLUMN_MS / 2);
+    TEST_ASSERT_EQUAL_HEX32(0, frame(screen, values));
+    fakeAdvanceMillis(COLUMN_MS / 2);
+    TEST_ASSERT_EQUAL_HEX32(0x2, frame(screen, values));
+    TEST_ASSERT_EQUAL_HEX32(0, frame(screen, values));
+
+    // And is cleared once its only column expires
+    fakeAdvanceMillis(LAYOUT_SPARK_WIDTH * COLUMN_MS);
+    TEST_ASSERT_EQUAL_HEX32(0x2, frame(screen, values));
+    SparkColumn columns[LAYOUT_SPARK_WIDTH];
+    Fixed       low, high;
+    TEST_ASSERT_FALSE(sparkColumns(1, columns, LAYOUT_SPARK_WIDTH, &low, &high));
+}
+
+static void test_sparkline_redraws_on_new_sample() {
+    ScreenLayout screen;
+    ValueTable   values;
+    TEST_ASSERT_TRUE(screen.parse(layout));
+    screen.setSparkSource(sparkColumns, COLUMN_MS);
+    frame(screen, values);
+
+    values.write(1, fixedFromFloat(2.0f), millis());
+    TEST_ASSERT_EQUAL_HEX32(0x2, frame(screen, values));
+}
+
+int main(int argc, char **argv) {
+    u8g2.begin();
+    glyphs.build(u8g2, u8g2_font_t0_13_tf);
+    UNITY_BEGIN();
+    RUN_TEST(test_first_frame_draws_everything);
+    RUN_TEST(test_value_redraws_only_when_shown_digits_change);
+    RUN_TEST(test_quiet_sparkline_scrolls_with_time);
+    RUN_TEST(test_sparkline_redraws_on_new_sample);
+    RUN_TEST(test_partial_frames_match_full_redraw);
+    return UNITY_END();
+}
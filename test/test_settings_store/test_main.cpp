@@ -0,0 +1,214 @@
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <unity.h>
+
+#include "fakes.h"
+#include "settings_store.h"
+
+struct TestSettings {
+        char     server[16];
+        uint32_t port;
+        float    speed;
+        uint8_t  contrast;
+};
+
+#define TEST_FIELD(id, member) { id, 1, sizeof(((TestSettings *) 0)->member), offsetof(TestSettings, member), -1, NULL }
+
+const SettingsField testFields[] = {
+    TEST_FIELD(1, server),
+    TEST_FIELD(2, port),
+    TEST_FIELD(3, speed),
+    TEST_FIELD(4, contrast),
+};
+
+#define FIELD_COUNT (sizeof(testFields) / sizeof(testFields[0]))
+
+static TestSettings defaults() {
+    TestSettings settings = {};
+    strcpy(settings.server, "broker");
+    settings.port     = 1883;
+    settings.speed    = 500.0f;
+    settings.contrast = 20;
+    return settings;
+}
+
+// What the next boot sees
+static TestSettings reload(SettingsStoreStats *stats = NULL) {
+    TestSettings  settings = defaults();
+    SettingsStore store(&settings, sizeof(settings), testFields, FIELD_COUNT);
+    store.load();
+    if(stats != NULL)
+        *stats = store.stats;
+    return settings;
+}
+
+void setUp() {
+    fakeFsReset();
+}
+
+void tearDown() {}
+
+static void test_fresh_filesystem_stores_defaults() {
+    SettingsStoreStats stats;
+    reload(&stats);
+    TEST_ASSERT_TRUE(LittleFS.exists(SETTINGS_SNAPSHOT_FILE));
+    TEST_ASSERT_EQUAL_UINT32(1, stats.compactions);
+
+    TestSettings loaded = reload(&stats);
+    TestSettings expected = defaults();
+    TEST_ASSERT_EQUAL_MEMORY(&expected, &loaded, sizeof(loaded));
+    TEST_ASSERT_EQUAL_UINT32(0, stats.compactions);
+}
+
+static void test_only_changed_fields_are_journaled() {
+    TestSettings  settings = defaults();
+    SettingsStore store(&settings, sizeof(settings), testFields, FIELD_COUNT);
+    store.load();
+
+    settings.speed = 750.0f;
+    store.requestSave();
+    store.flush();
+    TEST_ASSERT_EQUAL_UINT32(1, store.stats.fieldsWritten - FIELD_COUNT); // the snapshot wrote all of them once
+    TEST_ASSERT_TRUE(LittleFS.exists(SETTINGS_JOURNAL_FILE));
+
+    store.requestSave(); // nothing changed since
+    store.flush();
+    TEST_ASSERT_EQUAL_UINT32(1, store.stats.fieldsWritten - FIELD_COUNT);
+
+    TestSettings loaded = reload();
+    TEST_ASSERT_EQUAL_FLOAT(750.0f, loaded.speed);
+}
+
+static void test_saves_are_deferred_until_quiet() {
+    fakeSetMicros(0);
+    TestSettings  settings = defaults();
+    SettingsStore store(&settings, sizeof(settings), testFields, FIELD_COUNT);
+    store.load();
+    uint32_t writes = store.stats.flashWrites;
+
+    for(uint32_t i = 0; i < 20; i++) {
+        settings.contrast = i;
+        store.requestSave();
+        fakeAdvanceMillis(100);
+        store.loop();
+    }
+    TEST_ASSERT_TRUE(store.isPending());
+    TEST_ASSERT_EQUAL_UINT32(writes, store.stats.flashWrites);
+
+    fakeAdvanceMillis(SETTINGS_FLUSH_DELAY);
+    store.loop();
+    TEST_ASSERT_FALSE(store.isPending());
+    TEST_ASSERT_EQUAL_UINT32(writes + 1, store.stats.flashWrites);
+    TEST_ASSERT_EQUAL_UINT8(19, reload().contrast);
+}
+
+static void test_journal_is_folded_into_snapshot() {
+    TestSettings  settings = defaults();
+    SettingsStore store(&settings, sizeof(settings), testFields, FIELD_COUNT);
+    store.load();
+
+    for(uint32_t i = 0; i < 200; i++) {
+        settings.port = 2000 + i;
+        store.requestSave();
+        store.flush();
+    }
+    TEST_ASSERT_GREATER_THAN(1, store.stats.compactions);
+
+    File journal = LittleFS.open(SETTINGS_JOURNAL_FILE, "r");
+    TEST_ASSERT_LESS_OR_EQUAL(SETTINGS_JOURNAL_LIMIT, journal ? journal.size() : 0);
+    TEST_ASSERT_EQUAL_UINT32(2199, reload().port);
+}
+
+static void test_saves_after_torn_append_survive() {
+    TestSettings  settings = defaults();
+    SettingsStore store(&settings, sizeof(settings), testFields, FIELD_COUNT);
+    store.load();
+    settings.port = 8883;
+    store.requestSave();
+    store.flush();
+
+    // Power is cut halfway through the next record
+    settings.speed = 900.0f;
+    store.requestSave();
+    fakeFsTearAfter(6);
+    store.flush();
+    fakeFsRestore();
+
+    // Next boot: the torn record is dropped and the journal rewritten
+    TestSettings       booted = defaults();
+    SettingsStoreStats stats;
+    SettingsStore      next(&booted, sizeof(booted), testFields, FIELD_COUNT);
+    next.load();
+    TEST_ASSERT_EQUAL_UINT32(1, next.stats.badRecords);
+    TEST_ASSERT_EQUAL_UINT32(8883, booted.port);
+    TEST_ASSERT_EQUAL_FLOAT(500.0f, booted.speed);
+
+    // Everything saved from here on has to be readable on the boot after
+    booted.contrast = 33;
+    next.requestSave();
+    next.flush();
+
+    TestSettings loaded = reload(&stats);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.badRecords);
+    TEST_ASSERT_EQUAL_UINT32(8883, loaded.port);
+    TEST_ASSERT_EQUAL_UINT8(33, loaded.contrast);
+}
+
+static void test_bad_crc_in_journal_keeps_later_saves() {
+    TestSettings  settings = defaults();
+    SettingsStore store(&settings, sizeof(settings), testFields, FIELD_COUNT);
+    store.load();
+    settings.port = 1000;
+    store.requestSave();
+    store.flush();
+    settings.speed = 1.5f;
+    store.requestSave();
+    store.flush();
+
+    // Flip a data bit of the first journal record (after magic and header)
+    TEST_ASSERT_TRUE(fakeFsCorrupt(SETTINGS_JOURNAL_FILE, 4 + 4, 0x01));
+
+    TestSettings  booted = defaults();
+    SettingsStore next(&booted, sizeof(booted), testFields, FIELD_COUNT);
+    next.load();
+    TEST_ASSERT_EQUAL_UINT32(1, next.stats.badRecords);
+    TEST_ASSERT_EQUAL_UINT32(1883, booted.port); // records from the bad one on are lost
+
+    booted.contrast = 44;
+    next.requestSave();
+    next.flush();
+
+    SettingsStoreStats stats;
+    TestSettings       loaded = reload(&stats);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.badRecords);
+    TEST_ASSERT_EQUAL_UINT8(44, loaded.contrast);
+}
+
+static void test_unknown_and_mismatched_records_keep_defaults() {
+    // A snapshot of a layout where id 3 was a uint8_t and id 9 existed
+    const SettingsField oldFields[] = {
+        { 3, 1, 1, offsetof(TestSettings, contrast), -1, NULL },
+        { 9, 1, 4, offsetof(TestSettings, port), -1, NULL },
+    };
+    TestSettings  old = defaults();
+    old.contrast      = 77;
+    old.port          = 4242;
+    SettingsStore writer(&old, sizeof(old), oldFields, 2);
+    writer.load();
+
+    TestSettings loaded   = reload();
+    TestSettings expected = defaults();
+    TEST_ASSERT_EQUAL_MEMORY(&expected, &loaded, sizeof(loaded));
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_fresh_filesystem_stores_defaults);
+    RUN_TEST(test_only_changed_fields_are_journaled);
+    RUN_TEST(test_saves_are_deferred_until_quiet);
+    RUN_TEST(test_journal_is_folded_into_snapshot);
+    RUN_TEST(test_saves_after_torn_append_survive);
+    RUN_TEST(test_bad_crc_in_journal_keeps_later_saves);
+    RUN_TEST(test_unknown_and_mismatched_records_keep_defaults);
+    return UNITY_END();
+}
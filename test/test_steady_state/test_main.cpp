@@ -0,0 +1,227 @@
+#include <Arduino.h>
+#include <U8g2lib.h>
+#include <atomic>
+#include <thread>
+#include <unity.h>
+
+#include "display_transport.h"
+#include "fakes.h"
+#include "gesture_recognizer.h"
+#include "glyph_atlas.h"
+#include "payload_parser.h"
+#include "publish_governor.h"
+#include "screen_layout.h"
+#include "series_stats.h"
+#include "spark_series.h"
+#include "step_ramp.h"
+#include "subscriptions.h"
+#include "value_table.h"
+
+// An hour of the strict tasks' steady state on the fake clock: MQTT
+// readings every 10 s dispatched to their slots, trends and publish
+// governing, button gestures, a feed's step ramp, and the screen updated
+// and flushed every 10 ms. malloc, calloc and realloc are counted on this
+// thread once everything is set up, like env:alloc_guard does on the
+// board; the count has to stay at zero. Counting relies on glibc's
+// __libc_* entry points, elsewhere the test is ignored.
+
+#if defined(__GLIBC__)
+#define COUNT_ALLOCATIONS 1
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+}
+
+static thread_local bool counting = false;
+static std::atomic<uint32_t> allocations(0);
+
+extern "C" void *malloc(size_t size) {
+    if(counting)
+        allocations++;
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size) {
+    if(counting)
+        allocations++;
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *pointer, size_t size) {
+    if(counting && size > 0)
+        allocations++;
+    return __libc_realloc(pointer, size);
+}
+#else
+#define COUNT_ALLOCATIONS 0
+#endif
+
+#define SPARK_SPAN_MS (3 * 60 * 60 * 1000UL)
+
+class NullTransport : public DisplayTransport {
+    public:
+        void writeTiles(uint8_t tx, uint8_t page, uint8_t count, uint8_t *tiles) override {}
+        void setContrast(uint8_t value) override {}
+};
+
+typedef SeriesStats<32> TrendSeries;
+
+U8G2_ST7565_NHD_C12864_F_4W_HW_SPI u8g2(U8G2_R0, 0, 0, 0);
+NullTransport                      transport;
+DisplayFlusher                     flusher(u8g2, transport);
+GlyphFont                          glyphs;
+const LayoutFonts                  fonts = {
+    { u8g2_font_t0_13_tf, u8g2_font_t0_13_tf, u8g2_font_t0_13_tf },
+    {            &glyphs,            &glyphs,            &glyphs },
+    {            &glyphs,            &glyphs,            &glyphs },
+};
+ScreenLayout                       screenLayout;
+ValueTable                         values;
+SubscriptionRegistry               subscriptions;
+SparkSeries<LAYOUT_SPARK_WIDTH>    sparks[2] = { SparkSeries<LAYOUT_SPARK_WIDTH>(SPARK_SPAN_MS / LAYOUT_SPARK_WIDTH),
+                                                 SparkSeries<LAYOUT_SPARK_WIDTH>(SPARK_SPAN_MS / LAYOUT_SPARK_WIDTH) };
+TrendSeries                        trends[2] = { TrendSeries(15 * 60 * 1000UL, 0.2f), TrendSeries(15 * 60 * 1000UL, 0.2f) };
+PublishGovernor                    governor;
+GestureRecognizer                  gestures;
+StepRamp                           ramp;
+uint32_t                           publishes = 0;
+uint32_t                           gestureCount = 0;
+
+static const char layout[] = "page\n"
+                             "frame 0 0 45 64\n"
+                             "label 3 8 tiny 1 CO\n"
+                             "value 1 28 big -2 0 1 1 10 43 21\n"
+                             "trend 37 3 4 32 0.15\n"
+                             "value 1 51 big -2 1 1 1 33 43 20\n"
+                             "spark 46 0 82 30 0\n"
+                             "spark 46 34 82 30 1\n";
+
+static bool sparkColumns(uint8_t slot, SparkColumn *out, uint16_t width, Fixed *low, Fixed *high) {
+    if(slot > 1)
+        return false;
+    sparks[slot].expire(millis());
+    if(!sparks[slot].columns(millis(), out, width))
+        return false;
+    *low  = sparks[slot].minimum();
+    *high = sparks[slot].maximum();
+    return true;
+}
+
+static bool countPublish(void *entity, float value) {
+    publishes++;
+    return true;
+}
+
+struct Message {
+        const char *payload;
+        uint16_t    length;
+};
+
+static void onSlot(uint8_t slot, void *context) {
+    const Message *message  = static_cast<const Message *>(context);
+    const char    *jsonPath = subscriptions.jsonPath(slot);
+    Fixed          value;
+    bool           parsed   = jsonPath[0] != '\0' ? jsonExtractNumber(message->payload, message->length, jsonPath, &value)
+                                                  : parseNumber(message->payload, message->length, &value);
+    if(!parsed || slot > 1)
+        return;
+    sparks[slot].add(millis(), value);
+    values.write(slot, value, millis());
+    trends[slot].add(millis(), fixedToFloat(value));
+    values.write(VALUE_SLOT_COUNT + slot, fixedFromFloat(trends[slot].slope()), millis());
+    governor.update(slot * 2, trends[slot].ewma(), millis());
+    governor.update(slot * 2 + 1, trends[slot].slope(), millis());
+}
+
+static void onGesture(const Gesture &gesture, void *context) {
+    gestureCount++;
+}
+
+// The flusher runs on its own thread; waiting for it before each submit
+// makes the frame count independent of when that thread gets the CPU
+static void waitPresented() {
+    while(flusher.isBusy())
+        std::this_thread::yield();
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+static void test_an_hour_without_the_heap() {
+#if COUNT_ALLOCATIONS
+    fakeSetMicros(0);
+    u8g2.begin();
+    glyphs.build(u8g2, u8g2_font_t0_13_tf);
+    TEST_ASSERT_TRUE(screenLayout.parse(layout));
+    screenLayout.setSparkSource(sparkColumns, SPARK_SPAN_MS / LAYOUT_SPARK_WIDTH);
+    flusher.begin();
+    TEST_ASSERT_TRUE(subscriptions.set(0, "boiler/co/temperature"));
+    TEST_ASSERT_TRUE(subscriptions.set(1, "zigbee2mqtt/boiler/cwu", "state.temperature"));
+    const PublishPolicy policy = { 0.05f, 30000, 300000 };
+    for(uint8_t handle = 0; handle < 4; handle++)
+        governor.add(handle, countPublish, NULL, policy);
+    ramp.configure(1600, 3200);
+
+    char     co[16], cwu[64];
+    uint32_t frames = 0, steps = 0;
+    counting = true;
+    for(uint32_t tick = 0; tick < 60 * 60 * 100; tick++) {
+        uint32_t now = millis();
+
+        if(tick % 1000 == 0) {
+            int     length  = snprintf(co, sizeof(co), "%d.%d", (int) (40 + tick / 1000 % 20), (int) (tick % 10));
+            Message message = { co, (uint16_t) length };
+            subscriptions.dispatch("boiler/co/temperature", onSlot, &message);
+            length  = snprintf(cwu, sizeof(cwu), "{\"battery\":97,\"state\":{\"temperature\":%d.5}}", (int) (45 + tick / 3000 % 7));
+            message = { cwu, (uint16_t) length };
+            subscriptions.dispatch("zigbee2mqtt/boiler/cwu", onSlot, &message);
+            subscriptions.dispatch("home/unrelated", onSlot, &message);
+        }
+        governor.loop(now);
+
+        // A button press every 30 s
+        if(tick % 3000 == 0 || tick % 3000 == 10) {
+            ButtonEdge edge = { 0, (uint8_t) (tick % 3000 == 0), (uint32_t) micros() };
+            gestures.feed(edge, micros(), onGesture, NULL);
+        }
+        gestures.poll(micros(), onGesture, NULL);
+
+        // A feed every 15 minutes, its pulses computed as the ISR would
+        if(tick % 90000 == 0)
+            ramp.start(3200);
+        for(uint8_t i = 0; i < 16 && ramp.isRunning(); i++)
+            if(ramp.next() != 0)
+                steps++;
+
+        uint32_t changed = screenLayout.update(values);
+        if(changed != 0) {
+            waitPresented();
+            screenLayout.draw(u8g2, fonts, changed);
+            if(flusher.submit() != 0)
+                frames++;
+        }
+        fakeAdvanceMillis(10);
+    }
+    counting = false;
+
+    TEST_ASSERT_EQUAL_UINT32(0, allocations.load());
+    // One per reading, plus the spark column roll overs that fall between
+    // readings: 42 of them in the hour, 2 on a reading's tick
+    const uint32_t rollOvers = 60 * 60 * 1000UL / (SPARK_SPAN_MS / LAYOUT_SPARK_WIDTH);
+    TEST_ASSERT_EQUAL_UINT32(42, rollOvers);
+    TEST_ASSERT_EQUAL_UINT32(360 + rollOvers - 2, frames);
+    TEST_ASSERT_GREATER_THAN(0, publishes);
+    TEST_ASSERT_GREATER_THAN(100, gestureCount);
+    TEST_ASSERT_GREATER_THAN(3 * 3200, steps);
+#else
+    TEST_IGNORE_MESSAGE("allocation counting needs glibc");
+#endif
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_an_hour_without_the_heap);
+    return UNITY_END();
+}
@@ -0,0 +1,163 @@
+#include <Arduino.h>
+#include <AccelStepper.h>
+#include <vector>
+#include <unity.h>
+
+#include "fakes.h"
+#include "step_ramp.h"
+
+// StepRamp against the AccelStepper timing it replaced: same step count,
+// the same intervals while accelerating and about the same move time.
+// AccelStepper truncates every interval to whole microseconds and ends a
+// move on one longer pulse, so totals differ by a few tenths of a percent
+// at most.
+
+static std::vector<uint32_t> rampIntervals(uint32_t speed, uint32_t accel, uint32_t steps) {
+    StepRamp ramp;
+    ramp.configure(speed, accel);
+    ramp.start(steps);
+    std::vector<uint32_t> intervals;
+    uint32_t              interval;
+    while((interval = ramp.next()) != 0)
+        intervals.push_back(interval);
+    return intervals;
+}
+
+// AccelStepper steps when polled, so poll it every microsecond
+static std::vector<uint32_t> referenceIntervals(uint32_t speed, uint32_t accel, uint32_t steps) {
+    fakeSetMicros(0);
+    AccelStepper stepper;
+    stepper.setMaxSpeed(speed);
+    stepper.setAcceleration(accel);
+    stepper.move(steps);
+    while(stepper.run())
+        fakeAdvanceMicros(1);
+
+    const std::vector<unsigned long> &times = stepper.stepTimes();
+    std::vector<uint32_t>             intervals;
+    for(size_t i = 1; i < times.size(); i++)
+        intervals.push_back(times[i] - times[i - 1]);
+    return intervals;
+}
+
+static uint64_t total(const std::vector<uint32_t> &intervals) {
+    uint64_t sum = 0;
+    for(uint32_t interval : intervals)
+        sum += interval;
+    return sum;
+}
+
+static void matchesReference(uint32_t speed, uint32_t accel, uint32_t steps) {
+    std::vector<uint32_t> ramp      = rampIntervals(speed, accel, steps);
+    std::vector<uint32_t> reference = referenceIntervals(speed, accel, steps);
+
+    // One interval less than steps: the first pulse is due right away
+    TEST_ASSERT_EQUAL_UINT32(steps - 1, ramp.size());
+    TEST_ASSERT_EQUAL_UINT32(steps - 1, reference.size());
+
+    for(size_t i = 0; i < ramp.size() / 3; i++)
+        TEST_ASSERT_UINT32_WITHIN(reference[i] / 200 + 1, reference[i], ramp[i]); // AccelStepper keeps cn as a float
+
+    double deviation = ((double) total(ramp) - (double) total(reference)) / total(reference);
+    TEST_ASSERT_FLOAT_WITHIN(0.005, 0.0, deviation);
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+static void test_matches_accelstepper_slow_feed() {
+    matchesReference(160, 320, 3200);
+}
+
+static void test_matches_accelstepper_long_ramp() {
+    matchesReference(1600, 100, 20000);
+}
+
+static void test_matches_accelstepper_fast() {
+    matchesReference(2000, 4000, 3200);
+}
+
+static void test_matches_accelstepper_short_moves() {
+    for(uint32_t steps = 2; steps < 40; steps += 3)
+        matchesReference(1000, 2000, steps);
+}
+
+static void test_cruises_at_max_speed() {
+    std::vector<uint32_t> intervals = rampIntervals(1000, 2000, 5000);
+    uint32_t              middle    = intervals[intervals.size() / 2];
+    TEST_ASSERT_UINT32_WITHIN(1, 1000, middle);
+    for(uint32_t interval : intervals)
+        TEST_ASSERT_GREATER_OR_EQUAL(999, interval); // never above max speed
+}
+
+static void test_speeds_up_then_brakes() {
+    std::vector<uint32_t> intervals = rampIntervals(800, 400, 4000);
+    size_t                count     = intervals.size();
+    for(size_t i = 1; i < 100; i++)
+        TEST_ASSERT_LESS_OR_EQUAL(intervals[i - 1], intervals[i]);
+    for(size_t i = count - 100; i < count; i++)
+        TEST_ASSERT_GREATER_OR_EQUAL(intervals[i - 1], intervals[i]);
+    TEST_ASSERT_GREATER_OR_EQUAL(intervals[0], intervals[count - 1]); // stops from as slow as it started
+}
+
+static void test_short_move_never_reaches_max_speed() {
+    std::vector<uint32_t> intervals = rampIntervals(5000, 1000, 50);
+    uint32_t              fastest   = UINT32_MAX;
+    for(uint32_t interval : intervals)
+        fastest = min(fastest, interval);
+    TEST_ASSERT_GREATER_THAN(1000000 / 5000, fastest);
+}
+
+static void test_stop_brakes_within_ramp() {
+    StepRamp ramp;
+    ramp.configure(1000, 1000);
+    ramp.start(100000);
+    uint32_t interval = 0;
+    for(uint32_t i = 0; i < 2000; i++)
+        interval = ramp.next();
+
+    uint32_t braking = ramp.stoppingSteps();
+    TEST_ASSERT_GREATER_THAN(0, braking);
+    ramp.stop();
+    TEST_ASSERT_LESS_OR_EQUAL(braking + 1, ramp.remaining());
+
+    uint32_t steps = 0, previous = interval, next;
+    while((next = ramp.next()) != 0) {
+        TEST_ASSERT_GREATER_OR_EQUAL(previous, next);
+        previous = next;
+        steps++;
+    }
+    TEST_ASSERT_EQUAL_UINT32(braking, steps);
+    TEST_ASSERT_FALSE(ramp.isRunning());
+}
+
+static void test_degenerate_moves() {
+    StepRamp ramp;
+    ramp.configure(1000, 1000);
+    ramp.start(0);
+    TEST_ASSERT_FALSE(ramp.isRunning());
+    TEST_ASSERT_EQUAL_UINT32(0, ramp.next());
+
+    ramp.start(1);
+    TEST_ASSERT_TRUE(ramp.isRunning());
+    TEST_ASSERT_EQUAL_UINT32(0, ramp.next()); // the only pulse was the last
+
+    ramp.configure(0, 0); // clamped, still a usable ramp
+    ramp.start(3);
+    TEST_ASSERT_GREATER_THAN(0, ramp.next());
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_matches_accelstepper_slow_feed);
+    RUN_TEST(test_matches_accelstepper_long_ramp);
+    RUN_TEST(test_matches_accelstepper_fast);
+    RUN_TEST(test_matches_accelstepper_short_moves);
+    RUN_TEST(test_cruises_at_max_speed);
+    RUN_TEST(test_speeds_up_then_brakes);
+    RUN_TEST(test_short_move_never_reaches_max_speed);
+    RUN_TEST(test_stop_brakes_within_ramp);
+    RUN_TEST(test_degenerate_moves);
+    return UNITY_END();
+}
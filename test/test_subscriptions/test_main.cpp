@@ -0,0 +1,129 @@
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <string.h>
+#include <unity.h>
+
+#include "fakes.h"
+#include "subscriptions.h"
+
+// The registry on its command parser, on a router that runs out of room
+// and on a topics file written by hand
+
+static SubscriptionRegistry registry;
+
+static void collect(uint8_t slot, void *context) {
+    *static_cast<uint32_t *>(context) |= 1UL << slot;
+}
+
+static uint32_t matchSlots(const char *topic) {
+    uint32_t slots = 0;
+    registry.dispatch(topic, collect, &slots);
+    return slots;
+}
+
+static int apply(const char *command) {
+    return registry.applyCommand((const uint8_t *) command, strlen(command));
+}
+
+// Two levels, long enough that the name pool runs out after a few dozen
+static void longFilter(char *filter, uint8_t slot) {
+    int length = snprintf(filter, TOPIC_MAX_LENGTH, "s%u/", slot);
+    memset(filter + length, 'x', TOPIC_MAX_LENGTH - 1 - length);
+    filter[TOPIC_MAX_LENGTH - 1] = '\0';
+}
+
+void setUp() {
+    fakeFsReset();
+    registry = SubscriptionRegistry();
+}
+
+void tearDown() {}
+
+static void test_commands() {
+    TEST_ASSERT_EQUAL_INT(12, apply("12 home/boiler/co"));
+    TEST_ASSERT_EQUAL_INT(5, apply("5 zigbee2mqtt/sensor humidity"));
+    TEST_ASSERT_EQUAL_STRING("humidity", registry.jsonPath(5));
+
+    TEST_ASSERT_EQUAL_INT(-1, apply("12abc/x"));      // the slot has to end in a space
+    TEST_ASSERT_EQUAL_INT(-1, apply("4294967301 t")); // used to wrap around to slot 5
+    TEST_ASSERT_EQUAL_INT(-1, apply("0012 t"));
+    TEST_ASSERT_EQUAL_INT(-1, apply("32 t"));
+    TEST_ASSERT_EQUAL_INT(-1, apply("3 a/#/b"));
+    TEST_ASSERT_EQUAL_INT(-1, apply("3"));
+    TEST_ASSERT_EQUAL_STRING("zigbee2mqtt/sensor", registry.filter(5));
+    TEST_ASSERT_EQUAL_STRING("", registry.filter(3));
+
+    TEST_ASSERT_EQUAL_INT(12, apply("12 -"));
+    TEST_ASSERT_EQUAL_STRING("", registry.filter(12));
+    TEST_ASSERT_EQUAL_HEX32(0, matchSlots("home/boiler/co"));
+    TEST_ASSERT_EQUAL_HEX32(1UL << 5, matchSlots("zigbee2mqtt/sensor"));
+}
+
+static void test_full_router_keeps_the_previous_filter() {
+    char    filter[TOPIC_MAX_LENGTH];
+    uint8_t slot = 0;
+    TEST_ASSERT_TRUE(registry.set(31, "kept/topic", "value"));
+    for(; slot < 31; slot++) {
+        longFilter(filter, slot);
+        if(!registry.set(slot, filter))
+            break;
+    }
+    TEST_ASSERT_LESS_THAN_UINT32(31, slot); // the name pool ran out first
+
+    // The rejected slot is untouched and everything before still routes
+    TEST_ASSERT_EQUAL_STRING("", registry.filter(slot));
+    TEST_ASSERT_FALSE(registry.set(31, filter + 1, "other"));
+    TEST_ASSERT_EQUAL_STRING("kept/topic", registry.filter(31));
+    TEST_ASSERT_EQUAL_STRING("value", registry.jsonPath(31));
+    TEST_ASSERT_EQUAL_HEX32(1UL << 31, matchSlots("kept/topic"));
+    for(uint8_t i = 0; i < slot; i++) {
+        longFilter(filter, i);
+        TEST_ASSERT_EQUAL_HEX32(1UL << i, matchSlots(filter));
+    }
+
+    // Freeing a slot makes room again
+    TEST_ASSERT_TRUE(registry.set(0, ""));
+    longFilter(filter, slot);
+    TEST_ASSERT_TRUE(registry.set(slot, filter));
+    TEST_ASSERT_EQUAL_HEX32(1UL << slot, matchSlots(filter));
+}
+
+static void test_load_skips_what_does_not_fit() {
+    File file = LittleFS.open(SUBSCRIPTIONS_FILE, "w");
+    char filter[TOPIC_MAX_LENGTH];
+    char line[TOPIC_MAX_LENGTH + 8];
+    const char *head = "# slot filter [json.path]\n4 zigbee2mqtt/sensor temperature\n5 zigbee2mqtt/sensor humidity\n";
+    file.write((const uint8_t *) head, strlen(head));
+    for(uint8_t slot = 6; slot < 32; slot++) {
+        longFilter(filter, slot);
+        int length = snprintf(line, sizeof(line), "%u %s\n", slot, filter);
+        file.write((const uint8_t *) line, length);
+    }
+    file.close();
+
+    TEST_ASSERT_TRUE(registry.load());
+    TEST_ASSERT_EQUAL_HEX32((1UL << 4) | (1UL << 5), matchSlots("zigbee2mqtt/sensor"));
+    TEST_ASSERT_EQUAL_STRING("temperature", registry.jsonPath(4));
+    TEST_ASSERT_EQUAL_STRING("humidity", registry.jsonPath(5));
+
+    // Every filter kept in the table is also routed
+    uint8_t kept = 0;
+    for(uint8_t slot = 6; slot < 32; slot++) {
+        longFilter(filter, slot);
+        if(registry.filter(slot)[0] == '\0')
+            continue;
+        TEST_ASSERT_EQUAL_STRING(filter, registry.filter(slot));
+        TEST_ASSERT_EQUAL_HEX32(1UL << slot, matchSlots(filter));
+        kept++;
+    }
+    TEST_ASSERT_GREATER_THAN_UINT32(0, kept);
+    TEST_ASSERT_LESS_THAN_UINT32(26, kept);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_commands);
+    RUN_TEST(test_full_router_keeps_the_previous_filter);
+    RUN_TEST(test_load_skips_what_does_not_fit);
+    return UNITY_END();
+}
@@ -0,0 +1,180 @@
+#include <Arduino.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <unity.h>
+
+#include "topic_router.h"
+
+// The trie against a direct reading of the MQTT matching rules, on fixed
+// cases and on random filters and topics over a small alphabet so that
+// wildcards, shared prefixes and empty levels keep colliding
+
+static std::vector<std::string> levelsOf(const std::string &text) {
+    std::vector<std::string> levels;
+    size_t                   start = 0;
+    for(;;) {
+        size_t slash = text.find('/', start);
+        levels.push_back(text.substr(start, slash == std::string::npos ? std::string::npos : slash - start));
+        if(slash == std::string::npos)
+            return levels;
+        start = slash + 1;
+    }
+}
+
+static bool referenceMatch(const std::string &filter, const std::string &topic) {
+    std::vector<std::string> f = levelsOf(filter), t = levelsOf(topic);
+    if(!topic.empty() && topic[0] == '$' && (filter[0] == '+' || filter[0] == '#'))
+        return false;
+    for(size_t i = 0; i < f.size(); i++) {
+        if(f[i] == "#")
+            return true; // also the parent level: "a/#" matches "a"
+        if(i == t.size())
+            return false;
+        if(f[i] != "+" && f[i] != t[i])
+            return false;
+    }
+    return f.size() == t.size();
+}
+
+struct Matches {
+        uint32_t slots; // bit per slot
+        uint8_t  calls;
+};
+
+static void collect(uint8_t slot, void *context) {
+    Matches *matches  = static_cast<Matches *>(context);
+    matches->slots   |= 1UL << slot;
+    matches->calls++;
+}
+
+static uint32_t matchSlots(const TopicRouter &router, const char *topic) {
+    Matches matches = {};
+    uint8_t count = router.match(topic, collect, &matches);
+    TEST_ASSERT_EQUAL_UINT8(matches.calls, count);
+    return matches.slots;
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+static void test_filter_validation() {
+    const char *valid[]   = { "a", "a/b", "+", "#", "a/+/c", "a/#", "+/+", "/a", "a/", "$SYS/#" };
+    const char *invalid[] = { "", "a+", "a/b+", "#/a", "a/#/b", "a/b#", "+a/b" };
+    for(const char *filter : valid)
+        TEST_ASSERT_TRUE_MESSAGE(TopicRouter::isValidFilter(filter), filter);
+    for(const char *filter : invalid)
+        TEST_ASSERT_FALSE_MESSAGE(TopicRouter::isValidFilter(filter), filter);
+}
+
+static void test_wildcards() {
+    TopicRouter router;
+    TEST_ASSERT_TRUE(router.add("home/boiler/co", 0));
+    TEST_ASSERT_TRUE(router.add("home/+/co", 1));
+    TEST_ASSERT_TRUE(router.add("home/#", 2));
+    TEST_ASSERT_TRUE(router.add("#", 3));
+    TEST_ASSERT_TRUE(router.add("home/boiler/cwu", 4));
+    TEST_ASSERT_FALSE(router.add("home/#/co", 5));
+
+    TEST_ASSERT_EQUAL_HEX32(0x0F, matchSlots(router, "home/boiler/co"));
+    TEST_ASSERT_EQUAL_HEX32(0x1C, matchSlots(router, "home/boiler/cwu"));
+    TEST_ASSERT_EQUAL_HEX32(0x0C, matchSlots(router, "home"));   // "home/#" covers its parent
+    TEST_ASSERT_EQUAL_HEX32(0x08, matchSlots(router, "homes/boiler/co"));
+    TEST_ASSERT_EQUAL_HEX32(0x0E, matchSlots(router, "home//co"));
+    TEST_ASSERT_EQUAL_HEX32(0x00, matchSlots(router, "$SYS/broker/uptime")); // wildcards skip $ topics
+}
+
+static void test_same_filter_feeds_every_slot() {
+    // One sensor topic read into two slots through different JSON paths
+    TopicRouter router;
+    TEST_ASSERT_TRUE(router.add("zigbee2mqtt/sensor", 4));
+    TEST_ASSERT_TRUE(router.add("zigbee2mqtt/sensor", 5));
+    TEST_ASSERT_TRUE(router.add("zigbee2mqtt/#", 31));
+    TEST_ASSERT_TRUE(router.add("zigbee2mqtt/sensor", 4)); // binding twice is harmless
+    TEST_ASSERT_FALSE(router.add("zigbee2mqtt/sensor", TOPIC_SLOT_COUNT));
+
+    Matches matches = {};
+    TEST_ASSERT_EQUAL_UINT8(3, router.match("zigbee2mqtt/sensor", collect, &matches));
+    TEST_ASSERT_EQUAL_HEX32((1UL << 4) | (1UL << 5) | (1UL << 31), matches.slots);
+
+    router.clear();
+    TEST_ASSERT_EQUAL_HEX32(0, matchSlots(router, "a/b"));
+}
+
+static void test_limits() {
+    TopicRouter router;
+    std::string deep = "a";
+    for(uint8_t i = 1; i < TOPIC_MAX_LEVELS; i++)
+        deep += "/a";
+    TEST_ASSERT_TRUE(router.add(deep.c_str(), 0));
+    TEST_ASSERT_EQUAL_HEX32(1, matchSlots(router, deep.c_str()));
+    TEST_ASSERT_FALSE(router.add((deep + "/a").c_str(), 1));
+    TEST_ASSERT_EQUAL_HEX32(0, matchSlots(router, (deep + "/a").c_str()));
+
+    // Filling the node pool fails cleanly and keeps what was added
+    router.clear();
+    char    filter[16];
+    uint8_t added = 0;
+    for(uint16_t i = 0; i < TOPIC_NODE_COUNT; i++) {
+        snprintf(filter, sizeof(filter), "n%u", i);
+        if(router.add(filter, i % 32))
+            added++;
+    }
+    TEST_ASSERT_EQUAL_UINT8(TOPIC_NODE_COUNT - 1, added); // the root takes one
+    TEST_ASSERT_EQUAL_HEX32(1UL << 5, matchSlots(router, "n5"));
+}
+
+static void test_random_filters_match_reference() {
+    static const char *const words[] = { "a", "b", "ab", "", "$x" };
+    srand(3);
+
+    for(uint32_t round = 0; round < 300; round++) {
+        TopicRouter              router;
+        std::vector<std::string> filters;
+        for(uint8_t slot = 0; slot < 24; slot++) {
+            std::string filter;
+            uint8_t     levels = 1 + rand() % 4;
+            for(uint8_t i = 0; i < levels; i++) {
+                if(i > 0)
+                    filter += '/';
+                uint8_t pick = rand() % 8;
+                if(pick == 0)
+                    filter += '+';
+                else if(pick == 1 && i == levels - 1)
+                    filter += '#';
+                else
+                    filter += words[rand() % 4]; // no $ in filters
+            }
+            if(filter.empty())
+                filter = "b"; // the one invalid filter this makes
+            filters.push_back(filter);
+            TEST_ASSERT_TRUE_MESSAGE(router.add(filter.c_str(), slot), filter.c_str());
+        }
+
+        for(uint8_t k = 0; k < 50; k++) {
+            std::string topic;
+            uint8_t     levels = 1 + rand() % 4;
+            for(uint8_t i = 0; i < levels; i++) {
+                if(i > 0)
+                    topic += '/';
+                topic += words[rand() % 5];
+            }
+            uint32_t expected = 0;
+            for(uint8_t slot = 0; slot < filters.size(); slot++)
+                if(referenceMatch(filters[slot], topic))
+                    expected |= 1UL << slot;
+            TEST_ASSERT_EQUAL_HEX32_MESSAGE(expected, matchSlots(router, topic.c_str()), topic.c_str());
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_filter_validation);
+    RUN_TEST(test_wildcards);
+    RUN_TEST(test_same_filter_feeds_every_slot);
+    RUN_TEST(test_limits);
+    RUN_TEST(test_random_filters_match_reference);
+    return UNITY_END();
+}
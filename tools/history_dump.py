@@ -0,0 +1,70 @@
+#!/usr/bin/env python3
+"""Dump HASS-Display history segments (/hist/t<tier>-<seq>.seg) as CSV.
+
+Copy the segment files off the LittleFS partition (e.g. with
+mklittlefs -u on a flash dump) and pass them, or a directory, here:
+
+    tools/history_dump.py hist/ > history.csv
+
+Layout matches include/history_log.h: batches of a 12 byte header
+(magic, count, tier, version, crc32) followed by 20 byte records.
+Batches with a bad CRC are reported on stderr and skipped.
+"""
+
+import os
+import struct
+import sys
+import zlib
+
+BATCH_MAGIC = 0x31424C48
+HEADER = struct.Struct("<IHBBI")
+RECORD = struct.Struct("<IBBHfff")
+
+
+def read_segment(path):
+    with open(path, "rb") as f:
+        data = f.read()
+
+    offset = 0
+    while offset + HEADER.size <= len(data):
+        magic, count, tier, version, crc = HEADER.unpack_from(data, offset)
+        if magic != BATCH_MAGIC:
+            print(f"{path}: lost framing at {offset}", file=sys.stderr)
+            return
+        offset += HEADER.size
+        body = data[offset:offset + count * RECORD.size]
+        offset += count * RECORD.size
+        if len(body) != count * RECORD.size:
+            print(f"{path}: truncated batch", file=sys.stderr)
+            return
+        if zlib.crc32(body) != crc:
+            print(f"{path}: CRC mismatch, batch skipped", file=sys.stderr)
+            continue
+        for i in range(count):
+            yield RECORD.unpack_from(body, i * RECORD.size)
+
+
+def segment_files(args):
+    for arg in args:
+        if os.path.isdir(arg):
+            for name in sorted(os.listdir(arg)):
+                if name.endswith(".seg"):
+                    yield os.path.join(arg, name)
+        else:
+            yield arg
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__, file=sys.stderr)
+        return 1
+
+    print("time,series,tier,count,mean,min,max")
+    for path in segment_files(sys.argv[1:]):
+        for time, series, tier, count, mean, lo, hi in read_segment(path):
+            print(f"{time},{series},{tier},{count},{mean:.3f},{lo:.3f},{hi:.3f}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())